@@ -0,0 +1,459 @@
+//------------------------------------------------------------------------------
+// CPU-only stand-in for libGenie, used to benchmark the binding itself
+//
+// Implements the GenieDialog_*, GenieEmbedding_*, GenieProfile_* and
+// GenieSampler_* calls made by ContextHolder and EmbeddingsHolder. Queries
+// emit tokens at a fixed pace instead of running a model. Each token is
+// "@<ns> ", where <ns> is the steady (CLOCK_MONOTONIC) time it was emitted,
+// so the JS side can measure how long the token took to reach its callback.
+//
+// Pacing is read from the environment when a dialog or embedding is created:
+//   GENIE_STUB_TTFT_MS        Delay before the first token        (default 50)
+//   GENIE_STUB_TOKEN_MS       Delay between tokens                (default 10)
+//   GENIE_STUB_TOKENS         Tokens generated per query          (default 64)
+//   GENIE_STUB_EMBEDDING_MS   Time per embedding                  (default 5)
+//   GENIE_STUB_EMBEDDING_DIM  Embedding dimension                 (default 1024)
+//   GENIE_STUB_SESSION_KB     Size of saved session files         (default 0)
+//------------------------------------------------------------------------------
+
+#include "GenieDialog.h"
+#include "GenieEmbedding.h"
+#include "GenieProfile.h"
+#include "GenieSampler.h"
+#include <chrono>
+#include <condition_variable>
+#include <cstdlib>
+#include <cstring>
+#include <fstream>
+#include <mutex>
+#include <sstream>
+#include <string>
+#include <thread>
+#include <vector>
+
+namespace {
+
+using Clock = std::chrono::steady_clock;
+
+double envNumber(const char *name, double fallback) {
+  const char *value = std::getenv(name);
+  if (!value || !*value) return fallback;
+  char *end = nullptr;
+  double parsed = std::strtod(value, &end);
+  return end == value || parsed < 0 ? fallback : parsed;
+}
+
+Clock::duration millis(double ms) {
+  return std::chrono::duration_cast<Clock::duration>(
+      std::chrono::duration<double, std::milli>(ms));
+}
+
+int64_t toMicros(Clock::duration d) {
+  return std::chrono::duration_cast<std::chrono::microseconds>(d).count();
+}
+
+struct StubProfile {
+  std::mutex mutex;
+  std::vector<std::string> events;
+
+  void add(const std::string &event) {
+    std::lock_guard<std::mutex> lock(mutex);
+    events.push_back(event);
+  }
+};
+
+struct StubConfig {
+  std::string json;
+  StubProfile *profile = nullptr;
+};
+
+struct StubSampler {
+  std::string config;
+};
+
+struct StubDialog {
+  StubProfile *profile = nullptr;
+  StubSampler sampler;
+  std::string stop_sequence;
+  size_t n_past = 0;
+  double ttft_ms;
+  double token_ms;
+  size_t tokens;
+  size_t session_kb;
+
+  std::mutex mutex;
+  std::condition_variable cv;
+  bool aborted = false;
+
+  // Sleeps until the deadline; true if aborted meanwhile
+  bool waitUntil(Clock::time_point deadline) {
+    std::unique_lock<std::mutex> lock(mutex);
+    return cv.wait_until(lock, deadline, [this] { return aborted; });
+  }
+};
+
+struct StubEmbedding {
+  StubProfile *profile = nullptr;
+  double embedding_ms;
+  size_t dim;
+};
+
+// Handles are opaque pointers; the SDK declares them as pointers to
+// incomplete structs
+template <typename T, typename Handle> T *unwrap(Handle handle) {
+  return static_cast<T *>(const_cast<void *>(static_cast<const void *>(handle)));
+}
+
+template <typename Handle, typename T> Handle wrap(T *ptr) {
+  return reinterpret_cast<Handle>(ptr);
+}
+
+Genie_Status_t createConfig(const char *str, StubConfig **config) {
+  if (!str || !config) return GENIE_STATUS_ERROR_INVALID_ARGUMENT;
+  const char *p = str;
+  while (*p == ' ' || *p == '\n' || *p == '\r' || *p == '\t') ++p;
+  if (*p != '{') return GENIE_STATUS_ERROR_JSON_FORMAT;
+  *config = new StubConfig{str, nullptr};
+  return GENIE_STATUS_SUCCESS;
+}
+
+std::string metric(double value, const char *unit) {
+  std::ostringstream ss;
+  ss << "{\"value\": " << value << ", \"unit\": \"" << unit << "\"}";
+  return ss.str();
+}
+
+} // namespace
+
+//------------------------------------------------------------------------------
+// Profile
+//------------------------------------------------------------------------------
+
+Genie_Status_t GenieProfile_create(const GenieProfileConfig_Handle_t configHandle,
+                                   GenieProfile_Handle_t *profileHandle) {
+  (void)configHandle;
+  if (!profileHandle) return GENIE_STATUS_ERROR_INVALID_ARGUMENT;
+  *profileHandle = wrap<GenieProfile_Handle_t>(new StubProfile());
+  return GENIE_STATUS_SUCCESS;
+}
+
+Genie_Status_t GenieProfile_getJsonData(const GenieProfile_Handle_t profileHandle,
+                                        Genie_AllocCallback_t callback,
+                                        const char **jsonData) {
+  StubProfile *profile = unwrap<StubProfile>(profileHandle);
+  if (!profile || !callback || !jsonData) return GENIE_STATUS_ERROR_INVALID_ARGUMENT;
+  std::ostringstream ss;
+  ss << "{\"header\": {\"artifact_type\": \"GENIE_PROFILE\", \"stub\": true}, "
+     << "\"components\": [{\"name\": \"stub\", \"type\": \"dialog\", \"events\": [";
+  {
+    std::lock_guard<std::mutex> lock(profile->mutex);
+    for (size_t i = 0; i < profile->events.size(); ++i) {
+      if (i > 0) ss << ", ";
+      ss << profile->events[i];
+    }
+  }
+  ss << "]}]}";
+  std::string json = ss.str();
+  callback(json.size() + 1, jsonData);
+  if (!*jsonData) return GENIE_STATUS_ERROR_MEM_ALLOC;
+  std::memcpy(const_cast<char *>(*jsonData), json.c_str(), json.size() + 1);
+  return GENIE_STATUS_SUCCESS;
+}
+
+Genie_Status_t GenieProfile_free(const GenieProfile_Handle_t profileHandle) {
+  StubProfile *profile = unwrap<StubProfile>(profileHandle);
+  if (!profile) return GENIE_STATUS_ERROR_INVALID_HANDLE;
+  delete profile;
+  return GENIE_STATUS_SUCCESS;
+}
+
+//------------------------------------------------------------------------------
+// Dialog
+//------------------------------------------------------------------------------
+
+Genie_Status_t GenieDialogConfig_createFromJson(const char *str,
+                                                GenieDialogConfig_Handle_t *configHandle) {
+  if (!configHandle) return GENIE_STATUS_ERROR_INVALID_ARGUMENT;
+  StubConfig *config = nullptr;
+  Genie_Status_t status = createConfig(str, &config);
+  if (status == GENIE_STATUS_SUCCESS) *configHandle = wrap<GenieDialogConfig_Handle_t>(config);
+  return status;
+}
+
+Genie_Status_t GenieDialogConfig_bindProfiler(const GenieDialogConfig_Handle_t configHandle,
+                                              const GenieProfile_Handle_t profileHandle) {
+  StubConfig *config = unwrap<StubConfig>(configHandle);
+  if (!config) return GENIE_STATUS_ERROR_INVALID_HANDLE;
+  config->profile = unwrap<StubProfile>(profileHandle);
+  return GENIE_STATUS_SUCCESS;
+}
+
+Genie_Status_t GenieDialogConfig_free(const GenieDialogConfig_Handle_t configHandle) {
+  StubConfig *config = unwrap<StubConfig>(configHandle);
+  if (!config) return GENIE_STATUS_ERROR_INVALID_HANDLE;
+  delete config;
+  return GENIE_STATUS_SUCCESS;
+}
+
+Genie_Status_t GenieDialog_create(const GenieDialogConfig_Handle_t configHandle,
+                                  GenieDialog_Handle_t *dialogHandle) {
+  StubConfig *config = unwrap<StubConfig>(configHandle);
+  if (!config) return GENIE_STATUS_ERROR_INVALID_HANDLE;
+  if (!dialogHandle) return GENIE_STATUS_ERROR_INVALID_ARGUMENT;
+  StubDialog *dialog = new StubDialog();
+  dialog->profile = config->profile;
+  dialog->ttft_ms = envNumber("GENIE_STUB_TTFT_MS", 50);
+  dialog->token_ms = envNumber("GENIE_STUB_TOKEN_MS", 10);
+  dialog->tokens = static_cast<size_t>(envNumber("GENIE_STUB_TOKENS", 64));
+  dialog->session_kb = static_cast<size_t>(envNumber("GENIE_STUB_SESSION_KB", 0));
+  *dialogHandle = wrap<GenieDialog_Handle_t>(dialog);
+  return GENIE_STATUS_SUCCESS;
+}
+
+Genie_Status_t GenieDialog_query(const GenieDialog_Handle_t dialogHandle,
+                                 const char *queryStr,
+                                 const GenieDialog_SentenceCode_t sentenceCode,
+                                 const GenieDialog_QueryCallback_t callback,
+                                 const void *userData) {
+  (void)sentenceCode;
+  StubDialog *dialog = unwrap<StubDialog>(dialogHandle);
+  if (!dialog) return GENIE_STATUS_ERROR_INVALID_HANDLE;
+  if (!queryStr || !callback) return GENIE_STATUS_ERROR_INVALID_ARGUMENT;
+  {
+    std::lock_guard<std::mutex> lock(dialog->mutex);
+    dialog->aborted = false;
+  }
+
+  // Tokens follow a fixed schedule, so time spent in callbacks shows up as
+  // extra latency instead of shifting every later token
+  Clock::time_point start = Clock::now();
+  Clock::time_point firstToken = start + millis(dialog->ttft_ms);
+  size_t promptTokens = std::strlen(queryStr) / 4 + 1;
+  size_t generated = 0;
+  bool aborted = false;
+  Clock::duration ttft{};
+  for (size_t i = 0; i < dialog->tokens; ++i) {
+    if (dialog->waitUntil(firstToken + i * millis(dialog->token_ms))) {
+      aborted = true;
+      break;
+    }
+    Clock::time_point now = Clock::now();
+    if (i == 0) ttft = now - start;
+    std::string token = "@" + std::to_string(
+        std::chrono::duration_cast<std::chrono::nanoseconds>(now.time_since_epoch()).count()) + " ";
+    callback(token.c_str(), i == 0 ? GENIE_DIALOG_SENTENCE_BEGIN : GENIE_DIALOG_SENTENCE_CONTINUE, userData);
+    ++generated;
+  }
+  if (!aborted) {
+    std::lock_guard<std::mutex> lock(dialog->mutex);
+    aborted = dialog->aborted;
+  }
+  callback("", aborted ? GENIE_DIALOG_SENTENCE_ABORT : GENIE_DIALOG_SENTENCE_END, userData);
+  dialog->n_past += promptTokens + generated;
+
+  if (dialog->profile) {
+    Clock::duration total = Clock::now() - start;
+    Clock::duration decode = total - ttft;
+    double decodeSeconds = std::chrono::duration<double>(decode).count();
+    double ttftSeconds = std::chrono::duration<double>(ttft).count();
+    std::ostringstream ss;
+    ss << "{\"type\": \"GenieDialog_query\", \"duration\": " << toMicros(total)
+       << ", \"num-prompt-tokens\": " << metric(promptTokens, "")
+       << ", \"prompt-processing-rate\": " << metric(ttftSeconds > 0 ? promptTokens / ttftSeconds : 0, "toks/sec")
+       << ", \"time-to-first-token\": " << metric(toMicros(ttft), "us")
+       << ", \"num-generated-tokens\": " << metric(generated, "")
+       << ", \"token-generation-rate\": "
+       << metric(generated > 1 && decodeSeconds > 0 ? (generated - 1) / decodeSeconds : 0, "toks/sec")
+       << ", \"token-generation-time\": " << metric(toMicros(decode), "us") << "}";
+    dialog->profile->add(ss.str());
+  }
+  return aborted ? GENIE_STATUS_WARNING_ABORTED : GENIE_STATUS_SUCCESS;
+}
+
+Genie_Status_t GenieDialog_signal(const GenieDialog_Handle_t dialogHandle,
+                                  const GenieDialog_Action_t action) {
+  StubDialog *dialog = unwrap<StubDialog>(dialogHandle);
+  if (!dialog) return GENIE_STATUS_ERROR_INVALID_HANDLE;
+  if (action == GENIE_DIALOG_ACTION_ABORT) {
+    std::lock_guard<std::mutex> lock(dialog->mutex);
+    dialog->aborted = true;
+    dialog->cv.notify_all();
+  }
+  return GENIE_STATUS_SUCCESS;
+}
+
+Genie_Status_t GenieDialog_save(const GenieDialog_Handle_t dialogHandle, const char *path) {
+  StubDialog *dialog = unwrap<StubDialog>(dialogHandle);
+  if (!dialog) return GENIE_STATUS_ERROR_INVALID_HANDLE;
+  if (!path) return GENIE_STATUS_ERROR_INVALID_ARGUMENT;
+  std::ofstream out(path, std::ios::binary | std::ios::trunc);
+  if (!out) return GENIE_STATUS_ERROR_GENERAL;
+  out << "GENIE-STUB-SESSION " << dialog->n_past << "\n";
+  std::string padding(dialog->session_kb << 10, '\0');
+  out.write(padding.data(), padding.size());
+  return out ? GENIE_STATUS_SUCCESS : GENIE_STATUS_ERROR_GENERAL;
+}
+
+Genie_Status_t GenieDialog_restore(const GenieDialog_Handle_t dialogHandle, const char *path) {
+  StubDialog *dialog = unwrap<StubDialog>(dialogHandle);
+  if (!dialog) return GENIE_STATUS_ERROR_INVALID_HANDLE;
+  if (!path) return GENIE_STATUS_ERROR_INVALID_ARGUMENT;
+  std::ifstream in(path, std::ios::binary);
+  std::string magic;
+  size_t n_past = 0;
+  if (!(in >> magic >> n_past) || magic != "GENIE-STUB-SESSION") {
+    return GENIE_STATUS_ERROR_GENERAL;
+  }
+  dialog->n_past = n_past;
+  return GENIE_STATUS_SUCCESS;
+}
+
+Genie_Status_t GenieDialog_reset(const GenieDialog_Handle_t dialogHandle) {
+  StubDialog *dialog = unwrap<StubDialog>(dialogHandle);
+  if (!dialog) return GENIE_STATUS_ERROR_INVALID_HANDLE;
+  dialog->n_past = 0;
+  return GENIE_STATUS_SUCCESS;
+}
+
+Genie_Status_t GenieDialog_setStopSequence(const GenieDialog_Handle_t dialogHandle,
+                                           const char *newStopSequences) {
+  StubDialog *dialog = unwrap<StubDialog>(dialogHandle);
+  if (!dialog) return GENIE_STATUS_ERROR_INVALID_HANDLE;
+  dialog->stop_sequence = newStopSequences ? newStopSequences : "";
+  return GENIE_STATUS_SUCCESS;
+}
+
+Genie_Status_t GenieDialog_getSampler(const GenieDialog_Handle_t dialogHandle,
+                                      GenieSampler_Handle_t *dialogSamplerHandle) {
+  StubDialog *dialog = unwrap<StubDialog>(dialogHandle);
+  if (!dialog) return GENIE_STATUS_ERROR_INVALID_HANDLE;
+  if (!dialogSamplerHandle) return GENIE_STATUS_ERROR_INVALID_ARGUMENT;
+  *dialogSamplerHandle = wrap<GenieSampler_Handle_t>(&dialog->sampler);
+  return GENIE_STATUS_SUCCESS;
+}
+
+Genie_Status_t GenieDialog_applyLora(const GenieDialog_Handle_t dialogHandle,
+                                     const char *engine, const char *loraAdapterName) {
+  (void)engine;
+  (void)loraAdapterName;
+  return unwrap<StubDialog>(dialogHandle) ? GENIE_STATUS_SUCCESS : GENIE_STATUS_ERROR_INVALID_HANDLE;
+}
+
+Genie_Status_t GenieDialog_setLoraStrength(const GenieDialog_Handle_t dialogHandle,
+                                           const char *engine, const char *tensorName,
+                                           const float alpha) {
+  (void)engine;
+  (void)tensorName;
+  (void)alpha;
+  return unwrap<StubDialog>(dialogHandle) ? GENIE_STATUS_SUCCESS : GENIE_STATUS_ERROR_INVALID_HANDLE;
+}
+
+Genie_Status_t GenieDialog_free(const GenieDialog_Handle_t dialogHandle) {
+  StubDialog *dialog = unwrap<StubDialog>(dialogHandle);
+  if (!dialog) return GENIE_STATUS_ERROR_INVALID_HANDLE;
+  delete dialog;
+  return GENIE_STATUS_SUCCESS;
+}
+
+//------------------------------------------------------------------------------
+// Sampler
+//------------------------------------------------------------------------------
+
+Genie_Status_t GenieSamplerConfig_createFromJson(const char *str,
+                                                 GenieSamplerConfig_Handle_t *configHandle) {
+  if (!configHandle) return GENIE_STATUS_ERROR_INVALID_ARGUMENT;
+  StubConfig *config = nullptr;
+  Genie_Status_t status = createConfig(str, &config);
+  if (status == GENIE_STATUS_SUCCESS) *configHandle = wrap<GenieSamplerConfig_Handle_t>(config);
+  return status;
+}
+
+Genie_Status_t GenieSampler_applyConfig(const GenieSampler_Handle_t samplerHandle,
+                                        const GenieSamplerConfig_Handle_t configHandle) {
+  StubSampler *sampler = unwrap<StubSampler>(samplerHandle);
+  StubConfig *config = unwrap<StubConfig>(configHandle);
+  if (!sampler || !config) return GENIE_STATUS_ERROR_INVALID_HANDLE;
+  sampler->config = config->json;
+  return GENIE_STATUS_SUCCESS;
+}
+
+//------------------------------------------------------------------------------
+// Embedding
+//------------------------------------------------------------------------------
+
+Genie_Status_t GenieEmbeddingConfig_createFromJson(const char *str,
+                                                   GenieEmbeddingConfig_Handle_t *configHandle) {
+  if (!configHandle) return GENIE_STATUS_ERROR_INVALID_ARGUMENT;
+  StubConfig *config = nullptr;
+  Genie_Status_t status = createConfig(str, &config);
+  if (status == GENIE_STATUS_SUCCESS) *configHandle = wrap<GenieEmbeddingConfig_Handle_t>(config);
+  return status;
+}
+
+Genie_Status_t GenieEmbeddingConfig_bindProfiler(const GenieEmbeddingConfig_Handle_t configHandle,
+                                                 const GenieProfile_Handle_t profileHandle) {
+  StubConfig *config = unwrap<StubConfig>(configHandle);
+  if (!config) return GENIE_STATUS_ERROR_INVALID_HANDLE;
+  config->profile = unwrap<StubProfile>(profileHandle);
+  return GENIE_STATUS_SUCCESS;
+}
+
+Genie_Status_t GenieEmbeddingConfig_free(const GenieEmbeddingConfig_Handle_t configHandle) {
+  StubConfig *config = unwrap<StubConfig>(configHandle);
+  if (!config) return GENIE_STATUS_ERROR_INVALID_HANDLE;
+  delete config;
+  return GENIE_STATUS_SUCCESS;
+}
+
+Genie_Status_t GenieEmbedding_create(const GenieEmbeddingConfig_Handle_t configHandle,
+                                     GenieEmbedding_Handle_t *embeddingHandle) {
+  StubConfig *config = unwrap<StubConfig>(configHandle);
+  if (!config) return GENIE_STATUS_ERROR_INVALID_HANDLE;
+  if (!embeddingHandle) return GENIE_STATUS_ERROR_INVALID_ARGUMENT;
+  StubEmbedding *embedding = new StubEmbedding();
+  embedding->profile = config->profile;
+  embedding->embedding_ms = envNumber("GENIE_STUB_EMBEDDING_MS", 5);
+  embedding->dim = static_cast<size_t>(envNumber("GENIE_STUB_EMBEDDING_DIM", 1024));
+  *embeddingHandle = wrap<GenieEmbedding_Handle_t>(embedding);
+  return GENIE_STATUS_SUCCESS;
+}
+
+Genie_Status_t GenieEmbedding_generate(const GenieEmbedding_Handle_t embeddingHandle,
+                                       const char *queryStr,
+                                       const GenieEmbedding_GenerateCallback_t callback,
+                                       const void *userData) {
+  StubEmbedding *embedding = unwrap<StubEmbedding>(embeddingHandle);
+  if (!embedding) return GENIE_STATUS_ERROR_INVALID_HANDLE;
+  if (!queryStr || !callback) return GENIE_STATUS_ERROR_INVALID_ARGUMENT;
+  Clock::time_point start = Clock::now();
+
+  // Deterministic per prompt, so results can be compared across runs
+  uint64_t state = 1469598103934665603ull;
+  for (const char *p = queryStr; *p; ++p) state = (state ^ static_cast<uint8_t>(*p)) * 1099511628211ull;
+  std::vector<float> values(embedding->dim);
+  for (float &v : values) {
+    state ^= state << 13;
+    state ^= state >> 7;
+    state ^= state << 17;
+    v = static_cast<float>(static_cast<int32_t>(state >> 32)) / 2147483648.0f;
+  }
+  std::this_thread::sleep_until(start + millis(embedding->embedding_ms));
+
+  uint32_t dims[1] = {static_cast<uint32_t>(embedding->dim)};
+  callback(dims, 1, values.data(), userData);
+
+  if (embedding->profile) {
+    std::ostringstream ss;
+    ss << "{\"type\": \"GenieEmbedding_generate\", \"duration\": " << toMicros(Clock::now() - start)
+       << ", \"num-prompt-tokens\": " << metric(std::strlen(queryStr) / 4 + 1, "") << "}";
+    embedding->profile->add(ss.str());
+  }
+  return GENIE_STATUS_SUCCESS;
+}
+
+Genie_Status_t GenieEmbedding_free(const GenieEmbedding_Handle_t embeddingHandle) {
+  StubEmbedding *embedding = unwrap<StubEmbedding>(embeddingHandle);
+  if (!embedding) return GENIE_STATUS_ERROR_INVALID_HANDLE;
+  delete embedding;
+  return GENIE_STATUS_SUCCESS;
+}
@@ -0,0 +1,215 @@
+#!/usr/bin/env node
+// Query-path latency benchmark for the binding itself.
+//
+// Build against the CPU-only libGenie stand-in first (`npm run build:stub`),
+// which emits tokens on a fixed schedule and stamps each one with the time
+// it was produced. Anything measured beyond that schedule is overhead of
+// the Context / QueryWorker / ThreadSafeFunction path:
+//
+//   ttft            time to first token minus the stand-in's own delay
+//   token latency   emit (native thread) -> JS callback
+//   settle          last token -> query() promise resolved
+//   loop delay      event-loop lag while tokens stream in
+//   throughput      tokens/s with N contexts queried concurrently
+//
+// Usage: node bench/query-bench.js [--iterations 20] [--tokens 64]
+//          [--token-ms 10] [--ttft-ms 50] [--concurrency 1,2,4,8]
+//          [--embeddings 50] [--batch 1] [--json results.json]
+//
+// --batch 1 runs the query benchmarks with { batch: true } token delivery.
+
+const fs = require('fs');
+const { monitorEventLoopDelay } = require('perf_hooks');
+const { Context, Embedding } = require('..');
+
+const parseArgs = (argv) => {
+  const options = {
+    iterations: 20,
+    tokens: 64,
+    token_ms: 10,
+    ttft_ms: 50,
+    concurrency: [1, 2, 4, 8],
+    embeddings: 50,
+    batch: 0,
+    json: null,
+  };
+  for (let i = 0; i < argv.length; i++) {
+    const key = argv[i].replace(/^--/, '').replace(/-/g, '_');
+    const value = argv[++i];
+    if (!(key in options) || value === undefined) {
+      console.error(`Unknown or incomplete option ${argv[i - 1]}`);
+      process.exit(1);
+    }
+    if (key === 'json') options.json = value;
+    else if (key === 'concurrency') options.concurrency = value.split(',').map(Number);
+    else options[key] = Number(value);
+  }
+  return options;
+};
+
+const nowNs = () => process.hrtime.bigint();
+const msSince = (start) => Number(nowNs() - start) / 1e6;
+
+const percentile = (values, p) => {
+  if (values.length === 0) return 0;
+  const sorted = [...values].sort((a, b) => a - b);
+  return sorted[Math.min(sorted.length - 1, Math.floor((p / 100) * sorted.length))];
+};
+
+const summarize = (values) => ({
+  p50: percentile(values, 50),
+  p95: percentile(values, 95),
+  p99: percentile(values, 99),
+  max: values.length ? Math.max(...values) : 0,
+});
+
+const fmt = (s) => `p50 ${s.p50.toFixed(3)}  p95 ${s.p95.toFixed(3)}  p99 ${s.p99.toFixed(3)}  max ${s.max.toFixed(3)} ms`;
+
+const dialogConfig = { dialog: { version: 1, type: 'basic', stub: true } };
+const embeddingConfig = { embedding: { version: 1, stub: true } };
+
+const stubEnv = (options) => {
+  process.env.GENIE_STUB_TOKENS = String(options.tokens);
+  process.env.GENIE_STUB_TOKEN_MS = String(options.token_ms);
+  process.env.GENIE_STUB_TTFT_MS = String(options.ttft_ms);
+};
+
+// One query; token timestamps come from the stand-in's "@<ns> " tokens
+const runQuery = async (context, prompt, sample, batch, profile = false) => {
+  const start = nowNs();
+  let first = null;
+  let last = null;
+  let tokens = 0;
+  const profile = await context.query(prompt, (text) => {
+    const now = nowNs();
+    // Batched deliveries carry several tokens in one string
+    for (const token of (text || '').split(' ')) {
+      if (token[0] !== '@') continue;
+      if (first === null) first = now;
+      last = now;
+      tokens++;
+      if (sample) sample.token.push(Number(now - BigInt(token.slice(1))) / 1e6);
+    }
+  }, { batch, profile });
+  if (sample && first !== null) {
+    sample.ttft.push(Number(first - start) / 1e6);
+    sample.settle.push(msSince(last));
+  }
+  return { tokens, profile };
+};
+
+const benchSingle = async (options) => {
+  stubEnv(options);
+  const context = await Context.create(dialogConfig, { profile: true });
+  const { profile } = await runQuery(context, 'warm up', null, options.batch > 0, true);
+  if (!profile || !profile.header || !profile.header.stub) {
+    console.warn('Warning: not running against the libGenie stand-in, results include model time');
+  }
+  const sample = { ttft: [], token: [], settle: [] };
+  const loop = monitorEventLoopDelay({ resolution: 1 });
+  loop.enable();
+  for (let i = 0; i < options.iterations; i++) {
+    await runQuery(context, `prompt ${i}`, sample, options.batch > 0);
+  }
+  loop.disable();
+  await context.release();
+  return {
+    ttft_overhead: summarize(sample.ttft.map((t) => t - options.ttft_ms)),
+    token_latency: summarize(sample.token),
+    settle: summarize(sample.settle),
+    loop_delay: {
+      p50: loop.percentile(50) / 1e6,
+      p95: loop.percentile(95) / 1e6,
+      p99: loop.percentile(99) / 1e6,
+      max: loop.max / 1e6,
+    },
+  };
+};
+
+const benchConcurrent = async (options, n) => {
+  stubEnv(options);
+  const contexts = await Promise.all(Array.from({ length: n }, () => Context.create(dialogConfig)));
+  const sample = { ttft: [], token: [], settle: [] };
+  const loop = monitorEventLoopDelay({ resolution: 1 });
+  loop.enable();
+  const start = nowNs();
+  const counts = await Promise.all(contexts.map(async (context, c) => {
+    let tokens = 0;
+    for (let i = 0; i < options.iterations; i++) {
+      tokens += (await runQuery(context, `caller ${c} prompt ${i}`, sample, options.batch > 0)).tokens;
+    }
+    return tokens;
+  }));
+  const seconds = msSince(start) / 1000;
+  loop.disable();
+  await Promise.all(contexts.map((context) => context.release()));
+
+  const tokens = counts.reduce((a, b) => a + b, 0);
+  const ideal = (n * options.tokens) / ((options.ttft_ms + options.tokens * options.token_ms) / 1000);
+  return {
+    contexts: n,
+    tokens_per_sec: tokens / seconds,
+    efficiency: tokens / seconds / ideal,
+    token_latency: summarize(sample.token),
+    loop_delay_p99: loop.percentile(99) / 1e6,
+  };
+};
+
+const benchEmbedding = async (options) => {
+  const embedding_ms = 5;
+  process.env.GENIE_STUB_EMBEDDING_MS = String(embedding_ms);
+  const embedding = await Embedding.create(embeddingConfig);
+  const latency = [];
+  for (let i = 0; i < options.embeddings; i++) {
+    const start = nowNs();
+    await embedding.query(`embedding ${i}`, () => {});
+    latency.push(msSince(start) - embedding_ms);
+  }
+  // Same prompts through queryBatch: one worker, one result array
+  const prompts = Array.from({ length: options.embeddings }, (_, i) => `embedding ${i}`);
+  const start = nowNs();
+  await embedding.queryBatch(prompts);
+  const batch_overhead = (msSince(start) - options.embeddings * embedding_ms) / options.embeddings;
+  await embedding.release();
+  return { overhead: summarize(latency), batch_overhead };
+};
+
+const main = async () => {
+  const options = parseArgs(process.argv.slice(2));
+  const results = { options, node: process.version };
+
+  console.log(`${options.iterations} queries x ${options.tokens} tokens, ${options.ttft_ms} ms TTFT, ${options.token_ms} ms/token${options.batch ? ', batched' : ''}`);
+
+  results.single = await benchSingle(options);
+  console.log('\nSingle context');
+  console.log(`  ttft overhead  ${fmt(results.single.ttft_overhead)}`);
+  console.log(`  token latency  ${fmt(results.single.token_latency)}`);
+  console.log(`  settle         ${fmt(results.single.settle)}`);
+  console.log(`  loop delay     ${fmt(results.single.loop_delay)}`);
+
+  console.log('\nConcurrent contexts');
+  results.concurrent = [];
+  for (const n of options.concurrency) {
+    const r = await benchConcurrent(options, n);
+    results.concurrent.push(r);
+    console.log(`  ${String(n).padStart(3)}: ${r.tokens_per_sec.toFixed(0).padStart(6)} tok/s (${(r.efficiency * 100).toFixed(1)}% of ideal)  token p99 ${r.token_latency.p99.toFixed(3)} ms  loop p99 ${r.loop_delay_p99.toFixed(3)} ms`);
+  }
+
+  if (options.embeddings > 0 && typeof Embedding.create === 'function') {
+    results.embedding = await benchEmbedding(options);
+    console.log('\nEmbedding');
+    console.log(`  overhead       ${fmt(results.embedding.overhead)}`);
+    console.log(`  batch overhead ${results.embedding.batch_overhead.toFixed(3)} ms/item`);
+  }
+
+  if (options.json) fs.writeFileSync(options.json, JSON.stringify(results, null, 2));
+};
+
+main().then(
+  // Embedding query callbacks keep the event loop referenced, so exit explicitly
+  () => process.exit(0),
+  (e) => {
+    console.error(e);
+    process.exit(1);
+  },
+);
@@ -0,0 +1,532 @@
+//------------------------------------------------------------------------------
+// Standalone benchmark for the bundle unpack path (no Genie dependency)
+//
+// Generates synthetic QGENIE1 bundles and reports throughput of each stage
+// of the unpack path across thread counts:
+//   crc     CRC32 over the mapped bundle, split into 16 MiB chunks
+//   zstd    decompression of every frame into a scratch buffer (no writes)
+//   write   SectionOutput regions filled from memory (no decompression)
+//   unpack  unpackModel() end to end into an empty directory
+//
+// Bundles are freshly written, so reads are served from the page cache;
+// compare runs on the same machine and build type only.
+//------------------------------------------------------------------------------
+
+#include "unpack.h"
+#include <zstd.h>
+#include <zlib.h>
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <cstdio>
+#include <cstring>
+#include <exception>
+#include <filesystem>
+#include <fstream>
+#include <mutex>
+#include <sstream>
+#include <stdexcept>
+#include <thread>
+
+namespace fs = std::filesystem;
+
+static constexpr size_t   HEADER_SIZE     = 7 + 2 + 4 + 8 + 8 + 8;
+static constexpr uint64_t CRC_CHUNK_SIZE  = 16 << 20;  // 16 MiB
+static constexpr size_t   SCRATCH_SIZE    = 1 << 20;   // 1 MiB
+static constexpr size_t   WORD_COUNT      = 256;
+
+//------------------------------------------------------------------------------
+// Command line
+//------------------------------------------------------------------------------
+
+struct BenchOptions {
+    std::string              dir         = "unpack-bench";
+    uint64_t                 huge_mb     = 256;
+    size_t                   small_count = 512;
+    size_t                   small_kb    = 64;
+    uint64_t                 frame_mb    = 64;
+    int                      level       = 3;
+    int                      repeat      = 3;
+    bool                     keep        = false;
+    std::vector<size_t>      threads;
+    std::vector<std::string> modes       = {"auto"};
+    std::vector<std::string> scenarios;
+};
+
+static std::vector<std::string> splitList(const std::string &value) {
+    std::vector<std::string> items;
+    std::stringstream ss(value);
+    std::string item;
+    while (std::getline(ss, item, ',')) {
+        if (!item.empty()) items.push_back(item);
+    }
+    return items;
+}
+
+static void printUsage(const char *argv0) {
+    std::printf(
+        "Usage: %s [options]\n"
+        "  --dir PATH          Working directory (default unpack-bench)\n"
+        "  --scenario LIST     small,huge,huge-random,huge-stored (default all)\n"
+        "  --size-mb N         Size of the huge section (default 256)\n"
+        "  --small-count N     Number of small sections (default 512)\n"
+        "  --small-kb N        Size of each small section (default 64)\n"
+        "  --frame-mb N        Raw MiB per zstd frame, 0 = single frame (default 64)\n"
+        "  --level N           Zstd level used to generate bundles (default 3)\n"
+        "  --threads LIST      Thread counts (default 1,2,4,... up to the core count)\n"
+        "  --modes LIST        Write modes: auto,stream,mmap,pwrite,direct (default auto)\n"
+        "  --repeat N          Runs per measurement, best one is reported (default 3)\n"
+        "  --keep              Keep generated bundles and output\n",
+        argv0);
+}
+
+static BenchOptions parseArgs(int argc, char **argv) {
+    BenchOptions options;
+    for (int i = 1; i < argc; ++i) {
+        std::string arg = argv[i];
+        auto value = [&]() -> std::string {
+            if (i + 1 >= argc) throw std::runtime_error("Missing value for " + arg);
+            return argv[++i];
+        };
+        if (arg == "--dir") options.dir = value();
+        else if (arg == "--scenario") options.scenarios = splitList(value());
+        else if (arg == "--size-mb") options.huge_mb = std::stoull(value());
+        else if (arg == "--small-count") options.small_count = std::stoul(value());
+        else if (arg == "--small-kb") options.small_kb = std::stoul(value());
+        else if (arg == "--frame-mb") options.frame_mb = std::stoull(value());
+        else if (arg == "--level") options.level = std::stoi(value());
+        else if (arg == "--repeat") options.repeat = std::max(1, std::stoi(value()));
+        else if (arg == "--keep") options.keep = true;
+        else if (arg == "--threads") {
+            for (const std::string &t : splitList(value())) options.threads.push_back(std::stoul(t));
+        } else if (arg == "--modes") {
+            options.modes = splitList(value());
+            for (const std::string &m : options.modes) parseWriteMode(m);  // Validate early
+        } else if (arg == "--help" || arg == "-h") {
+            printUsage(argv[0]);
+            std::exit(0);
+        } else {
+            throw std::runtime_error("Unknown option " + arg);
+        }
+    }
+    if (options.threads.empty()) {
+        size_t cores = std::max(1u, std::thread::hardware_concurrency());
+        for (size_t t = 1; t < cores; t *= 2) options.threads.push_back(t);
+        options.threads.push_back(cores);
+    }
+    return options;
+}
+
+//------------------------------------------------------------------------------
+// Synthetic data
+//------------------------------------------------------------------------------
+
+struct Rng {
+    uint64_t state;
+    explicit Rng(uint64_t seed) : state(seed * 0x9E3779B97F4A7C15ull + 1) {}
+    uint64_t next() {
+        state ^= state << 13;
+        state ^= state >> 7;
+        state ^= state << 17;
+        return state;
+    }
+};
+
+// Random bytes don't compress at all; "compressible" data is a stream of
+// words drawn from a small vocabulary, which zstd shrinks roughly 3:1
+static void fillData(uint8_t *dst, size_t size, bool random, Rng &rng) {
+    if (random) {
+        for (size_t i = 0; i < size; i += sizeof(uint64_t)) {
+            uint64_t v = rng.next();
+            std::memcpy(dst + i, &v, std::min(sizeof(v), size - i));
+        }
+        return;
+    }
+    static const std::vector<std::string> words = [] {
+        Rng wordRng(42);
+        std::vector<std::string> w(WORD_COUNT);
+        for (std::string &word : w) {
+            size_t len = 2 + wordRng.next() % 10;
+            for (size_t k = 0; k < len; ++k) word.push_back(static_cast<char>(wordRng.next() & 0xFF));
+        }
+        return w;
+    }();
+    size_t i = 0;
+    while (i < size) {
+        const std::string &word = words[rng.next() % WORD_COUNT];
+        size_t len = std::min(word.size(), size - i);
+        std::memcpy(dst + i, word.data(), len);
+        i += len;
+    }
+}
+
+//------------------------------------------------------------------------------
+// Bundle generator
+//------------------------------------------------------------------------------
+
+struct SectionSpec {
+    std::string name;
+    uint64_t    size;
+    bool        random;
+    bool        stored;
+};
+
+struct Scenario {
+    std::string              name;
+    std::vector<SectionSpec> sections;
+};
+
+struct GeneratedSection {
+    Entry              entry;
+    std::vector<Frame> frames;  // Empty for stored sections
+};
+
+struct Bundle {
+    std::string                   path;
+    uint64_t                      raw_bytes  = 0;
+    uint64_t                      comp_bytes = 0;
+    std::vector<GeneratedSection> sections;
+};
+
+template <typename T>
+static void writeLE(std::ostream &out, T value) {
+    uint8_t bytes[sizeof(T)];
+    for (size_t i = 0; i < sizeof(T); ++i) bytes[i] = static_cast<uint8_t>(value >> (8 * i));
+    out.write(reinterpret_cast<const char*>(bytes), sizeof(T));
+}
+
+static std::vector<uint8_t> compressFrame(const uint8_t *src, size_t size, int level) {
+    std::vector<uint8_t> out(ZSTD_compressBound(size));
+    size_t ret = ZSTD_compress(out.data(), out.size(), src, size, level);
+    if (ZSTD_isError(ret)) throw std::runtime_error(ZSTD_getErrorName(ret));
+    out.resize(ret);
+    return out;
+}
+
+// Writes the same layout as pack.py: header, config, sections (multi-frame
+// with a seek table, or stored page-aligned), TOC and the global CRC
+static Bundle generateBundle(const Scenario &scenario, const BenchOptions &options) {
+    Bundle bundle;
+    bundle.path = (fs::path(options.dir) / (scenario.name + ".bin")).string();
+    std::ofstream out(bundle.path, std::ios::binary | std::ios::trunc);
+    if (!out) throw std::runtime_error("Cannot create " + bundle.path);
+    out.write(std::string(HEADER_SIZE, '\0').data(), HEADER_SIZE);
+
+    const std::string config = "{\"benchmark\": \"" + scenario.name + "\"}";
+    std::vector<uint8_t> compConfig =
+        compressFrame(reinterpret_cast<const uint8_t*>(config.data()), config.size(), options.level);
+    out.write(reinterpret_cast<const char*>(compConfig.data()), compConfig.size());
+    uint64_t cursor = HEADER_SIZE + compConfig.size();
+
+    uint64_t frameSize = options.frame_mb ? options.frame_mb << 20 : UINT64_MAX;
+    std::vector<uint8_t> raw;
+    Rng rng(1);
+    bool hasStored = false;
+    for (const SectionSpec &spec : scenario.sections) {
+        GeneratedSection section;
+        section.entry = {spec.name, cursor, 0, spec.size, static_cast<uint32_t>(crc32(0, nullptr, 0))};
+        if (spec.stored) {
+            hasStored = true;
+            uint64_t padding = (STORED_ALIGNMENT - cursor % STORED_ALIGNMENT) % STORED_ALIGNMENT;
+            out.write(std::string(padding, '\0').data(), padding);
+            cursor += padding;
+            section.entry.offset = cursor;
+            section.entry.codec  = CODEC_STORED;
+        }
+
+        uint64_t sectionStart = cursor;
+        std::vector<std::pair<uint32_t, uint32_t>> seekTable;
+        for (uint64_t offset = 0; offset < spec.size; offset += frameSize) {
+            size_t chunk = static_cast<size_t>(std::min(frameSize, spec.size - offset));
+            raw.resize(chunk);
+            fillData(raw.data(), chunk, spec.random, rng);
+            std::vector<uint8_t> comp;
+            const std::vector<uint8_t> &data = spec.stored ? raw : (comp = compressFrame(raw.data(), chunk, options.level));
+            out.write(reinterpret_cast<const char*>(data.data()), data.size());
+            section.entry.crc32 = crc32(section.entry.crc32, data.data(), static_cast<uInt>(data.size()));
+            if (!spec.stored) {
+                section.frames.push_back({cursor - sectionStart, data.size(), offset, chunk});
+                seekTable.emplace_back(static_cast<uint32_t>(data.size()), static_cast<uint32_t>(chunk));
+            }
+            cursor += data.size();
+        }
+        if (seekTable.size() > 1) {
+            std::ostringstream table;
+            for (const auto &frame : seekTable) {
+                writeLE<uint32_t>(table, frame.first);
+                writeLE<uint32_t>(table, frame.second);
+            }
+            writeLE<uint32_t>(table, static_cast<uint32_t>(seekTable.size()));
+            writeLE<uint8_t>(table, 0);
+            writeLE<uint32_t>(table, SEEKABLE_MAGIC);
+            std::ostringstream frame;
+            writeLE<uint32_t>(frame, SKIPPABLE_MAGIC);
+            writeLE<uint32_t>(frame, static_cast<uint32_t>(table.str().size()));
+            std::string bytes = frame.str() + table.str();
+            out.write(bytes.data(), bytes.size());
+            section.entry.crc32 = crc32(section.entry.crc32, reinterpret_cast<const Bytef*>(bytes.data()),
+                                        static_cast<uInt>(bytes.size()));
+            cursor += bytes.size();
+        }
+        section.entry.comp_length = cursor - sectionStart;
+        bundle.raw_bytes += spec.size;
+        bundle.sections.push_back(std::move(section));
+    }
+
+    uint16_t version = hasStored ? 2 : 1;
+    uint64_t tocOffset = cursor;
+    for (const GeneratedSection &section : bundle.sections) {
+        const Entry &e = section.entry;
+        writeLE<uint16_t>(out, static_cast<uint16_t>(e.name.size()));
+        out.write(e.name.data(), e.name.size());
+        writeLE<uint64_t>(out, e.offset);
+        writeLE<uint64_t>(out, e.comp_length);
+        writeLE<uint64_t>(out, e.raw_length);
+        writeLE<uint32_t>(out, e.crc32);
+        if (version >= 2) {
+            writeLE<uint8_t>(out, e.codec);
+            writeLE<uint8_t>(out, e.flags);
+        }
+    }
+    out.seekp(0);
+    out.write(CONTAINER_MAGIC, sizeof(CONTAINER_MAGIC));
+    writeLE<uint16_t>(out, version);
+    writeLE<uint32_t>(out, 0);
+    writeLE<uint64_t>(out, HEADER_SIZE);
+    writeLE<uint64_t>(out, compConfig.size());
+    writeLE<uint64_t>(out, tocOffset);
+    out.close();
+
+    uint32_t globalCrc;
+    {
+        MemoryMap mm(bundle.path);
+        globalCrc = crc32(0, nullptr, 0);
+        for (size_t offset = 0; offset < mm.size(); offset += CRC_CHUNK_SIZE) {
+            size_t chunk = static_cast<size_t>(std::min<uint64_t>(CRC_CHUNK_SIZE, mm.size() - offset));
+            globalCrc = crc32(globalCrc, mm.data() + offset, static_cast<uInt>(chunk));
+        }
+    }
+    std::ofstream footer(bundle.path, std::ios::binary | std::ios::app);
+    writeLE<uint32_t>(footer, globalCrc);
+    footer.close();
+    bundle.comp_bytes = fs::file_size(bundle.path);
+    return bundle;
+}
+
+//------------------------------------------------------------------------------
+// Measurements
+//------------------------------------------------------------------------------
+
+// Runs jobs on a pool of the given size and rethrows the first failure
+class BenchPool {
+public:
+    explicit BenchPool(size_t threads) : pool_(threads) {}
+
+    void enqueue(std::function<void()> job) {
+        pool_.enqueue([this, job = std::move(job)]() {
+            try {
+                job();
+            } catch (...) {
+                std::lock_guard<std::mutex> lock(mutex_);
+                if (!error_) error_ = std::current_exception();
+            }
+        });
+    }
+
+    void wait() {
+        pool_.wait();
+        if (error_) std::rethrow_exception(error_);
+    }
+
+private:
+    ThreadPool         pool_;
+    std::mutex         mutex_;
+    std::exception_ptr error_;
+};
+
+// Best throughput (MiB/s) over several runs of fn, which processes `bytes`
+template <typename Fn>
+static double measure(const BenchOptions &options, uint64_t bytes, Fn fn) {
+    double best = 0;
+    for (int r = 0; r < options.repeat; ++r) {
+        auto start = std::chrono::steady_clock::now();
+        fn();
+        double seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+        best = std::max(best, bytes / 1048576.0 / std::max(seconds, 1e-9));
+    }
+    return best;
+}
+
+static double benchCrc(const MemoryMap &mm, size_t threads, const BenchOptions &options) {
+    return measure(options, mm.size(), [&]() {
+        BenchPool pool(threads);
+        std::atomic<uint32_t> sink{0};
+        for (uint64_t offset = 0; offset < mm.size(); offset += CRC_CHUNK_SIZE) {
+            pool.enqueue([&, offset]() {
+                size_t chunk = static_cast<size_t>(std::min<uint64_t>(CRC_CHUNK_SIZE, mm.size() - offset));
+                sink ^= static_cast<uint32_t>(crc32(0, mm.data() + offset, static_cast<uInt>(chunk)));
+            });
+        }
+        pool.wait();
+    });
+}
+
+static double benchDecompress(const Bundle &bundle, const MemoryMap &mm, size_t threads, const BenchOptions &options) {
+    uint64_t rawBytes = 0;
+    for (const GeneratedSection &section : bundle.sections) {
+        for (const Frame &frame : section.frames) rawBytes += frame.raw_length;
+    }
+    if (rawBytes == 0) return 0;
+    return measure(options, rawBytes, [&]() {
+        BenchPool pool(threads);
+        for (const GeneratedSection &section : bundle.sections) {
+            for (const Frame &frame : section.frames) {
+                pool.enqueue([&, src = mm.data() + section.entry.offset + frame.comp_offset]() {
+                    std::unique_ptr<ZSTD_DCtx, size_t(*)(ZSTD_DCtx*)> dctx(ZSTD_createDCtx(), ZSTD_freeDCtx);
+                    std::vector<uint8_t> scratch(SCRATCH_SIZE);
+                    ZSTD_inBuffer in{src, frame.comp_length, 0};
+                    size_t ret = 1;
+                    while (ret != 0) {
+                        ZSTD_outBuffer out{scratch.data(), scratch.size(), 0};
+                        ret = ZSTD_decompressStream(dctx.get(), &out, &in);
+                        if (ZSTD_isError(ret)) throw std::runtime_error(ZSTD_getErrorName(ret));
+                        if (out.pos == 0 && in.pos == in.size && ret != 0) throw std::runtime_error("Truncated frame");
+                    }
+                });
+            }
+        }
+        pool.wait();
+    });
+}
+
+static double benchWrite(const Bundle &bundle, WriteMode mode, size_t threads, const BenchOptions &options) {
+    fs::path outDir = fs::path(options.dir) / "write";
+    std::vector<uint8_t> pattern(SCRATCH_SIZE);
+    Rng rng(7);
+    fillData(pattern.data(), pattern.size(), true, rng);
+    double result = measure(options, bundle.raw_bytes, [&]() {
+        fs::remove_all(outDir);
+        fs::create_directories(outDir);
+        std::vector<std::shared_ptr<SectionOutput>> outputs;
+        BenchPool pool(threads);
+        for (const GeneratedSection &section : bundle.sections) {
+            auto output = std::make_shared<SectionOutput>((outDir / section.entry.name).string(),
+                                                          section.entry.raw_length, mode);
+            outputs.push_back(output);
+            for (uint64_t offset = 0; offset < section.entry.raw_length; offset += CRC_CHUNK_SIZE) {
+                uint64_t length = std::min<uint64_t>(CRC_CHUNK_SIZE, section.entry.raw_length - offset);
+                pool.enqueue([&, output, offset, length]() {
+                    auto writer = output->region(offset, length);
+                    uint64_t done = 0;
+                    while (done < length) {
+                        size_t capacity = 0;
+                        uint8_t *dst = writer->window(capacity);
+                        size_t n = static_cast<size_t>(std::min<uint64_t>({capacity, pattern.size(), length - done}));
+                        if (n == 0) throw std::runtime_error("Writer window exhausted");
+                        std::memcpy(dst, pattern.data(), n);
+                        writer->commit(n);
+                        done += n;
+                    }
+                    writer->finish();
+                });
+            }
+        }
+        pool.wait();
+        for (auto &output : outputs) output->commit();
+    });
+    if (!options.keep) fs::remove_all(outDir);
+    return result;
+}
+
+static double benchUnpack(const Bundle &bundle, WriteMode mode, size_t threads, const BenchOptions &options) {
+    fs::path outDir = fs::path(options.dir) / "unpack";
+    UnpackOptions unpackOptions;
+    unpackOptions.write_mode = mode;
+    unpackOptions.n_threads  = threads;
+    double result = measure(options, bundle.raw_bytes, [&]() {
+        // An existing manifest would turn this into a warm start
+        fs::remove_all(outDir);
+        unpackModel(bundle.path, outDir.string(), unpackOptions);
+    });
+    if (!options.keep) fs::remove_all(outDir);
+    return result;
+}
+
+//------------------------------------------------------------------------------
+// Driver
+//------------------------------------------------------------------------------
+
+static std::vector<Scenario> buildScenarios(const BenchOptions &options) {
+    uint64_t huge = options.huge_mb << 20;
+    std::vector<Scenario> all;
+
+    Scenario small{"small", {}};
+    for (size_t i = 0; i < options.small_count; ++i) {
+        small.sections.push_back({"small_" + std::to_string(i) + ".bin", options.small_kb << 10, false, false});
+    }
+    all.push_back(small);
+    all.push_back({"huge",        {{"huge.bin", huge, false, false}}});
+    all.push_back({"huge-random", {{"huge.bin", huge, true,  false}}});
+    all.push_back({"huge-stored", {{"huge.bin", huge, true,  true}}});
+
+    if (options.scenarios.empty()) return all;
+    std::vector<Scenario> selected;
+    for (const std::string &name : options.scenarios) {
+        auto it = std::find_if(all.begin(), all.end(), [&](const Scenario &s) { return s.name == name; });
+        if (it == all.end()) throw std::runtime_error("Unknown scenario " + name);
+        selected.push_back(*it);
+    }
+    return selected;
+}
+
+static void printTable(const Bundle &bundle, const BenchOptions &options) {
+    std::printf("%8s %10s %10s", "threads", "crc", "zstd");
+    for (const std::string &mode : options.modes) {
+        std::printf(" %14s %14s", ("write:" + mode).c_str(), ("unpack:" + mode).c_str());
+    }
+    std::printf("\n");
+
+    MemoryMap mm(bundle.path);
+    for (size_t threads : options.threads) {
+        std::printf("%8zu", threads);
+        std::printf(" %10.0f", benchCrc(mm, threads, options));
+        double zstdRate = benchDecompress(bundle, mm, threads, options);
+        if (zstdRate > 0) std::printf(" %10.0f", zstdRate);
+        else std::printf(" %10s", "-");
+        std::fflush(stdout);
+        for (const std::string &name : options.modes) {
+            WriteMode mode = parseWriteMode(name);
+            std::printf(" %14.0f", benchWrite(bundle, mode, threads, options));
+            std::fflush(stdout);
+            std::printf(" %14.0f", benchUnpack(bundle, mode, threads, options));
+            std::fflush(stdout);
+        }
+        std::printf("\n");
+    }
+}
+
+int main(int argc, char **argv) {
+    try {
+        BenchOptions options = parseArgs(argc, argv);
+        fs::create_directories(options.dir);
+
+        std::printf("zstd %s, zlib %s, %u cores, best of %d, MiB/s\n",
+                    ZSTD_versionString(), zlibVersion(), std::thread::hardware_concurrency(), options.repeat);
+        for (const Scenario &scenario : buildScenarios(options)) {
+            auto start = std::chrono::steady_clock::now();
+            Bundle bundle = generateBundle(scenario, options);
+            double genSeconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+            std::printf("\n== %s: %zu sections, %.1f MiB raw, %.1f MiB bundle (generated in %.1fs)\n",
+                        scenario.name.c_str(), bundle.sections.size(),
+                        bundle.raw_bytes / 1048576.0, bundle.comp_bytes / 1048576.0, genSeconds);
+
+            printTable(bundle, options);
+            if (!options.keep) fs::remove(bundle.path);
+        }
+        if (!options.keep) fs::remove_all(options.dir);
+    } catch (const std::exception &e) {
+        std::fprintf(stderr, "Error: %s\n", e.what());
+        return 1;
+    }
+    return 0;
+}
@@ -15,22 +15,40 @@ const getHtpConfigFilePath = () => {
 };
 
 let Context;
+let ContextPool;
 let Embedding;
+let VectorIndex;
+let metrics;
+let startTrace;
+let stopTrace;
 try {
   const { platform, arch } = process;
   const pkgName = `node-qnn-llm-${platform}-${arch}`;
-  ({ Context, Embedding } = require(arch === 'arm64' ? pkgName : `./packages/${pkgName}`));
+  ({ Context, ContextPool, Embedding, VectorIndex, metrics, startTrace, stopTrace } = require(arch === 'arm64' ? pkgName : `./packages/${pkgName}`));
 } catch {
   Context = new Proxy({}, {
     get: () => {
       throw new Error('Unsupported platform or failed to load native module');
     }
   });
+  ContextPool = new Proxy({}, {
+    get: () => {
+      throw new Error('Unsupported platform or failed to load native module');
+    }
+  });
   Embedding = new Proxy({}, {
     get: () => {
       throw new Error('Unsupported platform or failed to load native module');
     }
   });
+  VectorIndex = new Proxy({}, {
+    get: () => {
+      throw new Error('Unsupported platform or failed to load native module');
+    }
+  });
+  metrics = startTrace = stopTrace = () => {
+    throw new Error('Unsupported platform or failed to load native module');
+  };
 }
 
 const preProcessEngine = (engine, dir, n_threads) => {
@@ -78,29 +96,53 @@ Context.load = async ({
   bundle_path,
   unpack_dir,
   n_threads,
+  write_mode,
+  profile,
+}) => {
+  await Context.unpack(bundle_path, unpack_dir, { write_mode, n_threads });
+  const config = JSON.parse(await fs.readFile(path.join(unpack_dir, 'config.json'), 'utf8'));
+  if (!config.dialog) throw new Error('Config is not a LLM dialog config');
+  preProcessConfig(config, unpack_dir, n_threads);
+  return await Context.create(config, { profile });
+};
+
+ContextPool.load = async ({
+  bundle_path,
+  unpack_dir,
+  n_threads,
+  write_mode,
+  size,
+  profile,
 }) => {
-  await Context.unpack(bundle_path, unpack_dir);
+  await Context.unpack(bundle_path, unpack_dir, { write_mode, n_threads });
   const config = JSON.parse(await fs.readFile(path.join(unpack_dir, 'config.json'), 'utf8'));
   if (!config.dialog) throw new Error('Config is not a LLM dialog config');
   preProcessConfig(config, unpack_dir, n_threads);
-  return await Context.create(config);
+  return await ContextPool.create(config, { size, profile });
 };
 
 Embedding.load = async ({
   bundle_path,
   unpack_dir,
   n_threads,
+  write_mode,
+  cache,
 }) => {
-  await Context.unpack(bundle_path, unpack_dir);
+  await Context.unpack(bundle_path, unpack_dir, { write_mode, n_threads });
   const config = JSON.parse(await fs.readFile(path.join(unpack_dir, 'config.json'), 'utf8'));
   if (!config.embedding) throw new Error('Config is not an embedding config');
   preProcessConfig(config, unpack_dir, n_threads);
-  return await Embedding.create(config);
+  return await Embedding.create(config, { cache });
 };
 
 module.exports = {
   SentenceCode,
   Context,
+  ContextPool,
   Embedding,
+  VectorIndex,
+  metrics,
+  startTrace,
+  stopTrace,
   getHtpConfigFilePath,
 };
@@ -21,7 +21,7 @@ except ImportError:
 
 # --------------------------------------------------------------------
 # Container format:
-#   Header: magic(7s), version(H), reserved(I),
+#   Header: magic(7s), version(H), reserved(I) [v3: config flags],
 #           config_offset(Q), config_length(Q), toc_offset(Q)
 #   Payload:
 #     [config_compressed]
@@ -30,18 +30,90 @@ except ImportError:
 #   TOC entries (for tokenizer + model_parts only):
 #     name_len (H), name (bytes),
 #     offset (Q), comp_length (Q), raw_length (Q), crc32 (I)
+#     [v2] codec (B), flags (B)
 #   Footer: global_crc32 (I)
+#
+# Version 2 adds a per-entry codec. Sections that barely compress are
+# stored raw at a page-aligned offset so they can be copied (or reflinked)
+# by the kernel at unpack time. Bundles without stored sections are still
+# written as version 1.
+#
+# Version 3 gives the (previously reserved) flags byte a meaning, plus the
+# same flags for config.json in the header's reserved word:
+#   FLAG_LONG        frames use long-distance matching with a window of up to
+#                    2^31, beyond zstd's default decoder limit (2^27)
+#   FLAG_DICT        compressed against the bundle dictionary
+#   FLAG_DICTIONARY  the bundle dictionary itself: a stored section that is
+#                    loaded by the unpacker but never extracted
+#
+# Sections larger than the frame size are split into independent zstd
+# frames followed by a seek table (zstd seekable format), so they can be
+# decompressed in parallel. FLAG_LONG sections use frames of at least the
+# long-distance window, so matches can reach back across all of it:
+#   [frame_0][frame_1]...[frame_n-1]
+#   skippable_magic (I), table_size (I),
+#   n x (comp_length (I), raw_length (I)),
+#   frame_count (I), descriptor (B), seekable_magic (I)
 # --------------------------------------------------------------------
 
 MAGIC           = b'QGENIE1'         # 7-byte magic
-VERSION         = 1                  # 2-byte version
+VERSION         = 3                  # 2-byte version
 HEADER_FMT      = '<7s H I Q Q Q'    # total size = 7+2+4 + 8+8+8 = 37 -> pad to 40 if you like
 
+SKIPPABLE_MAGIC    = 0x184D2A5E      # zstd skippable frame carrying the seek table
+SEEKABLE_MAGIC     = 0x8F92EAB1      # zstd seekable format footer magic
+DEFAULT_FRAME_SIZE = 64              # MiB of raw data per frame
+MAX_FRAME_SIZE     = 4095            # frame lengths in the seek table are u32
+
+CODEC_ZSTD              = 0
+CODEC_STORED            = 1
+STORED_ALIGNMENT        = 4096
+DEFAULT_STORE_THRESHOLD = 5.0        # store sections compressing by less than this %
+
+FLAG_LONG               = 0x01
+FLAG_DICT               = 0x02
+FLAG_DICTIONARY         = 0x04
+DEFAULT_LONG_WINDOW     = 27         # log2 of the long-distance matching window
+MIN_LONG_WINDOW         = 10         # zstd's window log bounds
+MAX_LONG_WINDOW         = 31
+LONG_SECTION_MIN        = 32 * 1024 * 1024   # only sections larger than this use long-distance matching
+DICT_NAME               = '.zstd-dictionary'
+DICT_SECTION_LIMIT      = 32 * 1024 * 1024   # only sections up to this size use the dictionary
+DICT_SAMPLE_SIZE        = 16 * 1024          # training sample chunk size
+
+def frame_size_arg(value):
+    """--frame-size in MiB, bounded so frame lengths fit the seek table"""
+    size = int(value)
+    if not 0 <= size <= MAX_FRAME_SIZE:
+        raise argparse.ArgumentTypeError(f"must be between 0 and {MAX_FRAME_SIZE} MiB")
+    return size
+
+def long_window_arg(value):
+    """--long window log, within the bounds zstd accepts"""
+    window = int(value)
+    if not MIN_LONG_WINDOW <= window <= MAX_LONG_WINDOW:
+        raise argparse.ArgumentTypeError(f"must be between {MIN_LONG_WINDOW} and {MAX_LONG_WINDOW}")
+    return window
+
+def import_zstandard():
+    """Long-range and dictionary modes need the full zstandard bindings"""
+    try:
+        import zstandard
+        return zstandard
+    except ImportError:
+        print("Error: zstandard module not found, please install it with `pip install zstandard`", file=sys.stderr)
+        sys.exit(1)
+
 class ModelPacker:
     """Class to handle packing of QNN Genie model configurations"""
     
-    def __init__(self, zstd_level=3):
+    def __init__(self, zstd_level=3, frame_size=DEFAULT_FRAME_SIZE,
+                 store_threshold=DEFAULT_STORE_THRESHOLD, long_window=0, dict_size=0):
         self.zstd_level = zstd_level
+        self.frame_size = frame_size * 1024 * 1024
+        self.store_threshold = store_threshold
+        self.long_window = long_window
+        self.dict_size = dict_size * 1024
         self.console = Console()
     
     def get_file_size(self, filepath):
@@ -66,10 +138,83 @@ class ModelPacker:
         else:
             return f"{size:.1f} {size_names[i]}"
     
-    def compress_with_progress(self, data, level, progress, task_id, description):
+    def make_compressor(self, flags, dictionary=None):
+        """Return a one-shot compress function for a section with the given flags"""
+        if not flags & (FLAG_LONG | FLAG_DICT):
+            return lambda data: zstd.compress(data, self.zstd_level)
+        zstandard = import_zstandard()
+        kwargs = {}
+        if flags & FLAG_LONG:
+            kwargs['compression_params'] = zstandard.ZstdCompressionParameters.from_level(
+                self.zstd_level, window_log=self.long_window, enable_ldm=True)
+        else:
+            kwargs['level'] = self.zstd_level
+        if flags & FLAG_DICT:
+            kwargs['dict_data'] = dictionary
+        return zstandard.ZstdCompressor(**kwargs).compress
+
+    def build_dictionary(self, raw_cfg, extra_entries, file_sizes, input_dir):
+        """Train a dictionary on the small sections; keep it only if it pays for itself.
+        Returns (dictionary, names of sections to compress with it)"""
+        zstandard = import_zstandard()
+        candidates = {'config.json': raw_cfg}
+        for name in extra_entries:
+            if 0 < file_sizes[name] <= DICT_SECTION_LIMIT:
+                candidates[name] = open(os.path.join(input_dir, name), 'rb').read()
+
+        samples = [data[i:i + DICT_SAMPLE_SIZE]
+                   for data in candidates.values()
+                   for i in range(0, len(data), DICT_SAMPLE_SIZE)]
+        try:
+            dictionary = zstandard.train_dictionary(self.dict_size, samples, level=self.zstd_level)
+        except zstandard.ZstdError as e:
+            self.console.print(f"[yellow]Warning: dictionary training failed ({e}), skipping[/yellow]")
+            return None, set()
+
+        plain = self.make_compressor(0)
+        with_dict = self.make_compressor(FLAG_DICT, dictionary)
+        names = set()
+        saved = 0
+        for name, data in candidates.items():
+            gain = len(plain(data)) - len(with_dict(data))
+            if gain > 0:
+                names.add(name)
+                saved += gain
+        if saved <= len(dictionary.as_bytes()):
+            self.console.print("[yellow]Dictionary does not pay for itself, skipping[/yellow]")
+            return None, set()
+        return dictionary, names
+
+    def section_frame_size(self, flags):
+        """Frames of long-distance sections span at least the match window"""
+        if flags & FLAG_LONG and self.frame_size > 0:
+            return max(self.frame_size, 1 << self.long_window)
+        return self.frame_size
+
+    def compress_section(self, data, compress, frame_size):
+        """Compress data as one frame, or as independent frames plus a seek table"""
+        if frame_size <= 0 or len(data) <= frame_size:
+            return compress(data)
+
+        frames = []
+        table = []
+        view = memoryview(data)
+        for start in range(0, len(data), frame_size):
+            chunk = bytes(view[start:start + frame_size])
+            comp = compress(chunk)
+            frames.append(comp)
+            table.append(struct.pack('<I I', len(comp), len(chunk)))
+        table.append(struct.pack('<I B I', len(frames), 0, SEEKABLE_MAGIC))
+        seek_table = b''.join(table)
+        frames.append(struct.pack('<I I', SKIPPABLE_MAGIC, len(seek_table)))
+        frames.append(seek_table)
+        return b''.join(frames)
+
+    def compress_with_progress(self, data, flags, dictionary, progress, task_id, description):
         """Compress data with progress updates"""
         progress.update(task_id, description=f"Compressing {description}")
-        compressed = zstd.compress(data, level)
+        compressed = self.compress_section(data, self.make_compressor(flags, dictionary),
+                                           self.section_frame_size(flags))
         progress.update(task_id, advance=1)
         return compressed
     
@@ -156,9 +301,22 @@ class ModelPacker:
             # placeholder header
             out.write(b'\x00' * header_size)
 
+            dictionary, dict_names = None, set()
+            if self.dict_size > 0:
+                progress.update(pack_task, description="📚 Training dictionary")
+                dictionary, dict_names = self.build_dictionary(raw_cfg, extra_entries, file_sizes, input_dir)
+
+            def section_flags(name, size):
+                flags = FLAG_DICT if name in dict_names else 0
+                if self.long_window > 0 and size > LONG_SECTION_MIN:
+                    flags |= FLAG_LONG
+                return flags
+
             # Compress and write config payload
             progress.update(pack_task, description="📝 Processing config.json")
-            comp_cfg = self.compress_with_progress(raw_cfg, self.zstd_level, progress, pack_task, "config.json")
+            cfg_flags = section_flags('config.json', len(raw_cfg))
+            comp_cfg = self.compress_with_progress(raw_cfg, cfg_flags, dictionary,
+                                                   progress, pack_task, "config.json")
             crc_cfg = zlib.crc32(comp_cfg)
             
             cfg_offset = header_size
@@ -168,6 +326,20 @@ class ModelPacker:
             # write tokenizer & model parts, record TOC entries
             toc = []
             cursor = cfg_offset + cfg_length
+
+            if dictionary is not None:
+                dict_data = dictionary.as_bytes()
+                out.write(dict_data)
+                toc.append({
+                    'name': DICT_NAME.encode('utf-8'),
+                    'offset': cursor,
+                    'comp_length': len(dict_data),
+                    'raw_length': len(dict_data),
+                    'crc32': zlib.crc32(dict_data),
+                    'codec': CODEC_STORED,
+                    'flags': FLAG_DICTIONARY
+                })
+                cursor += len(dict_data)
             
             for i, name in enumerate(extra_entries):
                 file_path = os.path.join(input_dir, name)
@@ -177,7 +349,20 @@ class ModelPacker:
                               description=f"📄 Processing {name} ({self.format_size(file_size)})")
                 
                 raw = open(file_path, 'rb').read()
-                comp = self.compress_with_progress(raw, self.zstd_level, progress, pack_task, name)
+                flags = section_flags(name, len(raw))
+                comp = self.compress_with_progress(raw, flags, dictionary,
+                                                   progress, pack_task, name)
+                compression_ratio = (1 - len(comp) / len(raw)) * 100 if raw else 0.0
+
+                codec = CODEC_ZSTD
+                if raw and compression_ratio < self.store_threshold:
+                    # Not worth decompressing: store raw, page-aligned
+                    codec = CODEC_STORED
+                    flags = 0
+                    comp = raw
+                    padding = -cursor % STORED_ALIGNMENT
+                    out.write(b'\x00' * padding)
+                    cursor += padding
                 crc = zlib.crc32(comp)
                 
                 out.write(comp)
@@ -186,17 +371,22 @@ class ModelPacker:
                     'offset': cursor,
                     'comp_length': len(comp),
                     'raw_length': len(raw),
-                    'crc32': crc
+                    'crc32': crc,
+                    'codec': codec,
+                    'flags': flags
                 })
                 cursor += len(comp)
                 
-                compression_ratio = (1 - len(comp) / len(raw)) * 100
-                progress.update(pack_task, 
-                              description=f"✅ {name} compressed ({compression_ratio:.1f}% reduction)")
+                if codec == CODEC_STORED:
+                    progress.update(pack_task,
+                                  description=f"✅ {name} stored ({compression_ratio:.1f}% reduction not worth it)")
+                else:
+                    progress.update(pack_task, 
+                                  description=f"✅ {name} compressed ({compression_ratio:.1f}% reduction)")
         
-        return toc, cfg_offset, cfg_length, cursor
+        return toc, cfg_offset, cfg_length, cfg_flags, cursor
     
-    def finalize_container(self, output_path, toc, cfg_offset, cfg_length, cursor, progress):
+    def finalize_container(self, output_path, toc, cfg_offset, cfg_length, cfg_flags, cursor, progress):
         """Finalize the container with TOC, header, and CRC"""
         # Phase 3: Finalization
         finalize_task = progress.add_task("🔧 Finalizing container...", total=3)
@@ -206,6 +396,14 @@ class ModelPacker:
             out.seek(cursor)
             toc_offset = cursor
             
+            # Keep older unpackers working unless codecs or flags are needed
+            if cfg_flags or any(e['flags'] for e in toc):
+                version = VERSION
+            elif any(e['codec'] != CODEC_ZSTD for e in toc):
+                version = 2
+            else:
+                version = 1
+
             progress.update(finalize_task, description="📋 Writing table of contents")
             for entry in toc:
                 out.write(struct.pack('<H', len(entry['name'])))
@@ -215,6 +413,8 @@ class ModelPacker:
                                       entry['comp_length'],
                                       entry['raw_length'],
                                       entry['crc32']))
+                if version >= 2:
+                    out.write(struct.pack('<B B', entry['codec'], entry['flags']))
             progress.advance(finalize_task)
 
             # Backfill header
@@ -223,8 +423,8 @@ class ModelPacker:
             out.write(struct.pack(
                 HEADER_FMT,
                 MAGIC,
-                VERSION,
-                0,              # reserved
+                version,
+                cfg_flags,      # reserved before v3
                 cfg_offset,
                 cfg_length,
                 toc_offset
@@ -250,7 +450,12 @@ class ModelPacker:
         self.console.print(f"📁 Input:  {self.format_size(total_raw_size)} ({len(extra_entries) + 1} files)")
         self.console.print(f"📦 Output: {self.format_size(final_size)} ({output_path})")
         self.console.print(f"📊 Compression: {compression_ratio:.1f}% reduction")
-        self.console.print(f"📋 Sections: {len(toc)} + config")
+        stored = sum(1 for e in toc if e['codec'] == CODEC_STORED and not e['flags'] & FLAG_DICTIONARY)
+        self.console.print(f"📋 Sections: {len(toc)} + config ({stored} stored)")
+        dictionary = next((e for e in toc if e['flags'] & FLAG_DICTIONARY), None)
+        if dictionary is not None:
+            with_dict = sum(1 for e in toc if e['flags'] & FLAG_DICT)
+            self.console.print(f"📚 Dictionary: {self.format_size(dictionary['comp_length'])} ({with_dict} sections)")
     
     def pack_model(self, config_path, output_path):
         """Main packing method that handles both dialog and embedding configs"""
@@ -285,19 +490,20 @@ class ModelPacker:
             progress.update(discover_task, completed=100)
             
             # Write container
-            toc, cfg_offset, cfg_length, cursor = self.write_container(
+            toc, cfg_offset, cfg_length, cfg_flags, cursor = self.write_container(
                 raw_cfg, extra_entries, file_sizes, input_dir, output_path, progress
             )
             
             # Finalize container
-            self.finalize_container(output_path, toc, cfg_offset, cfg_length, cursor, progress)
+            self.finalize_container(output_path, toc, cfg_offset, cfg_length, cfg_flags, cursor, progress)
             
             # Print statistics
             self.print_statistics(total_raw_size, output_path, extra_entries, toc)
 
-def pack_model(config_path, output_path, zstd_level=3):
+def pack_model(config_path, output_path, zstd_level=3, frame_size=DEFAULT_FRAME_SIZE,
+               store_threshold=DEFAULT_STORE_THRESHOLD, long_window=0, dict_size=0):
     """Legacy function wrapper for backward compatibility"""
-    packer = ModelPacker(zstd_level)
+    packer = ModelPacker(zstd_level, frame_size, store_threshold, long_window, dict_size)
     packer.pack_model(config_path, output_path)
 
 if __name__ == '__main__':
@@ -309,8 +515,17 @@ if __name__ == '__main__':
                    help="Output bundle file path")
     p.add_argument('-l', '--level',  type=int, default=3,
                    help="Zstd compression level (-7...22)")
+    p.add_argument('-f', '--frame-size', type=frame_size_arg, default=DEFAULT_FRAME_SIZE,
+                   help=f"MiB per independent zstd frame for parallel unpack (0 = single frame, max {MAX_FRAME_SIZE})")
+    p.add_argument('-s', '--store-threshold', type=float, default=DEFAULT_STORE_THRESHOLD,
+                   help="Store sections uncompressed when zstd saves less than this percent (0 = only when it grows)")
+    p.add_argument('--long', type=long_window_arg, nargs='?', const=DEFAULT_LONG_WINDOW, default=0, metavar='WINDOW_LOG',
+                   help=f"Long-distance matching for large sections, window 2^WINDOW_LOG "
+                        f"(default {DEFAULT_LONG_WINDOW}, {MIN_LONG_WINDOW} to {MAX_LONG_WINDOW})")
+    p.add_argument('--dict', type=int, nargs='?', const=112, default=0, metavar='KB',
+                   help="Train a shared dictionary of this many KiB for small sections (default 112)")
     args = p.parse_args()
 
     # Use the new class-based approach
-    packer = ModelPacker(args.level)
+    packer = ModelPacker(args.level, args.frame_size, args.store_threshold, args.long, args.dict)
     packer.pack_model(args.config_path, args.output)
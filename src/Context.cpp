@@ -1,10 +1,12 @@
 #include "Context.h"
 #include "ContextHolder.h"
 #include "LoadWorker.h"
+#include "ProcessWorker.h"
 #include "QueryWorker.h"
 #include "ReleaseWorker.h"
 #include "RestoreSessionWorker.h"
 #include "SaveSessionWorker.h"
+#include "StreamWorker.h"
 #include "UnpackWorker.h"
 #include <stdexcept>
 #include <string>
@@ -25,6 +27,12 @@ Napi::Object Context::Init(Napi::Env env, Napi::Object &exports) {
           InstanceMethod<&Context::Query>(
               "query", static_cast<napi_property_attributes>(
                            napi_writable | napi_configurable)),
+          InstanceMethod<&Context::Prefill>(
+              "prefill", static_cast<napi_property_attributes>(
+                             napi_writable | napi_configurable)),
+          InstanceMethod<&Context::Stream>(
+              "stream", static_cast<napi_property_attributes>(
+                            napi_writable | napi_configurable)),
           InstanceMethod<&Context::SaveSession>(
               "save_session", static_cast<napi_property_attributes>(
                                   napi_writable | napi_configurable)),
@@ -40,6 +48,12 @@ Napi::Object Context::Init(Napi::Env env, Napi::Object &exports) {
           InstanceMethod<&Context::ApplySamplerConfig>(
               "apply_sampler_config", static_cast<napi_property_attributes>(
                                           napi_writable | napi_configurable)),
+          InstanceMethod<&Context::SetPrefixCache>(
+              "set_prefix_cache", static_cast<napi_property_attributes>(
+                                      napi_writable | napi_configurable)),
+          InstanceMethod<&Context::Stats>(
+              "stats", static_cast<napi_property_attributes>(
+                           napi_writable | napi_configurable)),
           InstanceMethod<&Context::Release>(
               "release", static_cast<napi_property_attributes>(
                              napi_writable | napi_configurable)),
@@ -58,7 +72,8 @@ Context::Context(const Napi::CallbackInfo &info)
 
 Context::~Context() {
   if (_context) {
-    delete _context;
+    ContextHolder *context = _context;
+    _executor->submit([context]() { delete context; });
   }
 }
 
@@ -67,7 +82,28 @@ Napi::Value Context::Unpack(const Napi::CallbackInfo &info) {
   Napi::HandleScope scope(env);
   std::string bundle_path = info[0].As<Napi::String>().Utf8Value();
   std::string unpack_dir = info[1].As<Napi::String>().Utf8Value();
-  auto worker = new UnpackWorker(env, bundle_path, unpack_dir);
+  UnpackOptions options;
+  if (info[2].IsObject()) {
+    Napi::Object opts = info[2].As<Napi::Object>();
+    try {
+      if (opts.Get("write_mode").IsString()) {
+        options.write_mode =
+            parseWriteMode(opts.Get("write_mode").As<Napi::String>().Utf8Value());
+      }
+      if (opts.Get("n_threads").IsNumber()) {
+        int64_t n_threads = opts.Get("n_threads").As<Napi::Number>().Int64Value();
+        options.n_threads = n_threads > 0 ? static_cast<size_t>(n_threads) : 0;
+      }
+      if (opts.Get("max_inflight_mb").IsNumber()) {
+        int64_t mb = opts.Get("max_inflight_mb").As<Napi::Number>().Int64Value();
+        options.max_inflight_bytes = mb > 0 ? static_cast<uint64_t>(mb) << 20 : 0;
+      }
+    } catch (const std::runtime_error &e) {
+      Napi::Error::New(env, e.what()).ThrowAsJavaScriptException();
+      return env.Undefined();
+    }
+  }
+  auto worker = new UnpackWorker(env, bundle_path, unpack_dir, options);
   worker->Queue();
   return worker->Promise();
 }
@@ -79,11 +115,107 @@ Napi::Value Context::Create(const Napi::CallbackInfo &info) {
   Napi::Function stringify = JSON.Get("stringify").As<Napi::Function>();
   std::string config_json =
       stringify.Call({info[0]}).As<Napi::String>().Utf8Value();
-  auto worker = new LoadWorker(env, config_json);
+  bool profiling = info[1].IsObject() &&
+                   info[1].As<Napi::Object>().Get("profile").ToBoolean().Value();
+  auto worker = new LoadWorker(env, std::make_shared<Executor>(env, "context"),
+                               config_json, profiling);
   worker->Queue();
   return worker->Promise();
 }
 
+Napi::Value Context::abortReason(Napi::Env env, Napi::Object signal) {
+  Napi::Value reason = signal.Get("reason");
+  if (!reason.IsUndefined()) {
+    return reason;
+  }
+  Napi::Object error = Napi::Error::New(env, "The operation was aborted").Value();
+  error.Set("name", Napi::String::New(env, "AbortError"));
+  return error;
+}
+
+void Context::schedule(Napi::Env env, const Napi::Value &options,
+                       RequestQueue::Start start,
+                       std::function<void(Napi::Value)> cancel) {
+  int32_t priority = 0;
+  Napi::Object signal;
+  if (options.IsObject()) {
+    Napi::Object opts = options.As<Napi::Object>();
+    if (opts.Get("priority").IsNumber()) {
+      priority = opts.Get("priority").As<Napi::Number>().Int32Value();
+    }
+    if (opts.Get("signal").IsObject()) {
+      signal = opts.Get("signal").As<Napi::Object>();
+    }
+  }
+  if (!signal.IsEmpty() && signal.Get("aborted").ToBoolean().Value()) {
+    cancel(abortReason(env, signal));
+    return;
+  }
+  // Keep this Context, and with it the holder, alive until the request is done
+  Ref();
+  uint64_t id = _requests.push(
+      priority, std::move(start),
+      [this, cancel](uint64_t id, Napi::Value reason) {
+        detachSignal(id);
+        Unref();
+        cancel(reason);
+      });
+  if (!signal.IsEmpty()) {
+    Napi::Function handler = Napi::Function::New(
+        env, [this, id](const Napi::CallbackInfo &info) {
+          abortRequest(info.Env(), id);
+        });
+    signal.Get("addEventListener")
+        .As<Napi::Function>()
+        .Call(signal, {Napi::String::New(env, "abort"), handler});
+    _signals.emplace(
+        id, AbortListener{Napi::Persistent(signal), Napi::Persistent(handler)});
+  }
+  _requests.run();
+}
+
+void Context::finishRequest(uint64_t id) {
+  detachSignal(id);
+  Unref();
+  _requests.done();
+  if (_release_worker && _requests.idle()) {
+    _release_worker->Queue();
+    _release_worker = NULL;
+  }
+}
+
+void Context::abortRequest(Napi::Env env, uint64_t id) {
+  auto it = _signals.find(id);
+  if (it == _signals.end()) {
+    return;
+  }
+  Napi::Value reason = abortReason(env, it->second.signal.Value());
+  if (_requests.cancel(id, reason)) {
+    return;
+  }
+  if (_requests.isRunning(id) && _context) {
+    cancelStream();
+    try {
+      _context->abort();
+    } catch (const std::runtime_error &e) {
+      // finishes on its own
+    }
+  }
+}
+
+void Context::detachSignal(uint64_t id) {
+  auto it = _signals.find(id);
+  if (it == _signals.end()) {
+    return;
+  }
+  Napi::Env env = it->second.signal.Env();
+  Napi::Object signal = it->second.signal.Value();
+  signal.Get("removeEventListener")
+      .As<Napi::Function>()
+      .Call(signal, {Napi::String::New(env, "abort"), it->second.handler.Value()});
+  _signals.erase(it);
+}
+
 Napi::Value Context::Query(const Napi::CallbackInfo &info) {
   Napi::Env env = info.Env();
   Napi::HandleScope scope(env);
@@ -94,9 +226,92 @@ Napi::Value Context::Query(const Napi::CallbackInfo &info) {
   }
   std::string prompt = info[0].As<Napi::String>().Utf8Value();
   Napi::Function callback = info[1].As<Napi::Function>();
-  auto worker = new QueryWorker(env, prompt, _context, callback);
-  worker->Queue();
-  return worker->Promise();
+  auto worker = new QueryWorker(env, prompt, _context, _executor, callback,
+                                parseTokenBatchOptions(info[2]),
+                                parseProfileOption(info[2]));
+  Napi::Value promise = worker->Promise();
+  schedule(
+      env, info[2],
+      [this, worker](uint64_t id, double queue_wait_ms) {
+        worker->setQueueWait(queue_wait_ms);
+        worker->setOnComplete([this, id]() { finishRequest(id); });
+        worker->Queue();
+      },
+      [worker](Napi::Value reason) {
+        worker->cancel(reason);
+        delete worker;
+      });
+  return promise;
+}
+
+Napi::Value Context::Prefill(const Napi::CallbackInfo &info) {
+  Napi::Env env = info.Env();
+  Napi::HandleScope scope(env);
+  if (_context == NULL) {
+    Napi::Error::New(env, "Context is not initialized")
+        .ThrowAsJavaScriptException();
+    return env.Undefined();
+  }
+  std::string prompt = info[0].As<Napi::String>().Utf8Value();
+  bool snapshot = info[1].IsObject() &&
+                  info[1].As<Napi::Object>().Get("cache").ToBoolean().Value();
+  auto worker = new ProcessWorker(env, prompt, _context, _executor, snapshot,
+                                  parseProfileOption(info[1]));
+  Napi::Value promise = worker->Promise();
+  schedule(
+      env, info[1],
+      [this, worker](uint64_t id, double queue_wait_ms) {
+        worker->setQueueWait(queue_wait_ms);
+        worker->setOnComplete([this, id]() { finishRequest(id); });
+        worker->Queue();
+      },
+      [worker](Napi::Value reason) {
+        worker->cancel(reason);
+        delete worker;
+      });
+  return promise;
+}
+
+Napi::Value Context::Stream(const Napi::CallbackInfo &info) {
+  Napi::Env env = info.Env();
+  Napi::HandleScope scope(env);
+  if (_context == NULL) {
+    Napi::Error::New(env, "Context is not initialized")
+        .ThrowAsJavaScriptException();
+    return env.Undefined();
+  }
+  std::string prompt = info[0].As<Napi::String>().Utf8Value();
+  size_t max_pending = 64;
+  if (info[1].IsObject()) {
+    Napi::Object opts = info[1].As<Napi::Object>();
+    if (opts.Get("max_pending").IsNumber()) {
+      int64_t n = opts.Get("max_pending").As<Napi::Number>().Int64Value();
+      max_pending = n > 0 ? static_cast<size_t>(n) : 1;
+    }
+  }
+  auto queue = std::make_shared<TokenQueue>(max_pending);
+  Napi::Object stream = TokenStream::New(env, queue, info.This().As<Napi::Object>());
+  auto worker = new StreamWorker(env, prompt, _context, _executor, queue,
+                                 parseProfileOption(info[1]));
+  schedule(
+      env, info[1],
+      [this, worker, queue](uint64_t id, double) {
+        _stream = queue;
+        worker->setOnComplete([this, id]() { finishRequest(id); });
+        worker->Queue();
+      },
+      [worker](Napi::Value reason) {
+        worker->cancel(reason);
+        delete worker;
+      });
+  return stream;
+}
+
+void Context::cancelStream() {
+  // A reader that stopped pulling would otherwise keep the dialog blocked
+  if (auto queue = _stream.lock()) {
+    queue->cancel();
+  }
 }
 
 Napi::Value Context::SaveSession(const Napi::CallbackInfo &info) {
@@ -108,9 +323,29 @@ Napi::Value Context::SaveSession(const Napi::CallbackInfo &info) {
     return env.Undefined();
   }
   std::string filename = info[0].As<Napi::String>().Utf8Value();
-  auto worker = new SaveSessionWorker(env, filename, _context);
-  worker->Queue();
-  return worker->Promise();
+  bool compress = false;
+  int level = 3;
+  if (info[1].IsObject()) {
+    Napi::Object opts = info[1].As<Napi::Object>();
+    compress = opts.Get("compress").ToBoolean();
+    if (opts.Get("level").IsNumber()) {
+      level = opts.Get("level").As<Napi::Number>().Int32Value();
+    }
+  }
+  auto worker = new SaveSessionWorker(env, filename, _context, _executor,
+                                      compress, level);
+  Napi::Value promise = worker->Promise();
+  schedule(
+      env, info[1],
+      [this, worker](uint64_t id, double) {
+        worker->setOnComplete([this, id]() { finishRequest(id); });
+        worker->Queue();
+      },
+      [worker](Napi::Value reason) {
+        worker->cancel(reason);
+        delete worker;
+      });
+  return promise;
 }
 
 Napi::Value Context::RestoreSession(const Napi::CallbackInfo &info) {
@@ -122,9 +357,19 @@ Napi::Value Context::RestoreSession(const Napi::CallbackInfo &info) {
     return env.Undefined();
   }
   std::string filename = info[0].As<Napi::String>().Utf8Value();
-  auto worker = new RestoreSessionWorker(env, filename, _context);
-  worker->Queue();
-  return worker->Promise();
+  auto worker = new RestoreSessionWorker(env, filename, _context, _executor);
+  Napi::Value promise = worker->Promise();
+  schedule(
+      env, info[1],
+      [this, worker](uint64_t id, double) {
+        worker->setOnComplete([this, id]() { finishRequest(id); });
+        worker->Queue();
+      },
+      [worker](Napi::Value reason) {
+        worker->cancel(reason);
+        delete worker;
+      });
+  return promise;
 }
 
 void Context::Abort(const Napi::CallbackInfo &info) {
@@ -135,6 +380,7 @@ void Context::Abort(const Napi::CallbackInfo &info) {
         .ThrowAsJavaScriptException();
     return;
   }
+  cancelStream();
   try {
     _context->abort();
   } catch (const std::runtime_error &e) {
@@ -142,13 +388,13 @@ void Context::Abort(const Napi::CallbackInfo &info) {
   }
 }
 
-void Context::SetStopWords(const Napi::CallbackInfo &info) {
+Napi::Value Context::SetStopWords(const Napi::CallbackInfo &info) {
   Napi::Env env = info.Env();
   Napi::HandleScope scope(env);
   if (_context == NULL) {
     Napi::Error::New(env, "Context is not initialized")
         .ThrowAsJavaScriptException();
-    return;
+    return env.Undefined();
   }
   Napi::Object JSON = env.Global().Get("JSON").As<Napi::Object>();
   Napi::Function stringify = JSON.Get("stringify").As<Napi::Function>();
@@ -161,32 +407,114 @@ void Context::SetStopWords(const Napi::CallbackInfo &info) {
     config_json = "{}";
   } else {
     Napi::Error::New(env, "Invalid argument").ThrowAsJavaScriptException();
-    return;
-  }
-  try {
-    _context->set_stop_words(config_json);
-  } catch (const std::runtime_error &e) {
-    Napi::Error::New(env, e.what()).ThrowAsJavaScriptException();
+    return env.Undefined();
   }
+  Napi::Promise::Deferred deferred = Napi::Promise::Deferred::New(env);
+  schedule(
+      env, info[1],
+      [this, deferred, config_json](uint64_t id, double) {
+        Napi::Env env = deferred.Env();
+        try {
+          _context->set_stop_words(config_json);
+          deferred.Resolve(env.Undefined());
+        } catch (const std::runtime_error &e) {
+          deferred.Reject(Napi::Error::New(env, e.what()).Value());
+        }
+        finishRequest(id);
+      },
+      [deferred](Napi::Value reason) { deferred.Reject(reason); });
+  return deferred.Promise();
 }
 
-void Context::ApplySamplerConfig(const Napi::CallbackInfo &info) {
+Napi::Value Context::ApplySamplerConfig(const Napi::CallbackInfo &info) {
   Napi::Env env = info.Env();
   Napi::HandleScope scope(env);
   if (_context == NULL) {
     Napi::Error::New(env, "Context is not initialized")
         .ThrowAsJavaScriptException();
-    return;
+    return env.Undefined();
   }
   Napi::Object JSON = env.Global().Get("JSON").As<Napi::Object>();
   Napi::Function stringify = JSON.Get("stringify").As<Napi::Function>();
   std::string config_json =
       stringify.Call({info[0]}).As<Napi::String>().Utf8Value();
-  try {
-    _context->apply_sampler_config(config_json);
-  } catch (const std::runtime_error &e) {
-    Napi::Error::New(env, e.what()).ThrowAsJavaScriptException();
+  Napi::Promise::Deferred deferred = Napi::Promise::Deferred::New(env);
+  schedule(
+      env, info[1],
+      [this, deferred, config_json](uint64_t id, double) {
+        Napi::Env env = deferred.Env();
+        try {
+          _context->apply_sampler_config(config_json);
+          deferred.Resolve(env.Undefined());
+        } catch (const std::runtime_error &e) {
+          deferred.Reject(Napi::Error::New(env, e.what()).Value());
+        }
+        finishRequest(id);
+      },
+      [deferred](Napi::Value reason) { deferred.Reject(reason); });
+  return deferred.Promise();
+}
+
+Napi::Value Context::SetPrefixCache(const Napi::CallbackInfo &info) {
+  Napi::Env env = info.Env();
+  Napi::HandleScope scope(env);
+  if (_context == NULL) {
+    Napi::Error::New(env, "Context is not initialized")
+        .ThrowAsJavaScriptException();
+    return env.Undefined();
   }
+  std::string dir = "";
+  uint64_t max_bytes = 1024ull << 20;
+  if (info[0].IsObject()) {
+    Napi::Object opts = info[0].As<Napi::Object>();
+    if (!opts.Get("dir").IsString()) {
+      Napi::Error::New(env, "Invalid argument").ThrowAsJavaScriptException();
+      return env.Undefined();
+    }
+    dir = opts.Get("dir").As<Napi::String>().Utf8Value();
+    if (opts.Get("max_mb").IsNumber()) {
+      int64_t mb = opts.Get("max_mb").As<Napi::Number>().Int64Value();
+      max_bytes = mb > 0 ? static_cast<uint64_t>(mb) << 20 : 0;
+    }
+  } else if (!info[0].IsNull() && !info[0].IsUndefined()) {
+    Napi::Error::New(env, "Invalid argument").ThrowAsJavaScriptException();
+    return env.Undefined();
+  }
+  Napi::Promise::Deferred deferred = Napi::Promise::Deferred::New(env);
+  schedule(
+      env, info[1],
+      [this, deferred, dir, max_bytes](uint64_t id, double) {
+        Napi::Env env = deferred.Env();
+        try {
+          _context->set_prefix_cache(dir, max_bytes);
+          deferred.Resolve(env.Undefined());
+        } catch (const std::runtime_error &e) {
+          deferred.Reject(Napi::Error::New(env, e.what()).Value());
+        }
+        finishRequest(id);
+      },
+      [deferred](Napi::Value reason) { deferred.Reject(reason); });
+  return deferred.Promise();
+}
+
+Napi::Value Context::Stats(const Napi::CallbackInfo &info) {
+  Napi::Env env = info.Env();
+  Napi::HandleScope scope(env);
+  Napi::Object stats = _requests.stats(env);
+  PrefixCache *cache = _context ? _context->get_prefix_cache() : NULL;
+  if (cache) {
+    PrefixCacheStats cache_stats = cache->stats();
+    Napi::Object prefix_cache = Napi::Object::New(env);
+    prefix_cache.Set("hits", Napi::Number::New(env, cache_stats.hits));
+    prefix_cache.Set("misses", Napi::Number::New(env, cache_stats.misses));
+    prefix_cache.Set("insertions", Napi::Number::New(env, cache_stats.insertions));
+    prefix_cache.Set("evictions", Napi::Number::New(env, cache_stats.evictions));
+    prefix_cache.Set("entries", Napi::Number::New(env, cache_stats.entries));
+    prefix_cache.Set("bytes", Napi::Number::New(env, cache_stats.bytes));
+    prefix_cache.Set("max_bytes", Napi::Number::New(env, cache_stats.max_bytes));
+    stats.Set("prefix_cache", prefix_cache);
+  }
+  return stats;
 }
 
 Napi::Value Context::Release(const Napi::CallbackInfo &info) {
@@ -197,7 +525,24 @@ Napi::Value Context::Release(const Napi::CallbackInfo &info) {
         .ThrowAsJavaScriptException();
     return env.Undefined();
   }
-  auto worker = new ReleaseWorker(env, _context);
-  worker->Queue();
-  return worker->Promise();
+  ContextHolder *context = _context;
+  _context = NULL;
+  cancelStream();
+  _requests.cancelAll(Napi::Error::New(env, "Context is released").Value());
+  // The thread exits once the worker is done
+  auto worker = new ReleaseWorker(env, context, _executor);
+  _executor.reset();
+  Napi::Value promise = worker->Promise();
+  if (_requests.idle()) {
+    worker->Queue();
+  } else {
+    // Free the dialog once the running request has unwound
+    _release_worker = worker;
+    try {
+      context->abort();
+    } catch (const std::runtime_error &e) {
+      // finishes on its own
+    }
+  }
+  return promise;
 }
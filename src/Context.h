@@ -1,43 +1,94 @@
 #pragma once
 
 #include "ContextHolder.h"
+#include "Executor.h"
+#include "ReleaseWorker.h"
+#include "RequestQueue.h"
+#include "TokenStream.h"
+#include <functional>
+#include <memory>
+#include <unordered_map>
 #include <napi.h>
 
 class Context : public Napi::ObjectWrap<Context> {
 public:
   static Napi::Object Init(Napi::Env env, Napi::Object &exports);
 
-  static inline Napi::Object New(Napi::External<ContextHolder> context) {
-    return constructor.New({context});
+  // Every request on the holder runs on executor
+  static inline Napi::Object New(Napi::External<ContextHolder> context,
+                                 std::shared_ptr<Executor> executor) {
+    Napi::Object object = constructor.New({context});
+    Unwrap(object)->_executor = std::move(executor);
+    return object;
   }
 
   Context(const Napi::CallbackInfo &info);
   ~Context();
 
 protected:
-  // Context.unpack(bundle_path: string, unpack_dir: string): Promise<void>
+  // Context.unpack(bundle_path: string, unpack_dir: string,
+  //   options?: { write_mode?: string, n_threads?: number, max_inflight_mb?: number }): Promise<void>
   static Napi::Value Unpack(const Napi::CallbackInfo &info);
   // Context.create(config_json: object): Promise<Context>
   static Napi::Value Create(const Napi::CallbackInfo &info);
-  // context.set_stop_words(stop_words: string[]): void
-  void SetStopWords(const Napi::CallbackInfo &info);
-  // context.apply_sampler_config(config_json: object): void
-  void ApplySamplerConfig(const Napi::CallbackInfo &info);
-  // context.save_session(filename: string): void
+  // Requests below wait their turn instead of failing with "Context is busy".
+  // Each accepts options { priority?: number, signal?: AbortSignal } as its
+  // last argument (merged into the query / stream options).
+
+  // context.set_stop_words(stop_words: string[], options?): Promise<void>
+  Napi::Value SetStopWords(const Napi::CallbackInfo &info);
+  // context.apply_sampler_config(config_json: object, options?): Promise<void>
+  Napi::Value ApplySamplerConfig(const Napi::CallbackInfo &info);
+  // context.save_session(filename: string, options?): Promise<void>
   Napi::Value SaveSession(const Napi::CallbackInfo &info);
-  // context.restore_session(filename: string): void
+  // context.restore_session(filename: string, options?): Promise<void>
   Napi::Value RestoreSession(const Napi::CallbackInfo &info);
   // context.abort(): void
   void Abort(const Napi::CallbackInfo &info);
-  // context.query(prompt: string, callback: (result: string) => void):
+  // context.query(prompt: string, callback: (result: string) => void,
+  //   options?: { batch?: boolean, batch_interval_ms?: number, batch_max_tokens?: number,
+  //               priority?: number, signal?: AbortSignal }):
   // Promise<string>
+  // With batch the callback is (text: string, sentence_codes: number[]) => void
   Napi::Value Query(const Napi::CallbackInfo &info);
+  // context.prefill(prompt: string, options?: { cache?: boolean, priority?, signal? }):
+  // Promise<{ prefill_ms, total_ms, reused_chars, queue_wait_ms, profile }>
+  Napi::Value Prefill(const Napi::CallbackInfo &info);
+  // context.stream(prompt: string, options?: { max_pending?: number, priority?, signal? }):
+  // AsyncIterableIterator<string>
+  Napi::Value Stream(const Napi::CallbackInfo &info);
+  // context.set_prefix_cache(options: { dir: string, max_mb?: number } | null, options?): Promise<void>
+  Napi::Value SetPrefixCache(const Napi::CallbackInfo &info);
+  // context.stats(): { pending, running, processed, cancelled, queue_wait_ms: { last, max, avg },
+  //   prefix_cache?: { hits, misses, insertions, evictions, entries, bytes, max_bytes } }
+  Napi::Value Stats(const Napi::CallbackInfo &info);
   // context.release(): Promise<void>
   Napi::Value Release(const Napi::CallbackInfo &info);
 
   void releaseContext();
+  void cancelStream();
+
+  static Napi::Value abortReason(Napi::Env env, Napi::Object signal);
+  void schedule(Napi::Env env, const Napi::Value &options,
+                RequestQueue::Start start,
+                std::function<void(Napi::Value)> cancel);
+  void finishRequest(uint64_t id);
+  void abortRequest(Napi::Env env, uint64_t id);
+  void detachSignal(uint64_t id);
 
 private:
   static Napi::FunctionReference constructor;
   ContextHolder *_context = NULL;
+  std::shared_ptr<Executor> _executor;
+  std::weak_ptr<TokenQueue> _stream;
+
+  struct AbortListener {
+    Napi::ObjectReference signal;
+    Napi::FunctionReference handler;
+  };
+
+  RequestQueue _requests;
+  std::unordered_map<uint64_t, AbortListener> _signals;
+  // Deferred by release() until the running request completes
+  ReleaseWorker *_release_worker = NULL;
 };
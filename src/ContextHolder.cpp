@@ -1,30 +1,43 @@
 #include "ContextHolder.h"
+#include "metrics.h"
+#include "trace.h"
 #include "utils.h"
+#include <algorithm>
+#include <filesystem>
 #include <stdexcept>
 
-ContextHolder::ContextHolder(std::string config_json) {
+ContextHolder::ContextHolder(std::string config_json, bool profiling) {
   Genie_Status_t status;
-  status = GenieProfile_create(NULL, &profile);
-  if (status != GENIE_STATUS_SUCCESS) {
-    throw std::runtime_error(Genie_Status_ToString(status));
-  }
   status = GenieDialogConfig_createFromJson(config_json.c_str(), &config);
   if (status != GENIE_STATUS_SUCCESS) {
-    GenieProfile_free(profile);
     throw std::runtime_error(Genie_Status_ToString(status));
   }
-  status = GenieDialogConfig_bindProfiler(config, profile);
-  if (status != GENIE_STATUS_SUCCESS) {
-    GenieDialogConfig_free(config);
-    GenieProfile_free(profile);
-    throw std::runtime_error(Genie_Status_ToString(status));
+  // The profiler records every query, so only bind it when asked for
+  if (profiling) {
+    status = GenieProfile_create(NULL, &profile);
+    if (status != GENIE_STATUS_SUCCESS) {
+      GenieDialogConfig_free(config);
+      throw std::runtime_error(Genie_Status_ToString(status));
+    }
+    status = GenieDialogConfig_bindProfiler(config, profile);
+    if (status != GENIE_STATUS_SUCCESS) {
+      GenieDialogConfig_free(config);
+      GenieProfile_free(profile);
+      throw std::runtime_error(Genie_Status_ToString(status));
+    }
+  }
+  {
+    trace::Span span("GenieDialog_create");
+    status = GenieDialog_create(config, &dialog);
   }
-  status = GenieDialog_create(config, &dialog);
   if (status != GENIE_STATUS_SUCCESS) {
     GenieDialogConfig_free(config);
-    GenieProfile_free(profile);
+    if (profile) {
+      GenieProfile_free(profile);
+    }
     throw std::runtime_error(Genie_Status_ToString(status));
   }
+  perf::dialogs.inc();
 }
 
 ContextHolder::~ContextHolder() {
@@ -33,6 +46,7 @@ ContextHolder::~ContextHolder() {
   } catch (const std::runtime_error &e) {
     // nothing to do
   }
+  perf::dialogs.dec();
 }
 
 void ContextHolder::release() {
@@ -45,6 +59,7 @@ void ContextHolder::release() {
     busying = false;
   }
   if (dialog) {
+    trace::Span span("GenieDialog_free");
     Genie_Status_t status = GenieDialog_free(dialog);
     if (status != GENIE_STATUS_SUCCESS) {
       throw std::runtime_error(Genie_Status_ToString(status));
@@ -61,19 +76,64 @@ void ContextHolder::release() {
   }
 }
 
-void ContextHolder::process(std::string prompt) {
+size_t ContextHolder::shared_prefix(const std::string &prompt) const {
+  size_t length = std::min(full_context.size(), prompt.size());
+  return std::mismatch(full_context.begin(), full_context.begin() + length,
+                       prompt.begin())
+             .first -
+         full_context.begin();
+}
+
+void ContextHolder::set_prefix_cache(std::string dir, uint64_t max_bytes) {
   if (busying) {
     throw std::runtime_error("Context is busy");
   }
+  prefix_cache.reset();
+  if (!dir.empty()) {
+    prefix_cache = std::make_unique<PrefixCache>(dir, max_bytes);
+  }
+}
+
+void ContextHolder::restore_prefix(const std::string &prompt) {
+  PrefixCache::Snapshot snapshot;
+  if (!prefix_cache->lookup(prompt, shared_prefix(prompt), snapshot)) {
+    return;
+  }
+  trace::Span span("restore_prefix", snapshot.path);
+  Genie_Status_t status = GenieDialog_restore(dialog, snapshot.path.c_str());
+  if (status != GENIE_STATUS_SUCCESS) {
+    prefix_cache->remove(snapshot.prefix);
+    return;
+  }
+  full_context = snapshot.prefix;
+}
+
+void ContextHolder::save_prefix() {
+  std::string path = prefix_cache->reserve();
+  trace::Span span("save_prefix", path);
+  Genie_Status_t status = GenieDialog_save(dialog, path.c_str());
+  if (status != GENIE_STATUS_SUCCESS) {
+    throw std::runtime_error(Genie_Status_ToString(status));
+  }
+  prefix_cache->insert(full_context, path);
+}
+
+Genie_Status_t ContextHolder::send(const std::string &prompt,
+                                  GenieDialog_QueryCallback_t callback,
+                                  size_t *reused_chars) {
+  if (prefix_cache) {
+    restore_prefix(prompt);
+  }
+  if (reused_chars) {
+    *reused_chars = shared_prefix(prompt);
+  }
   std::string query = prompt;
   Genie_Status_t status;
   GenieDialog_SentenceCode_t sentenceCode = GENIE_DIALOG_SENTENCE_COMPLETE;
   if (!full_context.empty()) {
     sentenceCode = GENIE_DIALOG_SENTENCE_REWIND;
   }
-  busying = true;
-  this->callback = std::move(callback);
-  status = GenieDialog_query(dialog, query.c_str(), sentenceCode, process_callback, this);
+  status = GenieDialog_query(dialog, query.c_str(), sentenceCode, callback, this);
   if (status != GENIE_STATUS_SUCCESS && status != GENIE_STATUS_WARNING_ABORTED) {
     // retry normal query
     if (prompt.find(full_context) == 0) {
@@ -81,61 +141,107 @@ void ContextHolder::process(std::string prompt) {
     } else {
       status = GenieDialog_reset(dialog);
       if (status != GENIE_STATUS_SUCCESS) {
-        throw std::runtime_error(Genie_Status_ToString(status));
+        return status;
       }
     }
-    status = GenieDialog_query(dialog, query.c_str(), sentenceCode, process_callback, this);
+    status = GenieDialog_query(dialog, query.c_str(), sentenceCode, callback, this);
+  }
+  return status;
+}
+
+std::string ContextHolder::profile_json() {
+  if (!profile) {
+    return "";
   }
+  trace::Span span("GenieProfile_getJsonData");
+  const char* profile_json = nullptr;
+  GenieProfile_getJsonData(profile, alloc_json_data, &profile_json);
+  std::string profile_json_str(profile_json);
+  free((char*)profile_json);
+  return profile_json_str;
+}
+
+ProcessResult ContextHolder::process(std::string prompt, bool snapshot,
+                                     bool with_profile) {
+  if (busying) {
+    throw std::runtime_error("Context is busy");
+  }
+  trace::Span span("process");
+  ProcessResult result;
+  busying = true;
+  prefill_done = false;
+  auto start = std::chrono::steady_clock::now();
+  Genie_Status_t status = send(prompt, process_callback, &result.reused_chars);
   busying = false;
+  auto end = std::chrono::steady_clock::now();
   if (status != GENIE_STATUS_SUCCESS && status != GENIE_STATUS_WARNING_ABORTED) {
     throw std::runtime_error(Genie_Status_ToString(status));
   }
+  // The response token is dropped, the next REWIND query matches up to prompt
   full_context = prompt;
+  result.prefill_ms =
+      std::chrono::duration<double, std::milli>(
+          (prefill_done ? prefill_end : end) - start)
+          .count();
+  result.total_ms =
+      std::chrono::duration<double, std::milli>(end - start).count();
+  if (with_profile) {
+    result.profile_json = profile_json();
+  }
+  if (snapshot && prefix_cache) {
+    save_prefix();
+  }
+  return result;
 }
 
 void ContextHolder::process_callback(const char *response,
                                const GenieDialog_SentenceCode_t sentenceCode,
                                const void *userData) {
   ContextHolder *self = (ContextHolder *)userData;
-  GenieDialog_signal(self->dialog, GENIE_DIALOG_ACTION_ABORT);
+  // The prompt is in the KV cache once the first response arrives; there is
+  // no prefill-only query, so stop before decoding any further
+  if (!self->prefill_done) {
+    self->prefill_done = true;
+    self->prefill_end = std::chrono::steady_clock::now();
+    GenieDialog_signal(self->dialog, GENIE_DIALOG_ACTION_ABORT);
+  }
 }
 
-std::string ContextHolder::query(std::string prompt,
-                          const CompletionCallback &callback) {
+QueryResult ContextHolder::query(std::string prompt,
+                                 const CompletionCallback &callback,
+                                 bool with_profile) {
   if (busying) {
     throw std::runtime_error("Context is busy");
   }
-  std::string query = prompt;
-  Genie_Status_t status;
-  GenieDialog_SentenceCode_t sentenceCode = GENIE_DIALOG_SENTENCE_COMPLETE;
-  if (!full_context.empty()) {
-    sentenceCode = GENIE_DIALOG_SENTENCE_REWIND;
-  }
+  QueryResult result;
   busying = true;
-  this->callback = std::move(callback);
-  status = GenieDialog_query(dialog, query.c_str(), sentenceCode, on_response, this);
-  if (status != GENIE_STATUS_SUCCESS && status != GENIE_STATUS_WARNING_ABORTED) {
-    // retry normal query
-    if (prompt.find(full_context) == 0) {
-      query = prompt.substr(full_context.length());
-    } else {
-      status = GenieDialog_reset(dialog);
-      if (status != GENIE_STATUS_SUCCESS) {
-        throw std::runtime_error(Genie_Status_ToString(status));
-      }
+  this->callback = callback;
+  uint64_t trace_start = trace::enabled() ? trace::now() : 0;
+  metrics.start();
+  size_t reused_chars = 0;
+  Genie_Status_t status = send(prompt, on_response, &reused_chars);
+  metrics.finish();
+  if (trace_start) {
+    // Split at the first token, from the same timestamps as the metrics
+    uint64_t first = trace_start + static_cast<uint64_t>(metrics.ttft_ms * 1e6);
+    uint64_t end = trace_start + static_cast<uint64_t>(metrics.total_ms * 1e6);
+    trace::complete("prefill", trace_start, metrics.tokens ? first : end);
+    if (metrics.tokens) {
+      trace::complete("decode", first, end, std::to_string(metrics.tokens) + " tokens");
     }
-    status = GenieDialog_query(dialog, query.c_str(), sentenceCode, on_response, this);
   }
   busying = false;
+  this->callback = nullptr;
   if (status != GENIE_STATUS_SUCCESS && status != GENIE_STATUS_WARNING_ABORTED) {
     throw std::runtime_error(Genie_Status_ToString(status));
   }
   full_context = prompt;
-  const char* profile_json = nullptr;
-  GenieProfile_getJsonData(profile, alloc_json_data, &profile_json);
-  std::string profile_json_str(profile_json);
-  free((char*)profile_json);
-  return profile_json_str;
+  metrics.prompt_chars = prompt.size() - reused_chars;
+  result.metrics = metrics;
+  if (with_profile) {
+    result.profile_json = profile_json();
+  }
+  return result;
 }
 
 void ContextHolder::abort() {
@@ -145,21 +251,102 @@ void ContextHolder::abort() {
   }
 }
 
-void ContextHolder::save(std::string filename) {
+void ContextHolder::save(std::string filename, bool compress, int level,
+                         SessionStats &stats) {
   if (busying) {
     throw std::runtime_error("Context is busy");
   }
-  Genie_Status_t status = GenieDialog_save(dialog, filename.c_str());
+  std::string target = compress ? sessionScratchPath(filename) : filename;
+  auto start = std::chrono::steady_clock::now();
+  Genie_Status_t status;
+  {
+    trace::Span span("GenieDialog_save", target);
+    status = GenieDialog_save(dialog, target.c_str());
+  }
+  stats.genie_ms = std::chrono::duration<double, std::milli>(
+                       std::chrono::steady_clock::now() - start)
+                       .count();
   if (status != GENIE_STATUS_SUCCESS) {
+    if (compress) {
+      // Only the scratch path is ours; an uncompressed save wrote to filename
+      std::error_code ec;
+      std::filesystem::remove_all(target, ec);
+    }
     throw std::runtime_error(Genie_Status_ToString(status));
   }
+  if (!compress) {
+    stats.raw_bytes = stats.file_bytes = sessionSize(filename);
+    return;
+  }
+  // Written next to filename, so a failed pack never replaces a good file
+  std::string packed = sessionScratchPath(filename);
+  try {
+    packSession(target, packed, level, stats);
+  } catch (...) {
+    std::error_code ec;
+    std::filesystem::remove_all(target, ec);
+    std::filesystem::remove(packed, ec);
+    throw;
+  }
+  std::error_code ec;
+  std::filesystem::remove_all(target, ec);
+  // rename replaces a file atomically. An uncompressed session directory
+  // saved there before is moved aside, and put back if the rename fails.
+  std::string aside;
+  if (std::filesystem::is_directory(filename, ec)) {
+    aside = sessionScratchPath(filename);
+    std::filesystem::rename(filename, aside, ec);
+    if (ec) {
+      std::error_code ignored;
+      std::filesystem::remove(packed, ignored);
+      throw std::runtime_error("Failed to write session: " + ec.message());
+    }
+  }
+  std::filesystem::rename(packed, filename, ec);
+  if (ec) {
+    std::error_code ignored;
+    std::filesystem::remove(packed, ignored);
+    if (!aside.empty()) {
+      std::filesystem::rename(aside, filename, ignored);
+    }
+    throw std::runtime_error("Failed to write session: " + ec.message());
+  }
+  if (!aside.empty()) {
+    std::filesystem::remove_all(aside, ec);
+  }
 }
 
-void ContextHolder::restore(std::string filename) {
+void ContextHolder::restore(std::string filename, SessionStats &stats) {
   if (busying) {
     throw std::runtime_error("Context is busy");
   }
-  Genie_Status_t status = GenieDialog_restore(dialog, filename.c_str());
+  bool packed = isPackedSession(filename);
+  std::string source = filename;
+  if (packed) {
+    source = sessionScratchPath(filename);
+    try {
+      unpackSession(filename, source, stats);
+    } catch (...) {
+      std::error_code ec;
+      std::filesystem::remove_all(source, ec);
+      throw;
+    }
+  } else {
+    stats.raw_bytes = stats.file_bytes = sessionSize(filename);
+  }
+  auto start = std::chrono::steady_clock::now();
+  Genie_Status_t status;
+  {
+    trace::Span span("GenieDialog_restore", source);
+    status = GenieDialog_restore(dialog, source.c_str());
+  }
+  stats.genie_ms = std::chrono::duration<double, std::milli>(
+                       std::chrono::steady_clock::now() - start)
+                       .count();
+  if (packed) {
+    std::error_code ec;
+    std::filesystem::remove_all(source, ec);
+  }
   if (status != GENIE_STATUS_SUCCESS) {
     throw std::runtime_error(Genie_Status_ToString(status));
   }
@@ -200,7 +387,9 @@ void ContextHolder::on_response(const char *response,
                                 const GenieDialog_SentenceCode_t sentenceCode,
                                 const void *userData) {
   ContextHolder *context = (ContextHolder *)userData;
-  if (response) {
+  // END and other codes can arrive without text, they are not tokens
+  if (response && *response) {
+    context->metrics.token();
     context->full_context += response;
   }
   if (context->callback) {
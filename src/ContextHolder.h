@@ -1,33 +1,70 @@
 #pragma once
 
 #include "GenieDialog.h"
+#include "PrefixCache.h"
+#include "QueryMetrics.h"
+#include "session.h"
 #include <atomic>
+#include <chrono>
 #include <functional>
+#include <memory>
 #include <string>
 #include <unordered_map>
 
 typedef std::unordered_map<std::string, float> LoraStrengthMap;
 
+struct ProcessResult {
+  // Until the prompt was in the KV cache (first response), and the whole call
+  double prefill_ms = 0;
+  double total_ms = 0;
+  // Leading characters already held by the dialog (previous context or a
+  // restored prefix snapshot), which REWIND keeps
+  size_t reused_chars = 0;
+  std::string profile_json;
+};
+
 class ContextHolder {
   using CompletionCallback =
       std::function<void(const char *, const GenieDialog_SentenceCode_t)>;
 
 public:
-  ContextHolder(std::string config_json);
+  // Without profiling no Genie profiler is bound and profile JSON is empty
+  ContextHolder(std::string config_json, bool profiling = false);
   ~ContextHolder();
   void release();
-  void process(std::string prompt);
-  std::string query(std::string prompt, const CompletionCallback &callback);
+  // With snapshot, the processed state is added to the prefix cache
+  ProcessResult process(std::string prompt, bool snapshot = false,
+                        bool with_profile = false);
+  QueryResult query(std::string prompt, const CompletionCallback &callback,
+                    bool with_profile = false);
   void abort();
-  void save(std::string filename);
-  void restore(std::string filename);
+  // compress packs the Genie output into one zstd file (see session.h);
+  // restore accepts both forms
+  void save(std::string filename, bool compress, int level,
+            SessionStats &stats);
+  void restore(std::string filename, SessionStats &stats);
   void set_stop_words(std::string stop_words_json);
   void apply_sampler_config(std::string config_json);
   void apply_lora(const std::string &engine, const std::string &lora_adapter_name);
   void set_lora_strength(const std::string &engine, const LoraStrengthMap &lora_strength_map);
   void reset();
+  // Empty dir disables the cache
+  void set_prefix_cache(std::string dir, uint64_t max_bytes);
+  PrefixCache *get_prefix_cache() { return prefix_cache.get(); }
+  // Leading characters of prompt the dialog already holds
+  size_t shared_prefix(const std::string &prompt) const;
+  bool is_busy() const { return busying; }
+  bool is_profiling() const { return profile != NULL; }
 
 protected:
+  Genie_Status_t send(const std::string &prompt,
+                      GenieDialog_QueryCallback_t callback,
+                      size_t *reused_chars = NULL);
+  std::string profile_json();
+  // Restores the cached snapshot covering most of prompt, if it beats the
+  // live dialog state
+  void restore_prefix(const std::string &prompt);
+  void save_prefix();
   static void process_callback(const char *response,
                                const GenieDialog_SentenceCode_t sentenceCode,
                                const void *userData);
@@ -42,4 +79,8 @@ private:
   GenieDialogConfig_Handle_t config = NULL;
   GenieProfile_Handle_t profile = NULL;
   CompletionCallback callback = nullptr;
+  std::unique_ptr<PrefixCache> prefix_cache;
+  QueryMetrics metrics;
+  bool prefill_done = false;
+  std::chrono::steady_clock::time_point prefill_end;
 };
\ No newline at end of file
@@ -0,0 +1,203 @@
+#include "ContextPool.h"
+#include "PoolLoadWorker.h"
+#include <algorithm>
+#include <stdexcept>
+#include <string>
+
+Napi::FunctionReference ContextPool::constructor;
+
+Napi::Object ContextPool::Init(Napi::Env env, Napi::Object &exports) {
+  Napi::HandleScope scope(env);
+  Napi::Function func = DefineClass(
+      env, "ContextPool",
+      {
+          StaticMethod<&ContextPool::Create>(
+              "create", static_cast<napi_property_attributes>(
+                            napi_writable | napi_configurable)),
+          InstanceMethod<&ContextPool::Query>(
+              "query", static_cast<napi_property_attributes>(
+                           napi_writable | napi_configurable)),
+          InstanceMethod<&ContextPool::Stats>(
+              "stats", static_cast<napi_property_attributes>(
+                           napi_writable | napi_configurable)),
+          InstanceMethod<&ContextPool::Release>(
+              "release", static_cast<napi_property_attributes>(
+                             napi_writable | napi_configurable)),
+      });
+  constructor = Napi::Persistent(func);
+  constructor.SuppressDestruct();
+  exports.Set("ContextPool", func);
+  return exports;
+}
+
+ContextPool::ContextPool(const Napi::CallbackInfo &info)
+    : Napi::ObjectWrap<ContextPool>(info) {
+  Napi::HandleScope scope(info.Env());
+  _contexts = *info[0].As<Napi::External<std::vector<ContextHolder *>>>().Data();
+  busy_.assign(_contexts.size(), false);
+}
+
+ContextPool::~ContextPool() {
+  for (size_t i = 0; i < _contexts.size(); i++) {
+    ContextHolder *context = _contexts[i];
+    executors_[i]->submit([context]() { delete context; });
+  }
+}
+
+Napi::Value ContextPool::Create(const Napi::CallbackInfo &info) {
+  Napi::Env env = info.Env();
+  Napi::HandleScope scope(env);
+  Napi::Object JSON = env.Global().Get("JSON").As<Napi::Object>();
+  Napi::Function stringify = JSON.Get("stringify").As<Napi::Function>();
+  std::string config_json =
+      stringify.Call({info[0]}).As<Napi::String>().Utf8Value();
+  size_t size = 2;
+  bool profiling = false;
+  if (info[1].IsObject()) {
+    Napi::Object opts = info[1].As<Napi::Object>();
+    profiling = opts.Get("profile").ToBoolean().Value();
+    if (opts.Get("size").IsNumber()) {
+      int64_t n = opts.Get("size").As<Napi::Number>().Int64Value();
+      size = n > 0 ? static_cast<size_t>(n) : 1;
+    }
+  }
+  std::vector<std::shared_ptr<Executor>> executors;
+  for (size_t i = 0; i < size; i++) {
+    executors.push_back(std::make_shared<Executor>(env, "context"));
+  }
+  auto worker =
+      new PoolLoadWorker(env, std::move(executors), config_json, profiling);
+  worker->Queue();
+  return worker->Promise();
+}
+
+Napi::Value ContextPool::Query(const Napi::CallbackInfo &info) {
+  Napi::Env env = info.Env();
+  Napi::HandleScope scope(env);
+  if (released_) {
+    Napi::Error::New(env, "Context pool is released")
+        .ThrowAsJavaScriptException();
+    return env.Undefined();
+  }
+  std::string prompt = info[0].As<Napi::String>().Utf8Value();
+  Napi::Function callback = info[1].As<Napi::Function>();
+  auto worker = new QueryWorker(env, prompt, NULL, nullptr, callback,
+                                parseTokenBatchOptions(info[2]),
+                                parseProfileOption(info[2]));
+  Napi::Value promise = worker->Promise();
+  // Queued requests keep the pool alive until they complete
+  Ref();
+  pending_.push_back({worker, prompt, std::chrono::steady_clock::now()});
+  dispatch();
+  return promise;
+}
+
+size_t ContextPool::pick(const std::string &prompt) {
+  size_t best = _contexts.size();
+  size_t best_length = 0;
+  for (size_t i = 0; i < _contexts.size(); i++) {
+    if (busy_[i]) {
+      continue;
+    }
+    size_t shared = _contexts[i]->shared_prefix(prompt);
+    if (best == _contexts.size() || shared > best_length) {
+      best = i;
+      best_length = shared;
+    }
+  }
+  return best;
+}
+
+void ContextPool::dispatch() {
+  while (!pending_.empty() && running_ < _contexts.size()) {
+    PendingQuery query = pending_.front();
+    pending_.pop_front();
+    size_t index = pick(query.prompt);
+    double wait_ms = std::chrono::duration<double, std::milli>(
+                         std::chrono::steady_clock::now() - query.enqueued)
+                         .count();
+    dispatched_++;
+    wait_last_ms_ = wait_ms;
+    wait_max_ms_ = std::max(wait_max_ms_, wait_ms);
+    wait_total_ms_ += wait_ms;
+
+    busy_[index] = true;
+    running_++;
+    query.worker->setContext(_contexts[index], executors_[index]);
+    query.worker->setQueueWait(wait_ms);
+    query.worker->setOnComplete([this, index]() { complete(index); });
+    query.worker->Queue();
+  }
+}
+
+void ContextPool::complete(size_t index) {
+  busy_[index] = false;
+  running_--;
+  Unref();
+  if (released_) {
+    if (running_ == 0 && release_worker_) {
+      _contexts.clear();
+      release_worker_->Queue();
+      release_worker_ = NULL;
+    }
+    return;
+  }
+  dispatch();
+}
+
+Napi::Value ContextPool::Stats(const Napi::CallbackInfo &info) {
+  Napi::Env env = info.Env();
+  Napi::HandleScope scope(env);
+  Napi::Object stats = Napi::Object::New(env);
+  stats.Set("size", Napi::Number::New(env, _contexts.size()));
+  stats.Set("busy", Napi::Number::New(env, running_));
+  stats.Set("pending", Napi::Number::New(env, pending_.size()));
+  stats.Set("dispatched", Napi::Number::New(env, dispatched_));
+  Napi::Object wait = Napi::Object::New(env);
+  wait.Set("last", Napi::Number::New(env, wait_last_ms_));
+  wait.Set("max", Napi::Number::New(env, wait_max_ms_));
+  wait.Set("avg", Napi::Number::New(
+                      env, dispatched_ ? wait_total_ms_ / dispatched_ : 0));
+  stats.Set("queue_wait_ms", wait);
+  return stats;
+}
+
+Napi::Value ContextPool::Release(const Napi::CallbackInfo &info) {
+  Napi::Env env = info.Env();
+  Napi::HandleScope scope(env);
+  if (released_) {
+    Napi::Error::New(env, "Context pool is released")
+        .ThrowAsJavaScriptException();
+    return env.Undefined();
+  }
+  released_ = true;
+  // Requests still waiting for an instance fail with "Context is released"
+  while (!pending_.empty()) {
+    QueryWorker *worker = pending_.front().worker;
+    pending_.pop_front();
+    worker->cancel(Napi::Error::New(env, "Context is released").Value());
+    delete worker;
+    Unref();
+  }
+  // Threads exit once their last worker is done
+  auto worker = new ReleaseWorker(env, _contexts, executors_.front());
+  executors_.clear();
+  Napi::Value promise = worker->Promise();
+  if (running_ == 0) {
+    _contexts.clear();
+    worker->Queue();
+  } else {
+    // Free the dialogs once the running queries have unwound
+    release_worker_ = worker;
+    for (size_t i = 0; i < _contexts.size(); i++) {
+      if (busy_[i]) {
+        try {
+          _contexts[i]->abort();
+        } catch (const std::runtime_error &e) {
+          // finishes on its own
+        }
+      }
+    }
+  }
+  return promise;
+}
@@ -0,0 +1,67 @@
+#pragma once
+
+#include "ContextHolder.h"
+#include "Executor.h"
+#include "QueryWorker.h"
+#include "ReleaseWorker.h"
+#include <chrono>
+#include <deque>
+#include <memory>
+#include <napi.h>
+#include <vector>
+
+class ContextPool : public Napi::ObjectWrap<ContextPool> {
+public:
+  static Napi::Object Init(Napi::Env env, Napi::Object &exports);
+
+  // executors[i] runs every request on contexts[i]
+  static inline Napi::Object
+  New(Napi::External<std::vector<ContextHolder *>> contexts,
+      std::vector<std::shared_ptr<Executor>> executors) {
+    Napi::Object object = constructor.New({contexts});
+    Unwrap(object)->executors_ = std::move(executors);
+    return object;
+  }
+
+  ContextPool(const Napi::CallbackInfo &info);
+  ~ContextPool();
+
+protected:
+  // ContextPool.create(config_json: object, options?: { size?: number }):
+  // Promise<ContextPool>
+  static Napi::Value Create(const Napi::CallbackInfo &info);
+  // pool.query(prompt: string, callback: (result: string) => void,
+  //   options?: { batch?: boolean, batch_interval_ms?: number, batch_max_tokens?: number }):
+  // Promise<object> (query profile plus queue_wait_ms)
+  Napi::Value Query(const Napi::CallbackInfo &info);
+  // pool.stats(): { size, busy, pending, dispatched, queue_wait_ms: { last, max, avg } }
+  Napi::Value Stats(const Napi::CallbackInfo &info);
+  // pool.release(): Promise<void>
+  Napi::Value Release(const Napi::CallbackInfo &info);
+
+  // Hands queued requests to idle instances, oldest request first
+  void dispatch();
+  void complete(size_t index);
+  // Idle instance whose last context shares the longest prefix with prompt
+  size_t pick(const std::string &prompt);
+
+private:
+  struct PendingQuery {
+    QueryWorker *worker;
+    std::string prompt;
+    std::chrono::steady_clock::time_point enqueued;
+  };
+
+  static Napi::FunctionReference constructor;
+  std::vector<ContextHolder *> _contexts;
+  std::vector<std::shared_ptr<Executor>> executors_;
+  std::vector<bool> busy_;
+  std::deque<PendingQuery> pending_;
+  size_t running_ = 0;
+  bool released_ = false;
+  ReleaseWorker *release_worker_ = NULL;
+  uint64_t dispatched_ = 0;
+  double wait_last_ms_ = 0;
+  double wait_max_ms_ = 0;
+  double wait_total_ms_ = 0;
+};
@@ -1,5 +1,7 @@
 #include "Embedding.h"
 #include "EmbeddingsHolder.h"
+#include "EmbeddingBatchWorker.h"
+#include "EmbeddingLoadWorker.h"
 #include "EmbeddingQueryWorker.h"
 #include "ReleaseWorker.h"
 #include <stdexcept>
@@ -7,14 +9,46 @@
 
 Napi::FunctionReference Embedding::constructor;
 
+bool parseEmbeddingOptions(Napi::Env env, const Napi::Value &value,
+                                  EmbeddingOptions &options) {
+  if (!value.IsObject()) {
+    return true;
+  }
+  Napi::Object opts = value.As<Napi::Object>();
+  try {
+    if (opts.Get("pooling").IsString()) {
+      options.pooling =
+          parseEmbeddingPooling(opts.Get("pooling").As<Napi::String>().Utf8Value());
+    }
+    if (opts.Get("dtype").IsString()) {
+      options.type =
+          parseEmbeddingType(opts.Get("dtype").As<Napi::String>().Utf8Value());
+    }
+  } catch (const std::runtime_error &e) {
+    Napi::TypeError::New(env, e.what()).ThrowAsJavaScriptException();
+    return false;
+  }
+  options.normalize = opts.Get("normalize").ToBoolean().Value();
+  return true;
+}
+
 Napi::Object Embedding::Init(Napi::Env env, Napi::Object &exports) {
   Napi::HandleScope scope(env);
   Napi::Function func = DefineClass(
       env, "Embedding",
       {
+          StaticMethod<&Embedding::Create>(
+              "create", static_cast<napi_property_attributes>(
+                            napi_writable | napi_configurable)),
           InstanceMethod<&Embedding::Query>(
               "query", static_cast<napi_property_attributes>(
                            napi_writable | napi_configurable)),
+          InstanceMethod<&Embedding::QueryBatch>(
+              "queryBatch", static_cast<napi_property_attributes>(
+                                napi_writable | napi_configurable)),
+          InstanceMethod<&Embedding::CacheStats>(
+              "cacheStats", static_cast<napi_property_attributes>(
+                                napi_writable | napi_configurable)),
           InstanceMethod<&Embedding::Release>(
               "release", static_cast<napi_property_attributes>(
                              napi_writable | napi_configurable)),
@@ -33,8 +67,59 @@ Embedding::Embedding(const Napi::CallbackInfo &info)
 
 Embedding::~Embedding() {
   if (_embedding) {
-    delete _embedding;
+    // After the queries still running on it
+    EmbeddingsHolder *embedding = _embedding;
+    _executor->submit([embedding]() { delete embedding; });
+  }
+}
+
+EmbeddingsHolder *Embedding::HolderOf(const Napi::Value &value) {
+  if (!value.IsObject() ||
+      !value.As<Napi::Object>().InstanceOf(constructor.Value())) {
+    return NULL;
+  }
+  return Unwrap(value.As<Napi::Object>())->_embedding;
+}
+
+std::shared_ptr<Executor> Embedding::ExecutorOf(const Napi::Value &value) {
+  if (!value.IsObject() ||
+      !value.As<Napi::Object>().InstanceOf(constructor.Value())) {
+    return NULL;
   }
+  return Unwrap(value.As<Napi::Object>())->_executor;
+}
+
+Napi::Value Embedding::Create(const Napi::CallbackInfo &info) {
+  Napi::Env env = info.Env();
+  Napi::HandleScope scope(env);
+  Napi::Object JSON = env.Global().Get("JSON").As<Napi::Object>();
+  Napi::Function stringify = JSON.Get("stringify").As<Napi::Function>();
+  std::string config_json =
+      stringify.Call({info[0]}).As<Napi::String>().Utf8Value();
+  // { cache: true | { max_mb, path } }
+  size_t cache_bytes = 0;
+  std::string cache_path;
+  if (info[1].IsObject()) {
+    Napi::Value cache = info[1].As<Napi::Object>().Get("cache");
+    if (cache.IsObject()) {
+      Napi::Object opts = cache.As<Napi::Object>();
+      cache_bytes = 64 << 20;
+      if (opts.Get("max_mb").IsNumber()) {
+        int64_t mb = opts.Get("max_mb").As<Napi::Number>().Int64Value();
+        cache_bytes = mb > 0 ? static_cast<size_t>(mb) << 20 : 0;
+      }
+      if (opts.Get("path").IsString()) {
+        cache_path = opts.Get("path").As<Napi::String>().Utf8Value();
+      }
+    } else if (cache.ToBoolean().Value()) {
+      cache_bytes = 64 << 20;
+    }
+  }
+  auto worker = new EmbeddingLoadWorker(
+      env, std::make_shared<Executor>(env, "embedding"), config_json,
+      cache_bytes, cache_path);
+  worker->Queue();
+  return worker->Promise();
 }
 
 Napi::Value Embedding::Query(const Napi::CallbackInfo &info) {
@@ -47,11 +132,71 @@ Napi::Value Embedding::Query(const Napi::CallbackInfo &info) {
   }
   std::string prompt = info[0].As<Napi::String>().Utf8Value();
   Napi::Function callback = info[1].As<Napi::Function>();
-  auto worker = new EmbeddingQueryWorker(env, prompt, _embedding, callback);
+  EmbeddingOptions options;
+  if (!parseEmbeddingOptions(env, info[2], options)) {
+    return env.Undefined();
+  }
+  auto worker =
+      new EmbeddingQueryWorker(env, prompt, _embedding, _executor, callback,
+                               options);
+  worker->Queue();
+  return worker->Promise();
+}
+
+Napi::Value Embedding::QueryBatch(const Napi::CallbackInfo &info) {
+  Napi::Env env = info.Env();
+  Napi::HandleScope scope(env);
+  if (_embedding == NULL) {
+    Napi::Error::New(env, "Embedding is not initialized")
+        .ThrowAsJavaScriptException();
+    return env.Undefined();
+  }
+  if (!info[0].IsArray()) {
+    Napi::TypeError::New(env, "prompts must be an array of strings")
+        .ThrowAsJavaScriptException();
+    return env.Undefined();
+  }
+  Napi::Array array = info[0].As<Napi::Array>();
+  std::vector<std::string> prompts;
+  prompts.reserve(array.Length());
+  for (uint32_t i = 0; i < array.Length(); i++) {
+    Napi::Value prompt = array.Get(i);
+    if (!prompt.IsString()) {
+      Napi::TypeError::New(env, "prompts must be an array of strings")
+          .ThrowAsJavaScriptException();
+      return env.Undefined();
+    }
+    prompts.push_back(prompt.As<Napi::String>().Utf8Value());
+  }
+  EmbeddingOptions options;
+  if (!parseEmbeddingOptions(env, info[1], options)) {
+    return env.Undefined();
+  }
+  auto worker =
+      new EmbeddingBatchWorker(env, std::move(prompts), _embedding, _executor,
+                               options);
   worker->Queue();
   return worker->Promise();
 }
 
+Napi::Value Embedding::CacheStats(const Napi::CallbackInfo &info) {
+  Napi::Env env = info.Env();
+  if (_embedding == NULL || !_embedding->has_cache()) {
+    return env.Null();
+  }
+  EmbeddingCacheStats stats = _embedding->cache_stats();
+  uint64_t lookups = stats.hits + stats.misses;
+  Napi::Object result = Napi::Object::New(env);
+  result.Set("hits", Napi::Number::New(env, (double)stats.hits));
+  result.Set("misses", Napi::Number::New(env, (double)stats.misses));
+  result.Set("hit_rate",
+             Napi::Number::New(env, lookups ? (double)stats.hits / lookups : 0));
+  result.Set("entries", Napi::Number::New(env, (double)stats.entries));
+  result.Set("memory_bytes", Napi::Number::New(env, (double)stats.memory_bytes));
+  result.Set("file_bytes", Napi::Number::New(env, (double)stats.file_bytes));
+  return result;
+}
+
 Napi::Value Embedding::Release(const Napi::CallbackInfo &info) {
   Napi::Env env = info.Env();
   Napi::HandleScope scope(env);
@@ -60,7 +205,10 @@ Napi::Value Embedding::Release(const Napi::CallbackInfo &info) {
         .ThrowAsJavaScriptException();
     return env.Undefined();
   }
-  auto worker = new ReleaseWorker(env, _embedding);
+  // Queued behind running queries; the thread exits once the worker is done
+  auto worker = new ReleaseWorker(env, _embedding, _executor);
+  _embedding = NULL;
+  _executor.reset();
   worker->Queue();
   return worker->Promise();
 }
@@ -1,26 +1,55 @@
 #pragma once
 
 #include "EmbeddingsHolder.h"
+#include "Executor.h"
+#include <memory>
 #include <napi.h>
 
+// Reads { pooling, normalize, dtype }; throws a JS error and returns false on
+// unknown values
+bool parseEmbeddingOptions(Napi::Env env, const Napi::Value &value,
+                           EmbeddingOptions &options);
+
 class Embedding : public Napi::ObjectWrap<Embedding> {
 public:
   static Napi::Object Init(Napi::Env env, Napi::Object &exports);
 
-  static inline Napi::Object New(Napi::External<EmbeddingsHolder> embedding) {
-    return constructor.New({embedding});
+  // Every call on the holder runs on executor
+  static inline Napi::Object New(Napi::External<EmbeddingsHolder> embedding,
+                                 std::shared_ptr<Executor> executor) {
+    Napi::Object object = constructor.New({embedding});
+    Unwrap(object)->_executor = std::move(executor);
+    return object;
   }
 
   Embedding(const Napi::CallbackInfo &info);
   ~Embedding();
 
+  // Holder of an Embedding instance and the executor running it, NULL for
+  // other values
+  static EmbeddingsHolder *HolderOf(const Napi::Value &value);
+  static std::shared_ptr<Executor> ExecutorOf(const Napi::Value &value);
+
 protected:
-  // embedding.query(prompt: string, callback: (result: vector<float>) => void): Promise<string>
+  // Embedding.create(config: object, options?: { cache?: true | { max_mb?,
+  // path? } }): Promise<Embedding>
+  static Napi::Value Create(const Napi::CallbackInfo &info);
+  // embedding.query(prompt: string, callback: (result: Float32Array |
+  // Uint16Array | Int8Array, scale: number) => void, options?: { pooling,
+  // normalize, dtype }): Promise<string>
   Napi::Value Query(const Napi::CallbackInfo &info);
+  // embedding.queryBatch(prompts: string[], options?): Promise<{ embeddings
+  // (count x dim), count, dim, dtype, scales?: Float32Array, item_ms:
+  // Float64Array, total_ms }>
+  Napi::Value QueryBatch(const Napi::CallbackInfo &info);
+  // embedding.cacheStats(): { hits, misses, hit_rate, entries, memory_bytes,
+  // file_bytes } | null
+  Napi::Value CacheStats(const Napi::CallbackInfo &info);
   // embedding.release(): Promise<void>
   Napi::Value Release(const Napi::CallbackInfo &info);
 
 private:
   static Napi::FunctionReference constructor;
   EmbeddingsHolder *_embedding = NULL;
+  std::shared_ptr<Executor> _executor;
 };
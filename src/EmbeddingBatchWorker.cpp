@@ -0,0 +1,73 @@
+#include "EmbeddingBatchWorker.h"
+#include "ExternalTypedArray.h"
+#include "metrics.h"
+#include "trace.h"
+#include <stdexcept>
+
+EmbeddingBatchWorker::EmbeddingBatchWorker(Napi::Env env,
+                                           std::vector<std::string> prompts,
+                                           EmbeddingsHolder *embedding,
+                                           std::shared_ptr<Executor> executor,
+                                           const EmbeddingOptions &options)
+    : ExecutorWorker(env, executor), Napi::Promise::Deferred(env),
+      prompts_(std::move(prompts)), _embedding(embedding), options_(options) {}
+
+void EmbeddingBatchWorker::Execute() {
+  trace::Span span("EmbeddingBatchWorker");
+  try {
+    _embedding->query_batch(prompts_, batch_, options_);
+  } catch (const std::runtime_error &e) {
+    perf::embedding_queries_error.inc();
+    SetError(e.what());
+  }
+  // Items before a failure still count as done
+  size_t row_bytes = batch_.dim * embeddingElementSize(batch_.type);
+  perf::embedding_queries_ok.inc(row_bytes ? batch_.data.size() / row_bytes : 0);
+  for (double ms : batch_.item_ms) {
+    perf::embedding_duration.observe(ms / 1000.0);
+  }
+}
+
+void EmbeddingBatchWorker::OnOK() {
+  Napi::Env env = Napi::AsyncWorker::Env();
+  Napi::HandleScope scope(env);
+  size_t count = prompts_.size();
+  // Rows were written once from the Genie callback; hand that buffer over
+  Napi::Value embeddings;
+  const char *dtype;
+  switch (batch_.type) {
+  case EmbeddingType::Int8:
+    embeddings = ExternalTypedArray<int8_t>(env, std::move(batch_.data));
+    dtype = "int8";
+    break;
+  case EmbeddingType::Float16:
+    embeddings = ExternalTypedArray<uint16_t>(env, std::move(batch_.data));
+    dtype = "float16";
+    break;
+  default:
+    embeddings = ExternalTypedArray<float>(env, std::move(batch_.data));
+    dtype = "float32";
+    break;
+  }
+  Napi::Float64Array item_ms = Napi::Float64Array::New(env, count);
+  for (size_t i = 0; i < count; i++) {
+    item_ms[i] = batch_.item_ms[i];
+  }
+  Napi::Object result = Napi::Object::New(env);
+  result.Set("embeddings", embeddings);
+  result.Set("count", Napi::Number::New(env, (double)count));
+  result.Set("dim", Napi::Number::New(env, batch_.dim));
+  result.Set("dtype", Napi::String::New(env, dtype));
+  if (batch_.type == EmbeddingType::Int8) {
+    Napi::Float32Array scales = Napi::Float32Array::New(env, count);
+    for (size_t i = 0; i < count; i++) {
+      scales[i] = batch_.scales[i];
+    }
+    result.Set("scales", scales);
+  }
+  result.Set("item_ms", item_ms);
+  result.Set("total_ms", Napi::Number::New(env, batch_.total_ms));
+  Resolve(result);
+}
+
+void EmbeddingBatchWorker::OnError(const Napi::Error &e) { Reject(e.Value()); }
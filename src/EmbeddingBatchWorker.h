@@ -0,0 +1,25 @@
+#pragma once
+
+#include "EmbeddingsHolder.h"
+#include "ExecutorWorker.h"
+#include <napi.h>
+#include <string>
+#include <vector>
+
+class EmbeddingBatchWorker : public ExecutorWorker,
+                             public Napi::Promise::Deferred {
+public:
+  EmbeddingBatchWorker(Napi::Env env, std::vector<std::string> prompts,
+                       EmbeddingsHolder *embedding,
+                       std::shared_ptr<Executor> executor,
+                       const EmbeddingOptions &options = EmbeddingOptions());
+  void Execute();
+  void OnOK();
+  void OnError(const Napi::Error &e);
+
+private:
+  std::vector<std::string> prompts_;
+  EmbeddingsHolder *_embedding;
+  EmbeddingOptions options_;
+  EmbeddingBatch batch_;
+};
@@ -0,0 +1,35 @@
+#include "EmbeddingLoadWorker.h"
+#include "Embedding.h"
+#include "metrics.h"
+#include "trace.h"
+#include <stdexcept>
+
+EmbeddingLoadWorker::EmbeddingLoadWorker(Napi::Env env,
+                                         std::shared_ptr<Executor> executor,
+                                         std::string config_json,
+                                         size_t cache_bytes,
+                                         std::string cache_path)
+    : ExecutorWorker(env, executor), Napi::Promise::Deferred(env),
+      config_json_(config_json), cache_bytes_(cache_bytes),
+      cache_path_(cache_path) {}
+
+void EmbeddingLoadWorker::Execute() {
+  trace::Span span("EmbeddingLoadWorker");
+  auto start = std::chrono::steady_clock::now();
+  try {
+    _embedding = new EmbeddingsHolder(config_json_, cache_bytes_, cache_path_);
+    perf::load_ok.inc();
+  } catch (const std::runtime_error &e) {
+    perf::load_error.inc();
+    SetError(e.what());
+  }
+  perf::load_duration.observe(perf::secondsSince(start));
+}
+
+void EmbeddingLoadWorker::OnOK() {
+  Resolve(Embedding::New(Napi::External<EmbeddingsHolder>::New(
+                             Napi::AsyncWorker::Env(), _embedding),
+                         executor()));
+}
+
+void EmbeddingLoadWorker::OnError(const Napi::Error &e) { Reject(e.Value()); }
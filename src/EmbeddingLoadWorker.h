@@ -0,0 +1,23 @@
+#pragma once
+
+#include "EmbeddingsHolder.h"
+#include "ExecutorWorker.h"
+#include <napi.h>
+
+class EmbeddingLoadWorker : public ExecutorWorker,
+                            public Napi::Promise::Deferred {
+public:
+  // Loads on the executor the new Embedding will own
+  EmbeddingLoadWorker(Napi::Env env, std::shared_ptr<Executor> executor,
+                      std::string config_json, size_t cache_bytes = 0,
+                      std::string cache_path = "");
+  void Execute();
+  void OnOK();
+  void OnError(const Napi::Error &e);
+
+private:
+  std::string config_json_;
+  size_t cache_bytes_;
+  std::string cache_path_;
+  EmbeddingsHolder *_embedding = NULL;
+};
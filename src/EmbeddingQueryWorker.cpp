@@ -1,33 +1,58 @@
 #include "EmbeddingQueryWorker.h"
 #include "EmbeddingsHolder.h"
+#include "ExternalTypedArray.h"
+#include "metrics.h"
+#include "trace.h"
 #include <stdexcept>
 #include <memory>
 
-EmbeddingQueryWorker::EmbeddingQueryWorker(Napi::Env env, std::string prompt,
-                         EmbeddingsHolder *embedding, Napi::Function callback)
-    : Napi::AsyncWorker(env), Napi::Promise::Deferred(env), prompt_(prompt),
-      _embedding(embedding) {
-  _tsfn =
-      Napi::ThreadSafeFunction::New(env, callback, "EmbeddingQueryWorkerCallback", 0, 1);
+static Napi::Value EmbeddingArray(Napi::Env env, std::unique_ptr<uint8_t[]> data,
+                                  size_t length, EmbeddingType type) {
+  switch (type) {
+  case EmbeddingType::Int8:
+    return ExternalTypedArray<int8_t>(env, std::move(data), length);
+  case EmbeddingType::Float16:
+    return ExternalTypedArray<uint16_t>(env, std::move(data), length);
+  default:
+    return ExternalTypedArray<float>(env, std::move(data), length);
+  }
 }
 
+EmbeddingQueryWorker::EmbeddingQueryWorker(Napi::Env env, std::string prompt,
+                         EmbeddingsHolder *embedding,
+                         std::shared_ptr<Executor> executor,
+                         Napi::Function callback,
+                         const EmbeddingOptions &options)
+    : ExecutorWorker(env, executor), Napi::Promise::Deferred(env), prompt_(prompt),
+      _embedding(embedding), options_(options),
+      _callback(Napi::Persistent(callback)) {}
+
 void EmbeddingQueryWorker::Execute() {
+  trace::Span span("EmbeddingQueryWorker");
+  auto start = std::chrono::steady_clock::now();
   try {
     profile_json_ = _embedding->query(
         prompt_,
-        [this](std::vector<float> embedding) {
-          std::unique_ptr<std::vector<float>> embedding_ptr = std::make_unique<std::vector<float>>(embedding);
-          this->_tsfn.NonBlockingCall(embedding_ptr.release(), [this](Napi::Env env, Napi::Function callback, std::vector<float>* embedding_ptr) {
+        [this](std::unique_ptr<uint8_t[]> data, size_t length, float scale) {
+          EmbeddingType type = this->options_.type;
+          // The buffer becomes the typed array's backing store
+          uint8_t *buffer = data.get();
+          bool posted = executor()->post([this, buffer, length, scale, type](Napi::Env env) {
             Napi::HandleScope scope(env);
-            Napi::Float32Array array = Napi::Float32Array::New(env, embedding_ptr->size());
-            std::copy(embedding_ptr->begin(), embedding_ptr->end(), array.Data());
-            delete embedding_ptr;
-            callback.Call({array});
+            _callback.Call({EmbeddingArray(env, std::unique_ptr<uint8_t[]>(buffer), length, type),
+                            Napi::Number::New(env, scale)});
           });
-        });
+          if (posted) {
+            data.release();
+          }
+        },
+        options_);
+    perf::embedding_queries_ok.inc();
   } catch (const std::runtime_error &e) {
+    perf::embedding_queries_error.inc();
     SetError(e.what());
   }
+  perf::embedding_duration.observe(perf::secondsSince(start));
 }
 
 void EmbeddingQueryWorker::OnOK() {
@@ -1,10 +1,12 @@
 #include "EmbeddingsHolder.h"
+#include "ExecutorWorker.h"
 #include <napi.h>
 
-class EmbeddingQueryWorker : public Napi::AsyncWorker, public Napi::Promise::Deferred {
+class EmbeddingQueryWorker : public ExecutorWorker, public Napi::Promise::Deferred {
 public:
   EmbeddingQueryWorker(Napi::Env env, std::string prompt, EmbeddingsHolder *embedding,
-              Napi::Function callback);
+              std::shared_ptr<Executor> executor, Napi::Function callback,
+              const EmbeddingOptions &options = EmbeddingOptions());
   void Execute();
   void OnOK();
   void OnError(const Napi::Error &e);
@@ -12,6 +14,7 @@ public:
 private:
   std::string prompt_;
   EmbeddingsHolder *_embedding;
-  Napi::ThreadSafeFunction _tsfn;
+  EmbeddingOptions options_;
+  Napi::FunctionReference _callback;
   std::string profile_json_;
 };
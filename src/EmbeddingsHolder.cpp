@@ -1,8 +1,18 @@
 #include "EmbeddingsHolder.h"
+#include "metrics.h"
+#include "trace.h"
 #include "utils.h"
+#include <chrono>
 #include <stdexcept>
 
-EmbeddingsHolder::EmbeddingsHolder(std::string config_json) {
+EmbeddingsHolder::EmbeddingsHolder(std::string config_json, size_t cache_bytes,
+                                   std::string cache_path) {
+  if (cache_bytes > 0 || !cache_path.empty()) {
+    // The config and its model files identify the model, outputs of others
+    // are not reused
+    cache = std::make_unique<EmbeddingCache>(embeddingModelIdentity(config_json),
+                                             cache_bytes, cache_path);
+  }
   Genie_Status_t status;
   status = GenieProfile_create(NULL, &profile);
   if (status != GENIE_STATUS_SUCCESS) {
@@ -19,12 +29,16 @@ EmbeddingsHolder::EmbeddingsHolder(std::string config_json) {
     GenieProfile_free(profile);
     throw std::runtime_error(Genie_Status_ToString(status));
   }
-  status = GenieEmbedding_create(config, &embedding);
+  {
+    trace::Span span("GenieEmbedding_create");
+    status = GenieEmbedding_create(config, &embedding);
+  }
   if (status != GENIE_STATUS_SUCCESS) {
     GenieEmbeddingConfig_free(config);
     GenieProfile_free(profile);
     throw std::runtime_error(Genie_Status_ToString(status));
   }
+  perf::embeddings.inc();
 }
 
 EmbeddingsHolder::~EmbeddingsHolder() {
@@ -33,10 +47,12 @@ EmbeddingsHolder::~EmbeddingsHolder() {
   } catch (const std::runtime_error &e) {
     // nothing to do
   }
+  perf::embeddings.dec();
 }
 
 void EmbeddingsHolder::release() {
   if (embedding) {
+    trace::Span span("GenieEmbedding_free");
     Genie_Status_t status = GenieEmbedding_free(embedding);
     if (status != GENIE_STATUS_SUCCESS) {
       throw std::runtime_error(Genie_Status_ToString(status));
@@ -53,17 +69,65 @@ void EmbeddingsHolder::release() {
   }
 }
 
-std::string EmbeddingsHolder::query(std::string prompt, const EmbeddingsCallback &callback) {
+EmbeddingCacheStats EmbeddingsHolder::cache_stats() const {
+  return cache ? cache->stats() : EmbeddingCacheStats();
+}
+
+void EmbeddingsHolder::store_pending(const std::string &prompt, Genie_Status_t status) {
+  // Only a complete, single output is worth reusing
+  if (cache && status == GENIE_STATUS_SUCCESS && pending_outputs == 1) {
+    cache->store(prompt, pending_dimensions.data(),
+                 static_cast<uint32_t>(pending_dimensions.size()),
+                 pending_values.data());
+  }
+  pending_outputs = 0;
+}
+
+bool EmbeddingsHolder::serve_cached(const std::string &prompt) {
+  if (!cache) {
+    return false;
+  }
+  trace::Span span("embedding_cache_lookup");
+  bool hit = cache->lookup(prompt, [this](const uint32_t *dimensions, uint32_t rank,
+                                          const float *values) {
+    on_embeddings(dimensions, rank, values, this);
+  });
+  (hit ? perf::embedding_cache_hits : perf::embedding_cache_misses).inc();
+  return hit;
+}
+
+std::string EmbeddingsHolder::query(std::string prompt, const EmbeddingsCallback &callback,
+                                   const EmbeddingOptions &options) {
   if (busying) {
     throw std::runtime_error("Embedding context is busy");
   }
   busying = true;
-  this->callback = std::move(callback);
-  Genie_Status_t status = GenieEmbedding_generate(embedding, prompt.c_str(), on_embeddings, this);
+  Genie_Status_t status;
+  try {
+    this->callback = std::move(callback);
+    this->options = options;
+    // Hits skip the NPU and have no profile
+    if (serve_cached(prompt)) {
+      busying = false;
+      return std::string();
+    }
+    trace::Span span("GenieEmbedding_generate");
+    this->prompt = &prompt;
+    pending_outputs = 0;
+    status = GenieEmbedding_generate(embedding, prompt.c_str(), on_embeddings, this);
+    this->prompt = nullptr;
+    store_pending(prompt, status);
+  } catch (...) {
+    // A failed cache read or callback must not leave the context busy
+    this->prompt = nullptr;
+    busying = false;
+    throw;
+  }
   busying = false;
   if (status != GENIE_STATUS_SUCCESS) {
     throw std::runtime_error(Genie_Status_ToString(status));
   }
+  trace::Span span("GenieProfile_getJsonData");
   const char* profile_json = nullptr;
   GenieProfile_getJsonData(profile, alloc_json_data, &profile_json);
   std::string profile_json_str(profile_json);
@@ -71,17 +135,109 @@ std::string EmbeddingsHolder::query(std::string prompt, const EmbeddingsCallback
   return profile_json_str;
 }
 
+void EmbeddingsHolder::query_batch(const std::vector<std::string> &prompts,
+                                   EmbeddingBatch &batch,
+                                   const EmbeddingOptions &options) {
+  if (busying) {
+    throw std::runtime_error("Embedding context is busy");
+  }
+  busying = true;
+  std::string error;
+  try {
+    this->batch = &batch;
+    this->options = options;
+    batch.type = options.type;
+    trace::Span span("GenieEmbedding_generate", std::to_string(prompts.size()) + " prompts");
+    auto start = std::chrono::steady_clock::now();
+    batch.item_ms.reserve(prompts.size());
+    for (size_t i = 0; i < prompts.size(); i++) {
+      auto item_start = std::chrono::steady_clock::now();
+      batch_items = 0;
+      batch_mismatch = false;
+      Genie_Status_t status = GENIE_STATUS_SUCCESS;
+      if (!serve_cached(prompts[i])) {
+        this->prompt = &prompts[i];
+        pending_outputs = 0;
+        status = GenieEmbedding_generate(embedding, prompts[i].c_str(),
+                                         on_embeddings, this);
+        this->prompt = nullptr;
+        store_pending(prompts[i], status);
+      }
+      batch.item_ms.push_back(std::chrono::duration<double, std::milli>(
+                                  std::chrono::steady_clock::now() - item_start)
+                                  .count());
+      if (status != GENIE_STATUS_SUCCESS) {
+        error = Genie_Status_ToString(status);
+      } else if (batch_mismatch) {
+        error = "Embedding size changed at item " + std::to_string(i);
+      } else if (batch_items != 1) {
+        error = "Expected one embedding for item " + std::to_string(i);
+      }
+      if (!error.empty()) {
+        break;
+      }
+      if (i == 0) {
+        batch.data.reserve(batch.data.size() * prompts.size());
+      }
+    }
+    batch.total_ms = std::chrono::duration<double, std::milli>(
+                         std::chrono::steady_clock::now() - start)
+                         .count();
+  } catch (...) {
+    this->prompt = nullptr;
+    this->batch = nullptr;
+    busying = false;
+    throw;
+  }
+  this->batch = nullptr;
+  busying = false;
+  if (!error.empty()) {
+    throw std::runtime_error(error);
+  }
+}
+
 void EmbeddingsHolder::on_embeddings(const uint32_t* dimensions,
                                      const uint32_t rank,
                                      const float* embeddingBuffer,
                                      const void* userData) {
   EmbeddingsHolder *embeddingsHolder = (EmbeddingsHolder *)userData;
-  if (embeddingsHolder->callback) {
-    size_t size = 1;
+  // Kept until generate returns, the output of a failed call is not cached
+  if (embeddingsHolder->cache && embeddingsHolder->prompt &&
+      embeddingsHolder->pending_outputs++ == 0) {
+    size_t count = 1;
     for (uint32_t i = 0; i < rank; i++) {
-      size *= dimensions[i];
+      count *= dimensions[i];
+    }
+    embeddingsHolder->pending_dimensions.assign(dimensions, dimensions + rank);
+    embeddingsHolder->pending_values.assign(embeddingBuffer, embeddingBuffer + count);
+  }
+  const EmbeddingOptions &options = embeddingsHolder->options;
+  size_t length = embeddingOutputLength(dimensions, rank, options);
+  size_t bytes = length * embeddingElementSize(options.type);
+  if (EmbeddingBatch *batch = embeddingsHolder->batch) {
+    if (batch->data.empty()) {
+      batch->dim = static_cast<uint32_t>(length);
     }
-    std::vector<float> embedding(embeddingBuffer, embeddingBuffer + size);
-    embeddingsHolder->callback(embedding);
+    // Rows have to line up in the contiguous output
+    if (length != batch->dim) {
+      embeddingsHolder->batch_mismatch = true;
+      return;
+    }
+    size_t offset = batch->data.size();
+    batch->data.resize(offset + bytes);
+    float scale = convertEmbedding(embeddingBuffer, dimensions, rank, options,
+                                   batch->data.data() + offset,
+                                   embeddingsHolder->scratch);
+    if (options.type == EmbeddingType::Int8) {
+      batch->scales.push_back(scale);
+    }
+    embeddingsHolder->batch_items++;
+    return;
+  }
+  if (embeddingsHolder->callback) {
+    std::unique_ptr<uint8_t[]> data(new uint8_t[bytes]);
+    float scale = convertEmbedding(embeddingBuffer, dimensions, rank, options,
+                                   data.get(), embeddingsHolder->scratch);
+    embeddingsHolder->callback(std::move(data), length, scale);
   }
 }
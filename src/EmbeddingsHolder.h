@@ -1,20 +1,47 @@
 #pragma once
 
 #include "GenieEmbedding.h"
+#include "embedding_cache.h"
+#include "embedding_ops.h"
 #include <atomic>
 #include <functional>
+#include <memory>
 #include <string>
 #include <vector>
 
+// Embeddings of several prompts, stored row-major as count x dim elements of
+// type
+struct EmbeddingBatch {
+  std::vector<uint8_t> data;
+  uint32_t dim = 0;
+  EmbeddingType type = EmbeddingType::Float32;
+  // One per row for EmbeddingType::Int8
+  std::vector<float> scales;
+  std::vector<double> item_ms;
+  double total_ms = 0;
+};
+
 class EmbeddingsHolder {
-  using EmbeddingsCallback =
-      std::function<void(std::vector<float>)>;
+  // Receives the only copy of the Genie output buffer: length elements of the
+  // requested type, and the int8 scale
+  using EmbeddingsCallback = std::function<void(
+      std::unique_ptr<uint8_t[]> data, size_t length, float scale)>;
 
 public:
-  EmbeddingsHolder(std::string config_json);
+  // Caches outputs when cache_bytes or cache_path is set
+  EmbeddingsHolder(std::string config_json, size_t cache_bytes = 0,
+                   std::string cache_path = "");
   ~EmbeddingsHolder();
   void release();
-  std::string query(std::string prompt, const EmbeddingsCallback &callback);
+  bool has_cache() const { return cache != nullptr; }
+  EmbeddingCacheStats cache_stats() const;
+  std::string query(std::string prompt, const EmbeddingsCallback &callback,
+                    const EmbeddingOptions &options = EmbeddingOptions());
+  // Generates every prompt in turn on the calling thread, without profile
+  // JSON or per-item callbacks
+  void query_batch(const std::vector<std::string> &prompts,
+                   EmbeddingBatch &batch,
+                   const EmbeddingOptions &options = EmbeddingOptions());
 
 protected:
   static void on_embeddings(const uint32_t* dimensions,
@@ -23,9 +50,26 @@ protected:
                             const void* userData);
 
 private:
+  bool serve_cached(const std::string &prompt);
+  void store_pending(const std::string &prompt, Genie_Status_t status);
+
   std::atomic<bool> busying = false;
   GenieEmbedding_Handle_t embedding = NULL;
   GenieEmbeddingConfig_Handle_t config = NULL;
   GenieProfile_Handle_t profile = NULL;
   EmbeddingsCallback callback = nullptr;
+  EmbeddingOptions options;
+  std::unique_ptr<EmbeddingCache> cache;
+  // Prompt being generated; on_embeddings copies its output here, and it is
+  // stored in the cache once generate succeeds
+  const std::string *prompt = nullptr;
+  std::vector<uint32_t> pending_dimensions;
+  std::vector<float> pending_values;
+  size_t pending_outputs = 0;
+  // Pooled / normalized values before conversion, reused across outputs
+  std::vector<float> scratch;
+  // Set during query_batch, on_embeddings appends to it directly
+  EmbeddingBatch *batch = nullptr;
+  size_t batch_items = 0;
+  bool batch_mismatch = false;
 };
\ No newline at end of file
@@ -0,0 +1,111 @@
+#include "Executor.h"
+#include "metrics.h"
+#include "trace.h"
+
+Executor::Executor(Napi::Env env, const char *name)
+    : env_(env), name_(name),
+      closed_(std::make_shared<std::atomic<bool>>(false)) {
+  // Added before the thread-safe function, so it runs after the function is
+  // closed by its own hook and no later post() can succeed
+  cleanup_ = env.AddCleanupHook(std::function<void()>([this] { shutdown(); }));
+  std::shared_ptr<std::atomic<bool>> closed = closed_;
+  _tsfn = Napi::ThreadSafeFunction::New(
+      env, Napi::Function::New(env, [](const Napi::CallbackInfo &) {}),
+      "ExecutorCallback", 0, 1, [closed](Napi::Env) { closed->store(true); });
+  // An idle instance does not keep the process alive
+  _tsfn.Unref(env);
+  thread_ = std::thread(&Executor::run, this);
+}
+
+Executor::~Executor() {
+  {
+    std::lock_guard<std::mutex> lock(mutex_);
+    stopping_ = true;
+  }
+  cv_.notify_one();
+  thread_.join();
+  // Calls already queued are still delivered
+  if (!closed_->load()) {
+    _tsfn.Release();
+  }
+  // The hook may be the one destroying the executor
+  if (!shut_down_) {
+    cleanup_.Remove(env_);
+  }
+}
+
+void Executor::submit(Job job) {
+  perf::executor_jobs.inc();
+  {
+    std::lock_guard<std::mutex> lock(mutex_);
+    jobs_.push_back(std::move(job));
+  }
+  cv_.notify_one();
+}
+
+bool Executor::post(Callback callback) {
+  uint64_t queued = trace::enabled() ? trace::now() : 0;
+  perf::tsfn_pending.inc();
+  napi_status status = _tsfn.NonBlockingCall(
+      [callback = std::move(callback), queued](Napi::Env env, Napi::Function) {
+        perf::tsfn_pending.dec();
+        if (queued) {
+          trace::complete("tsfn_dispatch", queued, trace::now());
+        }
+        callback(env);
+      });
+  if (status != napi_ok) {
+    perf::tsfn_pending.dec();
+    return false;
+  }
+  return true;
+}
+
+void Executor::abandon(Job cleanup) {
+  std::lock_guard<std::mutex> lock(mutex_);
+  if (!shut_down_) {
+    abandoned_.push_back(std::move(cleanup));
+  }
+}
+
+void Executor::shutdown() {
+  std::vector<Job> abandoned;
+  {
+    std::lock_guard<std::mutex> lock(mutex_);
+    shut_down_ = true;
+    abandoned.swap(abandoned_);
+  }
+  // May delete the last worker holding this executor
+  for (Job &cleanup : abandoned) {
+    cleanup();
+  }
+}
+
+void Executor::ref() {
+  if (refs_++ == 0 && !closed_->load()) {
+    _tsfn.Ref(env_);
+  }
+}
+
+void Executor::unref() {
+  if (--refs_ == 0 && !closed_->load()) {
+    _tsfn.Unref(env_);
+  }
+}
+
+void Executor::run() {
+  trace::setThreadName(name_);
+  std::unique_lock<std::mutex> lock(mutex_);
+  while (true) {
+    cv_.wait(lock, [this] { return stopping_ || !jobs_.empty(); });
+    if (jobs_.empty()) {
+      return;
+    }
+    Job job = std::move(jobs_.front());
+    jobs_.pop_front();
+    lock.unlock();
+    job();
+    perf::executor_jobs.dec();
+    lock.lock();
+  }
+}
@@ -0,0 +1,67 @@
+#pragma once
+
+#include <atomic>
+#include <condition_variable>
+#include <deque>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <napi.h>
+#include <thread>
+#include <vector>
+
+// Long-lived native thread running the jobs of one model instance in order,
+// so model work never holds a libuv threadpool thread that fs, dns and crypto
+// need. Everything a job hands back to JS (token callbacks, embeddings,
+// completions) goes through one thread-safe function owned by the executor,
+// and arrives in the order it was posted.
+//
+// Created, referenced and destroyed on the JS thread; submit() and post() can
+// be called from any thread.
+class Executor {
+public:
+  using Job = std::function<void()>;
+  using Callback = std::function<void(Napi::Env)>;
+
+  // name labels the thread in traces and must be a string literal
+  Executor(Napi::Env env, const char *name);
+  // Runs the jobs still queued, then joins the thread
+  ~Executor();
+
+  Executor(const Executor &) = delete;
+  Executor &operator=(const Executor &) = delete;
+
+  void submit(Job job);
+  // Runs callback on the JS thread; false once the environment is shutting
+  // down and the callback will never run
+  bool post(Callback callback);
+  // Runs cleanup on the JS thread when the environment is torn down, for work
+  // whose completion could not be posted. Dropped if teardown already ran.
+  void abandon(Job cleanup);
+
+  // The event loop is kept alive while at least one reference is held, like
+  // for a queued AsyncWorker (JS thread only)
+  void ref();
+  void unref();
+
+private:
+  void run();
+  void shutdown();
+
+  Napi::Env env_;
+  const char *name_;
+  Napi::ThreadSafeFunction _tsfn;
+  // Set by the finalizer, which runs on its own during environment teardown
+  std::shared_ptr<std::atomic<bool>> closed_;
+  size_t refs_ = 0;
+
+  std::mutex mutex_;
+  std::condition_variable cv_;
+  std::deque<Job> jobs_;
+  bool stopping_ = false;
+  std::thread thread_;
+
+  Napi::Env::CleanupHook<std::function<void()>> cleanup_;
+  std::vector<Job> abandoned_;
+  bool shut_down_ = false;
+};
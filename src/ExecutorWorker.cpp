@@ -0,0 +1,30 @@
+#include "ExecutorWorker.h"
+
+ExecutorWorker::ExecutorWorker(Napi::Env env,
+                               std::shared_ptr<Executor> executor)
+    : Napi::AsyncWorker(env), executor_(std::move(executor)) {}
+
+void ExecutorWorker::Queue() {
+  if (!executor_) {
+    Napi::AsyncWorker::Queue();
+    return;
+  }
+  Executor *executor = executor_.get();
+  executor->ref();
+  executor->submit([this, executor]() {
+    OnExecute(Env());
+    // Settles the worker and deletes it, which may destroy the executor
+    bool posted = executor->post([this, executor](Napi::Env env) {
+      executor->unref();
+      OnWorkComplete(env, napi_ok);
+    });
+    if (!posted) {
+      // The environment is shutting down and the promise can no longer
+      // settle; the worker is still deleted on the JS thread
+      executor->abandon([this, executor]() {
+        executor->unref();
+        delete this;
+      });
+    }
+  });
+}
@@ -0,0 +1,27 @@
+#pragma once
+
+#include "Executor.h"
+#include <memory>
+#include <napi.h>
+
+// AsyncWorker whose Execute() runs on an Executor instead of the libuv
+// threadpool, with OnOK / OnError delivered through the executor's
+// thread-safe function after everything the worker posted before. Without an
+// executor it is queued on the threadpool like any AsyncWorker.
+class ExecutorWorker : public Napi::AsyncWorker {
+public:
+  void Queue();
+
+  const std::shared_ptr<Executor> &executor() const { return executor_; }
+  // For workers created before their instance is picked (ContextPool)
+  void setExecutor(std::shared_ptr<Executor> executor) {
+    executor_ = std::move(executor);
+  }
+
+protected:
+  ExecutorWorker(Napi::Env env, std::shared_ptr<Executor> executor);
+
+private:
+  // Keeps the thread alive until the worker is deleted on the JS thread
+  std::shared_ptr<Executor> executor_;
+};
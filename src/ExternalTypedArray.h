@@ -0,0 +1,53 @@
+#pragma once
+
+#include <cstring>
+#include <memory>
+#include <napi.h>
+#include <vector>
+
+// Typed arrays backed by native memory that is freed when the ArrayBuffer is
+// collected, so results reach JS without another copy. Runtimes that forbid
+// external buffers (Electron with the V8 sandbox) get a copy instead.
+
+template <typename T>
+inline Napi::TypedArrayOf<T>
+ExternalTypedArray(Napi::Env env, T *data, size_t length,
+                   napi_finalize finalize, void *hint) {
+  napi_value buffer;
+  napi_status status = napi_create_external_arraybuffer(
+      env, data, length * sizeof(T), finalize, hint, &buffer);
+  if (status == napi_ok) {
+    return Napi::TypedArrayOf<T>::New(env, length,
+                                      Napi::ArrayBuffer(env, buffer), 0);
+  }
+  Napi::TypedArrayOf<T> array = Napi::TypedArrayOf<T>::New(env, length);
+  if (length > 0) {
+    std::memcpy(array.Data(), data, length * sizeof(T));
+  }
+  finalize(env, data, hint);
+  return array;
+}
+
+// Takes a byte buffer from new uint8_t[] holding length elements of T
+template <typename T>
+inline Napi::TypedArrayOf<T> ExternalTypedArray(Napi::Env env,
+                                                std::unique_ptr<uint8_t[]> data,
+                                                size_t length) {
+  return ExternalTypedArray(
+      env, reinterpret_cast<T *>(data.release()), length,
+      [](napi_env, void *data, void *) { delete[] static_cast<uint8_t *>(data); },
+      nullptr);
+}
+
+// Takes a byte vector holding whole elements of T
+template <typename T>
+inline Napi::TypedArrayOf<T> ExternalTypedArray(Napi::Env env,
+                                                std::vector<uint8_t> &&data) {
+  auto owner = new std::vector<uint8_t>(std::move(data));
+  return ExternalTypedArray(
+      env, reinterpret_cast<T *>(owner->data()), owner->size() / sizeof(T),
+      [](napi_env, void *, void *hint) {
+        delete static_cast<std::vector<uint8_t> *>(hint);
+      },
+      owner);
+}
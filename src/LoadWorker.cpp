@@ -1,22 +1,31 @@
 #include "LoadWorker.h"
 #include "Context.h"
+#include "metrics.h"
+#include "trace.h"
 #include <stdexcept>
 
-LoadWorker::LoadWorker(Napi::Env env, std::string config_json)
-    : Napi::AsyncWorker(env), Napi::Promise::Deferred(env),
-      config_json_(config_json) {}
+LoadWorker::LoadWorker(Napi::Env env, std::shared_ptr<Executor> executor,
+                       std::string config_json, bool profiling)
+    : ExecutorWorker(env, executor), Napi::Promise::Deferred(env),
+      config_json_(config_json), profiling_(profiling) {}
 
 void LoadWorker::Execute() {
+  trace::Span span("LoadWorker");
+  auto start = std::chrono::steady_clock::now();
   try {
-    _context = new ContextHolder(config_json_);
+    _context = new ContextHolder(config_json_, profiling_);
+    perf::load_ok.inc();
   } catch (const std::runtime_error &e) {
+    perf::load_error.inc();
     SetError(e.what());
   }
+  perf::load_duration.observe(perf::secondsSince(start));
 }
 
 void LoadWorker::OnOK() {
   Resolve(Context::New(
-      Napi::External<ContextHolder>::New(Napi::AsyncWorker::Env(), _context)));
+      Napi::External<ContextHolder>::New(Napi::AsyncWorker::Env(), _context),
+      executor()));
 }
 
 void LoadWorker::OnError(const Napi::Error &e) { Reject(e.Value()); }
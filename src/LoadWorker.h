@@ -1,14 +1,18 @@
 #include "ContextHolder.h"
+#include "ExecutorWorker.h"
 #include <napi.h>
 
-class LoadWorker : public Napi::AsyncWorker, public Napi::Promise::Deferred {
+class LoadWorker : public ExecutorWorker, public Napi::Promise::Deferred {
 public:
-  LoadWorker(Napi::Env env, std::string config_json);
+  // Loads on the executor the new Context will own
+  LoadWorker(Napi::Env env, std::shared_ptr<Executor> executor,
+             std::string config_json, bool profiling = false);
   void Execute();
   void OnOK();
   void OnError(const Napi::Error &e);
 
 private:
   std::string config_json_;
+  bool profiling_;
   ContextHolder *_context = NULL;
 };
\ No newline at end of file
@@ -0,0 +1,39 @@
+#include "PoolLoadWorker.h"
+#include "ContextPool.h"
+#include "metrics.h"
+#include "trace.h"
+#include <stdexcept>
+
+PoolLoadWorker::PoolLoadWorker(
+    Napi::Env env, std::vector<std::shared_ptr<Executor>> executors,
+    std::string config_json, bool profiling)
+    : ExecutorWorker(env, executors.front()), Napi::Promise::Deferred(env),
+      config_json_(config_json), executors_(std::move(executors)),
+      profiling_(profiling) {}
+
+void PoolLoadWorker::Execute() {
+  trace::Span span("PoolLoadWorker");
+  try {
+    for (size_t i = 0; i < executors_.size(); i++) {
+      auto start = std::chrono::steady_clock::now();
+      _contexts.push_back(new ContextHolder(config_json_, profiling_));
+      perf::load_ok.inc();
+      perf::load_duration.observe(perf::secondsSince(start));
+    }
+  } catch (const std::runtime_error &e) {
+    perf::load_error.inc();
+    for (ContextHolder *context : _contexts) {
+      delete context;
+    }
+    _contexts.clear();
+    SetError(e.what());
+  }
+}
+
+void PoolLoadWorker::OnOK() {
+  Resolve(ContextPool::New(Napi::External<std::vector<ContextHolder *>>::New(
+                               Napi::AsyncWorker::Env(), &_contexts),
+                           executors_));
+}
+
+void PoolLoadWorker::OnError(const Napi::Error &e) { Reject(e.Value()); }
@@ -0,0 +1,26 @@
+#pragma once
+
+#include "ContextHolder.h"
+#include "ExecutorWorker.h"
+#include <memory>
+#include <napi.h>
+#include <vector>
+
+class PoolLoadWorker : public ExecutorWorker,
+                       public Napi::Promise::Deferred {
+public:
+  // Loads the instances one after the other on the first executor, one
+  // executor per instance
+  PoolLoadWorker(Napi::Env env,
+                 std::vector<std::shared_ptr<Executor>> executors,
+                 std::string config_json, bool profiling = false);
+  void Execute();
+  void OnOK();
+  void OnError(const Napi::Error &e);
+
+private:
+  std::string config_json_;
+  std::vector<std::shared_ptr<Executor>> executors_;
+  bool profiling_;
+  std::vector<ContextHolder *> _contexts;
+};
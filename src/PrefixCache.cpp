@@ -0,0 +1,209 @@
+#include "PrefixCache.h"
+#include "session.h"
+#include <filesystem>
+#include <stdexcept>
+#include <system_error>
+#include <vector>
+
+#ifdef _WIN32
+#include <windows.h>
+#else
+#include <stdlib.h>
+#endif
+
+namespace fs = std::filesystem;
+
+static void removeSnapshot(const std::string &path) {
+  std::error_code ec;
+  fs::remove_all(path, ec);
+}
+
+PrefixCache::PrefixCache(std::string dir, uint64_t max_bytes) {
+  stats_.max_bytes = max_bytes;
+  std::error_code ec;
+  fs::create_directories(dir, ec);
+  if (ec) {
+    throw std::runtime_error("Failed to create prefix cache directory: " +
+                             ec.message());
+  }
+  // A directory of its own, so instances sharing dir never reuse or delete
+  // each other's snapshots
+  std::string pattern = (fs::path(dir) / "prefix-").string();
+#ifdef _WIN32
+  for (unsigned attempt = 0; dir_.empty() && attempt < 1000; attempt++) {
+    std::string path = pattern + std::to_string(GetCurrentProcessId()) + "-" +
+                       std::to_string(GetTickCount64()) + "-" +
+                       std::to_string(attempt);
+    if (fs::create_directory(path, ec)) {
+      dir_ = path;
+    }
+  }
+#else
+  pattern += "XXXXXX";
+  if (mkdtemp(pattern.data())) {
+    dir_ = pattern;
+  }
+#endif
+  if (dir_.empty()) {
+    throw std::runtime_error("Failed to create prefix cache directory in " + dir);
+  }
+}
+
+PrefixCache::~PrefixCache() {
+  removeSnapshot(dir_);
+}
+
+std::string PrefixCache::reserve() {
+  std::lock_guard<std::mutex> lock(mutex_);
+  std::string path = (fs::path(dir_) / ("snapshot-" + std::to_string(next_id_++))).string();
+  removeSnapshot(path);
+  return path;
+}
+
+PrefixCache::Node *PrefixCache::insertNode(const std::string &key) {
+  Node *node = &root_;
+  size_t i = 0;
+  while (i < key.size()) {
+    auto it = node->children.find(key[i]);
+    if (it == node->children.end()) {
+      auto child = std::make_unique<Node>();
+      child->label = key.substr(i);
+      Node *leaf = child.get();
+      node->children.emplace(key[i], std::move(child));
+      return leaf;
+    }
+    Node *child = it->second.get();
+    size_t n = 0;
+    while (n < child->label.size() && i + n < key.size() &&
+           child->label[n] == key[i + n]) {
+      n++;
+    }
+    if (n < child->label.size()) {
+      // Split the edge where the key leaves it
+      auto middle = std::make_unique<Node>();
+      middle->label = child->label.substr(0, n);
+      std::unique_ptr<Node> rest = std::move(it->second);
+      rest->label = rest->label.substr(n);
+      char first = rest->label[0];
+      middle->children.emplace(first, std::move(rest));
+      it->second = std::move(middle);
+      child = it->second.get();
+    }
+    node = child;
+    i += n;
+  }
+  return node;
+}
+
+void PrefixCache::insert(const std::string &prefix, const std::string &path) {
+  uint64_t bytes = sessionSize(path);
+  std::lock_guard<std::mutex> lock(mutex_);
+  Node *node = insertNode(prefix);
+  if (node->has_snapshot) {
+    dropSnapshot(node);
+  }
+  lru_.push_front({prefix, path, bytes});
+  node->snapshot = lru_.begin();
+  node->has_snapshot = true;
+  stats_.bytes += bytes;
+  stats_.entries++;
+  stats_.insertions++;
+  evict();
+}
+
+bool PrefixCache::lookup(const std::string &prompt, size_t min_length,
+                         Snapshot &snapshot) {
+  std::lock_guard<std::mutex> lock(mutex_);
+  Node *node = &root_;
+  Node *best = NULL;
+  size_t i = 0;
+  while (i < prompt.size()) {
+    auto it = node->children.find(prompt[i]);
+    if (it == node->children.end() ||
+        prompt.compare(i, it->second->label.size(), it->second->label) != 0) {
+      break;
+    }
+    node = it->second.get();
+    i += node->label.size();
+    if (node->has_snapshot && i > min_length) {
+      best = node;
+    }
+  }
+  if (!best) {
+    stats_.misses++;
+    return false;
+  }
+  stats_.hits++;
+  lru_.splice(lru_.begin(), lru_, best->snapshot);
+  snapshot = *best->snapshot;
+  return true;
+}
+
+void PrefixCache::remove(const std::string &prefix) {
+  std::lock_guard<std::mutex> lock(mutex_);
+  erase(prefix);
+}
+
+void PrefixCache::dropSnapshot(Node *node) {
+  removeSnapshot(node->snapshot->path);
+  stats_.bytes -= node->snapshot->bytes;
+  stats_.entries--;
+  lru_.erase(node->snapshot);
+  node->has_snapshot = false;
+}
+
+bool PrefixCache::erase(const std::string &prefix) {
+  std::vector<Node *> path{&root_};
+  size_t i = 0;
+  while (i < prefix.size()) {
+    Node *node = path.back();
+    auto it = node->children.find(prefix[i]);
+    if (it == node->children.end() ||
+        prefix.compare(i, it->second->label.size(), it->second->label) != 0) {
+      return false;
+    }
+    path.push_back(it->second.get());
+    i += it->second->label.size();
+  }
+  if (!path.back()->has_snapshot) {
+    return false;
+  }
+  dropSnapshot(path.back());
+  // Remove nodes left with neither a snapshot nor children, then merge the
+  // first one left with a single child into that child
+  for (size_t depth = path.size() - 1; depth > 0; depth--) {
+    Node *node = path[depth];
+    if (node->has_snapshot) {
+      break;
+    }
+    if (node->children.empty()) {
+      path[depth - 1]->children.erase(node->label[0]);
+      continue;
+    }
+    if (node->children.size() == 1) {
+      std::unique_ptr<Node> child = std::move(node->children.begin()->second);
+      node->label += child->label;
+      node->has_snapshot = child->has_snapshot;
+      node->snapshot = child->snapshot;
+      node->children = std::move(child->children);
+    }
+    break;
+  }
+  return true;
+}
+
+void PrefixCache::evict() {
+  while (stats_.max_bytes > 0 && stats_.bytes > stats_.max_bytes &&
+         !lru_.empty()) {
+    std::string prefix = lru_.back().prefix;
+    if (!erase(prefix)) {
+      break;
+    }
+    stats_.evictions++;
+  }
+}
+
+PrefixCacheStats PrefixCache::stats() {
+  std::lock_guard<std::mutex> lock(mutex_);
+  return stats_;
+}
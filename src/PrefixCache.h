@@ -0,0 +1,69 @@
+#pragma once
+
+#include <cstdint>
+#include <list>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <unordered_map>
+
+struct PrefixCacheStats {
+  uint64_t hits = 0;
+  uint64_t misses = 0;
+  uint64_t insertions = 0;
+  uint64_t evictions = 0;
+  size_t entries = 0;
+  uint64_t bytes = 0;
+  uint64_t max_bytes = 0;
+};
+
+// Dialog snapshots (GenieDialog_save) indexed by the prompt text they were
+// taken after. A radix tree finds the snapshot sharing the longest prefix with
+// a new prompt; once max_bytes is exceeded the least recently used snapshots
+// are deleted, along with the tree nodes only they needed. Snapshots live in
+// a directory created for this cache inside dir.
+class PrefixCache {
+public:
+  struct Snapshot {
+    std::string prefix;
+    std::string path;
+    uint64_t bytes;
+  };
+
+  PrefixCache(std::string dir, uint64_t max_bytes);
+  // Deletes its directory, snapshots are only valid for the dialog that took
+  // them
+  ~PrefixCache();
+
+  // Path for a new snapshot inside the cache directory
+  std::string reserve();
+  // Indexes a snapshot written to path, replacing one with the same prefix
+  void insert(const std::string &prefix, const std::string &path);
+  // Longest cached prefix of prompt longer than min_length, counts hit / miss
+  bool lookup(const std::string &prompt, size_t min_length, Snapshot &snapshot);
+  // Drops a snapshot that could not be restored
+  void remove(const std::string &prefix);
+  PrefixCacheStats stats();
+
+private:
+  struct Node {
+    std::string label;
+    std::unordered_map<char, std::unique_ptr<Node>> children;
+    bool has_snapshot = false;
+    std::list<Snapshot>::iterator snapshot;
+  };
+
+  Node *insertNode(const std::string &key);
+  void dropSnapshot(Node *node);
+  // Drops the snapshot of prefix and prunes the tree, false if there is none
+  bool erase(const std::string &prefix);
+  void evict();
+
+  std::mutex mutex_;
+  std::string dir_;
+  Node root_;
+  // Most recently used first
+  std::list<Snapshot> lru_;
+  uint64_t next_id_ = 0;
+  PrefixCacheStats stats_;
+};
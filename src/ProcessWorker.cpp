@@ -3,20 +3,43 @@
 #include <stdexcept>
 
 ProcessWorker::ProcessWorker(Napi::Env env, std::string prompt,
-                         ContextHolder *context)
-    : Napi::AsyncWorker(env), Napi::Promise::Deferred(env), prompt_(prompt),
-      _context(context) {}
+                             ContextHolder *context,
+                             std::shared_ptr<Executor> executor, bool snapshot,
+                             bool profile)
+    : ExecutorWorker(env, executor), Napi::Promise::Deferred(env), prompt_(prompt),
+      _context(context), snapshot_(snapshot), profile_(profile) {}
 
 void ProcessWorker::Execute() {
   try {
-    _context->process(prompt_);
+    result_ = _context->process(prompt_, snapshot_, profile_);
   } catch (const std::runtime_error &e) {
     SetError(e.what());
   }
 }
 
 void ProcessWorker::OnOK() {
-  Resolve(Napi::AsyncWorker::Env().Undefined());
+  if (on_complete_) {
+    on_complete_();
+  }
+  Napi::Env env = Napi::AsyncWorker::Env();
+  Napi::HandleScope scope(env);
+  Napi::Object result = Napi::Object::New(env);
+  result.Set("prefill_ms", Napi::Number::New(env, result_.prefill_ms));
+  result.Set("total_ms", Napi::Number::New(env, result_.total_ms));
+  result.Set("reused_chars", Napi::Number::New(env, result_.reused_chars));
+  result.Set("queue_wait_ms", Napi::Number::New(env, queue_wait_ms_));
+  if (!result_.profile_json.empty()) {
+    Napi::Object JSON = env.Global().Get("JSON").As<Napi::Object>();
+    Napi::Function parse = JSON.Get("parse").As<Napi::Function>();
+    result.Set("profile",
+               parse.Call({Napi::String::New(env, result_.profile_json)}));
+  }
+  Resolve(result);
 }
 
-void ProcessWorker::OnError(const Napi::Error &e) { Reject(e.Value()); }
+void ProcessWorker::OnError(const Napi::Error &e) {
+  if (on_complete_) {
+    on_complete_();
+  }
+  Reject(e.Value());
+}
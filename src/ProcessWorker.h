@@ -1,14 +1,32 @@
+#pragma once
+
 #include "ContextHolder.h"
+#include "ExecutorWorker.h"
+#include <functional>
 #include <napi.h>
 
-class ProcessWorker : public Napi::AsyncWorker, public Napi::Promise::Deferred {
+class ProcessWorker : public ExecutorWorker, public Napi::Promise::Deferred {
 public:
-  ProcessWorker(Napi::Env env, std::string prompt, ContextHolder *context);
+  ProcessWorker(Napi::Env env, std::string prompt, ContextHolder *context,
+                std::shared_ptr<Executor> executor, bool snapshot = false,
+                bool profile = true);
   void Execute();
   void OnOK();
   void OnError(const Napi::Error &e);
 
+  void setQueueWait(double queue_wait_ms) { queue_wait_ms_ = queue_wait_ms; }
+  void setOnComplete(std::function<void()> on_complete) {
+    on_complete_ = std::move(on_complete);
+  }
+  // Settles a worker that was never queued; the caller deletes it
+  void cancel(Napi::Value reason) { Reject(reason); }
+
 private:
   std::string prompt_;
   ContextHolder *_context;
-};
\ No newline at end of file
+  bool snapshot_;
+  bool profile_;
+  std::function<void()> on_complete_;
+  double queue_wait_ms_ = 0;
+  ProcessResult result_;
+};
@@ -0,0 +1,79 @@
+#pragma once
+
+#include <chrono>
+#include <cstddef>
+#include <cstdint>
+#include <string>
+
+// Timings of one query, taken from the response callback timestamps. Cheap
+// enough to record on every query, unlike the Genie profile JSON.
+struct QueryMetrics {
+  // Inter-token latency buckets: <= 1, 2, 4, ... 512 ms, then the rest
+  static constexpr size_t HISTOGRAM_BUCKETS = 11;
+
+  double ttft_ms = 0;
+  double decode_ms = 0;
+  double total_ms = 0;
+  // Prompt characters processed, excluding the prefix kept by REWIND. Genie
+  // does not expose the prompt token count without profiling.
+  size_t prompt_chars = 0;
+  uint32_t tokens = 0;
+  double token_max_ms = 0;
+  uint32_t histogram[HISTOGRAM_BUCKETS] = {};
+
+  double prefill_chars_per_sec() const {
+    return ttft_ms > 0 ? prompt_chars * 1000.0 / ttft_ms : 0;
+  }
+  // The first token ends prefill, decode rate covers the ones after it
+  double decode_tokens_per_sec() const {
+    return decode_ms > 0 && tokens > 1 ? (tokens - 1) * 1000.0 / decode_ms : 0;
+  }
+  double token_avg_ms() const {
+    return tokens > 1 ? decode_ms / (tokens - 1) : 0;
+  }
+  static double bucket_bound_ms(size_t bucket) {
+    return bucket + 1 < HISTOGRAM_BUCKETS ? double(1u << bucket) : -1;
+  }
+
+  void start() {
+    *this = QueryMetrics();
+    start_ = last_token_ = clock::now();
+  }
+
+  void token() {
+    clock::time_point now = clock::now();
+    if (tokens == 0) {
+      ttft_ms = ms(start_, now);
+    } else {
+      double latency = ms(last_token_, now);
+      size_t bucket = 0;
+      while (bucket + 1 < HISTOGRAM_BUCKETS && latency > bucket_bound_ms(bucket)) {
+        bucket++;
+      }
+      histogram[bucket]++;
+      if (latency > token_max_ms) {
+        token_max_ms = latency;
+      }
+      decode_ms += latency;
+    }
+    last_token_ = now;
+    tokens++;
+  }
+
+  void finish() { total_ms = ms(start_, clock::now()); }
+
+private:
+  using clock = std::chrono::steady_clock;
+  static double ms(clock::time_point from, clock::time_point to) {
+    return std::chrono::duration<double, std::milli>(to - from).count();
+  }
+  clock::time_point start_;
+  clock::time_point last_token_;
+};
+
+struct QueryResult {
+  QueryMetrics metrics;
+  // Empty unless the context was created with profiling and the query asked
+  // for it
+  std::string profile_json;
+};
@@ -1,49 +1,216 @@
 #include "QueryWorker.h"
 #include "Context.h"
+#include "metrics.h"
+#include "trace.h"
+#include <cmath>
 #include <stdexcept>
 
 QueryWorker::QueryWorker(Napi::Env env, std::string prompt,
-                         ContextHolder *context, Napi::Function callback)
-    : Napi::AsyncWorker(env), Napi::Promise::Deferred(env), prompt_(prompt),
-      _context(context) {
-  _tsfn =
-      Napi::ThreadSafeFunction::New(env, callback, "QueryWorkerCallback", 0, 1);
+                         ContextHolder *context,
+                         std::shared_ptr<Executor> executor,
+                         Napi::Function callback,
+                         TokenBatchOptions batch_options, bool profile)
+    : ExecutorWorker(env, executor), Napi::Promise::Deferred(env), prompt_(prompt),
+      _context(context), _callback(Napi::Persistent(callback)),
+      batch_options_(batch_options), profile_(profile) {
+  if (batch_options_.enabled) {
+    _batch = std::make_shared<TokenBatch>();
+  }
+}
+
+TokenBatchOptions parseTokenBatchOptions(const Napi::Value &options) {
+  TokenBatchOptions batch_options;
+  if (!options.IsObject()) {
+    return batch_options;
+  }
+  Napi::Object opts = options.As<Napi::Object>();
+  batch_options.enabled = opts.Get("batch").ToBoolean().Value();
+  if (opts.Get("batch_interval_ms").IsNumber()) {
+    int64_t ms = opts.Get("batch_interval_ms").As<Napi::Number>().Int64Value();
+    batch_options.interval_ms = ms > 0 ? static_cast<uint32_t>(ms) : 0;
+  }
+  if (opts.Get("batch_max_tokens").IsNumber()) {
+    int64_t n = opts.Get("batch_max_tokens").As<Napi::Number>().Int64Value();
+    batch_options.max_tokens = n > 0 ? static_cast<uint32_t>(n) : 0;
+  }
+  return batch_options;
+}
+
+bool parseProfileOption(const Napi::Value &options) {
+  if (!options.IsObject()) {
+    return true;
+  }
+  Napi::Value profile = options.As<Napi::Object>().Get("profile");
+  return profile.IsUndefined() ? true : profile.ToBoolean().Value();
+}
+
+Napi::Object queryResultToObject(Napi::Env env, const QueryResult &result) {
+  Napi::Object object;
+  if (!result.profile_json.empty()) {
+    Napi::Object JSON = env.Global().Get("JSON").As<Napi::Object>();
+    Napi::Function parse = JSON.Get("parse").As<Napi::Function>();
+    Napi::Value profile = parse.Call({Napi::String::New(env, result.profile_json)});
+    if (profile.IsObject()) {
+      object = profile.As<Napi::Object>();
+    }
+  }
+  if (object.IsEmpty()) {
+    object = Napi::Object::New(env);
+  }
+  const QueryMetrics &m = result.metrics;
+  Napi::Object metrics = Napi::Object::New(env);
+  metrics.Set("ttft_ms", Napi::Number::New(env, m.ttft_ms));
+  metrics.Set("decode_ms", Napi::Number::New(env, m.decode_ms));
+  metrics.Set("total_ms", Napi::Number::New(env, m.total_ms));
+  metrics.Set("tokens", Napi::Number::New(env, m.tokens));
+  metrics.Set("prompt_chars", Napi::Number::New(env, (double)m.prompt_chars));
+  metrics.Set("prefill_chars_per_sec",
+              Napi::Number::New(env, m.prefill_chars_per_sec()));
+  metrics.Set("decode_tokens_per_sec",
+              Napi::Number::New(env, m.decode_tokens_per_sec()));
+  Napi::Object latency = Napi::Object::New(env);
+  latency.Set("avg", Napi::Number::New(env, m.token_avg_ms()));
+  latency.Set("max", Napi::Number::New(env, m.token_max_ms));
+  Napi::Array buckets = Napi::Array::New(env, QueryMetrics::HISTOGRAM_BUCKETS);
+  for (uint32_t i = 0; i < QueryMetrics::HISTOGRAM_BUCKETS; i++) {
+    Napi::Object bucket = Napi::Object::New(env);
+    double bound = QueryMetrics::bucket_bound_ms(i);
+    bucket.Set("le", bound < 0 ? Napi::Value(Napi::Number::New(env, INFINITY))
+                               : Napi::Value(Napi::Number::New(env, bound)));
+    bucket.Set("count", Napi::Number::New(env, m.histogram[i]));
+    buckets.Set(i, bucket);
+  }
+  latency.Set("histogram", buckets);
+  metrics.Set("token_latency_ms", latency);
+  object.Set("metrics", metrics);
+  return object;
+}
+
+void QueryWorker::onToken(const char *response,
+                          const GenieDialog_SentenceCode_t sentenceCode) {
+  char *value = response ? strdup(response) : NULL;
+  bool posted = executor()->post([this, value, sentenceCode](Napi::Env env) {
+    trace::Span span("token_callback");
+    Napi::HandleScope scope(env);
+    _callback.Call({Napi::String::New(env, value ? value : ""),
+                    Napi::Number::New(env, sentenceCode)});
+    if (value) {
+      free(value);
+    }
+  });
+  if (!posted) {
+    free(value);
+  }
+}
+
+void QueryWorker::onBatchedToken(const char *response,
+                                 const GenieDialog_SentenceCode_t sentenceCode) {
+  auto now = std::chrono::steady_clock::now();
+  {
+    std::lock_guard<std::mutex> lock(_batch->mutex);
+    if (response) {
+      _batch->text += response;
+    }
+    _batch->codes.push_back(sentenceCode);
+    if (_batch->scheduled) {
+      return;
+    }
+    bool due = batch_options_.interval_ms == 0 && batch_options_.max_tokens == 0;
+    if (batch_options_.interval_ms > 0 &&
+        now - _batch->last_flush >=
+            std::chrono::milliseconds(batch_options_.interval_ms)) {
+      due = true;
+    }
+    if (batch_options_.max_tokens > 0 &&
+        _batch->codes.size() >= batch_options_.max_tokens) {
+      due = true;
+    }
+    if (!due) {
+      return;
+    }
+    _batch->scheduled = true;
+    _batch->last_flush = now;
+  }
+  std::shared_ptr<TokenBatch> batch = _batch;
+  executor()->post([this, batch](Napi::Env env) {
+    trace::Span span("token_callback");
+    flush(env, _callback.Value(), *batch);
+  });
+}
+
+void QueryWorker::flush(Napi::Env env, Napi::Function callback,
+                        TokenBatch &batch) {
+  std::string text;
+  std::vector<int32_t> codes;
+  {
+    std::lock_guard<std::mutex> lock(batch.mutex);
+    batch.scheduled = false;
+    text.swap(batch.text);
+    codes.swap(batch.codes);
+  }
+  if (codes.empty()) {
+    return;
+  }
+  Napi::HandleScope scope(env);
+  Napi::Array array = Napi::Array::New(env, codes.size());
+  for (uint32_t i = 0; i < codes.size(); i++) {
+    array.Set(i, Napi::Number::New(env, codes[i]));
+  }
+  callback.Call({Napi::String::New(env, text), array});
 }
 
 void QueryWorker::Execute() {
+  trace::Span span("QueryWorker");
+  if (_context == NULL) {
+    // Never handed an instance
+    SetError("Context is released");
+    return;
+  }
   try {
-    profile_json_ = _context->query(
+    result_ = _context->query(
         prompt_,
         [this](const char *response,
                const GenieDialog_SentenceCode_t sentenceCode) {
-          char *value = response ? strdup(response) : NULL;
-          this->_tsfn.NonBlockingCall(
-              value, [sentenceCode](Napi::Env env, Napi::Function callback,
-                                    char *response) {
-                Napi::HandleScope scope(env);
-                callback.Call({Napi::String::New(env, response),
-                               Napi::Number::New(env, sentenceCode)});
-                if (response) {
-                  free(response);
-                }
-              });
-        });
+          if (batch_options_.enabled) {
+            onBatchedToken(response, sentenceCode);
+          } else {
+            onToken(response, sentenceCode);
+          }
+        },
+        profile_);
+    perf::observeQuery(result_.metrics);
   } catch (const std::runtime_error &e) {
+    perf::observeQueryError(e.what());
     SetError(e.what());
   }
 }
 
+void QueryWorker::cancel(Napi::Value reason) { Reject(reason); }
+
 void QueryWorker::OnOK() {
-  if (!profile_json_.empty()) {
-    Napi::Env env = Napi::AsyncWorker::Env();
-    Napi::HandleScope scope(env);
-    Napi::Object JSON = env.Global().Get("JSON").As<Napi::Object>();
-    Napi::Function parse = JSON.Get("parse").As<Napi::Function>();
-    Napi::Value result = parse.Call({Napi::String::New(env, profile_json_)});
-    Resolve(result);
-  } else {
-    Resolve(Napi::AsyncWorker::Env().Undefined());
+  Napi::Env env = Napi::AsyncWorker::Env();
+  Napi::HandleScope scope(env);
+  // Deliver whatever the last scheduled flush may not have picked up yet
+  if (_batch) {
+    flush(env, _callback.Value(), *_batch);
+  }
+  if (on_complete_) {
+    on_complete_();
   }
+  Napi::Object result = queryResultToObject(env, result_);
+  if (queue_wait_ms_ >= 0) {
+    result.Set("queue_wait_ms", Napi::Number::New(env, queue_wait_ms_));
+  }
+  Resolve(result);
 }
 
-void QueryWorker::OnError(const Napi::Error &e) { Reject(e.Value()); }
+void QueryWorker::OnError(const Napi::Error &e) {
+  if (_batch) {
+    Napi::HandleScope scope(Napi::AsyncWorker::Env());
+    flush(Napi::AsyncWorker::Env(), _callback.Value(), *_batch);
+  }
+  if (on_complete_) {
+    on_complete_();
+  }
+  Reject(e.Value());
+}
@@ -1,17 +1,84 @@
+#pragma once
+
 #include "ContextHolder.h"
+#include "ExecutorWorker.h"
+#include <chrono>
+#include <functional>
+#include <memory>
+#include <mutex>
 #include <napi.h>
+#include <string>
+#include <vector>
+
+struct TokenBatchOptions {
+  bool enabled = false;
+  // Flush at most this often; 0 = whenever the event loop picks it up
+  uint32_t interval_ms = 0;
+  // Flush once this many tokens are pending, regardless of interval_ms
+  uint32_t max_tokens = 0;
+};
+
+// Reads { batch, batch_interval_ms, batch_max_tokens } from query options
+TokenBatchOptions parseTokenBatchOptions(const Napi::Value &options);
+
+// Reads { profile } from query options; defaults to true, which only has an
+// effect on contexts created with profiling
+bool parseProfileOption(const Napi::Value &options);
 
-class QueryWorker : public Napi::AsyncWorker, public Napi::Promise::Deferred {
+// { metrics, ...profile }: the parsed Genie profile (if any) with the native
+// metrics added as a plain object
+Napi::Object queryResultToObject(Napi::Env env, const QueryResult &result);
+
+// Tokens waiting to be delivered to JS. Shared with queued TSFN calls.
+struct TokenBatch {
+  std::mutex mutex;
+  std::string text;
+  std::vector<int32_t> codes;
+  bool scheduled = false;
+  std::chrono::steady_clock::time_point last_flush;
+};
+
+class QueryWorker : public ExecutorWorker, public Napi::Promise::Deferred {
 public:
   QueryWorker(Napi::Env env, std::string prompt, ContextHolder *context,
-              Napi::Function callback);
+              std::shared_ptr<Executor> executor, Napi::Function callback,
+              TokenBatchOptions batch_options = {}, bool profile = true);
   void Execute();
   void OnOK();
   void OnError(const Napi::Error &e);
 
+  // For deferred dispatch (ContextPool): the holder and its executor are
+  // picked when the worker is queued, and on_complete runs on the JS thread
+  // before the promise settles. A queue wait >= 0 is reported as
+  // queue_wait_ms in the result.
+  void setContext(ContextHolder *context, std::shared_ptr<Executor> executor) {
+    _context = context;
+    setExecutor(std::move(executor));
+  }
+  void setQueueWait(double queue_wait_ms) { queue_wait_ms_ = queue_wait_ms; }
+  void setOnComplete(std::function<void()> on_complete) {
+    on_complete_ = std::move(on_complete);
+  }
+  // Settles a worker that was never queued; the caller deletes it
+  void cancel(Napi::Value reason);
+
+protected:
+  void onToken(const char *response,
+               const GenieDialog_SentenceCode_t sentenceCode);
+  void onBatchedToken(const char *response,
+                      const GenieDialog_SentenceCode_t sentenceCode);
+  static void flush(Napi::Env env, Napi::Function callback, TokenBatch &batch);
+
 private:
   std::string prompt_;
   ContextHolder *_context;
-  Napi::ThreadSafeFunction _tsfn;
-  std::string profile_json_;
-};
\ No newline at end of file
+  // Called from the executor's thread-safe function, which delivers tokens
+  // before the completion that deletes the worker
+  Napi::FunctionReference _callback;
+  TokenBatchOptions batch_options_;
+  bool profile_;
+  std::shared_ptr<TokenBatch> _batch;
+  std::function<void()> on_complete_;
+  double queue_wait_ms_ = -1;
+  QueryResult result_;
+};
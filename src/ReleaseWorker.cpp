@@ -1,14 +1,25 @@
 #include "ReleaseWorker.h"
 #include "Context.h"
+#include "metrics.h"
+#include "trace.h"
 #include <stdexcept>
 
-ReleaseWorker::ReleaseWorker(Napi::Env env, ContextHolder *context)
-    : Napi::AsyncWorker(env), Napi::Promise::Deferred(env), _context(context) {}
+ReleaseWorker::ReleaseWorker(Napi::Env env, ContextHolder *context,
+                             std::shared_ptr<Executor> executor)
+    : ExecutorWorker(env, executor), Napi::Promise::Deferred(env), _context(context) {}
 
-ReleaseWorker::ReleaseWorker(Napi::Env env, EmbeddingsHolder *embedding)
-    : Napi::AsyncWorker(env), Napi::Promise::Deferred(env), _embedding(embedding) {}
+ReleaseWorker::ReleaseWorker(Napi::Env env, EmbeddingsHolder *embedding,
+                             std::shared_ptr<Executor> executor)
+    : ExecutorWorker(env, executor), Napi::Promise::Deferred(env), _embedding(embedding) {}
+
+ReleaseWorker::ReleaseWorker(Napi::Env env, std::vector<ContextHolder *> contexts,
+                             std::shared_ptr<Executor> executor)
+    : ExecutorWorker(env, executor), Napi::Promise::Deferred(env), _contexts(contexts) {}
 
 void ReleaseWorker::Execute() {
+  trace::Span span("ReleaseWorker");
+  auto start = std::chrono::steady_clock::now();
+  bool failed = false;
   try {
     if (_context) {
       _context->release();
@@ -19,8 +30,26 @@ void ReleaseWorker::Execute() {
       delete _embedding;
     }
   } catch (const std::runtime_error &e) {
+    failed = true;
     SetError(e.what());
   }
+  // Free every pool instance even if one fails to release
+  std::string error;
+  for (ContextHolder *context : _contexts) {
+    try {
+      context->release();
+    } catch (const std::runtime_error &e) {
+      if (error.empty()) {
+        error = e.what();
+      }
+    }
+    delete context;
+  }
+  if (!error.empty()) {
+    SetError(error);
+  }
+  (failed || !error.empty() ? perf::releases_error : perf::releases_ok).inc();
+  perf::release_duration.observe(perf::secondsSince(start));
 }
 
 void ReleaseWorker::OnOK() { Resolve(Napi::AsyncWorker::Env().Undefined()); }
@@ -1,11 +1,20 @@
+#pragma once
+
 #include "ContextHolder.h"
 #include "EmbeddingsHolder.h"
+#include "ExecutorWorker.h"
 #include <napi.h>
+#include <vector>
 
-class ReleaseWorker : public Napi::AsyncWorker, public Napi::Promise::Deferred {
+class ReleaseWorker : public ExecutorWorker, public Napi::Promise::Deferred {
 public:
-  ReleaseWorker(Napi::Env env, ContextHolder *context);
-  ReleaseWorker(Napi::Env env, EmbeddingsHolder *embedding);
+  ReleaseWorker(Napi::Env env, ContextHolder *context,
+                std::shared_ptr<Executor> executor);
+  ReleaseWorker(Napi::Env env, EmbeddingsHolder *embedding,
+                std::shared_ptr<Executor> executor);
+  // Pool instances are released in turn on one of their executors
+  ReleaseWorker(Napi::Env env, std::vector<ContextHolder *> contexts,
+                std::shared_ptr<Executor> executor);
   void Execute();
   void OnOK();
   void OnError(const Napi::Error &e);
@@ -13,4 +22,5 @@ public:
 private:
   ContextHolder *_context = NULL;
   EmbeddingsHolder *_embedding = NULL;
+  std::vector<ContextHolder *> _contexts;
 };
@@ -0,0 +1,71 @@
+#include "RequestQueue.h"
+#include <algorithm>
+
+uint64_t RequestQueue::push(int32_t priority, Start start, Cancel cancel) {
+  uint64_t id = next_id_++;
+  auto it = std::find_if(pending_.begin(), pending_.end(),
+                         [priority](const Request &request) {
+                           return request.priority < priority;
+                         });
+  pending_.insert(it, {id, priority, std::chrono::steady_clock::now(),
+                       std::move(start), std::move(cancel)});
+  return id;
+}
+
+void RequestQueue::run() {
+  // A request may complete inside start(), so re-check after each one
+  while (!running_ && !pending_.empty()) {
+    Request request = std::move(pending_.front());
+    pending_.pop_front();
+    double wait_ms = std::chrono::duration<double, std::milli>(
+                         std::chrono::steady_clock::now() - request.enqueued)
+                         .count();
+    processed_++;
+    wait_last_ms_ = wait_ms;
+    wait_max_ms_ = std::max(wait_max_ms_, wait_ms);
+    wait_total_ms_ += wait_ms;
+    running_ = true;
+    running_id_ = request.id;
+    request.start(request.id, wait_ms);
+  }
+}
+
+void RequestQueue::done() {
+  running_ = false;
+  run();
+}
+
+bool RequestQueue::cancel(uint64_t id, Napi::Value reason) {
+  auto it = std::find_if(
+      pending_.begin(), pending_.end(),
+      [id](const Request &request) { return request.id == id; });
+  if (it == pending_.end()) {
+    return false;
+  }
+  Request request = std::move(*it);
+  pending_.erase(it);
+  cancelled_++;
+  request.cancel(id, reason);
+  return true;
+}
+
+void RequestQueue::cancelAll(Napi::Value reason) {
+  while (!pending_.empty()) {
+    cancel(pending_.front().id, reason);
+  }
+}
+
+Napi::Object RequestQueue::stats(Napi::Env env) const {
+  Napi::Object stats = Napi::Object::New(env);
+  stats.Set("pending", Napi::Number::New(env, pending_.size()));
+  stats.Set("running", Napi::Boolean::New(env, running_));
+  stats.Set("processed", Napi::Number::New(env, processed_));
+  stats.Set("cancelled", Napi::Number::New(env, cancelled_));
+  Napi::Object wait = Napi::Object::New(env);
+  wait.Set("last", Napi::Number::New(env, wait_last_ms_));
+  wait.Set("max", Napi::Number::New(env, wait_max_ms_));
+  wait.Set("avg", Napi::Number::New(
+                      env, processed_ ? wait_total_ms_ / processed_ : 0));
+  stats.Set("queue_wait_ms", wait);
+  return stats;
+}
@@ -0,0 +1,51 @@
+#pragma once
+
+#include <chrono>
+#include <cstdint>
+#include <deque>
+#include <functional>
+#include <napi.h>
+
+// Serializes the requests made on one Context. Requests wait here instead of
+// failing with "Context is busy", highest priority first and in arrival order
+// within a priority. Only used from the JS thread.
+class RequestQueue {
+public:
+  // Starts a request; it must call done() once it has completed
+  using Start = std::function<void(uint64_t id, double queue_wait_ms)>;
+  // Settles a request that is dropped before it started
+  using Cancel = std::function<void(uint64_t id, Napi::Value reason)>;
+
+  // Adds a request, run() starts it once the context is free
+  uint64_t push(int32_t priority, Start start, Cancel cancel);
+  void run();
+  void done();
+  // Drops a queued request, returns false once it has started
+  bool cancel(uint64_t id, Napi::Value reason);
+  void cancelAll(Napi::Value reason);
+
+  bool isRunning(uint64_t id) const { return running_ && running_id_ == id; }
+  bool idle() const { return !running_ && pending_.empty(); }
+
+  // { pending, running, processed, cancelled, queue_wait_ms: { last, max, avg } }
+  Napi::Object stats(Napi::Env env) const;
+
+private:
+  struct Request {
+    uint64_t id;
+    int32_t priority;
+    std::chrono::steady_clock::time_point enqueued;
+    Start start;
+    Cancel cancel;
+  };
+
+  std::deque<Request> pending_;
+  bool running_ = false;
+  uint64_t running_id_ = 0;
+  uint64_t next_id_ = 1;
+  uint64_t processed_ = 0;
+  uint64_t cancelled_ = 0;
+  double wait_last_ms_ = 0;
+  double wait_max_ms_ = 0;
+  double wait_total_ms_ = 0;
+};
@@ -3,20 +3,35 @@
 #include <stdexcept>
 
 RestoreSessionWorker::RestoreSessionWorker(Napi::Env env, std::string filename,
-                                           ContextHolder *context)
-    : Napi::AsyncWorker(env), Napi::Promise::Deferred(env), filename_(filename),
+                                           ContextHolder *context,
+                                           std::shared_ptr<Executor> executor)
+    : ExecutorWorker(env, executor), Napi::Promise::Deferred(env), filename_(filename),
       _context(context) {}
 
 void RestoreSessionWorker::Execute() {
   try {
-    _context->restore(filename_);
+    _context->restore(filename_, stats_);
   } catch (const std::runtime_error &e) {
     SetError(e.what());
   }
 }
 
 void RestoreSessionWorker::OnOK() {
-  Resolve(Napi::AsyncWorker::Env().Undefined());
+  if (on_complete_) {
+    on_complete_();
+  }
+  Napi::Env env = Napi::AsyncWorker::Env();
+  Napi::Object result = Napi::Object::New(env);
+  result.Set("raw_bytes", Napi::Number::New(env, (double)stats_.raw_bytes));
+  result.Set("bytes", Napi::Number::New(env, (double)stats_.file_bytes));
+  result.Set("genie_ms", Napi::Number::New(env, stats_.genie_ms));
+  result.Set("unpack_ms", Napi::Number::New(env, stats_.pack_ms));
+  Resolve(result);
 }
 
-void RestoreSessionWorker::OnError(const Napi::Error &e) { Reject(e.Value()); }
+void RestoreSessionWorker::OnError(const Napi::Error &e) {
+  if (on_complete_) {
+    on_complete_();
+  }
+  Reject(e.Value());
+}
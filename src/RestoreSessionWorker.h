@@ -1,16 +1,29 @@
+#pragma once
+
 #include "ContextHolder.h"
+#include "ExecutorWorker.h"
+#include <functional>
 #include <napi.h>
 
-class RestoreSessionWorker : public Napi::AsyncWorker,
+class RestoreSessionWorker : public ExecutorWorker,
                              public Napi::Promise::Deferred {
 public:
   RestoreSessionWorker(Napi::Env env, std::string filename,
-                       ContextHolder *context);
+                       ContextHolder *context,
+                       std::shared_ptr<Executor> executor);
   void Execute();
   void OnOK();
   void OnError(const Napi::Error &e);
 
+  void setOnComplete(std::function<void()> on_complete) {
+    on_complete_ = std::move(on_complete);
+  }
+  // Settles a worker that was never queued; the caller deletes it
+  void cancel(Napi::Value reason) { Reject(reason); }
+
 private:
   std::string filename_;
   ContextHolder *_context;
+  SessionStats stats_;
+  std::function<void()> on_complete_;
 };
\ No newline at end of file
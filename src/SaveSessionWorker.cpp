@@ -3,20 +3,36 @@
 #include <stdexcept>
 
 SaveSessionWorker::SaveSessionWorker(Napi::Env env, std::string filename,
-                                     ContextHolder *context)
-    : Napi::AsyncWorker(env), Napi::Promise::Deferred(env), filename_(filename),
-      _context(context) {}
+                                     ContextHolder *context,
+                                     std::shared_ptr<Executor> executor,
+                                     bool compress, int level)
+    : ExecutorWorker(env, executor), Napi::Promise::Deferred(env), filename_(filename),
+      _context(context), compress_(compress), level_(level) {}
 
 void SaveSessionWorker::Execute() {
   try {
-    _context->save(filename_);
+    _context->save(filename_, compress_, level_, stats_);
   } catch (const std::runtime_error &e) {
     SetError(e.what());
   }
 }
 
 void SaveSessionWorker::OnOK() {
-  Resolve(Napi::AsyncWorker::Env().Undefined());
+  if (on_complete_) {
+    on_complete_();
+  }
+  Napi::Env env = Napi::AsyncWorker::Env();
+  Napi::Object result = Napi::Object::New(env);
+  result.Set("raw_bytes", Napi::Number::New(env, (double)stats_.raw_bytes));
+  result.Set("bytes", Napi::Number::New(env, (double)stats_.file_bytes));
+  result.Set("genie_ms", Napi::Number::New(env, stats_.genie_ms));
+  result.Set("pack_ms", Napi::Number::New(env, stats_.pack_ms));
+  Resolve(result);
 }
 
-void SaveSessionWorker::OnError(const Napi::Error &e) { Reject(e.Value()); }
+void SaveSessionWorker::OnError(const Napi::Error &e) {
+  if (on_complete_) {
+    on_complete_();
+  }
+  Reject(e.Value());
+}
@@ -1,16 +1,31 @@
+#pragma once
+
 #include "ContextHolder.h"
+#include "ExecutorWorker.h"
+#include <functional>
 #include <napi.h>
 
-class SaveSessionWorker : public Napi::AsyncWorker,
+class SaveSessionWorker : public ExecutorWorker,
                           public Napi::Promise::Deferred {
 public:
   SaveSessionWorker(Napi::Env env, std::string filename,
-                    ContextHolder *context);
+                    ContextHolder *context, std::shared_ptr<Executor> executor,
+                    bool compress = false, int level = 3);
   void Execute();
   void OnOK();
   void OnError(const Napi::Error &e);
 
+  void setOnComplete(std::function<void()> on_complete) {
+    on_complete_ = std::move(on_complete);
+  }
+  // Settles a worker that was never queued; the caller deletes it
+  void cancel(Napi::Value reason) { Reject(reason); }
+
 private:
   std::string filename_;
   ContextHolder *_context;
+  bool compress_;
+  int level_;
+  SessionStats stats_;
+  std::function<void()> on_complete_;
 };
\ No newline at end of file
@@ -0,0 +1,68 @@
+#include "StreamWorker.h"
+#include "metrics.h"
+#include "trace.h"
+#include <stdexcept>
+
+StreamWorker::StreamWorker(Napi::Env env, std::string prompt,
+                           ContextHolder *context,
+                           std::shared_ptr<Executor> executor,
+                           std::shared_ptr<TokenQueue> queue, bool profile)
+    : ExecutorWorker(env, executor), prompt_(prompt), _context(context),
+      _queue(queue), profile_(profile) {}
+
+void StreamWorker::Execute() {
+  trace::Span span("StreamWorker");
+  try {
+    result_ = _context->query(
+        prompt_, [this](const char *response,
+                        const GenieDialog_SentenceCode_t sentenceCode) {
+          bool wake = false;
+          if (!_queue->push(response, wake)) {
+            // Nobody is reading any more, stop generating
+            if (!aborted_) {
+              aborted_ = true;
+              try {
+                _context->abort();
+              } catch (const std::runtime_error &e) {
+                // finishes on its own
+              }
+            }
+            return;
+          }
+          if (wake) {
+            // Only wakes up a waiting reader, tokens travel through _queue
+            std::shared_ptr<TokenQueue> queue = _queue;
+            executor()->post([queue](Napi::Env env) { queue->settle(env); });
+          }
+        },
+        profile_);
+    perf::observeQuery(result_.metrics);
+  } catch (const std::runtime_error &e) {
+    perf::observeQueryError(e.what());
+    SetError(e.what());
+  }
+}
+
+void StreamWorker::cancel(Napi::Value reason) {
+  std::string message = "The operation was aborted";
+  if (reason.IsObject() && reason.As<Napi::Object>().Get("message").IsString()) {
+    message = reason.As<Napi::Object>().Get("message").As<Napi::String>().Utf8Value();
+  } else if (reason.IsString()) {
+    message = reason.As<Napi::String>().Utf8Value();
+  }
+  _queue->finish(Napi::AsyncWorker::Env(), QueryResult(), message);
+}
+
+void StreamWorker::OnOK() {
+  if (on_complete_) {
+    on_complete_();
+  }
+  _queue->finish(Napi::AsyncWorker::Env(), result_, "");
+}
+
+void StreamWorker::OnError(const Napi::Error &e) {
+  if (on_complete_) {
+    on_complete_();
+  }
+  _queue->finish(Napi::AsyncWorker::Env(), QueryResult(), e.Message());
+}
@@ -0,0 +1,33 @@
+#pragma once
+
+#include "ContextHolder.h"
+#include "ExecutorWorker.h"
+#include "TokenStream.h"
+#include <functional>
+#include <memory>
+#include <napi.h>
+
+class StreamWorker : public ExecutorWorker {
+public:
+  StreamWorker(Napi::Env env, std::string prompt, ContextHolder *context,
+               std::shared_ptr<Executor> executor,
+               std::shared_ptr<TokenQueue> queue, bool profile = true);
+  void Execute();
+  void OnOK();
+  void OnError(const Napi::Error &e);
+
+  void setOnComplete(std::function<void()> on_complete) {
+    on_complete_ = std::move(on_complete);
+  }
+  // Ends a stream whose worker was never queued; the caller deletes it
+  void cancel(Napi::Value reason);
+
+private:
+  std::string prompt_;
+  ContextHolder *_context;
+  std::shared_ptr<TokenQueue> _queue;
+  bool aborted_ = false;
+  std::function<void()> on_complete_;
+  bool profile_;
+  QueryResult result_;
+};
@@ -0,0 +1,178 @@
+#include "TokenStream.h"
+#include "QueryWorker.h"
+
+TokenQueue::TokenQueue(size_t capacity) : capacity_(capacity ? capacity : 1) {}
+
+bool TokenQueue::push(const char *text, bool &wake) {
+  std::unique_lock<std::mutex> lock(mutex_);
+  not_full_.wait(lock,
+                 [this] { return cancelled_ || tokens_.size() < capacity_; });
+  if (cancelled_) {
+    return false;
+  }
+  tokens_.emplace_back(text ? text : "");
+  if (waiting_ > 0 && !wake_scheduled_) {
+    wake_scheduled_ = true;
+    wake = true;
+  }
+  return true;
+}
+
+Napi::Object TokenQueue::result(Napi::Env env, Napi::Value value, bool done) {
+  Napi::Object result = Napi::Object::New(env);
+  result.Set("value", value);
+  result.Set("done", Napi::Boolean::New(env, done));
+  return result;
+}
+
+Napi::Value TokenQueue::next(Napi::Env env) {
+  Napi::Promise::Deferred read = Napi::Promise::Deferred::New(env);
+  {
+    std::lock_guard<std::mutex> lock(mutex_);
+    reads_.push_back(read);
+    waiting_++;
+  }
+  settle(env);
+  return read.Promise();
+}
+
+void TokenQueue::settle(Napi::Env env) {
+  Napi::HandleScope scope(env);
+  while (true) {
+    std::unique_lock<std::mutex> lock(mutex_);
+    wake_scheduled_ = false;
+    if (reads_.empty()) {
+      return;
+    }
+    Napi::Promise::Deferred read = reads_.front();
+    if (!tokens_.empty()) {
+      std::string text = std::move(tokens_.front());
+      tokens_.pop_front();
+      reads_.pop_front();
+      waiting_--;
+      lock.unlock();
+      not_full_.notify_one();
+      read.Resolve(result(env, Napi::String::New(env, text), false));
+    } else if (cancelled_ || finished_) {
+      std::string error;
+      error.swap(error_);
+      bool has_result = has_result_;
+      has_result_ = false;
+      QueryResult query_result = std::move(result_);
+      reads_.pop_front();
+      waiting_--;
+      lock.unlock();
+      if (!error.empty()) {
+        read.Reject(Napi::Error::New(env, error).Value());
+      } else if (has_result) {
+        read.Resolve(
+            result(env, queryResultToObject(env, query_result), true));
+      } else {
+        read.Resolve(result(env, env.Undefined(), true));
+      }
+    } else {
+      return;
+    }
+  }
+}
+
+void TokenQueue::finish(Napi::Env env, QueryResult result,
+                        std::string error) {
+  {
+    std::lock_guard<std::mutex> lock(mutex_);
+    finished_ = true;
+    if (!cancelled_) {
+      has_result_ = error.empty();
+      result_ = std::move(result);
+      error_ = std::move(error);
+    }
+  }
+  settle(env);
+}
+
+void TokenQueue::cancel() {
+  {
+    std::lock_guard<std::mutex> lock(mutex_);
+    cancelled_ = true;
+    tokens_.clear();
+  }
+  not_full_.notify_all();
+}
+
+bool TokenQueue::finished() {
+  std::lock_guard<std::mutex> lock(mutex_);
+  return finished_;
+}
+
+Napi::FunctionReference TokenStream::constructor;
+
+Napi::Object TokenStream::Init(Napi::Env env, Napi::Object &exports) {
+  Napi::HandleScope scope(env);
+  Napi::Function func = DefineClass(
+      env, "TokenStream",
+      {
+          InstanceMethod<&TokenStream::Next>(
+              "next", static_cast<napi_property_attributes>(
+                          napi_writable | napi_configurable)),
+          InstanceMethod<&TokenStream::Return>(
+              "return", static_cast<napi_property_attributes>(
+                            napi_writable | napi_configurable)),
+          InstanceMethod<&TokenStream::Iterator>(
+              Napi::Symbol::WellKnown(env, "asyncIterator"),
+              static_cast<napi_property_attributes>(napi_writable |
+                                                    napi_configurable)),
+      });
+  constructor = Napi::Persistent(func);
+  constructor.SuppressDestruct();
+  return exports;
+}
+
+Napi::Object TokenStream::New(Napi::Env env, std::shared_ptr<TokenQueue> queue,
+                              Napi::Object owner) {
+  Napi::Object object = constructor.New(std::vector<napi_value>{});
+  TokenStream *stream = TokenStream::Unwrap(object);
+  stream->_queue = std::move(queue);
+  stream->_owner = Napi::Persistent(owner);
+  return object;
+}
+
+TokenStream::TokenStream(const Napi::CallbackInfo &info)
+    : Napi::ObjectWrap<TokenStream>(info) {}
+
+TokenStream::~TokenStream() {
+  // Dropped without being drained: unblock the query thread so it aborts the
+  // dialog. No JS may run here, so pending reads are left as they are.
+  if (_queue && !_queue->finished()) {
+    _queue->cancel();
+  }
+}
+
+Napi::Value TokenStream::Next(const Napi::CallbackInfo &info) {
+  Napi::Env env = info.Env();
+  Napi::HandleScope scope(env);
+  if (!_queue) {
+    Napi::Error::New(env, "Stream is not initialized")
+        .ThrowAsJavaScriptException();
+    return env.Undefined();
+  }
+  return _queue->next(env);
+}
+
+Napi::Value TokenStream::Return(const Napi::CallbackInfo &info) {
+  Napi::Env env = info.Env();
+  Napi::HandleScope scope(env);
+  if (_queue) {
+    _queue->cancel();
+    _queue->settle(env);
+  }
+  Napi::Promise::Deferred deferred = Napi::Promise::Deferred::New(env);
+  Napi::Object result = Napi::Object::New(env);
+  result.Set("value", env.Undefined());
+  result.Set("done", Napi::Boolean::New(env, true));
+  deferred.Resolve(result);
+  return deferred.Promise();
+}
+
+Napi::Value TokenStream::Iterator(const Napi::CallbackInfo &info) {
+  return info.This();
+}
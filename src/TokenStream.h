@@ -0,0 +1,72 @@
+#pragma once
+
+#include "ContextHolder.h"
+#include <condition_variable>
+#include <deque>
+#include <memory>
+#include <mutex>
+#include <napi.h>
+#include <string>
+
+// Bounded hand-off between a query thread and the JS reader of a stream.
+// push() blocks the Genie callback while the queue is full, which stalls
+// decoding until the reader catches up.
+class TokenQueue {
+public:
+  explicit TokenQueue(size_t capacity);
+
+  // Query thread: returns false once the reader has gone away. Sets wake when
+  // a read is pending and settle() needs to be scheduled on the JS thread.
+  bool push(const char *text, bool &wake);
+
+  // JS thread
+  Napi::Value next(Napi::Env env);
+  void settle(Napi::Env env);
+  // The final { done: true } read carries result as its value
+  void finish(Napi::Env env, QueryResult result, std::string error);
+  bool finished();
+
+  // Any thread: drops queued tokens and makes push() fail from now on
+  void cancel();
+
+private:
+  static Napi::Object result(Napi::Env env, Napi::Value value, bool done);
+
+  std::mutex mutex_;
+  std::condition_variable not_full_;
+  std::deque<std::string> tokens_;
+  std::deque<Napi::Promise::Deferred> reads_;
+  size_t capacity_;
+  size_t waiting_ = 0;
+  bool wake_scheduled_ = false;
+  bool cancelled_ = false;
+  bool finished_ = false;
+  QueryResult result_;
+  bool has_result_ = false;
+  std::string error_;
+};
+
+class TokenStream : public Napi::ObjectWrap<TokenStream> {
+public:
+  static Napi::Object Init(Napi::Env env, Napi::Object &exports);
+
+  static Napi::Object New(Napi::Env env, std::shared_ptr<TokenQueue> queue,
+                          Napi::Object owner);
+
+  TokenStream(const Napi::CallbackInfo &info);
+  ~TokenStream();
+
+protected:
+  // stream.next(): Promise<{ value: string, done: boolean }>
+  Napi::Value Next(const Napi::CallbackInfo &info);
+  // stream.return(): Promise<{ value: undefined, done: true }>
+  Napi::Value Return(const Napi::CallbackInfo &info);
+  // stream[Symbol.asyncIterator](): this
+  Napi::Value Iterator(const Napi::CallbackInfo &info);
+
+private:
+  static Napi::FunctionReference constructor;
+  std::shared_ptr<TokenQueue> _queue;
+  // Keeps the Context (and its holder) alive while the stream is reachable
+  Napi::ObjectReference _owner;
+};
@@ -1,14 +1,18 @@
 #include "UnpackWorker.h"
+#include "trace.h"
 #include "unpack.h"
 #include <stdexcept>
 
-UnpackWorker::UnpackWorker(Napi::Env env, std::string bundle_path, std::string unpack_dir)
-    : Napi::AsyncWorker(env), Napi::Promise::Deferred(env),
-      bundle_path_(bundle_path), unpack_dir_(unpack_dir) {}
+UnpackWorker::UnpackWorker(Napi::Env env, std::string bundle_path, std::string unpack_dir,
+                           UnpackOptions options)
+    : ExecutorWorker(env, std::make_shared<Executor>(env, "unpack")),
+      Napi::Promise::Deferred(env),
+      bundle_path_(bundle_path), unpack_dir_(unpack_dir), options_(options) {}
 
 void UnpackWorker::Execute() {
+  trace::Span span("UnpackWorker");
   try {
-    unpackModel(bundle_path_, unpack_dir_);
+    unpackModel(bundle_path_, unpack_dir_, options_);
   } catch (const std::runtime_error &e) {
     SetError(e.what());
   }
@@ -1,11 +1,15 @@
 #pragma once
 
+#include "ExecutorWorker.h"
+#include "unpack.h"
 #include <string>
 #include <napi.h>
 
-class UnpackWorker : public Napi::AsyncWorker, public Napi::Promise::Deferred {
+class UnpackWorker : public ExecutorWorker, public Napi::Promise::Deferred {
 public:
-  UnpackWorker(Napi::Env env, std::string bundle_path, std::string unpack_dir);
+  // Runs on a thread of its own, joined once the promise settles
+  UnpackWorker(Napi::Env env, std::string bundle_path, std::string unpack_dir,
+               UnpackOptions options);
   void Execute();
   void OnOK();
   void OnError(const Napi::Error &e);
@@ -13,4 +17,5 @@ public:
 private:
   std::string bundle_path_;
   std::string unpack_dir_;
+  UnpackOptions options_;
 };
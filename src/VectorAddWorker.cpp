@@ -0,0 +1,79 @@
+#include "VectorAddWorker.h"
+#include "metrics.h"
+#include "trace.h"
+#include <cstring>
+#include <stdexcept>
+
+VectorAddWorker::VectorAddWorker(Napi::Env env, std::shared_ptr<VectorIndex> index,
+                                 std::vector<uint8_t> rows, EmbeddingType type,
+                                 size_t count, std::vector<float> scales)
+    : ExecutorWorker(env, nullptr), Napi::Promise::Deferred(env),
+      _index(std::move(index)), rows_(std::move(rows)), type_(type),
+      count_(count), scales_(std::move(scales)) {}
+
+VectorAddWorker::VectorAddWorker(Napi::Env env, std::shared_ptr<VectorIndex> index,
+                                 EmbeddingsHolder *embedding,
+                                 std::shared_ptr<Executor> executor,
+                                 std::vector<std::string> prompts,
+                                 const EmbeddingOptions &options)
+    : ExecutorWorker(env, executor), Napi::Promise::Deferred(env),
+      _index(std::move(index)), count_(prompts.size()), _embedding(embedding),
+      prompts_(std::move(prompts)), options_(options) {}
+
+void VectorAddWorker::Execute() {
+  trace::Span span("VectorAddWorker");
+  const VectorIndexOptions &index = _index->options();
+  try {
+    if (count_ == 0) {
+      first_ = static_cast<uint32_t>(_index->size());
+      return;
+    }
+    if (_embedding) {
+      // Rows arrive in the index's type, so they are copied in as is
+      EmbeddingBatch batch;
+      try {
+        _embedding->query_batch(prompts_, batch, options_);
+      } catch (const std::runtime_error &e) {
+        perf::embedding_queries_error.inc();
+        throw;
+      }
+      perf::embedding_queries_ok.inc(prompts_.size());
+      for (double ms : batch.item_ms) {
+        perf::embedding_duration.observe(ms / 1000.0);
+      }
+      if (batch.dim != index.dim) {
+        throw std::runtime_error("Embedding size " + std::to_string(batch.dim) +
+                                 " does not match index dim " +
+                                 std::to_string(index.dim));
+      }
+      first_ = _index->addEncoded(batch.data.data(), count_, batch.scales.data(),
+                                  options_.normalize);
+    } else if (type_ == index.type) {
+      first_ = _index->addEncoded(rows_.data(), count_, scales_.data(), false);
+    } else if (type_ == EmbeddingType::Float32) {
+      first_ = _index->add(reinterpret_cast<const float *>(rows_.data()), count_);
+    } else {
+      std::vector<float> values(count_ * index.dim);
+      for (size_t i = 0; i < count_; i++) {
+        float *row = values.data() + i * index.dim;
+        if (type_ == EmbeddingType::Int8) {
+          fromInt8(reinterpret_cast<const int8_t *>(rows_.data()) + i * index.dim,
+                   index.dim, scales_[i], row);
+        } else {
+          fromFloat16(reinterpret_cast<const uint16_t *>(rows_.data()) + i * index.dim,
+                      index.dim, row);
+        }
+      }
+      first_ = _index->add(values.data(), count_);
+    }
+    perf::vector_adds.inc(count_);
+  } catch (const std::runtime_error &e) {
+    SetError(e.what());
+  }
+}
+
+void VectorAddWorker::OnOK() {
+  Resolve(Napi::Number::New(Napi::AsyncWorker::Env(), first_));
+}
+
+void VectorAddWorker::OnError(const Napi::Error &e) { Reject(e.Value()); }
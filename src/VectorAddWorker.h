@@ -0,0 +1,38 @@
+#pragma once
+
+#include "EmbeddingsHolder.h"
+#include "ExecutorWorker.h"
+#include "vector_index.h"
+#include <memory>
+#include <napi.h>
+#include <string>
+#include <vector>
+
+class VectorAddWorker : public ExecutorWorker, public Napi::Promise::Deferred {
+public:
+  // count rows of type copied from JS, with one scale per row for int8; runs
+  // on the threadpool
+  VectorAddWorker(Napi::Env env, std::shared_ptr<VectorIndex> index,
+                  std::vector<uint8_t> rows, EmbeddingType type, size_t count,
+                  std::vector<float> scales);
+  // Embeds prompts straight into the index's row type, on the embedding's
+  // executor
+  VectorAddWorker(Napi::Env env, std::shared_ptr<VectorIndex> index,
+                  EmbeddingsHolder *embedding, std::shared_ptr<Executor> executor,
+                  std::vector<std::string> prompts,
+                  const EmbeddingOptions &options);
+  void Execute();
+  void OnOK();
+  void OnError(const Napi::Error &e);
+
+private:
+  std::shared_ptr<VectorIndex> _index;
+  std::vector<uint8_t> rows_;
+  EmbeddingType type_ = EmbeddingType::Float32;
+  size_t count_ = 0;
+  std::vector<float> scales_;
+  EmbeddingsHolder *_embedding = NULL;
+  std::vector<std::string> prompts_;
+  EmbeddingOptions options_;
+  uint32_t first_ = 0;
+};
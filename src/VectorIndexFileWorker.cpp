@@ -0,0 +1,38 @@
+#include "VectorIndexFileWorker.h"
+#include "VectorIndexWrap.h"
+#include "trace.h"
+#include <stdexcept>
+
+VectorIndexFileWorker::VectorIndexFileWorker(Napi::Env env, std::string path)
+    : Napi::AsyncWorker(env), Napi::Promise::Deferred(env), path_(path) {}
+
+VectorIndexFileWorker::VectorIndexFileWorker(Napi::Env env,
+                                             std::shared_ptr<VectorIndex> index,
+                                             std::string path)
+    : Napi::AsyncWorker(env), Napi::Promise::Deferred(env), path_(path),
+      _index(std::move(index)) {}
+
+void VectorIndexFileWorker::Execute() {
+  trace::Span span("VectorIndexFileWorker", path_);
+  try {
+    if (_index) {
+      _index->save(path_);
+    } else {
+      _loaded = VectorIndex::load(path_);
+    }
+  } catch (const std::runtime_error &e) {
+    SetError(e.what());
+  }
+}
+
+void VectorIndexFileWorker::OnOK() {
+  Napi::Env env = Napi::AsyncWorker::Env();
+  if (_loaded) {
+    Resolve(VectorIndexWrap::New(
+        Napi::External<VectorIndex>::New(env, _loaded.release())));
+  } else {
+    Resolve(env.Undefined());
+  }
+}
+
+void VectorIndexFileWorker::OnError(const Napi::Error &e) { Reject(e.Value()); }
@@ -0,0 +1,23 @@
+#pragma once
+
+#include "vector_index.h"
+#include <memory>
+#include <napi.h>
+#include <string>
+
+// Saves an index, or loads one when constructed without
+class VectorIndexFileWorker : public Napi::AsyncWorker,
+                              public Napi::Promise::Deferred {
+public:
+  VectorIndexFileWorker(Napi::Env env, std::string path);
+  VectorIndexFileWorker(Napi::Env env, std::shared_ptr<VectorIndex> index,
+                        std::string path);
+  void Execute();
+  void OnOK();
+  void OnError(const Napi::Error &e);
+
+private:
+  std::string path_;
+  std::shared_ptr<VectorIndex> _index;
+  std::unique_ptr<VectorIndex> _loaded;
+};
@@ -0,0 +1,305 @@
+#include "VectorIndexWrap.h"
+#include "Embedding.h"
+#include "VectorAddWorker.h"
+#include "VectorIndexFileWorker.h"
+#include "VectorSearchWorker.h"
+#include <stdexcept>
+#include <string>
+
+Napi::FunctionReference VectorIndexWrap::constructor;
+
+static uint32_t getUint32(const Napi::Object &options, const char *name,
+                          uint32_t value) {
+  Napi::Value number = options.Get(name);
+  if (number.IsNumber()) {
+    int64_t n = number.As<Napi::Number>().Int64Value();
+    value = n > 0 ? static_cast<uint32_t>(std::min<int64_t>(n, UINT32_MAX)) : 0;
+  }
+  return value;
+}
+
+static bool parseIndexOptions(Napi::Env env, const Napi::Value &value,
+                              VectorIndexOptions &options) {
+  if (!value.IsObject()) {
+    Napi::TypeError::New(env, "options must be an object")
+        .ThrowAsJavaScriptException();
+    return false;
+  }
+  Napi::Object opts = value.As<Napi::Object>();
+  try {
+    if (opts.Get("dtype").IsString()) {
+      options.type =
+          parseEmbeddingType(opts.Get("dtype").As<Napi::String>().Utf8Value());
+    }
+    if (opts.Get("metric").IsString()) {
+      options.metric =
+          parseVectorMetric(opts.Get("metric").As<Napi::String>().Utf8Value());
+    }
+    if (opts.Get("type").IsString()) {
+      options.kind =
+          parseVectorIndexKind(opts.Get("type").As<Napi::String>().Utf8Value());
+    }
+  } catch (const std::runtime_error &e) {
+    Napi::TypeError::New(env, e.what()).ThrowAsJavaScriptException();
+    return false;
+  }
+  options.dim = getUint32(opts, "dim", options.dim);
+  options.m = getUint32(opts, "m", options.m);
+  options.ef_construction =
+      getUint32(opts, "ef_construction", options.ef_construction);
+  options.ef_search = getUint32(opts, "ef_search", options.ef_search);
+  return true;
+}
+
+static size_t parseK(const Napi::Value &value) {
+  if (!value.IsNumber()) {
+    return 10;
+  }
+  int64_t k = value.As<Napi::Number>().Int64Value();
+  return k > 0 ? static_cast<size_t>(k) : 0;
+}
+
+static uint32_t parseEf(const Napi::Value &options) {
+  if (!options.IsObject()) {
+    return 0;
+  }
+  return getUint32(options.As<Napi::Object>(), "ef", 0);
+}
+
+Napi::Object VectorIndexWrap::Init(Napi::Env env, Napi::Object &exports) {
+  Napi::HandleScope scope(env);
+  Napi::Function func = DefineClass(
+      env, "VectorIndex",
+      {
+          StaticMethod<&VectorIndexWrap::Load>(
+              "load", static_cast<napi_property_attributes>(
+                          napi_writable | napi_configurable)),
+          InstanceMethod<&VectorIndexWrap::Add>(
+              "add", static_cast<napi_property_attributes>(
+                         napi_writable | napi_configurable)),
+          InstanceMethod<&VectorIndexWrap::AddText>(
+              "addText", static_cast<napi_property_attributes>(
+                             napi_writable | napi_configurable)),
+          InstanceMethod<&VectorIndexWrap::Search>(
+              "search", static_cast<napi_property_attributes>(
+                            napi_writable | napi_configurable)),
+          InstanceMethod<&VectorIndexWrap::SearchText>(
+              "searchText", static_cast<napi_property_attributes>(
+                                napi_writable | napi_configurable)),
+          InstanceMethod<&VectorIndexWrap::Save>(
+              "save", static_cast<napi_property_attributes>(
+                          napi_writable | napi_configurable)),
+          InstanceMethod<&VectorIndexWrap::Size>(
+              "size", static_cast<napi_property_attributes>(
+                          napi_writable | napi_configurable)),
+          InstanceMethod<&VectorIndexWrap::Dim>(
+              "dim", static_cast<napi_property_attributes>(
+                         napi_writable | napi_configurable)),
+      });
+  constructor = Napi::Persistent(func);
+  constructor.SuppressDestruct();
+  exports.Set("VectorIndex", func);
+  return exports;
+}
+
+VectorIndexWrap::VectorIndexWrap(const Napi::CallbackInfo &info)
+    : Napi::ObjectWrap<VectorIndexWrap>(info) {
+  Napi::Env env = info.Env();
+  Napi::HandleScope scope(env);
+  if (info[0].IsExternal()) {
+    _index.reset(info[0].As<Napi::External<VectorIndex>>().Data());
+    return;
+  }
+  VectorIndexOptions options;
+  if (!parseIndexOptions(env, info[0], options)) {
+    return;
+  }
+  try {
+    _index = std::make_shared<VectorIndex>(options);
+  } catch (const std::runtime_error &e) {
+    Napi::Error::New(env, e.what()).ThrowAsJavaScriptException();
+  }
+}
+
+Napi::Value VectorIndexWrap::Load(const Napi::CallbackInfo &info) {
+  Napi::Env env = info.Env();
+  Napi::HandleScope scope(env);
+  if (!info[0].IsString()) {
+    Napi::TypeError::New(env, "path must be a string")
+        .ThrowAsJavaScriptException();
+    return env.Undefined();
+  }
+  auto worker =
+      new VectorIndexFileWorker(env, info[0].As<Napi::String>().Utf8Value());
+  worker->Queue();
+  return worker->Promise();
+}
+
+Napi::Value VectorIndexWrap::Add(const Napi::CallbackInfo &info) {
+  Napi::Env env = info.Env();
+  Napi::HandleScope scope(env);
+  EmbeddingType type;
+  if (!info[0].IsTypedArray()) {
+    Napi::TypeError::New(env, "vectors must be a Float32Array, Uint16Array "
+                              "(float16) or Int8Array")
+        .ThrowAsJavaScriptException();
+    return env.Undefined();
+  }
+  Napi::TypedArray vectors = info[0].As<Napi::TypedArray>();
+  switch (vectors.TypedArrayType()) {
+  case napi_float32_array:
+    type = EmbeddingType::Float32;
+    break;
+  case napi_uint16_array:
+    type = EmbeddingType::Float16;
+    break;
+  case napi_int8_array:
+    type = EmbeddingType::Int8;
+    break;
+  default:
+    Napi::TypeError::New(env, "vectors must be a Float32Array, Uint16Array "
+                              "(float16) or Int8Array")
+        .ThrowAsJavaScriptException();
+    return env.Undefined();
+  }
+  uint32_t dim = _index->options().dim;
+  if (vectors.ElementLength() % dim != 0) {
+    Napi::RangeError::New(env, "vectors length must be a multiple of dim")
+        .ThrowAsJavaScriptException();
+    return env.Undefined();
+  }
+  size_t count = vectors.ElementLength() / dim;
+  std::vector<float> scales;
+  if (type == EmbeddingType::Int8) {
+    scales.assign(count, 1.0f);
+    Napi::Value value = info[1].IsObject()
+                            ? info[1].As<Napi::Object>().Get("scales")
+                            : env.Undefined();
+    if (value.IsTypedArray() &&
+        value.As<Napi::TypedArray>().TypedArrayType() == napi_float32_array) {
+      Napi::Float32Array array = value.As<Napi::Float32Array>();
+      if (array.ElementLength() != count) {
+        Napi::RangeError::New(env, "scales needs one entry per vector")
+            .ThrowAsJavaScriptException();
+        return env.Undefined();
+      }
+      scales.assign(array.Data(), array.Data() + count);
+    }
+  }
+  // Copied, the worker must not read memory JS can change meanwhile
+  const uint8_t *data =
+      static_cast<const uint8_t *>(vectors.ArrayBuffer().Data()) +
+      vectors.ByteOffset();
+  std::vector<uint8_t> rows(data, data + vectors.ByteLength());
+  auto worker = new VectorAddWorker(env, _index, std::move(rows), type, count,
+                                    std::move(scales));
+  worker->Queue();
+  return worker->Promise();
+}
+
+Napi::Value VectorIndexWrap::AddText(const Napi::CallbackInfo &info) {
+  Napi::Env env = info.Env();
+  Napi::HandleScope scope(env);
+  EmbeddingsHolder *embedding = Embedding::HolderOf(info[0]);
+  if (embedding == NULL) {
+    Napi::TypeError::New(env, "embedding must be an Embedding")
+        .ThrowAsJavaScriptException();
+    return env.Undefined();
+  }
+  if (!info[1].IsArray()) {
+    Napi::TypeError::New(env, "prompts must be an array of strings")
+        .ThrowAsJavaScriptException();
+    return env.Undefined();
+  }
+  Napi::Array array = info[1].As<Napi::Array>();
+  std::vector<std::string> prompts;
+  prompts.reserve(array.Length());
+  for (uint32_t i = 0; i < array.Length(); i++) {
+    Napi::Value prompt = array.Get(i);
+    if (!prompt.IsString()) {
+      Napi::TypeError::New(env, "prompts must be an array of strings")
+          .ThrowAsJavaScriptException();
+      return env.Undefined();
+    }
+    prompts.push_back(prompt.As<Napi::String>().Utf8Value());
+  }
+  EmbeddingOptions options;
+  if (!parseEmbeddingOptions(env, info[2], options)) {
+    return env.Undefined();
+  }
+  // Encoded by the embedding callback, ready to append
+  options.type = _index->options().type;
+  if (_index->options().metric == VectorMetric::Cosine) {
+    options.normalize = true;
+  }
+  auto worker = new VectorAddWorker(env, _index, embedding,
+                                    Embedding::ExecutorOf(info[0]),
+                                    std::move(prompts), options);
+  worker->Queue();
+  return worker->Promise();
+}
+
+Napi::Value VectorIndexWrap::Search(const Napi::CallbackInfo &info) {
+  Napi::Env env = info.Env();
+  Napi::HandleScope scope(env);
+  if (!info[0].IsTypedArray() ||
+      info[0].As<Napi::TypedArray>().TypedArrayType() != napi_float32_array) {
+    Napi::TypeError::New(env, "query must be a Float32Array")
+        .ThrowAsJavaScriptException();
+    return env.Undefined();
+  }
+  Napi::Float32Array query = info[0].As<Napi::Float32Array>();
+  std::vector<float> values(query.Data(), query.Data() + query.ElementLength());
+  auto worker = new VectorSearchWorker(env, _index, std::move(values),
+                                       parseK(info[1]), parseEf(info[2]));
+  worker->Queue();
+  return worker->Promise();
+}
+
+Napi::Value VectorIndexWrap::SearchText(const Napi::CallbackInfo &info) {
+  Napi::Env env = info.Env();
+  Napi::HandleScope scope(env);
+  EmbeddingsHolder *embedding = Embedding::HolderOf(info[0]);
+  if (embedding == NULL) {
+    Napi::TypeError::New(env, "embedding must be an Embedding")
+        .ThrowAsJavaScriptException();
+    return env.Undefined();
+  }
+  if (!info[1].IsString()) {
+    Napi::TypeError::New(env, "prompt must be a string")
+        .ThrowAsJavaScriptException();
+    return env.Undefined();
+  }
+  EmbeddingOptions options;
+  if (!parseEmbeddingOptions(env, info[3], options)) {
+    return env.Undefined();
+  }
+  auto worker = new VectorSearchWorker(
+      env, _index, embedding, Embedding::ExecutorOf(info[0]),
+      info[1].As<Napi::String>().Utf8Value(), options, parseK(info[2]),
+      parseEf(info[3]));
+  worker->Queue();
+  return worker->Promise();
+}
+
+Napi::Value VectorIndexWrap::Save(const Napi::CallbackInfo &info) {
+  Napi::Env env = info.Env();
+  Napi::HandleScope scope(env);
+  if (!info[0].IsString()) {
+    Napi::TypeError::New(env, "path must be a string")
+        .ThrowAsJavaScriptException();
+    return env.Undefined();
+  }
+  auto worker = new VectorIndexFileWorker(
+      env, _index, info[0].As<Napi::String>().Utf8Value());
+  worker->Queue();
+  return worker->Promise();
+}
+
+Napi::Value VectorIndexWrap::Size(const Napi::CallbackInfo &info) {
+  return Napi::Number::New(info.Env(), (double)_index->size());
+}
+
+Napi::Value VectorIndexWrap::Dim(const Napi::CallbackInfo &info) {
+  return Napi::Number::New(info.Env(), _index->options().dim);
+}
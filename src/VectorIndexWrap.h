@@ -0,0 +1,46 @@
+#pragma once
+
+#include "vector_index.h"
+#include <memory>
+#include <napi.h>
+
+// JS VectorIndex; workers share ownership of the index so it outlives a
+// collected wrapper until they finish
+class VectorIndexWrap : public Napi::ObjectWrap<VectorIndexWrap> {
+public:
+  static Napi::Object Init(Napi::Env env, Napi::Object &exports);
+
+  static inline Napi::Object New(Napi::External<VectorIndex> index) {
+    return constructor.New({index});
+  }
+
+  VectorIndexWrap(const Napi::CallbackInfo &info);
+
+protected:
+  // new VectorIndex({ dim, dtype?, metric?, type?, m?, ef_construction?,
+  // ef_search? })
+  // VectorIndex.load(path: string): Promise<VectorIndex>
+  static Napi::Value Load(const Napi::CallbackInfo &info);
+  // index.add(vectors: Float32Array | Uint16Array | Int8Array, options?: {
+  // scales?: Float32Array }): Promise<number> (id of the first row)
+  Napi::Value Add(const Napi::CallbackInfo &info);
+  // index.addText(embedding: Embedding, prompts: string[], options?: {
+  // pooling, normalize }): Promise<number>
+  Napi::Value AddText(const Napi::CallbackInfo &info);
+  // index.search(query: Float32Array, k: number, options?: { ef }): Promise<{
+  // ids: Uint32Array, scores: Float32Array }>
+  Napi::Value Search(const Napi::CallbackInfo &info);
+  // index.searchText(embedding: Embedding, prompt: string, k: number,
+  // options?: { ef, pooling, normalize }): Promise<{ ids, scores }>
+  Napi::Value SearchText(const Napi::CallbackInfo &info);
+  // index.save(path: string): Promise<void>
+  Napi::Value Save(const Napi::CallbackInfo &info);
+  // index.size(): number
+  Napi::Value Size(const Napi::CallbackInfo &info);
+  // index.dim(): number
+  Napi::Value Dim(const Napi::CallbackInfo &info);
+
+private:
+  static Napi::FunctionReference constructor;
+  std::shared_ptr<VectorIndex> _index;
+};
@@ -0,0 +1,76 @@
+#include "VectorSearchWorker.h"
+#include "metrics.h"
+#include "trace.h"
+#include <stdexcept>
+
+VectorSearchWorker::VectorSearchWorker(Napi::Env env,
+                                       std::shared_ptr<VectorIndex> index,
+                                       std::vector<float> query, size_t k,
+                                       uint32_t ef)
+    : ExecutorWorker(env, nullptr), Napi::Promise::Deferred(env),
+      _index(std::move(index)), query_(std::move(query)), k_(k), ef_(ef) {}
+
+VectorSearchWorker::VectorSearchWorker(Napi::Env env,
+                                       std::shared_ptr<VectorIndex> index,
+                                       EmbeddingsHolder *embedding,
+                                       std::shared_ptr<Executor> executor,
+                                       std::string prompt,
+                                       const EmbeddingOptions &options, size_t k,
+                                       uint32_t ef)
+    : ExecutorWorker(env, executor), Napi::Promise::Deferred(env),
+      _index(std::move(index)), _embedding(embedding), prompt_(std::move(prompt)),
+      options_(options), k_(k), ef_(ef) {}
+
+void VectorSearchWorker::Execute() {
+  trace::Span span("VectorSearchWorker");
+  auto start = std::chrono::steady_clock::now();
+  try {
+    if (_embedding) {
+      // The query embedding goes from the Genie callback to the search
+      // without a round trip through JS
+      options_.type = EmbeddingType::Float32;
+      auto embedding_start = std::chrono::steady_clock::now();
+      try {
+        _embedding->query(
+            prompt_,
+            [this](std::unique_ptr<uint8_t[]> data, size_t length, float) {
+              const float *values = reinterpret_cast<const float *>(data.get());
+              query_.assign(values, values + length);
+            },
+            options_);
+      } catch (const std::runtime_error &e) {
+        perf::embedding_queries_error.inc();
+        throw;
+      }
+      perf::embedding_queries_ok.inc();
+      perf::embedding_duration.observe(perf::secondsSince(embedding_start));
+    }
+    if (query_.size() != _index->options().dim) {
+      throw std::runtime_error("Query size " + std::to_string(query_.size()) +
+                               " does not match index dim " +
+                               std::to_string(_index->options().dim));
+    }
+    hits_ = _index->search(query_.data(), k_, ef_);
+    perf::vector_searches.inc();
+  } catch (const std::runtime_error &e) {
+    SetError(e.what());
+  }
+  perf::vector_search_duration.observe(perf::secondsSince(start));
+}
+
+void VectorSearchWorker::OnOK() {
+  Napi::Env env = Napi::AsyncWorker::Env();
+  Napi::HandleScope scope(env);
+  Napi::Uint32Array ids = Napi::Uint32Array::New(env, hits_.size());
+  Napi::Float32Array scores = Napi::Float32Array::New(env, hits_.size());
+  for (size_t i = 0; i < hits_.size(); i++) {
+    ids[i] = hits_[i].id;
+    scores[i] = hits_[i].score;
+  }
+  Napi::Object result = Napi::Object::New(env);
+  result.Set("ids", ids);
+  result.Set("scores", scores);
+  Resolve(result);
+}
+
+void VectorSearchWorker::OnError(const Napi::Error &e) { Reject(e.Value()); }
@@ -0,0 +1,34 @@
+#pragma once
+
+#include "EmbeddingsHolder.h"
+#include "ExecutorWorker.h"
+#include "vector_index.h"
+#include <memory>
+#include <napi.h>
+#include <string>
+#include <vector>
+
+class VectorSearchWorker : public ExecutorWorker, public Napi::Promise::Deferred {
+public:
+  // Runs on the threadpool
+  VectorSearchWorker(Napi::Env env, std::shared_ptr<VectorIndex> index,
+                     std::vector<float> query, size_t k, uint32_t ef);
+  // Embeds prompt and searches with it on the embedding's executor
+  VectorSearchWorker(Napi::Env env, std::shared_ptr<VectorIndex> index,
+                     EmbeddingsHolder *embedding,
+                     std::shared_ptr<Executor> executor, std::string prompt,
+                     const EmbeddingOptions &options, size_t k, uint32_t ef);
+  void Execute();
+  void OnOK();
+  void OnError(const Napi::Error &e);
+
+private:
+  std::shared_ptr<VectorIndex> _index;
+  std::vector<float> query_;
+  EmbeddingsHolder *_embedding = NULL;
+  std::string prompt_;
+  EmbeddingOptions options_;
+  size_t k_;
+  uint32_t ef_;
+  std::vector<SearchHit> hits_;
+};
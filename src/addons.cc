@@ -1,10 +1,46 @@
 #include "Context.h"
+#include "ContextPool.h"
 #include "Embedding.h"
+#include "TokenStream.h"
+#include "VectorIndexWrap.h"
+#include "metrics.h"
+#include "trace.h"
 #include <napi.h>
+#include <stdexcept>
+
+// metrics(): process-wide counters in Prometheus text format
+static Napi::Value Metrics(const Napi::CallbackInfo &info) {
+  return Napi::String::New(info.Env(), perf::render());
+}
+
+// startTrace(): records spans until stopTrace()
+static void StartTrace(const Napi::CallbackInfo &info) {
+  trace::setThreadName("js");
+  trace::start();
+}
+
+// stopTrace(path): writes a Chrome trace-event JSON file, returns the event
+// count
+static Napi::Value StopTrace(const Napi::CallbackInfo &info) {
+  Napi::Env env = info.Env();
+  try {
+    size_t events = trace::stop(info[0].As<Napi::String>().Utf8Value());
+    return Napi::Number::New(env, (double)events);
+  } catch (const std::runtime_error &e) {
+    Napi::Error::New(env, e.what()).ThrowAsJavaScriptException();
+    return env.Undefined();
+  }
+}
 
 Napi::Object Init(Napi::Env env, Napi::Object exports) {
   exports = Context::Init(env, exports);
+  exports = ContextPool::Init(env, exports);
   exports = Embedding::Init(env, exports);
+  exports = TokenStream::Init(env, exports);
+  exports = VectorIndexWrap::Init(env, exports);
+  exports.Set("metrics", Napi::Function::New(env, Metrics, "metrics"));
+  exports.Set("startTrace", Napi::Function::New(env, StartTrace, "startTrace"));
+  exports.Set("stopTrace", Napi::Function::New(env, StopTrace, "stopTrace"));
   return exports;
 }
 
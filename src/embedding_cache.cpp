@@ -0,0 +1,358 @@
+#include "embedding_cache.h"
+#include "trace.h"
+#include "unpack.h"
+#include <cstring>
+#include <filesystem>
+#include <stdexcept>
+#include <zlib.h>
+
+#ifdef _WIN32
+#include <windows.h>
+#include <io.h>
+#else
+#include <sys/file.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#endif
+
+namespace fs = std::filesystem;
+
+static constexpr size_t HEADER_SIZE = 16;
+static constexpr size_t KEY_SIZE = 16;
+static constexpr uint32_t MAX_RANK = 8;
+
+namespace {
+
+template<typename T>
+void appendLE(std::vector<uint8_t> &out, T value) {
+    uint8_t bytes[sizeof(T)];
+    std::memcpy(bytes, &value, sizeof(T));
+    out.insert(out.end(), bytes, bytes + sizeof(T));
+}
+
+template<typename T>
+T readLE(const uint8_t *ptr) {
+    T val;
+    std::memcpy(&val, ptr, sizeof(T));
+    return val;
+}
+
+// MurmurHash64A
+uint64_t hash64(const void *data, size_t size, uint64_t seed) {
+    const uint64_t m = 0xc6a4a7935bd1e995ULL;
+    const int r = 47;
+    uint64_t h = seed ^ (size * m);
+    const uint8_t *p = static_cast<const uint8_t *>(data);
+    for (size_t i = 0; i + 8 <= size; i += 8) {
+        uint64_t k = readLE<uint64_t>(p + i);
+        k *= m;
+        k ^= k >> r;
+        k *= m;
+        h ^= k;
+        h *= m;
+    }
+    const uint8_t *tail = p + (size & ~static_cast<size_t>(7));
+    switch (size & 7) {
+    case 7: h ^= static_cast<uint64_t>(tail[6]) << 48; [[fallthrough]];
+    case 6: h ^= static_cast<uint64_t>(tail[5]) << 40; [[fallthrough]];
+    case 5: h ^= static_cast<uint64_t>(tail[4]) << 32; [[fallthrough]];
+    case 4: h ^= static_cast<uint64_t>(tail[3]) << 24; [[fallthrough]];
+    case 3: h ^= static_cast<uint64_t>(tail[2]) << 16; [[fallthrough]];
+    case 2: h ^= static_cast<uint64_t>(tail[1]) << 8; [[fallthrough]];
+    case 1: h ^= static_cast<uint64_t>(tail[0]); h *= m;
+    }
+    h ^= h >> r;
+    h *= m;
+    h ^= h >> r;
+    return h;
+}
+
+size_t valueCount(const uint32_t *dimensions, uint32_t rank) {
+    size_t count = 1;
+    for (uint32_t i = 0; i < rank; ++i) count *= dimensions[i];
+    return count;
+}
+
+// Whether size bytes at payload hold a key, a shape and its values
+bool validPayload(const uint8_t *payload, uint32_t size) {
+    if (size < KEY_SIZE + 4) return false;
+    uint32_t rank = readLE<uint32_t>(payload + KEY_SIZE);
+    if (rank == 0 || rank > MAX_RANK || KEY_SIZE + 4 + 4ull * rank > size) return false;
+    uint64_t count = 1;
+    for (uint32_t i = 0; i < rank; ++i) {
+        count *= readLE<uint32_t>(payload + KEY_SIZE + 4 + 4 * i);
+        if (count > size) return false;
+    }
+    return KEY_SIZE + 4 + 4ull * rank + 4 * count == size;
+}
+
+uint64_t fileSize(std::FILE *file) {
+#ifdef _WIN32
+    struct _stat64 st;
+    return _fstat64(_fileno(file), &st) == 0 ? static_cast<uint64_t>(st.st_size) : 0;
+#else
+    struct stat st;
+    return fstat(fileno(file), &st) == 0 ? static_cast<uint64_t>(st.st_size) : 0;
+#endif
+}
+
+bool truncateFile(std::FILE *file, uint64_t size) {
+#ifdef _WIN32
+    return _chsize_s(_fileno(file), static_cast<__int64>(size)) == 0;
+#else
+    return ftruncate(fileno(file), static_cast<off_t>(size)) == 0;
+#endif
+}
+
+// Exclusive until the file is closed, without waiting
+bool lockFile(std::FILE *file) {
+#ifdef _WIN32
+    // One byte far past the end, so the lock never blocks reads or appends
+    OVERLAPPED overlapped = {};
+    overlapped.Offset = 0xFFFFFFFE;
+    overlapped.OffsetHigh = 0x7FFFFFFF;
+    HANDLE handle = reinterpret_cast<HANDLE>(_get_osfhandle(_fileno(file)));
+    return LockFileEx(handle, LOCKFILE_EXCLUSIVE_LOCK | LOCKFILE_FAIL_IMMEDIATELY, 0, 1, 0,
+                      &overlapped) != 0;
+#else
+    return flock(fileno(file), LOCK_EX | LOCK_NB) == 0;
+#endif
+}
+
+} // namespace
+
+size_t EmbeddingCache::Entry::bytes() const {
+    return sizeof(Entry) + dimensions.size() * sizeof(uint32_t) + values.size() * sizeof(float);
+}
+
+std::string embeddingModelIdentity(const std::string &configJson) {
+    std::string identity = configJson;
+    // Every string value that names a regular file (binaries, tokenizer)
+    for (size_t i = 0; i < configJson.size(); i++) {
+        if (configJson[i] != '"') {
+            continue;
+        }
+        std::string value;
+        for (i++; i < configJson.size() && configJson[i] != '"'; i++) {
+            if (configJson[i] == '\\' && i + 1 < configJson.size()) {
+                i++;
+            }
+            value.push_back(configJson[i]);
+        }
+        std::error_code ec;
+        if (value.empty() || !fs::is_regular_file(value, ec)) {
+            continue;
+        }
+        uintmax_t size = fs::file_size(value, ec);
+        if (ec) {
+            continue;
+        }
+        auto mtime = fs::last_write_time(value, ec);
+        if (ec) {
+            continue;
+        }
+        identity += '\0' + value + '\0' + std::to_string(size) + '\0' +
+                    std::to_string(mtime.time_since_epoch().count());
+    }
+    return identity;
+}
+
+EmbeddingCache::EmbeddingCache(const std::string &model, size_t maxBytes, const std::string &path)
+    : model_(hash64(model.data(), model.size(), 0)), maxBytes_(maxBytes) {
+    if (path.empty()) return;
+    try {
+        openFile(path);
+    } catch (const std::runtime_error &) {
+        closeFile();
+        throw;
+    }
+}
+
+EmbeddingCache::~EmbeddingCache() {
+    closeFile();
+}
+
+EmbeddingCache::Key EmbeddingCache::keyOf(const std::string &prompt) const {
+    return {hash64(prompt.data(), prompt.size(), model_),
+            hash64(prompt.data(), prompt.size(), model_ ^ 0x9e3779b97f4a7c15ULL)};
+}
+
+void EmbeddingCache::openFile(const std::string &path) {
+    trace::Span span("embedding_cache_open", path);
+    file_ = std::fopen(path.c_str(), "a+b");
+    if (!file_) throw std::runtime_error("Failed to open embedding cache: " + path);
+    // Unbuffered, so a record reaches the file in one write and the file size
+    // always tells where the next one goes
+    std::setvbuf(file_, nullptr, _IONBF, 0);
+    if (!lockFile(file_)) {
+        throw std::runtime_error("Embedding cache is in use by another process or Embedding: " +
+                                 path);
+    }
+    uint64_t size = fileSize(file_);
+    uint64_t valid = 0;
+    if (size >= HEADER_SIZE) {
+        map_ = std::make_unique<MemoryMap>(file_);
+        const uint8_t *data = map_->data();
+        if (std::memcmp(data, EMBEDDING_CACHE_MAGIC, sizeof(EMBEDDING_CACHE_MAGIC)) == 0 &&
+            readLE<uint64_t>(data + 8) == model_) {
+            valid = HEADER_SIZE;
+            while (valid + 8 <= size) {
+                uint32_t payloadSize = readLE<uint32_t>(data + valid);
+                if (payloadSize > size - valid - 8) break;
+                const uint8_t *payload = data + valid + 4;
+                if (!validPayload(payload, payloadSize) ||
+                    readLE<uint32_t>(payload + payloadSize) !=
+                        crc32(crc32(0, nullptr, 0), payload, payloadSize)) {
+                    break;
+                }
+                records_[{readLE<uint64_t>(payload), readLE<uint64_t>(payload + 8)}] = valid + 4;
+                valid += 8 + payloadSize;
+            }
+        }
+    }
+    if (valid < size || valid == 0) {
+        // Torn tail, or a short file or another model's file to start over
+        map_.reset();
+        if (valid == 0) records_.clear();
+        if (!truncateFile(file_, valid)) {
+            throw std::runtime_error("Failed to truncate embedding cache: " + path);
+        }
+    }
+    if (valid == 0) {
+        std::vector<uint8_t> header(EMBEDDING_CACHE_MAGIC,
+                                    EMBEDDING_CACHE_MAGIC + sizeof(EMBEDDING_CACHE_MAGIC));
+        appendLE<uint64_t>(header, model_);
+        if (std::fwrite(header.data(), 1, header.size(), file_) != header.size()) {
+            throw std::runtime_error("Failed to write embedding cache: " + path);
+        }
+        valid = HEADER_SIZE;
+    }
+    fileBytes_ = fileSize(file_);
+    if (fileBytes_ != valid) {
+        throw std::runtime_error("Failed to write embedding cache: " + path);
+    }
+}
+
+void EmbeddingCache::closeFile() {
+    map_.reset();
+    records_.clear();
+    fileBytes_ = 0;
+    if (file_) {
+        std::fclose(file_);
+        file_ = nullptr;
+    }
+}
+
+bool EmbeddingCache::readRecord(uint64_t offset, const Key &key, const Reader &reader) {
+    if (!map_ || offset >= map_->size()) {
+        // Appended after the mapping was made
+        map_.reset();
+        if (!file_) return false;
+        try {
+            map_ = std::make_unique<MemoryMap>(file_);
+        } catch (const std::runtime_error &) {
+            return false;
+        }
+    }
+    uint64_t size = map_->size();
+    if (offset % 4 != 0 || offset < HEADER_SIZE + 4 || offset > size) return false;
+    const uint8_t *payload = map_->data() + offset;
+    uint32_t payloadSize = readLE<uint32_t>(payload - 4);
+    if (payloadSize > size - offset || !validPayload(payload, payloadSize) ||
+        readLE<uint64_t>(payload) != key.a || readLE<uint64_t>(payload + 8) != key.b) {
+        return false;
+    }
+    uint32_t rank = readLE<uint32_t>(payload + KEY_SIZE);
+    // Records are 4-byte aligned in a page-aligned mapping
+    const uint32_t *dimensions = reinterpret_cast<const uint32_t *>(payload + KEY_SIZE + 4);
+    const float *values = reinterpret_cast<const float *>(dimensions + rank);
+    reader(dimensions, rank, values);
+    return true;
+}
+
+void EmbeddingCache::remember(Entry entry) {
+    size_t bytes = entry.bytes();
+    if (bytes > maxBytes_) return;
+    Key key = entry.key;
+    lru_.push_front(std::move(entry));
+    memory_[key] = lru_.begin();
+    memoryBytes_ += bytes;
+    while (memoryBytes_ > maxBytes_) {
+        memoryBytes_ -= lru_.back().bytes();
+        memory_.erase(lru_.back().key);
+        lru_.pop_back();
+    }
+}
+
+bool EmbeddingCache::lookup(const std::string &prompt, const Reader &reader) {
+    Key key = keyOf(prompt);
+    std::lock_guard<std::mutex> lock(mutex_);
+    auto it = memory_.find(key);
+    if (it != memory_.end()) {
+        lru_.splice(lru_.begin(), lru_, it->second);
+        const Entry &entry = *it->second;
+        hits_++;
+        reader(entry.dimensions.data(), static_cast<uint32_t>(entry.dimensions.size()),
+               entry.values.data());
+        return true;
+    }
+    auto record = records_.find(key);
+    if (record != records_.end()) {
+        if (readRecord(record->second, key, reader)) {
+            hits_++;
+            return true;
+        }
+        // Unreadable, generated and appended again
+        records_.erase(record);
+    }
+    misses_++;
+    return false;
+}
+
+void EmbeddingCache::store(const std::string &prompt, const uint32_t *dimensions, uint32_t rank,
+                           const float *values) {
+    if (rank == 0 || rank > MAX_RANK) return;
+    Key key = keyOf(prompt);
+    size_t count = valueCount(dimensions, rank);
+    std::lock_guard<std::mutex> lock(mutex_);
+    if (memory_.count(key) || records_.count(key)) return;
+    if (file_) {
+        std::vector<uint8_t> record;
+        record.reserve(8 + KEY_SIZE + 4 + 4 * rank + 4 * count);
+        appendLE<uint32_t>(record, 0);
+        appendLE<uint64_t>(record, key.a);
+        appendLE<uint64_t>(record, key.b);
+        appendLE<uint32_t>(record, rank);
+        for (uint32_t i = 0; i < rank; ++i) appendLE<uint32_t>(record, dimensions[i]);
+        const uint8_t *bytes = reinterpret_cast<const uint8_t *>(values);
+        record.insert(record.end(), bytes, bytes + count * sizeof(float));
+        uint32_t payloadSize = static_cast<uint32_t>(record.size() - 4);
+        std::memcpy(record.data(), &payloadSize, sizeof(payloadSize));
+        appendLE<uint32_t>(record, crc32(crc32(0, nullptr, 0), record.data() + 4, payloadSize));
+        if (std::fwrite(record.data(), 1, record.size(), file_) == record.size()) {
+            records_[key] = fileBytes_ + 4;
+            fileBytes_ += record.size();
+        } else {
+            // Part of the record may have been written (disk full); cut it off
+            // so later records land where records_ says, or stop using the file
+            std::clearerr(file_);
+            if (!truncateFile(file_, fileBytes_) || fileSize(file_) != fileBytes_) closeFile();
+        }
+    }
+    Entry entry;
+    entry.key = key;
+    entry.dimensions.assign(dimensions, dimensions + rank);
+    entry.values.assign(values, values + count);
+    remember(std::move(entry));
+}
+
+EmbeddingCacheStats EmbeddingCache::stats() const {
+    std::lock_guard<std::mutex> lock(mutex_);
+    EmbeddingCacheStats stats;
+    stats.hits = hits_;
+    stats.misses = misses_;
+    stats.entries = file_ ? records_.size() : memory_.size();
+    stats.memory_bytes = memoryBytes_;
+    stats.file_bytes = file_ ? fileBytes_ : 0;
+    return stats;
+}
@@ -0,0 +1,109 @@
+#pragma once
+
+#include <cstdint>
+#include <cstdio>
+#include <functional>
+#include <list>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <unordered_map>
+#include <vector>
+
+class MemoryMap;
+
+// -----------------------------------------------------------------------------
+// Cache of raw embedding outputs keyed by prompt
+//
+// Keys are two 64-bit hashes of the prompt seeded with the model identity (see
+// embeddingModelIdentity). Outputs are kept before pooling or type
+// conversion, so a hit serves any per-call options.
+//
+// Recent outputs stay in an in-memory LRU bounded by bytes. With a path, every
+// output is also appended to a file that is memory-mapped on open, so it
+// survives restarts; hits on file records read the mapping in place.
+//
+// File format (little-endian), records 4-byte aligned:
+//   Header (16 bytes): "QEMBC1\0\0", u64 model hash
+//   Record:            u32 payload_size, payload, u32 crc32(payload)
+//   Payload:           u64 key_a, u64 key_b, u32 rank, u32 dims[rank],
+//                      f32 values[product of dims]
+// A torn record at the end (crash while appending) is truncated on open, and
+// a failed append is cut off again. A file written for another model, or
+// shorter than the header, is started over. The file is locked while open:
+// a second cache on the same path (another process or Embedding) fails to
+// open it. Lookups check a record's bounds and key before reading it.
+// -----------------------------------------------------------------------------
+
+// The embedding config followed by the size and modification time of every
+// file it names, so outputs of a rebuilt model under the same paths are not
+// reused
+std::string embeddingModelIdentity(const std::string &configJson);
+
+static constexpr char EMBEDDING_CACHE_MAGIC[8] = {'Q','E','M','B','C','1','\0','\0'};
+
+struct EmbeddingCacheStats {
+    uint64_t hits         = 0;
+    uint64_t misses       = 0;
+    size_t   entries      = 0;  // Distinct prompts, memory and file
+    size_t   memory_bytes = 0;
+    uint64_t file_bytes   = 0;
+};
+
+class EmbeddingCache {
+public:
+    using Reader = std::function<void(const uint32_t *dimensions, uint32_t rank,
+                                      const float *values)>;
+
+    // path may be empty for a memory-only cache
+    EmbeddingCache(const std::string &model, size_t maxBytes, const std::string &path);
+    ~EmbeddingCache();
+
+    // Calls reader with the cached output and returns true on a hit
+    bool lookup(const std::string &prompt, const Reader &reader);
+    void store(const std::string &prompt, const uint32_t *dimensions, uint32_t rank,
+               const float *values);
+
+    EmbeddingCacheStats stats() const;
+
+private:
+    struct Key {
+        uint64_t a;
+        uint64_t b;
+        bool operator==(const Key &other) const { return a == other.a && b == other.b; }
+    };
+    struct KeyHash {
+        size_t operator()(const Key &key) const { return static_cast<size_t>(key.a); }
+    };
+    struct Entry {
+        Key                   key;
+        std::vector<uint32_t> dimensions;
+        std::vector<float>    values;
+        size_t bytes() const;
+    };
+
+    Key  keyOf(const std::string &prompt) const;
+    void openFile(const std::string &path);
+    void closeFile();
+    // Reads the record whose payload starts at offset; false if it does not
+    // hold key or cannot be mapped
+    bool readRecord(uint64_t offset, const Key &key, const Reader &reader);
+    void remember(Entry entry);
+
+    uint64_t model_;
+    size_t   maxBytes_;
+
+    mutable std::mutex mutex_;
+    std::list<Entry>   lru_;  // Most recent first
+    std::unordered_map<Key, std::list<Entry>::iterator, KeyHash> memory_;
+    size_t   memoryBytes_ = 0;
+    uint64_t hits_        = 0;
+    uint64_t misses_      = 0;
+
+    // Offsets of payloads in the file, read through map_ (remapped from file_
+    // when a record was appended after the mapping was made)
+    std::unique_ptr<MemoryMap>           map_;
+    std::FILE                           *file_ = nullptr;
+    uint64_t                             fileBytes_ = 0;
+    std::unordered_map<Key, uint64_t, KeyHash> records_;
+};
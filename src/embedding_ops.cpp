@@ -0,0 +1,455 @@
+#include "embedding_ops.h"
+#include <algorithm>
+#include <cmath>
+#include <cstring>
+#include <stdexcept>
+
+#if defined(__ARM_NEON) || defined(_M_ARM64)
+#define EMBEDDING_NEON 1
+#ifdef _MSC_VER
+#include <arm64_neon.h>
+#else
+#include <arm_neon.h>
+#endif
+#elif defined(__AVX2__) || defined(__SSE2__) || defined(_M_X64)
+#define EMBEDDING_SSE2 1
+#include <immintrin.h>
+#endif
+
+namespace {
+
+#ifdef EMBEDDING_NEON
+inline float horizontalSum(float32x4_t v) {
+#if defined(__aarch64__) || defined(_M_ARM64)
+    return vaddvq_f32(v);
+#else
+    float32x2_t s = vadd_f32(vget_low_f32(v), vget_high_f32(v));
+    return vget_lane_f32(vpadd_f32(s, s), 0);
+#endif
+}
+#endif
+
+#ifdef EMBEDDING_SSE2
+inline float horizontalSum(__m128 v) {
+    __m128 shuf = _mm_shuffle_ps(v, v, _MM_SHUFFLE(2, 3, 0, 1));
+    __m128 sums = _mm_add_ps(v, shuf);
+    shuf = _mm_movehl_ps(shuf, sums);
+    return _mm_cvtss_f32(_mm_add_ss(sums, shuf));
+}
+#endif
+
+// Round to nearest even, with subnormals, infinities and NaN
+uint16_t floatToHalf(float value) {
+    uint32_t bits;
+    std::memcpy(&bits, &value, sizeof(bits));
+    uint32_t sign = (bits >> 16) & 0x8000;
+    uint32_t exponent = (bits >> 23) & 0xff;
+    uint32_t mantissa = bits & 0x7fffff;
+    if (exponent == 0xff) {
+        return static_cast<uint16_t>(sign | 0x7c00 | (mantissa ? 0x200 | (mantissa >> 13) : 0));
+    }
+    int32_t halfExponent = static_cast<int32_t>(exponent) - 127 + 15;
+    if (halfExponent >= 0x1f) {
+        return static_cast<uint16_t>(sign | 0x7c00);
+    }
+    if (halfExponent <= 0) {
+        if (halfExponent < -10) {
+            return static_cast<uint16_t>(sign);
+        }
+        mantissa |= 0x800000;
+        uint32_t shift = static_cast<uint32_t>(14 - halfExponent);
+        uint32_t half = mantissa >> shift;
+        uint32_t rest = mantissa & ((1u << shift) - 1);
+        uint32_t midpoint = 1u << (shift - 1);
+        if (rest > midpoint || (rest == midpoint && (half & 1))) {
+            half++;
+        }
+        return static_cast<uint16_t>(sign | half);
+    }
+    uint32_t half = (static_cast<uint32_t>(halfExponent) << 10) | (mantissa >> 13);
+    uint32_t rest = mantissa & 0x1fff;
+    if (rest > 0x1000 || (rest == 0x1000 && (half & 1))) {
+        half++;  // May carry into the exponent, up to infinity
+    }
+    return static_cast<uint16_t>(sign | half);
+}
+
+// Exponent rebias by multiplication, which also handles subnormals
+inline float halfToFloat(uint16_t half) {
+    uint32_t bits = static_cast<uint32_t>(half & 0x7fff) << 13;
+    float value;
+    std::memcpy(&value, &bits, sizeof(value));
+    value *= 0x1p112f;
+    std::memcpy(&bits, &value, sizeof(bits));
+    if ((half & 0x7c00) == 0x7c00) bits |= 0x7f800000;  // Inf / NaN
+    bits |= static_cast<uint32_t>(half & 0x8000) << 16;
+    std::memcpy(&value, &bits, sizeof(value));
+    return value;
+}
+
+#if defined(EMBEDDING_SSE2) && !defined(__F16C__)
+// halfToFloat on four halves zero-extended to 32 bits
+inline __m128 halfToFloat4(__m128i half) {
+    __m128i bits = _mm_slli_epi32(_mm_and_si128(half, _mm_set1_epi32(0x7fff)), 13);
+    __m128 value = _mm_mul_ps(_mm_castsi128_ps(bits), _mm_set1_ps(0x1p112f));
+    __m128i special = _mm_cmpgt_epi32(bits, _mm_set1_epi32(0x7bff << 13));
+    __m128i sign = _mm_slli_epi32(_mm_and_si128(half, _mm_set1_epi32(0x8000)), 16);
+    __m128i result = _mm_or_si128(_mm_castps_si128(value), _mm_and_si128(special, _mm_set1_epi32(0x7f800000)));
+    return _mm_castsi128_ps(_mm_or_si128(result, sign));
+}
+#endif
+
+#ifdef EMBEDDING_SSE2
+// Sign-extends 16 int8 values to four vectors of 4 floats
+inline void int8ToFloat16x(__m128i bytes, __m128 out[4]) {
+    __m128i lo = _mm_srai_epi16(_mm_unpacklo_epi8(bytes, bytes), 8);
+    __m128i hi = _mm_srai_epi16(_mm_unpackhi_epi8(bytes, bytes), 8);
+    out[0] = _mm_cvtepi32_ps(_mm_srai_epi32(_mm_unpacklo_epi16(lo, lo), 16));
+    out[1] = _mm_cvtepi32_ps(_mm_srai_epi32(_mm_unpackhi_epi16(lo, lo), 16));
+    out[2] = _mm_cvtepi32_ps(_mm_srai_epi32(_mm_unpacklo_epi16(hi, hi), 16));
+    out[3] = _mm_cvtepi32_ps(_mm_srai_epi32(_mm_unpackhi_epi16(hi, hi), 16));
+}
+#endif
+
+#ifdef EMBEDDING_NEON
+// Sign-extends 16 int8 values to four vectors of 4 floats
+inline void int8ToFloat16x(int8x16_t bytes, float32x4_t out[4]) {
+    int16x8_t lo = vmovl_s8(vget_low_s8(bytes));
+    int16x8_t hi = vmovl_s8(vget_high_s8(bytes));
+    out[0] = vcvtq_f32_s32(vmovl_s16(vget_low_s16(lo)));
+    out[1] = vcvtq_f32_s32(vmovl_s16(vget_high_s16(lo)));
+    out[2] = vcvtq_f32_s32(vmovl_s16(vget_low_s16(hi)));
+    out[3] = vcvtq_f32_s32(vmovl_s16(vget_high_s16(hi)));
+}
+#endif
+
+} // namespace
+
+void meanPool(const float *src, size_t tokens, size_t dim, float *dst) {
+    std::fill(dst, dst + dim, 0.0f);
+    if (tokens == 0) return;
+    for (size_t t = 0; t < tokens; ++t) {
+        const float *row = src + t * dim;
+        size_t i = 0;
+#if defined(EMBEDDING_NEON)
+        for (; i + 4 <= dim; i += 4) {
+            vst1q_f32(dst + i, vaddq_f32(vld1q_f32(dst + i), vld1q_f32(row + i)));
+        }
+#elif defined(__AVX2__)
+        for (; i + 8 <= dim; i += 8) {
+            _mm256_storeu_ps(dst + i, _mm256_add_ps(_mm256_loadu_ps(dst + i), _mm256_loadu_ps(row + i)));
+        }
+#elif defined(EMBEDDING_SSE2)
+        for (; i + 4 <= dim; i += 4) {
+            _mm_storeu_ps(dst + i, _mm_add_ps(_mm_loadu_ps(dst + i), _mm_loadu_ps(row + i)));
+        }
+#endif
+        for (; i < dim; ++i) dst[i] += row[i];
+    }
+    float inv = 1.0f / static_cast<float>(tokens);
+    size_t i = 0;
+#if defined(EMBEDDING_NEON)
+    for (; i + 4 <= dim; i += 4) vst1q_f32(dst + i, vmulq_n_f32(vld1q_f32(dst + i), inv));
+#elif defined(EMBEDDING_SSE2)
+    __m128 scale = _mm_set1_ps(inv);
+    for (; i + 4 <= dim; i += 4) _mm_storeu_ps(dst + i, _mm_mul_ps(_mm_loadu_ps(dst + i), scale));
+#endif
+    for (; i < dim; ++i) dst[i] *= inv;
+}
+
+void l2Normalize(float *data, size_t n) {
+    float sum = 0.0f;
+    size_t i = 0;
+#if defined(EMBEDDING_NEON)
+    float32x4_t acc = vdupq_n_f32(0.0f);
+    for (; i + 4 <= n; i += 4) {
+        float32x4_t v = vld1q_f32(data + i);
+        acc = vmlaq_f32(acc, v, v);
+    }
+    sum = horizontalSum(acc);
+#elif defined(EMBEDDING_SSE2)
+    __m128 acc = _mm_setzero_ps();
+    for (; i + 4 <= n; i += 4) {
+        __m128 v = _mm_loadu_ps(data + i);
+        acc = _mm_add_ps(acc, _mm_mul_ps(v, v));
+    }
+    sum = horizontalSum(acc);
+#endif
+    for (; i < n; ++i) sum += data[i] * data[i];
+    if (sum <= 0.0f) return;
+    float inv = 1.0f / std::sqrt(sum);
+    i = 0;
+#if defined(EMBEDDING_NEON)
+    for (; i + 4 <= n; i += 4) vst1q_f32(data + i, vmulq_n_f32(vld1q_f32(data + i), inv));
+#elif defined(EMBEDDING_SSE2)
+    __m128 scale = _mm_set1_ps(inv);
+    for (; i + 4 <= n; i += 4) _mm_storeu_ps(data + i, _mm_mul_ps(_mm_loadu_ps(data + i), scale));
+#endif
+    for (; i < n; ++i) data[i] *= inv;
+}
+
+// NaN elements are left out of the scale and quantize to 0
+float quantizeInt8(const float *src, size_t n, int8_t *dst) {
+    float maxAbs = 0.0f;
+    size_t i = 0;
+#if defined(EMBEDDING_NEON)
+    float32x4_t vmax = vdupq_n_f32(0.0f);
+    for (; i + 4 <= n; i += 4) {
+        float32x4_t a = vabsq_f32(vld1q_f32(src + i));
+        vmax = vbslq_f32(vcgtq_f32(a, vmax), a, vmax);
+    }
+    float lanes[4];
+    vst1q_f32(lanes, vmax);
+    maxAbs = std::max(std::max(lanes[0], lanes[1]), std::max(lanes[2], lanes[3]));
+#elif defined(EMBEDDING_SSE2)
+    const __m128 absMask = _mm_castsi128_ps(_mm_set1_epi32(0x7fffffff));
+    __m128 vmax = _mm_setzero_ps();
+    // maxps returns its second operand when either is NaN
+    for (; i + 4 <= n; i += 4) vmax = _mm_max_ps(_mm_and_ps(_mm_loadu_ps(src + i), absMask), vmax);
+    float lanes[4];
+    _mm_storeu_ps(lanes, vmax);
+    maxAbs = std::max(std::max(lanes[0], lanes[1]), std::max(lanes[2], lanes[3]));
+#endif
+    for (; i < n; ++i) maxAbs = std::max(maxAbs, std::fabs(src[i]));
+    float scale = maxAbs / 127.0f;
+    float inv = 127.0f / maxAbs;
+    // Nothing but zeros, NaNs or magnitudes too small to invert; infinities
+    // leave no usable scale either
+    if (!std::isfinite(inv) || !std::isfinite(maxAbs)) {
+        std::fill(dst, dst + n, int8_t(0));
+        return std::isfinite(maxAbs) ? 1.0f : maxAbs;
+    }
+    i = 0;
+#if defined(EMBEDDING_NEON) && (defined(__aarch64__) || defined(_M_ARM64))
+    for (; i + 16 <= n; i += 16) {
+        int32x4_t a = vcvtnq_s32_f32(vmulq_n_f32(vld1q_f32(src + i), inv));
+        int32x4_t b = vcvtnq_s32_f32(vmulq_n_f32(vld1q_f32(src + i + 4), inv));
+        int32x4_t c = vcvtnq_s32_f32(vmulq_n_f32(vld1q_f32(src + i + 8), inv));
+        int32x4_t d = vcvtnq_s32_f32(vmulq_n_f32(vld1q_f32(src + i + 12), inv));
+        int16x8_t ab = vcombine_s16(vqmovn_s32(a), vqmovn_s32(b));
+        int16x8_t cd = vcombine_s16(vqmovn_s32(c), vqmovn_s32(d));
+        vst1q_s8(dst + i, vcombine_s8(vqmovn_s16(ab), vqmovn_s16(cd)));
+    }
+#elif defined(EMBEDDING_SSE2)
+    // _mm_cvtps_epi32 rounds to nearest even under the default MXCSR, and
+    // would turn NaN into INT_MIN, so NaN lanes are zeroed first
+    __m128 vinv = _mm_set1_ps(inv);
+    auto quantize4 = [vinv](const float *p) {
+        __m128 v = _mm_mul_ps(_mm_loadu_ps(p), vinv);
+        return _mm_cvtps_epi32(_mm_and_ps(v, _mm_cmpord_ps(v, v)));
+    };
+    for (; i + 16 <= n; i += 16) {
+        __m128i a = quantize4(src + i);
+        __m128i b = quantize4(src + i + 4);
+        __m128i c = quantize4(src + i + 8);
+        __m128i d = quantize4(src + i + 12);
+        __m128i packed = _mm_packs_epi16(_mm_packs_epi32(a, b), _mm_packs_epi32(c, d));
+        _mm_storeu_si128(reinterpret_cast<__m128i *>(dst + i), packed);
+    }
+#endif
+    for (; i < n; ++i) {
+        float q = std::nearbyint(src[i] * inv);
+        dst[i] = std::isnan(q) ? 0 : static_cast<int8_t>(std::min(127.0f, std::max(-127.0f, q)));
+    }
+    return scale;
+}
+
+void toFloat16(const float *src, size_t n, uint16_t *dst) {
+    size_t i = 0;
+#if defined(EMBEDDING_NEON) && defined(__aarch64__) && !defined(_MSC_VER)
+    for (; i + 4 <= n; i += 4) {
+        vst1_u16(dst + i, vreinterpret_u16_f16(vcvt_f16_f32(vld1q_f32(src + i))));
+    }
+#elif defined(__F16C__)
+    for (; i + 8 <= n; i += 8) {
+        __m128i half = _mm256_cvtps_ph(_mm256_loadu_ps(src + i), _MM_FROUND_TO_NEAREST_INT);
+        _mm_storeu_si128(reinterpret_cast<__m128i *>(dst + i), half);
+    }
+#endif
+    for (; i < n; ++i) dst[i] = floatToHalf(src[i]);
+}
+
+EmbeddingPooling parseEmbeddingPooling(const std::string &name) {
+    if (name.empty() || name == "none") return EmbeddingPooling::None;
+    if (name == "mean") return EmbeddingPooling::Mean;
+    throw std::runtime_error("Unknown pooling: " + name);
+}
+
+EmbeddingType parseEmbeddingType(const std::string &name) {
+    if (name.empty() || name == "float32") return EmbeddingType::Float32;
+    if (name == "float16") return EmbeddingType::Float16;
+    if (name == "int8")    return EmbeddingType::Int8;
+    throw std::runtime_error("Unknown embedding dtype: " + name);
+}
+
+void fromFloat16(const uint16_t *src, size_t n, float *dst) {
+    size_t i = 0;
+#if defined(EMBEDDING_NEON) && defined(__aarch64__) && !defined(_MSC_VER)
+    for (; i + 4 <= n; i += 4) {
+        vst1q_f32(dst + i, vcvt_f32_f16(vreinterpret_f16_u16(vld1_u16(src + i))));
+    }
+#elif defined(__F16C__)
+    for (; i + 8 <= n; i += 8) {
+        __m128i half = _mm_loadu_si128(reinterpret_cast<const __m128i *>(src + i));
+        _mm256_storeu_ps(dst + i, _mm256_cvtph_ps(half));
+    }
+#elif defined(EMBEDDING_SSE2)
+    for (; i + 8 <= n; i += 8) {
+        __m128i half = _mm_loadu_si128(reinterpret_cast<const __m128i *>(src + i));
+        __m128i zero = _mm_setzero_si128();
+        _mm_storeu_ps(dst + i, halfToFloat4(_mm_unpacklo_epi16(half, zero)));
+        _mm_storeu_ps(dst + i + 4, halfToFloat4(_mm_unpackhi_epi16(half, zero)));
+    }
+#endif
+    for (; i < n; ++i) dst[i] = halfToFloat(src[i]);
+}
+
+void fromInt8(const int8_t *src, size_t n, float scale, float *dst) {
+    size_t i = 0;
+#if defined(EMBEDDING_NEON)
+    for (; i + 16 <= n; i += 16) {
+        float32x4_t v[4];
+        int8ToFloat16x(vld1q_s8(src + i), v);
+        for (int j = 0; j < 4; ++j) vst1q_f32(dst + i + 4 * j, vmulq_n_f32(v[j], scale));
+    }
+#elif defined(EMBEDDING_SSE2)
+    __m128 vscale = _mm_set1_ps(scale);
+    for (; i + 16 <= n; i += 16) {
+        __m128 v[4];
+        int8ToFloat16x(_mm_loadu_si128(reinterpret_cast<const __m128i *>(src + i)), v);
+        for (int j = 0; j < 4; ++j) _mm_storeu_ps(dst + i + 4 * j, _mm_mul_ps(v[j], vscale));
+    }
+#endif
+    for (; i < n; ++i) dst[i] = src[i] * scale;
+}
+
+float dotF32(const float *a, const float *b, size_t n) {
+    float sum = 0.0f;
+    size_t i = 0;
+#if defined(EMBEDDING_NEON)
+    float32x4_t acc0 = vdupq_n_f32(0.0f), acc1 = vdupq_n_f32(0.0f);
+    for (; i + 8 <= n; i += 8) {
+        acc0 = vmlaq_f32(acc0, vld1q_f32(a + i), vld1q_f32(b + i));
+        acc1 = vmlaq_f32(acc1, vld1q_f32(a + i + 4), vld1q_f32(b + i + 4));
+    }
+    sum = horizontalSum(vaddq_f32(acc0, acc1));
+#elif defined(__AVX2__)
+    __m256 acc = _mm256_setzero_ps();
+    for (; i + 8 <= n; i += 8) {
+        acc = _mm256_add_ps(acc, _mm256_mul_ps(_mm256_loadu_ps(a + i), _mm256_loadu_ps(b + i)));
+    }
+    sum = horizontalSum(_mm_add_ps(_mm256_castps256_ps128(acc), _mm256_extractf128_ps(acc, 1)));
+#elif defined(EMBEDDING_SSE2)
+    __m128 acc0 = _mm_setzero_ps(), acc1 = _mm_setzero_ps();
+    for (; i + 8 <= n; i += 8) {
+        acc0 = _mm_add_ps(acc0, _mm_mul_ps(_mm_loadu_ps(a + i), _mm_loadu_ps(b + i)));
+        acc1 = _mm_add_ps(acc1, _mm_mul_ps(_mm_loadu_ps(a + i + 4), _mm_loadu_ps(b + i + 4)));
+    }
+    sum = horizontalSum(_mm_add_ps(acc0, acc1));
+#endif
+    for (; i < n; ++i) sum += a[i] * b[i];
+    return sum;
+}
+
+float dotF16(const float *a, const uint16_t *b, size_t n) {
+    float sum = 0.0f;
+    size_t i = 0;
+#if defined(EMBEDDING_NEON) && defined(__aarch64__) && !defined(_MSC_VER)
+    float32x4_t acc = vdupq_n_f32(0.0f);
+    for (; i + 4 <= n; i += 4) {
+        acc = vmlaq_f32(acc, vld1q_f32(a + i), vcvt_f32_f16(vreinterpret_f16_u16(vld1_u16(b + i))));
+    }
+    sum = horizontalSum(acc);
+#elif defined(__F16C__)
+    __m256 acc = _mm256_setzero_ps();
+    for (; i + 8 <= n; i += 8) {
+        __m256 v = _mm256_cvtph_ps(_mm_loadu_si128(reinterpret_cast<const __m128i *>(b + i)));
+        acc = _mm256_add_ps(acc, _mm256_mul_ps(_mm256_loadu_ps(a + i), v));
+    }
+    sum = horizontalSum(_mm_add_ps(_mm256_castps256_ps128(acc), _mm256_extractf128_ps(acc, 1)));
+#elif defined(EMBEDDING_SSE2)
+    __m128 acc = _mm_setzero_ps();
+    __m128i zero = _mm_setzero_si128();
+    for (; i + 8 <= n; i += 8) {
+        __m128i half = _mm_loadu_si128(reinterpret_cast<const __m128i *>(b + i));
+        acc = _mm_add_ps(acc, _mm_mul_ps(_mm_loadu_ps(a + i), halfToFloat4(_mm_unpacklo_epi16(half, zero))));
+        acc = _mm_add_ps(acc, _mm_mul_ps(_mm_loadu_ps(a + i + 4), halfToFloat4(_mm_unpackhi_epi16(half, zero))));
+    }
+    sum = horizontalSum(acc);
+#endif
+    for (; i < n; ++i) sum += a[i] * halfToFloat(b[i]);
+    return sum;
+}
+
+float dotI8(const float *a, const int8_t *b, size_t n) {
+    float sum = 0.0f;
+    size_t i = 0;
+#if defined(EMBEDDING_NEON)
+    float32x4_t acc = vdupq_n_f32(0.0f);
+    for (; i + 16 <= n; i += 16) {
+        float32x4_t v[4];
+        int8ToFloat16x(vld1q_s8(b + i), v);
+        for (int j = 0; j < 4; ++j) acc = vmlaq_f32(acc, vld1q_f32(a + i + 4 * j), v[j]);
+    }
+    sum = horizontalSum(acc);
+#elif defined(EMBEDDING_SSE2)
+    __m128 acc = _mm_setzero_ps();
+    for (; i + 16 <= n; i += 16) {
+        __m128 v[4];
+        int8ToFloat16x(_mm_loadu_si128(reinterpret_cast<const __m128i *>(b + i)), v);
+        for (int j = 0; j < 4; ++j) acc = _mm_add_ps(acc, _mm_mul_ps(_mm_loadu_ps(a + i + 4 * j), v[j]));
+    }
+    sum = horizontalSum(acc);
+#endif
+    for (; i < n; ++i) sum += a[i] * b[i];
+    return sum;
+}
+
+size_t embeddingElementSize(EmbeddingType type) {
+    switch (type) {
+    case EmbeddingType::Float16: return 2;
+    case EmbeddingType::Int8:    return 1;
+    default:                     return 4;
+    }
+}
+
+size_t embeddingOutputLength(const uint32_t *dimensions, uint32_t rank,
+                             const EmbeddingOptions &options) {
+    if (rank == 0) return 0;
+    if (options.pooling == EmbeddingPooling::Mean) return dimensions[rank - 1];
+    size_t size = 1;
+    for (uint32_t i = 0; i < rank; ++i) size *= dimensions[i];
+    return size;
+}
+
+float convertEmbedding(const float *src, const uint32_t *dimensions, uint32_t rank,
+                       const EmbeddingOptions &options, uint8_t *dst,
+                       std::vector<float> &scratch) {
+    size_t length = embeddingOutputLength(dimensions, rank, options);
+    bool pool = options.pooling == EmbeddingPooling::Mean && rank > 1;
+    bool inPlace = options.type == EmbeddingType::Float32;
+    // Float32 results are built in dst, the rest go through scratch
+    float *values = inPlace ? reinterpret_cast<float *>(dst) : nullptr;
+    if (!inPlace && (pool || options.normalize)) {
+        scratch.resize(length);
+        values = scratch.data();
+    }
+    if (pool) {
+        size_t tokens = 1;
+        for (uint32_t i = 0; i + 1 < rank; ++i) tokens *= dimensions[i];
+        meanPool(src, tokens, length, values);
+    } else if (values) {
+        std::memcpy(values, src, length * sizeof(float));
+    }
+    if (options.normalize) l2Normalize(values, length);
+    const float *result = values ? values : src;
+    switch (options.type) {
+    case EmbeddingType::Int8:
+        return quantizeInt8(result, length, reinterpret_cast<int8_t *>(dst));
+    case EmbeddingType::Float16:
+        toFloat16(result, length, reinterpret_cast<uint16_t *>(dst));
+        return 1.0f;
+    default:
+        return 1.0f;
+    }
+}
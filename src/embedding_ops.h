@@ -0,0 +1,60 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <string>
+#include <vector>
+
+// -----------------------------------------------------------------------------
+// Post-processing of embedding outputs
+//
+// Kernels use NEON on ARM, AVX2 / SSE2 on x86 (whichever the compiler targets)
+// and fall back to scalar loops elsewhere.
+// -----------------------------------------------------------------------------
+
+enum class EmbeddingPooling {
+    None,  // Keep the tensor as is (flattened)
+    Mean,  // Average over tokens: [..., tokens, dim] -> [dim]
+};
+
+enum class EmbeddingType {
+    Float32,
+    Float16,  // IEEE half precision bits, round to nearest even
+    Int8,     // Symmetric per-vector scale: value = int8 * scale
+};
+
+struct EmbeddingOptions {
+    EmbeddingPooling pooling   = EmbeddingPooling::None;
+    bool             normalize = false;  // L2, after pooling
+    EmbeddingType    type      = EmbeddingType::Float32;
+};
+
+// Throws std::runtime_error on unknown names
+EmbeddingPooling parseEmbeddingPooling(const std::string &name);  // none, mean
+EmbeddingType    parseEmbeddingType(const std::string &name);     // float32, float16, int8
+
+size_t embeddingElementSize(EmbeddingType type);
+
+// Elements produced for a Genie output of the given shape
+size_t embeddingOutputLength(const uint32_t *dimensions, uint32_t rank,
+                             const EmbeddingOptions &options);
+
+// Applies options to src (shape dimensions) and writes
+// embeddingOutputLength() elements of options.type to dst. Returns the int8
+// scale, 1 for other types. scratch holds intermediate floats between calls.
+float convertEmbedding(const float *src, const uint32_t *dimensions, uint32_t rank,
+                       const EmbeddingOptions &options, uint8_t *dst,
+                       std::vector<float> &scratch);
+
+// Kernels
+void  meanPool(const float *src, size_t tokens, size_t dim, float *dst);
+void  l2Normalize(float *data, size_t n);
+float quantizeInt8(const float *src, size_t n, int8_t *dst);
+void  toFloat16(const float *src, size_t n, uint16_t *dst);
+void  fromFloat16(const uint16_t *src, size_t n, float *dst);
+void  fromInt8(const int8_t *src, size_t n, float scale, float *dst);
+
+// Dot products of a float query with a stored row; int8 rows are unscaled
+float dotF32(const float *a, const float *b, size_t n);
+float dotF16(const float *a, const uint16_t *b, size_t n);
+float dotI8(const float *a, const int8_t *b, size_t n);
@@ -0,0 +1,257 @@
+#include "metrics.h"
+#include <algorithm>
+#include <cmath>
+#include <cstdio>
+#include <cstring>
+#include <mutex>
+
+namespace perf {
+
+namespace {
+
+std::mutex &registryMutex() {
+    static std::mutex mutex;
+    return mutex;
+}
+
+std::vector<const Metric *> &registry() {
+    static std::vector<const Metric *> metrics;
+    return metrics;
+}
+
+void atomicAdd(std::atomic<double> &target, double value) {
+    double current = target.load(std::memory_order_relaxed);
+    while (!target.compare_exchange_weak(current, current + value, std::memory_order_relaxed)) {
+    }
+}
+
+void appendNumber(std::string &out, double value) {
+    if (std::isinf(value)) {
+        out += value > 0 ? "+Inf" : "-Inf";
+        return;
+    }
+    char buf[32];
+    std::snprintf(buf, sizeof(buf), "%.17g", value);
+    out += buf;
+}
+
+void appendSample(std::string &out, const char *name, const char *suffix,
+                  const char *labels, const char *extraLabel, double value) {
+    out += name;
+    out += suffix;
+    bool hasLabels = labels[0] != '\0';
+    if (hasLabels || extraLabel) {
+        out += '{';
+        out += labels;
+        if (extraLabel) {
+            if (hasLabels) out += ',';
+            out += extraLabel;
+        }
+        out += '}';
+    }
+    out += ' ';
+    appendNumber(out, value);
+    out += '\n';
+}
+
+// Buckets for durations from milliseconds (queries) to minutes (unpack)
+const std::vector<double> SECONDS_BUCKETS = {
+    0.005, 0.01, 0.025, 0.05, 0.1, 0.25, 0.5, 1, 2.5, 5, 10, 30, 60, 120, 300, 600};
+
+// Sub-millisecond operations such as vector searches
+const std::vector<double> FAST_SECONDS_BUCKETS = {
+    0.0001, 0.00025, 0.0005, 0.001, 0.0025, 0.005, 0.01, 0.025, 0.05, 0.1, 0.25, 0.5, 1};
+
+// Same bounds as QueryMetrics::histogram, so per-query counts merge as is
+std::vector<double> tokenLatencyBuckets() {
+    std::vector<double> bounds;
+    for (size_t i = 0; i + 1 < QueryMetrics::HISTOGRAM_BUCKETS; i++) {
+        bounds.push_back(QueryMetrics::bucket_bound_ms(i) / 1000.0);
+    }
+    return bounds;
+}
+
+} // namespace
+
+Metric::Metric(const char *name, const char *help, const char *type, const char *labels)
+    : name_(name), help_(help), type_(type), labels_(labels) {
+    std::lock_guard<std::mutex> lock(registryMutex());
+    registry().push_back(this);
+}
+
+void Counter::render(std::string &out) const {
+    appendSample(out, name(), "", labels(), nullptr,
+                 static_cast<double>(value_.load(std::memory_order_relaxed)));
+}
+
+void FloatCounter::add(double value) { atomicAdd(value_, value); }
+
+void FloatCounter::render(std::string &out) const {
+    appendSample(out, name(), "", labels(), nullptr, value_.load(std::memory_order_relaxed));
+}
+
+void Gauge::render(std::string &out) const {
+    appendSample(out, name(), "", labels(), nullptr,
+                 static_cast<double>(value_.load(std::memory_order_relaxed)));
+}
+
+Histogram::Histogram(const char *name, const char *help, std::vector<double> bounds,
+                     const char *labels)
+    : Metric(name, help, "histogram", labels), bounds_(std::move(bounds)),
+      buckets_(new std::atomic<uint64_t>[bounds_.size() + 1]) {
+    for (size_t i = 0; i <= bounds_.size(); i++) {
+        buckets_[i].store(0, std::memory_order_relaxed);
+    }
+}
+
+void Histogram::observe(double value) {
+    size_t bucket = std::lower_bound(bounds_.begin(), bounds_.end(), value) - bounds_.begin();
+    buckets_[bucket].fetch_add(1, std::memory_order_relaxed);
+    count_.fetch_add(1, std::memory_order_relaxed);
+    atomicAdd(sum_, value);
+}
+
+void Histogram::observeBuckets(const uint32_t *counts, size_t n, double sum) {
+    uint64_t total = 0;
+    for (size_t i = 0; i < n && i <= bounds_.size(); i++) {
+        if (counts[i] == 0) continue;
+        buckets_[i].fetch_add(counts[i], std::memory_order_relaxed);
+        total += counts[i];
+    }
+    count_.fetch_add(total, std::memory_order_relaxed);
+    atomicAdd(sum_, sum);
+}
+
+void Histogram::render(std::string &out) const {
+    // Prometheus buckets are cumulative
+    uint64_t cumulative = 0;
+    char le[48];
+    for (size_t i = 0; i <= bounds_.size(); i++) {
+        cumulative += buckets_[i].load(std::memory_order_relaxed);
+        if (i < bounds_.size()) {
+            std::snprintf(le, sizeof(le), "le=\"%g\"", bounds_[i]);
+        } else {
+            std::strcpy(le, "le=\"+Inf\"");
+        }
+        appendSample(out, name(), "_bucket", labels(), le, static_cast<double>(cumulative));
+    }
+    appendSample(out, name(), "_sum", labels(), nullptr, sum_.load(std::memory_order_relaxed));
+    appendSample(out, name(), "_count", labels(), nullptr,
+                 static_cast<double>(count_.load(std::memory_order_relaxed)));
+}
+
+// -----------------------------------------------------------------------------
+// Addon metrics
+// -----------------------------------------------------------------------------
+
+static constexpr const char *UNPACK_HELP = "Bundle unpacks by result";
+Counter unpack_ok("qnn_llm_unpack_total", UNPACK_HELP, "result=\"ok\"");
+Counter unpack_cached("qnn_llm_unpack_total", UNPACK_HELP, "result=\"cached\"");
+Counter unpack_error("qnn_llm_unpack_total", UNPACK_HELP, "result=\"error\"");
+Counter unpack_written_bytes("qnn_llm_unpack_written_bytes_total",
+                             "Bytes written by bundle unpacks");
+Histogram unpack_duration("qnn_llm_unpack_duration_seconds",
+                          "Bundle unpack time, including cached unpacks", SECONDS_BUCKETS);
+
+static constexpr const char *LOAD_HELP = "Dialog and embedding instances created by result";
+Counter load_ok("qnn_llm_load_total", LOAD_HELP, "result=\"ok\"");
+Counter load_error("qnn_llm_load_total", LOAD_HELP, "result=\"error\"");
+Histogram load_duration("qnn_llm_load_duration_seconds",
+                        "Time to create a dialog or embedding instance", SECONDS_BUCKETS);
+Gauge dialogs("qnn_llm_dialogs", "Dialog instances currently loaded");
+Gauge embeddings("qnn_llm_embeddings", "Embedding instances currently loaded");
+
+static constexpr const char *QUERY_HELP = "Dialog queries by result";
+Counter queries_ok("qnn_llm_queries_total", QUERY_HELP, "result=\"ok\"");
+Counter queries_busy("qnn_llm_queries_total", QUERY_HELP, "result=\"busy\"");
+Counter queries_error("qnn_llm_queries_total", QUERY_HELP, "result=\"error\"");
+Histogram query_duration("qnn_llm_query_duration_seconds",
+                         "Dialog query time, prompt to last token", SECONDS_BUCKETS);
+Histogram query_ttft("qnn_llm_query_ttft_seconds", "Dialog time to first token",
+                     SECONDS_BUCKETS);
+Histogram token_latency("qnn_llm_token_latency_seconds",
+                        "Time between generated tokens", tokenLatencyBuckets());
+Counter generated_tokens("qnn_llm_generated_tokens_total", "Tokens generated by dialog queries");
+FloatCounter decode_seconds("qnn_llm_decode_seconds_total",
+                            "Time spent generating tokens after the first one");
+
+static constexpr const char *EMBEDDING_HELP = "Embedding queries by result";
+Counter embedding_queries_ok("qnn_llm_embedding_queries_total", EMBEDDING_HELP, "result=\"ok\"");
+Counter embedding_queries_error("qnn_llm_embedding_queries_total", EMBEDDING_HELP,
+                                "result=\"error\"");
+Histogram embedding_duration("qnn_llm_embedding_duration_seconds", "Embedding query time",
+                             SECONDS_BUCKETS);
+static constexpr const char *EMBEDDING_CACHE_HELP = "Embedding cache lookups by result";
+Counter embedding_cache_hits("qnn_llm_embedding_cache_lookups_total", EMBEDDING_CACHE_HELP,
+                             "result=\"hit\"");
+Counter embedding_cache_misses("qnn_llm_embedding_cache_lookups_total", EMBEDDING_CACHE_HELP,
+                               "result=\"miss\"");
+
+Counter vector_searches("qnn_llm_vector_searches_total", "Vector index searches");
+Counter vector_adds("qnn_llm_vector_added_total", "Rows added to vector indexes");
+Histogram vector_search_duration("qnn_llm_vector_search_duration_seconds",
+                                 "Vector index search time, including the query embedding",
+                                 FAST_SECONDS_BUCKETS);
+
+static constexpr const char *RELEASE_HELP = "Context, pool and embedding releases by result";
+Counter releases_ok("qnn_llm_releases_total", RELEASE_HELP, "result=\"ok\"");
+Counter releases_error("qnn_llm_releases_total", RELEASE_HELP, "result=\"error\"");
+Histogram release_duration("qnn_llm_release_duration_seconds", "Release time",
+                           SECONDS_BUCKETS);
+
+Gauge executor_jobs("qnn_llm_executor_jobs",
+                    "Jobs queued or running on per-instance executor threads");
+Gauge tsfn_pending("qnn_llm_tsfn_pending_calls",
+                   "Thread-safe function calls queued for the JS thread");
+
+void observeQuery(const QueryMetrics &metrics) {
+    queries_ok.inc();
+    query_duration.observe(metrics.total_ms / 1000.0);
+    if (metrics.tokens > 0) {
+        query_ttft.observe(metrics.ttft_ms / 1000.0);
+        generated_tokens.inc(metrics.tokens);
+        decode_seconds.add(metrics.decode_ms / 1000.0);
+        token_latency.observeBuckets(metrics.histogram, QueryMetrics::HISTOGRAM_BUCKETS,
+                                     metrics.decode_ms / 1000.0);
+    }
+}
+
+void observeQueryError(const std::string &message) {
+    if (message.find("is busy") != std::string::npos) {
+        queries_busy.inc();
+    } else {
+        queries_error.inc();
+    }
+}
+
+std::string render() {
+    std::vector<const Metric *> metrics;
+    {
+        std::lock_guard<std::mutex> lock(registryMutex());
+        metrics = registry();
+    }
+    // One HELP / TYPE block per name, label sets of a name kept together
+    std::stable_sort(metrics.begin(), metrics.end(), [](const Metric *a, const Metric *b) {
+        return std::strcmp(a->name(), b->name()) < 0;
+    });
+    std::string out;
+    const char *previous = nullptr;
+    for (const Metric *metric : metrics) {
+        if (!previous || std::strcmp(previous, metric->name()) != 0) {
+            out += "# HELP ";
+            out += metric->name();
+            out += ' ';
+            out += metric->help();
+            out += "\n# TYPE ";
+            out += metric->name();
+            out += ' ';
+            out += metric->type();
+            out += '\n';
+            previous = metric->name();
+        }
+        metric->render(out);
+    }
+    return out;
+}
+
+} // namespace perf
@@ -0,0 +1,153 @@
+#pragma once
+
+#include "QueryMetrics.h"
+#include <atomic>
+#include <chrono>
+#include <cstdint>
+#include <memory>
+#include <string>
+#include <vector>
+
+// -----------------------------------------------------------------------------
+// Process-wide performance counters
+//
+// Every metric registers itself on construction and is updated with relaxed
+// atomics only, so workers can record from any thread without locking.
+// render() writes all of them in the Prometheus text exposition format.
+// -----------------------------------------------------------------------------
+
+namespace perf {
+
+class Metric {
+public:
+    // labels is the rendered label set without braces, e.g. result="ok"
+    Metric(const char *name, const char *help, const char *type, const char *labels);
+    virtual ~Metric() = default;
+
+    const char *name() const { return name_; }
+    const char *help() const { return help_; }
+    const char *type() const { return type_; }
+    const char *labels() const { return labels_; }
+    virtual void render(std::string &out) const = 0;
+
+private:
+    const char *name_;
+    const char *help_;
+    const char *type_;
+    const char *labels_;
+};
+
+class Counter : public Metric {
+public:
+    Counter(const char *name, const char *help, const char *labels = "")
+        : Metric(name, help, "counter", labels) {}
+
+    void inc(uint64_t n = 1) { value_.fetch_add(n, std::memory_order_relaxed); }
+    void render(std::string &out) const override;
+
+private:
+    std::atomic<uint64_t> value_{0};
+};
+
+// Counter of fractional amounts, e.g. seconds spent
+class FloatCounter : public Metric {
+public:
+    FloatCounter(const char *name, const char *help, const char *labels = "")
+        : Metric(name, help, "counter", labels) {}
+
+    void add(double value);
+    void render(std::string &out) const override;
+
+private:
+    std::atomic<double> value_{0};
+};
+
+class Gauge : public Metric {
+public:
+    Gauge(const char *name, const char *help, const char *labels = "")
+        : Metric(name, help, "gauge", labels) {}
+
+    void add(int64_t n) { value_.fetch_add(n, std::memory_order_relaxed); }
+    void inc() { add(1); }
+    void dec() { add(-1); }
+    void render(std::string &out) const override;
+
+private:
+    std::atomic<int64_t> value_{0};
+};
+
+class Histogram : public Metric {
+public:
+    // bounds are the ascending bucket upper bounds, +Inf is implied
+    Histogram(const char *name, const char *help, std::vector<double> bounds,
+              const char *labels = "");
+
+    void observe(double value);
+    // Merges pre-bucketed observations; counts has one entry per bound plus
+    // the overflow bucket
+    void observeBuckets(const uint32_t *counts, size_t n, double sum);
+    void render(std::string &out) const override;
+
+private:
+    std::vector<double> bounds_;
+    std::unique_ptr<std::atomic<uint64_t>[]> buckets_;
+    std::atomic<uint64_t> count_{0};
+    std::atomic<double> sum_{0};
+};
+
+// Seconds since start, for duration histograms
+inline double secondsSince(std::chrono::steady_clock::time_point start) {
+    return std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+}
+
+// -----------------------------------------------------------------------------
+// Addon metrics
+// -----------------------------------------------------------------------------
+
+extern Counter   unpack_ok;
+extern Counter   unpack_cached;
+extern Counter   unpack_error;
+extern Counter   unpack_written_bytes;
+extern Histogram unpack_duration;
+
+extern Counter   load_ok;
+extern Counter   load_error;
+extern Histogram load_duration;
+extern Gauge     dialogs;
+extern Gauge     embeddings;
+
+extern Counter      queries_ok;
+extern Counter      queries_busy;
+extern Counter      queries_error;
+extern Histogram    query_duration;
+extern Histogram    query_ttft;
+extern Histogram    token_latency;
+extern Counter      generated_tokens;
+extern FloatCounter decode_seconds;
+
+extern Counter   embedding_queries_ok;
+extern Counter   embedding_queries_error;
+extern Histogram embedding_duration;
+extern Counter   embedding_cache_hits;
+extern Counter   embedding_cache_misses;
+
+extern Counter   vector_searches;
+extern Counter   vector_adds;
+extern Histogram vector_search_duration;
+
+extern Counter   releases_ok;
+extern Counter   releases_error;
+extern Histogram release_duration;
+
+extern Gauge     executor_jobs;
+extern Gauge     tsfn_pending;
+
+// Records a finished query from its native metrics
+void observeQuery(const QueryMetrics &metrics);
+
+// Counts a failed query, telling "busy" rejections apart
+void observeQueryError(const std::string &message);
+
+std::string render();
+
+} // namespace perf
@@ -0,0 +1,363 @@
+#include "session.h"
+#include "trace.h"
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <cstring>
+#include <filesystem>
+#include <fstream>
+#include <stdexcept>
+#include <thread>
+#include <vector>
+#include <zstd.h>
+#include <zlib.h>
+
+namespace fs = std::filesystem;
+static constexpr size_t IO_BUFFER_SIZE = 1 << 20;  // 1 MiB
+static constexpr size_t HEADER_SIZE = 10;
+static constexpr size_t FOOTER_SIZE = 12;
+
+namespace {
+
+struct SessionFile {
+    std::string name;
+    uint64_t    size;
+    uint32_t    crc32;
+};
+
+template<typename T>
+void appendLE(std::vector<uint8_t> &out, T value) {
+    uint8_t bytes[sizeof(T)];
+    std::memcpy(bytes, &value, sizeof(T));
+    out.insert(out.end(), bytes, bytes + sizeof(T));
+}
+
+template<typename T>
+T readLE(const uint8_t *ptr) {
+    T val;
+    std::memcpy(&val, ptr, sizeof(T));
+    return val;
+}
+
+double msSince(std::chrono::steady_clock::time_point start) {
+    return std::chrono::duration<double, std::milli>(
+        std::chrono::steady_clock::now() - start).count();
+}
+
+// Tracks the whole-file CRC of everything written or read
+class CheckedFile {
+public:
+    CheckedFile(const std::string &path, bool write)
+        : stream_(path, std::ios::binary | (write ? std::ios::out | std::ios::trunc : std::ios::in)),
+          crc_(crc32(0, nullptr, 0)) {
+        if (!stream_) {
+            throw std::runtime_error("Failed to open session file: " + path);
+        }
+    }
+
+    void write(const uint8_t *data, size_t size) {
+        stream_.write(reinterpret_cast<const char *>(data), size);
+        if (!stream_) throw std::runtime_error("Failed to write session file");
+        crc_ = crc32(crc_, data, static_cast<uInt>(size));
+        bytes_ += size;
+    }
+
+    size_t read(uint8_t *data, size_t size) {
+        stream_.read(reinterpret_cast<char *>(data), size);
+        size_t got = static_cast<size_t>(stream_.gcount());
+        crc_ = crc32(crc_, data, static_cast<uInt>(got));
+        bytes_ += got;
+        return got;
+    }
+
+    void readExact(uint8_t *data, size_t size) {
+        if (read(data, size) != size) throw std::runtime_error("Truncated session file");
+    }
+
+    // Reads outside the checksummed stream (footer, early table lookup)
+    void peek(uint64_t offset, uint8_t *data, size_t size) {
+        std::streampos pos = stream_.tellg();
+        stream_.seekg(static_cast<std::streamoff>(offset));
+        stream_.read(reinterpret_cast<char *>(data), size);
+        if (static_cast<size_t>(stream_.gcount()) != size) {
+            throw std::runtime_error("Truncated session file");
+        }
+        stream_.clear();
+        stream_.seekg(pos);
+    }
+
+    void flush() {
+        stream_.flush();
+        if (!stream_) throw std::runtime_error("Failed to write session file");
+    }
+
+    uint32_t crc() const { return crc_; }
+    uint64_t bytes() const { return bytes_; }
+
+private:
+    std::fstream stream_;
+    uint32_t     crc_;
+    uint64_t     bytes_ = 0;
+};
+
+std::vector<SessionFile> listSession(const std::string &sessionPath, uint8_t &layout) {
+    std::vector<SessionFile> files;
+    std::error_code ec;
+    if (!fs::is_directory(sessionPath, ec)) {
+        layout = SESSION_LAYOUT_FILE;
+        uint64_t size = fs::file_size(sessionPath, ec);
+        if (ec) throw std::runtime_error("Session not found: " + sessionPath);
+        files.push_back({"", size, 0});
+        return files;
+    }
+    layout = SESSION_LAYOUT_DIRECTORY;
+    for (auto it = fs::recursive_directory_iterator(sessionPath); it != fs::recursive_directory_iterator(); ++it) {
+        if (!it->is_regular_file()) continue;
+        std::string name = fs::relative(it->path(), sessionPath).generic_string();
+        if (name.size() > UINT16_MAX) throw std::runtime_error("Session file name too long");
+        files.push_back({name, static_cast<uint64_t>(it->file_size()), 0});
+    }
+    // Stable order keeps packed files of equal sessions identical
+    std::sort(files.begin(), files.end(),
+              [](const SessionFile &a, const SessionFile &b) { return a.name < b.name; });
+    return files;
+}
+
+fs::path outputPath(const std::string &sessionPath, const std::string &name) {
+    if (name.empty()) return fs::path(sessionPath);
+    fs::path rel = fs::path(name).lexically_normal();
+    if (rel.is_absolute() || rel.empty() || *rel.begin() == "..") {
+        throw std::runtime_error("Invalid session file name: " + name);
+    }
+    return fs::path(sessionPath) / rel;
+}
+
+} // namespace
+
+bool isPackedSession(const std::string &path) {
+    std::ifstream in(path, std::ios::binary);
+    char magic[sizeof(SESSION_MAGIC)];
+    return in.read(magic, sizeof(magic)) &&
+           std::memcmp(magic, SESSION_MAGIC, sizeof(SESSION_MAGIC)) == 0;
+}
+
+uint64_t sessionSize(const std::string &path) {
+    std::error_code ec;
+    if (!fs::is_directory(path, ec)) {
+        uint64_t size = fs::file_size(path, ec);
+        return ec ? 0 : size;
+    }
+    uint64_t size = 0;
+    for (auto it = fs::recursive_directory_iterator(path, ec);
+         !ec && it != fs::recursive_directory_iterator(); it.increment(ec)) {
+        if (it->is_regular_file(ec)) {
+            size += it->file_size(ec);
+        }
+    }
+    return size;
+}
+
+std::string sessionScratchPath(const std::string &path) {
+    static std::atomic<uint64_t> counter{0};
+    fs::path target(path);
+    std::string name = "." + target.filename().string() + ".raw-" + std::to_string(counter++);
+    return (target.parent_path() / name).string();
+}
+
+void packSession(const std::string &sessionPath, const std::string &filePath,
+                 int level, SessionStats &stats) {
+    trace::Span span("pack_session", filePath);
+    auto start = std::chrono::steady_clock::now();
+    uint8_t layout;
+    std::vector<SessionFile> files = listSession(sessionPath, layout);
+
+    std::unique_ptr<ZSTD_CCtx, size_t (*)(ZSTD_CCtx *)> cctx(ZSTD_createCCtx(), ZSTD_freeCCtx);
+    if (!cctx) throw std::runtime_error("Failed to create zstd context");
+    ZSTD_CCtx_setParameter(cctx.get(), ZSTD_c_compressionLevel, level);
+    ZSTD_CCtx_setParameter(cctx.get(), ZSTD_c_checksumFlag, 0);
+    // Uses zstd's worker threads when the library is built with them
+    unsigned workers = std::min(4u, std::max(1u, std::thread::hardware_concurrency() / 2));
+    ZSTD_CCtx_setParameter(cctx.get(), ZSTD_c_nbWorkers, static_cast<int>(workers));
+
+    CheckedFile out(filePath, true);
+    std::vector<uint8_t> header(SESSION_MAGIC, SESSION_MAGIC + sizeof(SESSION_MAGIC));
+    appendLE<uint16_t>(header, SESSION_VERSION);
+    header.push_back(layout);
+    header.push_back(0);
+    out.write(header.data(), header.size());
+
+    std::vector<uint8_t> inBuf(IO_BUFFER_SIZE);
+    std::vector<uint8_t> outBuf(ZSTD_CStreamOutSize());
+    auto drain = [&](ZSTD_inBuffer &input, ZSTD_EndDirective mode) {
+        bool finished = false;
+        while (!finished) {
+            ZSTD_outBuffer output = {outBuf.data(), outBuf.size(), 0};
+            size_t remaining = ZSTD_compressStream2(cctx.get(), &output, &input, mode);
+            if (ZSTD_isError(remaining)) {
+                throw std::runtime_error(std::string("zstd: ") + ZSTD_getErrorName(remaining));
+            }
+            out.write(outBuf.data(), output.pos);
+            finished = mode == ZSTD_e_end ? remaining == 0 : input.pos == input.size;
+        }
+    };
+
+    for (SessionFile &file : files) {
+        std::ifstream in(outputPath(sessionPath, file.name), std::ios::binary);
+        if (!in) throw std::runtime_error("Failed to read session file: " + file.name);
+        file.crc32 = crc32(0, nullptr, 0);
+        uint64_t left = file.size;
+        while (left > 0) {
+            size_t chunk = static_cast<size_t>(std::min<uint64_t>(left, inBuf.size()));
+            in.read(reinterpret_cast<char *>(inBuf.data()), chunk);
+            if (static_cast<size_t>(in.gcount()) != chunk) {
+                throw std::runtime_error("Session file changed while packing: " + file.name);
+            }
+            file.crc32 = crc32(file.crc32, inBuf.data(), static_cast<uInt>(chunk));
+            ZSTD_inBuffer input = {inBuf.data(), chunk, 0};
+            drain(input, ZSTD_e_continue);
+            left -= chunk;
+        }
+        stats.raw_bytes += file.size;
+    }
+    ZSTD_inBuffer empty = {nullptr, 0, 0};
+    drain(empty, ZSTD_e_end);
+
+    uint64_t tableOffset = out.bytes();
+    std::vector<uint8_t> table;
+    appendLE<uint32_t>(table, static_cast<uint32_t>(files.size()));
+    for (const SessionFile &file : files) {
+        appendLE<uint16_t>(table, static_cast<uint16_t>(file.name.size()));
+        table.insert(table.end(), file.name.begin(), file.name.end());
+        appendLE<uint64_t>(table, file.size);
+        appendLE<uint32_t>(table, file.crc32);
+    }
+    out.write(table.data(), table.size());
+
+    std::vector<uint8_t> footer;
+    appendLE<uint64_t>(footer, tableOffset);
+    appendLE<uint32_t>(footer, out.crc());
+    out.write(footer.data(), footer.size());
+    out.flush();
+    stats.file_bytes = out.bytes();
+    stats.pack_ms = msSince(start);
+}
+
+void unpackSession(const std::string &filePath, const std::string &sessionPath,
+                   SessionStats &stats) {
+    trace::Span span("unpack_session", filePath);
+    auto start = std::chrono::steady_clock::now();
+    uint64_t fileSize = fs::file_size(filePath);
+    if (fileSize < HEADER_SIZE + FOOTER_SIZE) throw std::runtime_error("Invalid session file");
+    CheckedFile in(filePath, false);
+
+    uint8_t header[HEADER_SIZE];
+    in.readExact(header, sizeof(header));
+    if (std::memcmp(header, SESSION_MAGIC, sizeof(SESSION_MAGIC)) != 0) {
+        throw std::runtime_error("Invalid session file");
+    }
+    uint16_t version = readLE<uint16_t>(header + 6);
+    uint8_t layout = header[8];
+    if (version == 0 || version > SESSION_VERSION) {
+        throw std::runtime_error("Unsupported session version " + std::to_string(version));
+    }
+
+    // The table is needed first to route the stream, it is checksummed later
+    uint8_t footer[FOOTER_SIZE];
+    in.peek(fileSize - FOOTER_SIZE, footer, sizeof(footer));
+    uint64_t tableOffset = readLE<uint64_t>(footer);
+    uint32_t expectedCrc = readLE<uint32_t>(footer + 8);
+    if (tableOffset < HEADER_SIZE || tableOffset > fileSize - FOOTER_SIZE) {
+        throw std::runtime_error("Invalid session file");
+    }
+    std::vector<uint8_t> table(fileSize - FOOTER_SIZE - tableOffset);
+    in.peek(tableOffset, table.data(), table.size());
+
+    std::vector<SessionFile> files;
+    size_t ptr = 0;
+    auto need = [&](size_t n) {
+        if (table.size() - ptr < n) throw std::runtime_error("Invalid session table");
+    };
+    need(4);
+    uint32_t count = readLE<uint32_t>(table.data()); ptr += 4;
+    for (uint32_t i = 0; i < count; i++) {
+        need(2);
+        uint16_t nameLen = readLE<uint16_t>(table.data() + ptr); ptr += 2;
+        need(nameLen + 12);
+        std::string name(reinterpret_cast<const char *>(table.data() + ptr), nameLen); ptr += nameLen;
+        uint64_t size = readLE<uint64_t>(table.data() + ptr); ptr += 8;
+        uint32_t crc  = readLE<uint32_t>(table.data() + ptr); ptr += 4;
+        files.push_back({name, size, crc});
+    }
+    if ((layout == SESSION_LAYOUT_FILE) != (files.size() == 1 && files[0].name.empty())) {
+        throw std::runtime_error("Invalid session table");
+    }
+
+    std::error_code ec;
+    fs::remove_all(sessionPath, ec);
+    if (layout == SESSION_LAYOUT_DIRECTORY) fs::create_directories(sessionPath);
+
+    std::unique_ptr<ZSTD_DCtx, size_t (*)(ZSTD_DCtx *)> dctx(ZSTD_createDCtx(), ZSTD_freeDCtx);
+    if (!dctx) throw std::runtime_error("Failed to create zstd context");
+
+    size_t current = 0;
+    std::ofstream out;
+    uint64_t left = 0;
+    uint32_t crc = 0;
+    // Opens the next file, finishing (and verifying) the previous one
+    auto advance = [&]() {
+        while (left == 0) {
+            if (out.is_open()) {
+                out.close();
+                if (!out || crc != files[current].crc32) {
+                    throw std::runtime_error("Session checksum mismatch: " + files[current].name);
+                }
+                current++;
+            }
+            if (current >= files.size()) return false;
+            fs::path path = outputPath(sessionPath, files[current].name);
+            if (path.has_parent_path()) fs::create_directories(path.parent_path());
+            out.open(path, std::ios::binary | std::ios::trunc);
+            if (!out) throw std::runtime_error("Failed to write session file: " + path.string());
+            left = files[current].size;
+            crc = crc32(0, nullptr, 0);
+        }
+        return true;
+    };
+
+    std::vector<uint8_t> inBuf(ZSTD_DStreamInSize());
+    std::vector<uint8_t> outBuf(ZSTD_DStreamOutSize());
+    uint64_t compLeft = tableOffset - HEADER_SIZE;
+    size_t ret = 1;
+    while (compLeft > 0) {
+        size_t chunk = static_cast<size_t>(std::min<uint64_t>(compLeft, inBuf.size()));
+        in.readExact(inBuf.data(), chunk);
+        compLeft -= chunk;
+        ZSTD_inBuffer input = {inBuf.data(), chunk, 0};
+        while (input.pos < input.size) {
+            ZSTD_outBuffer output = {outBuf.data(), outBuf.size(), 0};
+            ret = ZSTD_decompressStream(dctx.get(), &output, &input);
+            if (ZSTD_isError(ret)) {
+                throw std::runtime_error(std::string("zstd: ") + ZSTD_getErrorName(ret));
+            }
+            size_t pos = 0;
+            while (pos < output.pos) {
+                if (!advance()) throw std::runtime_error("Session data exceeds its table");
+                size_t n = static_cast<size_t>(std::min<uint64_t>(left, output.pos - pos));
+                out.write(reinterpret_cast<const char *>(outBuf.data() + pos), n);
+                crc = crc32(crc, outBuf.data() + pos, static_cast<uInt>(n));
+                left -= n;
+                pos += n;
+                stats.raw_bytes += n;
+            }
+        }
+    }
+    if (ret != 0) throw std::runtime_error("Truncated session data");
+    // Closes the last file and creates trailing empty ones
+    if (advance()) throw std::runtime_error("Truncated session data");
+
+    // Feeds the table through the whole-file checksum as well
+    in.readExact(table.data(), table.size());
+    if (in.crc() != expectedCrc) throw std::runtime_error("Session checksum mismatch");
+    stats.file_bytes = fileSize;
+    stats.pack_ms = msSince(start);
+}
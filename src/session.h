@@ -0,0 +1,49 @@
+#pragma once
+
+#include <cstdint>
+#include <string>
+
+// -----------------------------------------------------------------------------
+// Packed session snapshots
+//
+// GenieDialog_save writes a file or a directory of raw KV state. A packed
+// session stores all of it as one zstd stream in a single file:
+//
+//   header   magic "QSESS1", u16 version, u8 layout, u8 reserved
+//   data     one zstd stream with every file concatenated in table order
+//   table    u32 count, then per file: u16 name length, name (relative path,
+//            '/' separated, empty for a single-file session), u64 size,
+//            u32 CRC32 of the raw bytes
+//   footer   u64 table offset, u32 CRC32 of everything before the footer
+// -----------------------------------------------------------------------------
+
+static constexpr char SESSION_MAGIC[6] = {'Q','S','E','S','S','1'};
+static constexpr uint16_t SESSION_VERSION = 1;
+
+static constexpr uint8_t SESSION_LAYOUT_FILE      = 0;
+static constexpr uint8_t SESSION_LAYOUT_DIRECTORY = 1;
+
+struct SessionStats {
+    uint64_t raw_bytes  = 0;  // Size of the Genie session output
+    uint64_t file_bytes = 0;  // Size of the packed file
+    double   genie_ms   = 0;  // GenieDialog_save / GenieDialog_restore
+    double   pack_ms    = 0;  // Compression or decompression
+};
+
+// Packs the Genie session at sessionPath into filePath
+void packSession(const std::string &sessionPath, const std::string &filePath,
+                 int level, SessionStats &stats);
+
+// Streams a packed session back out to sessionPath, verifying every checksum
+void unpackSession(const std::string &filePath, const std::string &sessionPath,
+                   SessionStats &stats);
+
+bool isPackedSession(const std::string &path);
+
+// Total size of a session, which is a file or a directory depending on the
+// Genie version
+uint64_t sessionSize(const std::string &path);
+
+// Hidden path next to path, unique within the process: the raw Genie session
+// while packing, or a file about to replace path
+std::string sessionScratchPath(const std::string &path);
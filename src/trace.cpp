@@ -0,0 +1,240 @@
+#include "trace.h"
+#include <chrono>
+#include <cstdio>
+#include <fstream>
+#include <memory>
+#include <mutex>
+#include <stdexcept>
+#include <vector>
+#ifdef _WIN32
+#include <process.h>
+#define getpid _getpid
+#else
+#include <unistd.h>
+#endif
+
+namespace trace {
+
+std::atomic<bool> active{false};
+
+namespace {
+
+struct Event {
+    const char *name;
+    uint64_t    start;
+    uint64_t    end;
+    std::string detail;
+};
+
+// Chunks are allocated as a thread records, up to 256K events per thread
+static constexpr size_t CHUNK_EVENTS = 1024;
+static constexpr size_t MAX_CHUNKS   = 256;
+
+struct Chunk {
+    Event events[CHUNK_EVENTS];
+};
+
+// Written only by its thread; count is published with release so stop() can
+// read the events below it while the thread keeps running
+struct ThreadBuffer {
+    uint32_t                 tid = 0;
+    std::atomic<const char*> name{nullptr};
+    std::atomic<uint64_t>    generation{0};
+    std::atomic<size_t>      count{0};
+    std::atomic<uint64_t>    dropped{0};
+    std::atomic<Chunk*>      chunks[MAX_CHUNKS] = {};
+
+    ~ThreadBuffer() {
+        for (auto &chunk : chunks) delete chunk.load();
+    }
+};
+
+std::mutex registryMutex;
+// A buffer stays registered after its thread exits while a trace is running,
+// until stop() has written it
+std::vector<std::unique_ptr<ThreadBuffer>> buffers;
+std::vector<const ThreadBuffer*> exited;
+std::atomic<uint64_t> generation{0};
+uint64_t origin = 0;
+uint32_t nextTid = 0;
+
+// Called with registryMutex held
+void removeBuffer(const ThreadBuffer *buffer) {
+    for (auto it = buffers.begin(); it != buffers.end(); ++it) {
+        if (it->get() == buffer) {
+            buffers.erase(it);
+            break;
+        }
+    }
+}
+
+void releaseBuffer(ThreadBuffer *buffer) {
+    std::lock_guard<std::mutex> lock(registryMutex);
+    if (active.load(std::memory_order_relaxed)) {
+        exited.push_back(buffer);
+    } else {
+        removeBuffer(buffer);
+    }
+}
+
+// Hands the buffer back when its thread exits
+struct LocalBuffer {
+    ThreadBuffer *buffer = nullptr;
+    ~LocalBuffer() {
+        if (buffer) releaseBuffer(buffer);
+    }
+};
+
+thread_local const char *threadName = nullptr;
+thread_local LocalBuffer threadBuffer;
+
+// Created on the first event, threads that never record cost nothing
+ThreadBuffer &localBuffer() {
+    if (!threadBuffer.buffer) {
+        std::lock_guard<std::mutex> lock(registryMutex);
+        buffers.push_back(std::make_unique<ThreadBuffer>());
+        threadBuffer.buffer = buffers.back().get();
+        threadBuffer.buffer->tid = ++nextTid;
+        threadBuffer.buffer->name.store(threadName, std::memory_order_relaxed);
+    }
+    return *threadBuffer.buffer;
+}
+
+void appendEscaped(std::string &out, const char *text) {
+    for (const char *c = text; *c; ++c) {
+        switch (*c) {
+        case '"':  out += "\\\""; break;
+        case '\\': out += "\\\\"; break;
+        case '\n': out += "\\n"; break;
+        case '\t': out += "\\t"; break;
+        default:
+            if (static_cast<unsigned char>(*c) < 0x20) {
+                char buf[8];
+                std::snprintf(buf, sizeof(buf), "\\u%04x", *c);
+                out += buf;
+            } else {
+                out += *c;
+            }
+        }
+    }
+}
+
+void appendMicros(std::string &out, uint64_t ns) {
+    char buf[32];
+    std::snprintf(buf, sizeof(buf), "%.3f", ns / 1000.0);
+    out += buf;
+}
+
+} // namespace
+
+uint64_t now() {
+    return std::chrono::duration_cast<std::chrono::nanoseconds>(
+        std::chrono::steady_clock::now().time_since_epoch()).count();
+}
+
+void start() {
+    std::lock_guard<std::mutex> lock(registryMutex);
+    origin = now();
+    // Buffers reset themselves on their next event
+    generation.fetch_add(1, std::memory_order_release);
+    active.store(true, std::memory_order_release);
+}
+
+void setThreadName(const char *name) {
+    threadName = name;
+    if (threadBuffer.buffer) threadBuffer.buffer->name.store(name, std::memory_order_relaxed);
+}
+
+void complete(const char *name, uint64_t start_ns, uint64_t end_ns, const std::string &detail) {
+    // A span that ends after stop() is dropped
+    if (!enabled()) return;
+    ThreadBuffer &buffer = localBuffer();
+    uint64_t current = generation.load(std::memory_order_acquire);
+    if (buffer.generation.load(std::memory_order_relaxed) != current) {
+        buffer.count.store(0, std::memory_order_relaxed);
+        buffer.dropped.store(0, std::memory_order_relaxed);
+        buffer.generation.store(current, std::memory_order_relaxed);
+    }
+    size_t index = buffer.count.load(std::memory_order_relaxed);
+    if (index >= CHUNK_EVENTS * MAX_CHUNKS) {
+        buffer.dropped.fetch_add(1, std::memory_order_relaxed);
+        return;
+    }
+    std::atomic<Chunk*> &slot = buffer.chunks[index / CHUNK_EVENTS];
+    Chunk *chunk = slot.load(std::memory_order_relaxed);
+    if (!chunk) {
+        chunk = new Chunk();
+        slot.store(chunk, std::memory_order_release);
+    }
+    Event &event = chunk->events[index % CHUNK_EVENTS];
+    event.name   = name;
+    event.start  = start_ns;
+    event.end    = end_ns;
+    event.detail = detail;
+    buffer.count.store(index + 1, std::memory_order_release);
+}
+
+size_t stop(const std::string &path) {
+    std::lock_guard<std::mutex> lock(registryMutex);
+    active.store(false, std::memory_order_release);
+    uint64_t current = generation.load(std::memory_order_acquire);
+    long pid = static_cast<long>(getpid());
+
+    std::string out = "{\"displayTimeUnit\":\"ms\",\"traceEvents\":[\n";
+    size_t events = 0;
+    uint64_t dropped = 0;
+    char head[96];
+    for (const auto &buffer : buffers) {
+        const char *name = buffer->name.load(std::memory_order_relaxed);
+        if (name) {
+            std::snprintf(head, sizeof(head),
+                          "{\"ph\":\"M\",\"name\":\"thread_name\",\"pid\":%ld,\"tid\":%u,\"args\":{\"name\":\"",
+                          pid, buffer->tid);
+            out += head;
+            appendEscaped(out, name);
+            out += "\"}},\n";
+        }
+        if (buffer->generation.load(std::memory_order_relaxed) != current) continue;
+        size_t count = buffer->count.load(std::memory_order_acquire);
+        dropped += buffer->dropped.load(std::memory_order_relaxed);
+        for (size_t i = 0; i < count; ++i) {
+            const Event &event = buffer->chunks[i / CHUNK_EVENTS].load(std::memory_order_acquire)
+                                     ->events[i % CHUNK_EVENTS];
+            // Spans opened before start() are clipped to it
+            uint64_t begin = event.start > origin ? event.start - origin : 0;
+            uint64_t end   = event.end > origin ? event.end - origin : 0;
+            std::snprintf(head, sizeof(head), "{\"ph\":\"X\",\"pid\":%ld,\"tid\":%u,\"name\":\"",
+                          pid, buffer->tid);
+            out += head;
+            appendEscaped(out, event.name);
+            out += "\",\"ts\":";
+            appendMicros(out, begin);
+            out += ",\"dur\":";
+            appendMicros(out, end > begin ? end - begin : 0);
+            if (!event.detail.empty()) {
+                out += ",\"args\":{\"detail\":\"";
+                appendEscaped(out, event.detail.c_str());
+                out += "\"}";
+            }
+            out += "},\n";
+            events++;
+        }
+    }
+    std::snprintf(head, sizeof(head), "{\"ph\":\"M\",\"name\":\"process_name\",\"pid\":%ld,", pid);
+    out += head;
+    out += "\"args\":{\"name\":\"node-qnn-llm\"}}\n],\"otherData\":{\"dropped_events\":";
+    out += std::to_string(dropped);
+    out += "}}\n";
+
+    // Threads that exited during the trace are written out, drop them
+    for (const ThreadBuffer *buffer : exited) removeBuffer(buffer);
+    exited.clear();
+
+    std::ofstream file(path, std::ios::binary | std::ios::trunc);
+    if (!file || !file.write(out.data(), out.size())) {
+        throw std::runtime_error("Failed to write trace: " + path);
+    }
+    return events;
+}
+
+} // namespace trace
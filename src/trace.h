@@ -0,0 +1,62 @@
+#pragma once
+
+#include <atomic>
+#include <cstdint>
+#include <string>
+
+// -----------------------------------------------------------------------------
+// Timeline tracing
+//
+// Spans are appended to a per-thread buffer owned by the recording thread, so
+// recording never takes a lock. While tracing is off a span costs one relaxed
+// atomic load. stop() writes the Chrome trace-event JSON format, which opens in
+// Perfetto (ui.perfetto.dev) and chrome://tracing.
+// -----------------------------------------------------------------------------
+
+namespace trace {
+
+extern std::atomic<bool> active;
+
+inline bool enabled() { return active.load(std::memory_order_relaxed); }
+
+// Nanoseconds on the steady clock
+uint64_t now();
+
+// Starts a new trace, dropping events of a previous one
+void start();
+
+// Stops tracing and writes the events to path; returns the event count
+size_t stop(const std::string &path);
+
+// Names the calling thread in the trace; its buffer is only allocated once it
+// records an event
+void setThreadName(const char *name);
+
+// Records a finished span on the calling thread while tracing is on; name must
+// be a string literal
+void complete(const char *name, uint64_t start_ns, uint64_t end_ns,
+              const std::string &detail = std::string());
+
+// Records a span for its own scope
+class Span {
+public:
+    explicit Span(const char *name) : name_(enabled() ? name : nullptr) {
+        if (name_) start_ = now();
+    }
+    Span(const char *name, const std::string &detail) : Span(name) {
+        if (name_) detail_ = detail;
+    }
+    ~Span() {
+        if (name_) complete(name_, start_, now(), detail_);
+    }
+
+    Span(const Span &) = delete;
+    Span &operator=(const Span &) = delete;
+
+private:
+    const char *name_;
+    uint64_t    start_ = 0;
+    std::string detail_;
+};
+
+} // namespace trace
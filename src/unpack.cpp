@@ -1,9 +1,15 @@
 #include "unpack.h"
+#include "metrics.h"
+#include "trace.h"
+#include <chrono>
 #include <filesystem>
 #include <fstream>
 #include <vector>
 #include <cstring>
+#include <cerrno>
+#include <cstdlib>
 #include <stdexcept>
+#include <exception>
 #include <algorithm>
 #include <zstd.h>
 #include <zlib.h>
@@ -11,15 +17,23 @@
 #include <mutex>
 #include <condition_variable>
 #include <queue>
+#include <atomic>
+#include <unordered_map>
 
 #ifdef _WIN32
 #include <windows.h>
+#include <io.h>
 #else
 #include <sys/mman.h>
 #include <sys/stat.h>
 #include <fcntl.h>
 #include <unistd.h>
 #endif
+#ifdef __linux__
+#include <linux/fs.h>
+#include <sys/ioctl.h>
+#include <sys/sendfile.h>
+#endif
 
 namespace fs = std::filesystem;
 static constexpr size_t IO_BUFFER_SIZE = 1 << 20;  // 1 MiB
@@ -30,7 +44,8 @@ static constexpr size_t IO_BUFFER_SIZE = 1 << 20;  // 1 MiB
 
 MemoryMap::MemoryMap(const std::string &path) {
 #ifdef _WIN32
-    file_ = CreateFileA(path.c_str(), GENERIC_READ, FILE_SHARE_READ,
+    // Shared for writing too, so append-only files can be mapped while open
+    file_ = CreateFileA(path.c_str(), GENERIC_READ, FILE_SHARE_READ | FILE_SHARE_WRITE,
                         nullptr, OPEN_EXISTING, FILE_ATTRIBUTE_NORMAL, nullptr);
     if (file_ == INVALID_HANDLE_VALUE) throw std::runtime_error("Cannot open file");
     LARGE_INTEGER sz;
@@ -51,6 +66,44 @@ MemoryMap::MemoryMap(const std::string &path) {
 #endif
 }
 
+MemoryMap::MemoryMap(std::FILE *file) : data_(nullptr), size_(0) {
+#ifdef _WIN32
+    mapping_ = nullptr;
+    HANDLE handle = reinterpret_cast<HANDLE>(_get_osfhandle(_fileno(file)));
+    if (!DuplicateHandle(GetCurrentProcess(), handle, GetCurrentProcess(), &file_, 0, FALSE,
+                         DUPLICATE_SAME_ACCESS)) {
+        throw std::runtime_error("Cannot open file");
+    }
+    LARGE_INTEGER sz;
+    if (GetFileSizeEx((HANDLE)file_, &sz) && sz.QuadPart > 0) {
+        size_ = static_cast<size_t>(sz.QuadPart);
+        mapping_ = CreateFileMappingA((HANDLE)file_, nullptr, PAGE_READONLY, 0, 0, nullptr);
+        if (mapping_) {
+            data_ = static_cast<const uint8_t*>(MapViewOfFile((HANDLE)mapping_, FILE_MAP_READ, 0, 0, 0));
+        }
+    }
+    if (!data_) {
+        if (mapping_) CloseHandle((HANDLE)mapping_);
+        CloseHandle((HANDLE)file_);
+        throw std::runtime_error("MapViewOfFile failed");
+    }
+#else
+    fd_ = dup(fileno(file));
+    if (fd_ < 0) throw std::runtime_error("Cannot open file");
+    struct stat st;
+    void *ptr = MAP_FAILED;
+    if (fstat(fd_, &st) == 0 && st.st_size > 0) {
+        ptr = mmap(nullptr, static_cast<size_t>(st.st_size), PROT_READ, MAP_PRIVATE, fd_, 0);
+    }
+    if (ptr == MAP_FAILED) {
+        close(fd_);
+        throw std::runtime_error("mmap failed");
+    }
+    size_ = static_cast<size_t>(st.st_size);
+    data_ = static_cast<const uint8_t*>(ptr);
+#endif
+}
+
 MemoryMap::~MemoryMap() {
 #ifdef _WIN32
     if (data_) UnmapViewOfFile(data_);
@@ -64,6 +117,9 @@ MemoryMap::~MemoryMap() {
 
 const uint8_t* MemoryMap::data() const { return data_; }
 size_t         MemoryMap::size() const { return size_; }
+#ifndef _WIN32
+int            MemoryMap::fd()   const { return fd_; }
+#endif
 
 //------------------------------------------------------------------------------
 // ThreadPool implementation (PImpl idiom)
@@ -83,6 +139,7 @@ ThreadPool::ThreadPool(size_t threadCount)
     : impl_(new Impl()) {
     for (size_t i = 0; i < threadCount; ++i) {
         impl_->workers.emplace_back([this] {
+            trace::setThreadName("unpack");
             auto &I = *impl_;
             while (true) {
                 std::function<void()> job;
@@ -132,6 +189,86 @@ ThreadPool::~ThreadPool() {
     delete impl_;
 }
 
+//------------------------------------------------------------------------------
+// Process-wide pool shared by all unpack calls
+//------------------------------------------------------------------------------
+
+static ThreadPool &sharedPool() {
+    static ThreadPool pool(std::max(1u, std::thread::hardware_concurrency()));
+    return pool;
+}
+
+//------------------------------------------------------------------------------
+// Size-aware scheduler on top of the shared pool
+//
+// Starts the largest jobs first so a big section doesn't end up running
+// alone at the end, keeps at most maxRunning jobs and maxBytes of work in
+// flight (a job larger than maxBytes still runs, alone), and waits only for
+// its own jobs.
+//------------------------------------------------------------------------------
+
+namespace {
+
+class UnpackScheduler {
+public:
+    UnpackScheduler(size_t maxRunning, uint64_t maxBytes)
+        : maxRunning_(std::max<size_t>(1, maxRunning)),
+          maxBytes_(maxBytes ? maxBytes : UINT64_MAX) {}
+
+    void add(uint64_t bytes, std::function<void()> job) {
+        pending_.push_back({bytes, std::move(job)});
+    }
+
+    void run() {
+        std::stable_sort(pending_.begin(), pending_.end(),
+                         [](const Job &a, const Job &b) { return a.bytes < b.bytes; });
+        std::unique_lock<std::mutex> lock(mutex_);
+        dispatchLocked();
+        done_.wait(lock, [&] { return pending_.empty() && running_ == 0; });
+    }
+
+private:
+    struct Job {
+        uint64_t              bytes;
+        std::function<void()> fn;
+    };
+
+    void dispatchLocked() {
+        while (!pending_.empty() && running_ < maxRunning_) {
+            // Largest job that fits the byte budget (pending_ is ascending)
+            auto it = pending_.end();
+            if (running_ > 0) {
+                uint64_t budget = maxBytes_ > inflight_ ? maxBytes_ - inflight_ : 0;
+                it = std::upper_bound(pending_.begin(), pending_.end(), budget,
+                                      [](uint64_t value, const Job &job) { return value < job.bytes; });
+                if (it == pending_.begin()) return;
+            }
+            Job job = std::move(*--it);
+            pending_.erase(it);
+            ++running_;
+            inflight_ += job.bytes;
+            sharedPool().enqueue([this, job = std::move(job)]() {
+                job.fn();
+                std::lock_guard<std::mutex> lock(mutex_);
+                --running_;
+                inflight_ -= job.bytes;
+                dispatchLocked();
+                if (pending_.empty() && running_ == 0) done_.notify_all();
+            });
+        }
+    }
+
+    size_t                  maxRunning_;
+    uint64_t                maxBytes_;
+    std::vector<Job>        pending_;
+    std::mutex              mutex_;
+    std::condition_variable done_;
+    size_t                  running_  = 0;
+    uint64_t                inflight_ = 0;
+};
+
+} // namespace
+
 //------------------------------------------------------------------------------
 // Utility: read little-endian integers from memory
 //------------------------------------------------------------------------------
@@ -144,72 +281,626 @@ static T readLE(const uint8_t *ptr) {
 }
 
 //------------------------------------------------------------------------------
-// Compute global CRC32 over data[0..size-5] (exclude last 4-byte footer)
+// CRC32 helpers (zlib takes 32-bit lengths)
 //------------------------------------------------------------------------------
 
-static uint32_t computeGlobalCrc(const uint8_t *data, size_t size) {
-    size_t validLen = (size > sizeof(uint32_t)) ? size - sizeof(uint32_t) : 0;
-    uint32_t crc = crc32(0, nullptr, 0);
+static uint32_t crcUpdate(uint32_t crc, const uint8_t *data, size_t size) {
     size_t offset = 0;
-    while (offset < validLen) {
-        size_t chunk = std::min<size_t>(IO_BUFFER_SIZE, validLen - offset);
+    while (offset < size) {
+        size_t chunk = std::min<size_t>(IO_BUFFER_SIZE, size - offset);
         crc = crc32(crc, data + offset, static_cast<uInt>(chunk));
         offset += chunk;
     }
     return crc;
 }
 
+static uint32_t crcRange(const uint8_t *data, size_t size) {
+    return crcUpdate(crc32(0, nullptr, 0), data, size);
+}
+
+// CRC of A||B from CRC(A), CRC(B) and len(B), without touching the data again
+static uint32_t crcAppend(uint32_t crcA, uint32_t crcB, uint64_t lenB) {
+    // crc32_combine takes a signed length; fold very large ranges in halves
+    const uint64_t maxLen = uint64_t(1) << 30;
+    while (lenB > maxLen) {
+        crcA = static_cast<uint32_t>(crc32_combine(crcA, crc32(0, nullptr, 0), static_cast<z_off_t>(maxLen)));
+        lenB -= maxLen;
+    }
+    return static_cast<uint32_t>(crc32_combine(crcA, crcB, static_cast<z_off_t>(lenB)));
+}
+
+//------------------------------------------------------------------------------
+// Section writers
 //------------------------------------------------------------------------------
-static void decompressSection(const uint8_t *base,
-                              size_t offset,
-                              size_t compSize,
-                              const fs::path &outputPath) {
-    const uint8_t *srcPtr = base + offset;
-    ZSTD_DStream *dctx = ZSTD_createDStream();
+
+WriteMode parseWriteMode(const std::string &name) {
+    if (name.empty() || name == "auto") return WriteMode::Auto;
+    if (name == "stream") return WriteMode::Stream;
+    if (name == "mmap")   return WriteMode::Mmap;
+    if (name == "pwrite") return WriteMode::Pwrite;
+    if (name == "direct") return WriteMode::Direct;
+    throw std::runtime_error("Unknown write mode: " + name);
+}
+
+namespace {
+
+// Portable buffered writer used on Windows and for sections of unknown size
+class StreamSectionWriter : public SectionWriter {
+public:
+    StreamSectionWriter(const std::string &path, uint64_t offset, uint64_t length, bool truncate)
+        : path_(path), length_(length), buffer_(IO_BUFFER_SIZE) {
+        auto flags = std::ios::binary | std::ios::out;
+        out_.open(path, truncate ? flags | std::ios::trunc : flags | std::ios::in);
+        if (!out_) throw std::runtime_error("Cannot open " + path);
+        out_.seekp(static_cast<std::streamoff>(offset));
+    }
+
+    uint8_t *window(size_t &capacity) override {
+        capacity = buffer_.size() - fill_;
+        return buffer_.data() + fill_;
+    }
+
+    void commit(size_t bytes) override {
+        fill_ += bytes;
+        if (fill_ == buffer_.size()) flush();
+    }
+
+    void finish() override {
+        flush();
+        out_.close();
+        if (!out_) throw std::runtime_error("Write failed: " + path_);
+        if (length_ && written_ != length_) throw std::runtime_error("Section size mismatch: " + path_);
+    }
+
+private:
+    void flush() {
+        out_.write(reinterpret_cast<const char*>(buffer_.data()), fill_);
+        if (!out_) throw std::runtime_error("Write failed: " + path_);
+        written_ += fill_;
+        fill_ = 0;
+    }
+
+    std::string          path_;
+    uint64_t             length_;
+    std::vector<uint8_t> buffer_;
+    std::fstream         out_;
+    size_t               fill_    = 0;
+    uint64_t             written_ = 0;
+};
+
+#ifndef _WIN32
+
+static constexpr size_t WRITE_BUFFER_SIZE = 8 << 20;  // 8 MiB
+static constexpr size_t DIRECT_ALIGNMENT  = 4096;
+
+static void pwriteAll(int fd, const uint8_t *data, size_t len, uint64_t offset) {
+    while (len > 0) {
+        ssize_t n = pwrite(fd, data, len, static_cast<off_t>(offset));
+        if (n < 0) {
+            if (errno == EINTR) continue;
+            throw std::runtime_error("pwrite failed");
+        }
+        data   += n;
+        len    -= static_cast<size_t>(n);
+        offset += static_cast<uint64_t>(n);
+    }
+}
+
+// Decompresses straight into the section's shared writable mapping
+class MmapSectionWriter : public SectionWriter {
+public:
+    MmapSectionWriter(const std::string &path, uint8_t *data, uint64_t length)
+        : path_(path), data_(data), length_(length) {}
+
+    uint8_t *window(size_t &capacity) override {
+        capacity = static_cast<size_t>(length_ - written_);
+        return data_ + written_;
+    }
+
+    void commit(size_t bytes) override { written_ += bytes; }
+
+    void finish() override {
+        if (written_ != length_) throw std::runtime_error("Section size mismatch: " + path_);
+    }
+
+private:
+    std::string path_;
+    uint8_t    *data_;
+    uint64_t    length_;
+    uint64_t    written_ = 0;
+};
+
+// Accumulates output in a large page-aligned buffer and flushes it with
+// pwrite(); with O_DIRECT the data bypasses (and doesn't evict) the page cache
+class PwriteSectionWriter : public SectionWriter {
+public:
+    PwriteSectionWriter(const std::string &path, uint64_t offset, uint64_t length, bool direct)
+        : path_(path), offset_(offset), length_(length) {
+        int flags = O_WRONLY | O_CLOEXEC;
+#ifdef O_DIRECT
+        direct_ = direct && offset % DIRECT_ALIGNMENT == 0;
+        fd_ = open(path.c_str(), direct_ ? flags | O_DIRECT : flags);
+        if (fd_ < 0 && direct_ && errno == EINVAL) {
+            // Filesystem without O_DIRECT support (e.g. tmpfs)
+            direct_ = false;
+            fd_ = open(path.c_str(), flags);
+        }
+#else
+        (void)direct;
+        fd_ = open(path.c_str(), flags);
+#endif
+        if (fd_ < 0) throw std::runtime_error("Cannot open " + path);
+        if (posix_memalign(reinterpret_cast<void**>(&buffer_), DIRECT_ALIGNMENT, WRITE_BUFFER_SIZE) != 0) {
+            close(fd_);
+            throw std::runtime_error("Failed to allocate write buffer");
+        }
+    }
+
+    ~PwriteSectionWriter() override {
+        free(buffer_);
+        if (fd_ >= 0) close(fd_);
+    }
+
+    uint8_t *window(size_t &capacity) override {
+        capacity = WRITE_BUFFER_SIZE - fill_;
+        return buffer_ + fill_;
+    }
+
+    void commit(size_t bytes) override {
+        fill_ += bytes;
+        if (fill_ == WRITE_BUFFER_SIZE) flush();
+    }
+
+    void finish() override {
+        flush();
+        if (written_ != length_) throw std::runtime_error("Section size mismatch: " + path_);
+        close(fd_);
+        fd_ = -1;
+    }
+
+private:
+    void flush() {
+        if (fill_ == 0) return;
+#ifdef O_DIRECT
+        if (direct_ && fill_ % DIRECT_ALIGNMENT != 0) {
+            // O_DIRECT needs block-multiple lengths; write the tail buffered
+            int flags = fcntl(fd_, F_GETFL);
+            fcntl(fd_, F_SETFL, flags & ~O_DIRECT);
+            direct_ = false;
+        }
+#endif
+        pwriteAll(fd_, buffer_, fill_, offset_ + written_);
+        written_ += fill_;
+        fill_ = 0;
+    }
+
+    std::string path_;
+    uint64_t    offset_;
+    uint64_t    length_;
+    bool        direct_   = false;
+    int         fd_       = -1;
+    uint8_t    *buffer_   = nullptr;
+    size_t      fill_     = 0;
+    uint64_t    written_  = 0;
+};
+
+#endif
+
+} // namespace
+
+//------------------------------------------------------------------------------
+// SectionOutput implementation
+//------------------------------------------------------------------------------
+
+SectionOutput::SectionOutput(const std::string &path, uint64_t size, WriteMode mode)
+    : path_(path), part_(path + ".part"), size_(size), mode_(mode) {
+    fs::create_directories(fs::path(path).parent_path());
+#ifdef _WIN32
+    mode_ = WriteMode::Stream;
+#else
+    if (mode_ == WriteMode::Auto) mode_ = WriteMode::Mmap;
+#endif
+    if (size_ == 0) mode_ = WriteMode::Stream;
+
+    if (mode_ == WriteMode::Stream) {
+        std::ofstream create(part_, std::ios::binary | std::ios::trunc);
+        if (!create) throw std::runtime_error("Cannot create " + path);
+        create.close();
+        if (size_ > 0) fs::resize_file(part_, size_);
+        return;
+    }
+#ifndef _WIN32
+    fd_ = open(part_.c_str(), O_RDWR | O_CREAT | O_TRUNC | O_CLOEXEC, 0644);
+    if (fd_ < 0) throw std::runtime_error("Cannot create " + path);
+#ifdef __linux__
+    // Reserve the whole extent up front so the filesystem can allocate it
+    // contiguously, and so a full disk fails here rather than as SIGBUS on a
+    // mapped page. Not every filesystem implements fallocate(); without it
+    // the section is written with pwrite(), which reports ENOSPC.
+    int rc;
+    do {
+        rc = fallocate(fd_, 0, 0, static_cast<off_t>(size_));
+    } while (rc != 0 && errno == EINTR);
+    if (rc != 0) {
+        int err = errno;
+        if (err != EOPNOTSUPP && err != ENOSYS) {
+            close(fd_);
+            unlink(part_.c_str());
+            throw std::runtime_error("Failed to preallocate " + path + ": " + std::strerror(err));
+        }
+        if (mode_ == WriteMode::Mmap) mode_ = WriteMode::Pwrite;
+    }
+#endif
+    void *ptr = nullptr;
+    if (ftruncate(fd_, static_cast<off_t>(size_)) != 0 ||
+        (mode_ == WriteMode::Mmap &&
+         (ptr = mmap(nullptr, size_, PROT_READ | PROT_WRITE, MAP_SHARED, fd_, 0)) == MAP_FAILED)) {
+        close(fd_);
+        unlink(part_.c_str());
+        throw std::runtime_error("Failed to preallocate " + path);
+    }
+    map_ = static_cast<uint8_t*>(ptr);
+#endif
+}
+
+SectionOutput::~SectionOutput() {
+#ifndef _WIN32
+    if (map_) munmap(map_, size_);
+    if (fd_ >= 0) close(fd_);
+#endif
+    if (!committed_) {
+        std::error_code ec;
+        fs::remove(part_, ec);
+    }
+}
+
+std::unique_ptr<SectionWriter> SectionOutput::region(uint64_t offset, uint64_t length) {
+    if (length == 0 && size_ > offset) length = size_ - offset;
+    if (size_ > 0 && offset + length > size_) {
+        throw std::runtime_error("Section region out of range: " + path_);
+    }
+#ifndef _WIN32
+    switch (mode_) {
+    case WriteMode::Mmap:   return std::make_unique<MmapSectionWriter>(path_, map_ + offset, length);
+    case WriteMode::Pwrite: return std::make_unique<PwriteSectionWriter>(part_, offset, length, false);
+    case WriteMode::Direct: return std::make_unique<PwriteSectionWriter>(part_, offset, length, true);
+    default: break;
+    }
+#endif
+    return std::make_unique<StreamSectionWriter>(part_, offset, length, false);
+}
+
+void SectionOutput::copyRegion(const MemoryMap &src, uint64_t srcOffset,
+                               uint64_t dstOffset, uint64_t length) {
+    uint64_t done = 0;
+#ifdef __linux__
+    if (fd_ >= 0 && !map_) {
+#ifdef FICLONERANGE
+        // Share extents with the bundle on reflink-capable filesystems
+        // (btrfs, XFS); only whole blocks can be cloned
+        uint64_t aligned = length - length % STORED_ALIGNMENT;
+        if (aligned > 0 && srcOffset % STORED_ALIGNMENT == 0 && dstOffset % STORED_ALIGNMENT == 0) {
+            struct file_clone_range range{src.fd(), srcOffset, aligned, dstOffset};
+            if (ioctl(fd_, FICLONERANGE, &range) == 0) done = aligned;
+        }
+#endif
+        // In-kernel copy, no round trip through userspace buffers
+        while (done < length) {
+            loff_t in  = static_cast<loff_t>(srcOffset + done);
+            loff_t out = static_cast<loff_t>(dstOffset + done);
+            ssize_t n = copy_file_range(src.fd(), &in, fd_, &out, length - done, 0);
+            if (n > 0) {
+                done += static_cast<uint64_t>(n);
+            } else if (n < 0 && errno == EINTR) {
+                continue;
+            } else {
+                break;  // ENOSYS, EXDEV (pre-5.3 cross-fs), ...
+            }
+        }
+        // sendfile() writes at the file position, so give it its own descriptor
+        if (done < length) {
+            int out = open(part_.c_str(), O_WRONLY | O_CLOEXEC);
+            if (out >= 0 && lseek(out, static_cast<off_t>(dstOffset + done), SEEK_SET) >= 0) {
+                while (done < length) {
+                    off_t in = static_cast<off_t>(srcOffset + done);
+                    ssize_t n = sendfile(out, src.fd(), &in, static_cast<size_t>(length - done));
+                    if (n > 0) {
+                        done += static_cast<uint64_t>(n);
+                    } else if (n < 0 && errno == EINTR) {
+                        continue;
+                    } else {
+                        break;
+                    }
+                }
+            }
+            if (out >= 0) close(out);
+        }
+    }
+#endif
+    if (done == length) return;
+    // Plain copy out of the bundle mapping for whatever is left
+    auto writer = region(dstOffset + done, length - done);
+    const uint8_t *from = src.data() + srcOffset + done;
+    uint64_t remaining = length - done;
+    while (remaining > 0) {
+        size_t capacity = 0;
+        uint8_t *dst = writer->window(capacity);
+        size_t n = static_cast<size_t>(std::min<uint64_t>(capacity, remaining));
+        std::memcpy(dst, from, n);
+        writer->commit(n);
+        from      += n;
+        remaining -= n;
+    }
+    writer->finish();
+}
+
+void SectionOutput::commit() {
+#ifndef _WIN32
+    if (map_) {
+        munmap(map_, size_);
+        map_ = nullptr;
+    }
+    if (fd_ >= 0) {
+        close(fd_);
+        fd_ = -1;
+    }
+#endif
+    fs::rename(part_, path_);
+    committed_ = true;
+}
+
+//------------------------------------------------------------------------------
+// Parse the seekable-format seek table at the end of a section, if any.
+// Returns an empty list for plain single-frame sections.
+//------------------------------------------------------------------------------
+
+static constexpr size_t SEEK_TABLE_FOOTER_SIZE = 9;  // frames(4) descriptor(1) magic(4)
+
+static std::vector<Frame> readFrameIndex(const uint8_t *src, size_t size) {
+    std::vector<Frame> frames;
+    if (size < 8 + SEEK_TABLE_FOOTER_SIZE) return frames;
+    const uint8_t *footer = src + size - SEEK_TABLE_FOOTER_SIZE;
+    if (readLE<uint32_t>(footer + 5) != SEEKABLE_MAGIC) return frames;
+
+    uint32_t count      = readLE<uint32_t>(footer);
+    uint8_t  descriptor = footer[4];
+    size_t   entrySize  = (descriptor & 0x80) ? 12 : 8;
+    uint64_t tableSize  = 8 + uint64_t(count) * entrySize + SEEK_TABLE_FOOTER_SIZE;
+    if (count == 0 || tableSize > size) return frames;
+
+    const uint8_t *table = src + size - tableSize;
+    if (readLE<uint32_t>(table) != SKIPPABLE_MAGIC ||
+        readLE<uint32_t>(table + 4) != tableSize - 8) {
+        return frames;
+    }
+
+    uint64_t compOffset = 0, rawOffset = 0;
+    const uint8_t *ptr = table + 8;
+    for (uint32_t i = 0; i < count; ++i, ptr += entrySize) {
+        uint64_t clen = readLE<uint32_t>(ptr);
+        uint64_t rlen = readLE<uint32_t>(ptr + 4);
+        frames.push_back({compOffset, clen, rawOffset, rlen});
+        compOffset += clen;
+        rawOffset  += rlen;
+    }
+    if (compOffset != size - tableSize) frames.clear();
+    return frames;
+}
+
+//------------------------------------------------------------------------------
+// Stream-decompress src (one or more frames) into a region writer and return
+// the CRC32 of src. The checksum runs one chunk ahead of the decompressor so
+// verification reads the input while it's cache-hot instead of in a
+// separate pass. Long-range sections lift zstd's default window limit and
+// dictionary sections decode against the shared bundle dictionary.
+//------------------------------------------------------------------------------
+
+static uint32_t decompressRange(const uint8_t *src, size_t srcSize, SectionWriter &writer,
+                                const ZSTD_DDict *ddict, bool longWindow) {
+    std::unique_ptr<ZSTD_DStream, size_t(*)(ZSTD_DStream*)> dctx(ZSTD_createDStream(), ZSTD_freeDStream);
     if (!dctx) throw std::runtime_error("Failed to create Zstd decompressor");
-    if (ZSTD_isError(ZSTD_initDStream(dctx))) {
+    // initDStream drops any referenced dictionary, so configure afterwards
+    if (ZSTD_isError(ZSTD_initDStream(dctx.get()))) {
         throw std::runtime_error("Failed to initialize Zstd decompressor");
     }
+    if (longWindow) {
+        ZSTD_bounds bounds = ZSTD_dParam_getBounds(ZSTD_d_windowLogMax);
+        if (ZSTD_isError(ZSTD_DCtx_setParameter(dctx.get(), ZSTD_d_windowLogMax, bounds.upperBound))) {
+            throw std::runtime_error("Failed to configure Zstd window size");
+        }
+    }
+    if (ddict && ZSTD_isError(ZSTD_DCtx_refDDict(dctx.get(), ddict))) {
+        throw std::runtime_error("Failed to load Zstd dictionary");
+    }
 
-    std::ofstream outFile(outputPath, std::ios::binary);
-    ZSTD_inBuffer inBuf{srcPtr, compSize, 0};
-    std::vector<char> outBuf(IO_BUFFER_SIZE);
-    ZSTD_outBuffer outZ{outBuf.data(), outBuf.size(), 0};
-
-    while (inBuf.pos < inBuf.size) {
-        size_t ret = ZSTD_decompressStream(dctx, &outZ, &inBuf);
+    uint32_t crc = crc32(0, nullptr, 0);
+    ZSTD_inBuffer inBuf{src, 0, 0};
+    size_t ret = 0;
+    do {
+        if (inBuf.pos == inBuf.size && inBuf.size < srcSize) {
+            size_t chunk = std::min<size_t>(IO_BUFFER_SIZE, srcSize - inBuf.size);
+            crc = crc32(crc, src + inBuf.size, static_cast<uInt>(chunk));
+            inBuf.size += chunk;
+        }
+        size_t capacity = 0;
+        uint8_t *dst = writer.window(capacity);
+        ZSTD_outBuffer outZ{dst, capacity, 0};
+        ret = ZSTD_decompressStream(dctx.get(), &outZ, &inBuf);
         if (ZSTD_isError(ret)) {
-            ZSTD_freeDStream(dctx);
             throw std::runtime_error("Zstd decompression error");
         }
-        outFile.write(outBuf.data(), outZ.pos);
-        outZ.pos = 0;
+        writer.commit(outZ.pos);
+        if (outZ.pos == 0 && inBuf.pos == srcSize && ret != 0) {
+            // No room left for pending output, or the frame is cut short
+            throw std::runtime_error(capacity == 0 ? "Section size mismatch" : "Truncated section");
+        }
+    } while (inBuf.pos < srcSize || ret != 0);
+    writer.finish();
+    return crc;
+}
+
+//------------------------------------------------------------------------------
+// Split a section into independently decompressible tasks
+//------------------------------------------------------------------------------
+
+static constexpr uint64_t MIN_TASK_RAW_SIZE = 16 << 20;  // 16 MiB
+
+struct SectionTask {
+    uint64_t comp_offset;    // Relative to the section start
+    uint64_t comp_length;
+    uint64_t raw_offset;
+    uint64_t raw_length;     // 0 = rest of the section
+};
+
+// Already-extracted sections only need their checksum; split them evenly
+static std::vector<SectionTask> planChecksum(const Entry &entry) {
+    std::vector<SectionTask> tasks;
+    for (uint64_t offset = 0; offset < entry.comp_length; offset += MIN_TASK_RAW_SIZE) {
+        tasks.push_back({offset, std::min<uint64_t>(MIN_TASK_RAW_SIZE, entry.comp_length - offset), 0, 0});
+    }
+    return tasks;
+}
+
+static std::vector<SectionTask> planSection(const uint8_t *base, const Entry &entry, uint64_t rawSize) {
+    if (entry.codec == CODEC_STORED) {
+        std::vector<SectionTask> tasks = planChecksum(entry);
+        for (SectionTask &t : tasks) {
+            t.raw_offset = t.comp_offset;
+            t.raw_length = t.comp_length;
+        }
+        return tasks;
+    }
+    std::vector<Frame> frames = readFrameIndex(base + entry.offset, entry.comp_length);
+    uint64_t framesRaw = frames.empty() ? 0 : frames.back().raw_offset + frames.back().raw_length;
+    if (frames.size() < 2 || framesRaw != rawSize) {
+        return {{0, entry.comp_length, 0, 0}};
+    }
+    // Group adjacent frames so tiny frames don't turn into tiny tasks
+    std::vector<SectionTask> tasks;
+    for (const Frame &f : frames) {
+        if (!tasks.empty() && tasks.back().raw_length < MIN_TASK_RAW_SIZE) {
+            tasks.back().comp_length += f.comp_length;
+            tasks.back().raw_length  += f.raw_length;
+        } else {
+            tasks.push_back({f.comp_offset, f.comp_length, f.raw_offset, f.raw_length});
+        }
+    }
+    return tasks;
+}
+
+//------------------------------------------------------------------------------
+// Unpack manifest
+//
+// Records which bundle produced the files in the unpack directory and the
+// checksum, size and mtime of every extracted entry, so a warm start can
+// validate the directory with a few stat() calls instead of reading the
+// bundle again. Format (text):
+//   QGENIE-MANIFEST 1
+//   <bundle size> <bundle mtime> <header crc>
+//   <entry crc> <size> <mtime> <name>      (one line per entry)
+//------------------------------------------------------------------------------
+
+static constexpr const char *MANIFEST_NAME  = ".unpack-manifest";
+static constexpr const char *MANIFEST_MAGIC = "QGENIE-MANIFEST 1";
+
+struct ManifestEntry {
+    uint32_t crc;
+    uint64_t size;
+    int64_t  mtime;
+};
+
+struct Manifest {
+    uint64_t bundle_size  = 0;
+    int64_t  bundle_mtime = 0;
+    uint32_t header_crc   = 0;
+    std::unordered_map<std::string, ManifestEntry> entries;
+};
+
+static int64_t mtimeOf(const fs::path &path, std::error_code &ec) {
+    return static_cast<int64_t>(fs::last_write_time(path, ec).time_since_epoch().count());
+}
+
+static bool readManifest(const fs::path &path, Manifest &manifest) {
+    std::ifstream in(path);
+    std::string line;
+    if (!std::getline(in, line) || line != MANIFEST_MAGIC) return false;
+    if (!(in >> manifest.bundle_size >> manifest.bundle_mtime >> manifest.header_crc)) return false;
+    ManifestEntry entry;
+    std::string name;
+    while (in >> entry.crc >> entry.size >> entry.mtime && in.get() == ' ' && std::getline(in, name)) {
+        manifest.entries[name] = entry;
+    }
+    return true;
+}
+
+static void writeManifest(const fs::path &path, const Manifest &manifest) {
+    fs::path tmp = path;
+    tmp += ".tmp";
+    {
+        std::ofstream out(tmp, std::ios::trunc);
+        out << MANIFEST_MAGIC << '\n'
+            << manifest.bundle_size << ' ' << manifest.bundle_mtime << ' ' << manifest.header_crc << '\n';
+        for (const auto &[name, entry] : manifest.entries) {
+            out << entry.crc << ' ' << entry.size << ' ' << entry.mtime << ' ' << name << '\n';
+        }
+        if (!out) throw std::runtime_error("Failed to write unpack manifest");
     }
+    fs::rename(tmp, path);
+}
 
-    ZSTD_freeDStream(dctx);
+// True if the manifest says this exact entry is already extracted and the
+// file on disk still has the size and mtime it had back then
+static bool isExtracted(const Manifest &manifest, const Entry &e, const fs::path &outPath) {
+    auto it = manifest.entries.find(e.name);
+    if (it == manifest.entries.end() || it->second.crc != e.crc32) return false;
+    if (e.raw_length && it->second.size != e.raw_length) return false;
+    std::error_code ec;
+    uint64_t size = fs::file_size(outPath, ec);
+    if (ec || size != it->second.size) return false;
+    int64_t mtime = mtimeOf(outPath, ec);
+    return !ec && mtime == it->second.mtime;
 }
 
 //------------------------------------------------------------------------------
 // unpackModel implementation
 //------------------------------------------------------------------------------
 
-void unpackModel(const std::string &bundlePath,
-                 const std::string &outDir) {
+static constexpr size_t HEADER_SIZE = 7 + 2 + 4 + 8 + 8 + 8;
+
+// Work for one TOC entry: its tasks, their checksums and (unless the file is
+// already extracted) the output they write into
+struct SectionJob {
+    Entry                          entry;
+    bool                           verify;  // config.json has no entry CRC
+    bool                           skip;    // Extracted and trusted, no work at all
+    std::shared_ptr<SectionOutput> output;
+    std::vector<SectionTask>       tasks;
+    std::vector<uint32_t>          crcs;
+    uint32_t                       crc;     // Whole-section CRC after the pool drains
+};
+
+// Returns the bytes written, 0 when every section was already extracted
+static uint64_t extractBundle(const std::string &bundlePath,
+                              const std::string &outDir,
+                              const UnpackOptions &options) {
     MemoryMap mm(bundlePath);
     const uint8_t *base = mm.data();
     size_t totalSize   = mm.size();
-
-    // Validate global CRC32
-    uint32_t storedCrc = readLE<uint32_t>(base + totalSize - sizeof(uint32_t));
-    if (storedCrc != computeGlobalCrc(base, totalSize)) {
-        throw std::runtime_error("Global CRC mismatch");
+    if (totalSize < HEADER_SIZE + sizeof(uint32_t) ||
+        std::memcmp(base, CONTAINER_MAGIC, sizeof(CONTAINER_MAGIC)) != 0) {
+        throw std::runtime_error("Invalid bundle");
     }
+    size_t dataEnd = totalSize - sizeof(uint32_t);
 
     // Parse header manually
     const uint8_t *p = base;
     p += 7; // magic
-    p += 2; // version
-    p += 4; // reserved
+    uint16_t version = readLE<uint16_t>(p); p += 2;
+    uint32_t configFlags = readLE<uint32_t>(p); p += 4;  // Reserved before v3
+    if (version == 0 || version > CONTAINER_VERSION) {
+        throw std::runtime_error("Unsupported bundle version " + std::to_string(version));
+    }
+    size_t entryFixedSize = version >= 2 ? 30 : 28;
     uint64_t configOffset = readLE<uint64_t>(p); p += 8;
     uint64_t configLength = readLE<uint64_t>(p); p += 8;
     uint64_t tocOffset    = readLE<uint64_t>(p); p += 8;
@@ -217,28 +908,233 @@ void unpackModel(const std::string &bundlePath,
     // Collect entries (config.json + TOC entries)
     std::vector<Entry> entries;
     entries.push_back({"config.json", configOffset, configLength, 0, 0});
+    if (version >= 3) entries[0].flags = static_cast<uint8_t>(configFlags);
 
+    if (tocOffset > dataEnd) throw std::runtime_error("Invalid TOC");
     size_t ptr = tocOffset;
-    while (ptr + sizeof(uint16_t) < totalSize - sizeof(uint32_t)) {
+    while (ptr + sizeof(uint16_t) < dataEnd) {
         uint16_t nameLen = readLE<uint16_t>(base + ptr); ptr += 2;
+        if (ptr + nameLen + entryFixedSize > dataEnd) throw std::runtime_error("Invalid TOC");
         std::string name(reinterpret_cast<const char*>(base + ptr), nameLen);
         ptr += nameLen;
         uint64_t offset = readLE<uint64_t>(base + ptr); ptr += 8;
         uint64_t clen   = readLE<uint64_t>(base + ptr); ptr += 8;
         uint64_t rlen   = readLE<uint64_t>(base + ptr); ptr += 8;
         uint32_t crc    = readLE<uint32_t>(base + ptr); ptr += 4;
-        entries.push_back({name, offset, clen, rlen, crc});
+        Entry entry{name, offset, clen, rlen, crc};
+        if (version >= 2) {
+            entry.codec = base[ptr++];
+            entry.flags = version >= 3 ? base[ptr] : 0;
+            ptr++;
+        }
+        entries.push_back(entry);
+    }
+    for (const Entry &e : entries) {
+        if (e.offset < HEADER_SIZE || e.offset > tocOffset || e.comp_length > tocOffset - e.offset ||
+            (e.codec != CODEC_ZSTD && e.codec != CODEC_STORED) ||
+            (e.codec == CODEC_STORED && e.raw_length != e.comp_length) ||
+            ((e.flags & ENTRY_FLAG_DICTIONARY) && e.codec != CODEC_STORED)) {
+            throw std::runtime_error("Invalid section: " + e.name);
+        }
     }
 
+    // Identify the bundle by size, mtime and a hash of its header, TOC and
+    // stored global CRC. A manifest written for the same bundle means every
+    // section was verified before, so the global CRC can be skipped.
     fs::create_directories(outDir);
-    ThreadPool pool(std::thread::hardware_concurrency());
-    for (auto &e : entries) {
-        // Skip if file exists and size matches expected raw length
+    fs::path manifestPath = fs::path(outDir) / MANIFEST_NAME;
+    std::error_code ec;
+    Manifest previous;
+    Manifest current;
+    current.bundle_size  = totalSize;
+    current.bundle_mtime = mtimeOf(bundlePath, ec);
+    current.header_crc   = crcUpdate(crcRange(base, HEADER_SIZE), base + tocOffset, totalSize - tocOffset);
+    bool trusted = readManifest(manifestPath, previous) &&
+                   previous.bundle_size  == current.bundle_size &&
+                   previous.bundle_mtime == current.bundle_mtime &&
+                   previous.header_crc   == current.header_crc;
+
+    // config.json has no entry CRC; identify it by its (small) payload
+    entries[0].crc32 = crcRange(base + configOffset, configLength);
+
+    // Dictionary sections are decoded against one shared, parsed copy; check
+    // it up front so a damaged dictionary fails as such, not as zstd errors
+    std::unique_ptr<ZSTD_DDict, size_t(*)(ZSTD_DDict*)> ddict(nullptr, ZSTD_freeDDict);
+    for (const Entry &e : entries) {
+        if (!(e.flags & ENTRY_FLAG_DICTIONARY) || ddict) continue;
+        if (!trusted && crcRange(base + e.offset, e.comp_length) != e.crc32) {
+            throw std::runtime_error("CRC mismatch: " + e.name);
+        }
+        ddict.reset(ZSTD_createDDict(base + e.offset, e.comp_length));
+        if (!ddict) throw std::runtime_error("Invalid dictionary: " + e.name);
+    }
+
+    std::vector<SectionJob> jobs;
+    jobs.reserve(entries.size());
+    for (size_t i = 0; i < entries.size(); ++i) {
+        const Entry &e = entries[i];
+        SectionJob job{e, i > 0, false, nullptr, {}, {}, 0};
+        if ((e.flags & ENTRY_FLAG_DICT) && !ddict) {
+            throw std::runtime_error("Missing dictionary for section: " + e.name);
+        }
+        if (e.flags & ENTRY_FLAG_DICTIONARY) {
+            // Already verified above; only its CRC feeds the global check
+            job.skip = trusted;
+            jobs.push_back(std::move(job));
+            continue;
+        }
+
+        // Skip entries the manifest vouches for; unless the bundle itself is
+        // trusted they are still checksummed for the global CRC
         fs::path outPath = fs::path(outDir) / e.name;
-        if (fs::exists(outPath) && fs::file_size(outPath) == e.raw_length) {
-            continue; // skip already extracted section
+        if (isExtracted(previous, e, outPath)) {
+            job.skip = trusted;
+            if (!trusted) job.tasks = planChecksum(e);
+        } else {
+            // config.json has no raw length in the header; take it from the frame
+            uint64_t rawSize = e.raw_length;
+            if (rawSize == 0) {
+                unsigned long long frameSize = ZSTD_getFrameContentSize(base + e.offset, e.comp_length);
+                if (frameSize != ZSTD_CONTENTSIZE_UNKNOWN && frameSize != ZSTD_CONTENTSIZE_ERROR) {
+                    rawSize = frameSize;
+                }
+            }
+            // Stored sections are copied by the kernel, which needs a plain
+            // descriptor rather than a mapping
+            WriteMode mode = options.write_mode;
+            if (e.codec == CODEC_STORED && (mode == WriteMode::Auto || mode == WriteMode::Mmap)) {
+                mode = WriteMode::Pwrite;
+            }
+            job.tasks  = planSection(base, e, rawSize);
+            job.output = std::make_shared<SectionOutput>(outPath.string(), rawSize, mode);
+        }
+        job.crcs.resize(job.tasks.size());
+        jobs.push_back(std::move(job));
+    }
+    bool allSkipped = std::all_of(jobs.begin(), jobs.end(), [](const SectionJob &job) { return job.skip; });
+    if (allSkipped) return 0;
+
+    size_t threads = options.n_threads ? options.n_threads : std::thread::hardware_concurrency();
+    UnpackScheduler scheduler(threads, options.max_inflight_bytes);
+    std::mutex errorMutex;
+    std::exception_ptr firstError;
+    for (SectionJob &job : jobs) {
+        for (size_t t = 0; t < job.tasks.size(); ++t) {
+            // Weigh tasks by the bytes they produce (or just read, for checksums)
+            const SectionTask &task = job.tasks[t];
+            uint64_t bytes = task.comp_length;
+            if (job.output && job.entry.codec == CODEC_ZSTD) {
+                bytes = task.raw_length ? task.raw_length : std::max(job.entry.raw_length, task.comp_length);
+            }
+            scheduler.add(bytes, [&, t, jobPtr = &job](){
+                const SectionTask &task = jobPtr->tasks[t];
+                const uint8_t *src = base + jobPtr->entry.offset + task.comp_offset;
+                trace::Span span(jobPtr->output ? "section" : "section_crc", jobPtr->entry.name);
+                try {
+                    if (jobPtr->output && jobPtr->entry.codec == CODEC_STORED) {
+                        jobPtr->crcs[t] = crcRange(src, task.comp_length);
+                        jobPtr->output->copyRegion(mm, jobPtr->entry.offset + task.comp_offset,
+                                                   task.raw_offset, task.raw_length);
+                    } else if (jobPtr->output) {
+                        auto writer = jobPtr->output->region(task.raw_offset, task.raw_length);
+                        uint8_t flags = jobPtr->entry.flags;
+                        jobPtr->crcs[t] = decompressRange(src, task.comp_length, *writer,
+                                                          (flags & ENTRY_FLAG_DICT) ? ddict.get() : nullptr,
+                                                          (flags & ENTRY_FLAG_LONG) != 0);
+                    } else {
+                        jobPtr->crcs[t] = crcRange(src, task.comp_length);
+                    }
+                } catch (...) {
+                    // Report corrupted input as such rather than as a zstd error
+                    std::exception_ptr error = std::current_exception();
+                    if (jobPtr->output && jobPtr->verify &&
+                        crcRange(base + jobPtr->entry.offset, jobPtr->entry.comp_length) != jobPtr->entry.crc32) {
+                        error = std::make_exception_ptr(std::runtime_error("CRC mismatch: " + jobPtr->entry.name));
+                    }
+                    std::lock_guard<std::mutex> lock(errorMutex);
+                    if (!firstError) firstError = error;
+                }
+            });
+        }
+    }
+    scheduler.run();
+    if (firstError) std::rethrow_exception(firstError);
+
+    // Fold section checksums (plus any trailing seek table) and the bytes
+    // between sections into the global CRC without re-reading the sections
+    for (SectionJob &job : jobs) {
+        if (job.skip) continue;
+        uint32_t crc = crc32(0, nullptr, 0);
+        uint64_t covered = 0;
+        for (size_t t = 0; t < job.tasks.size(); ++t) {
+            crc = crcAppend(crc, job.crcs[t], job.tasks[t].comp_length);
+            covered += job.tasks[t].comp_length;
+        }
+        crc = crcUpdate(crc, base + job.entry.offset + covered, job.entry.comp_length - covered);
+        if (job.verify && crc != job.entry.crc32) {
+            throw std::runtime_error("CRC mismatch: " + job.entry.name);
+        }
+        job.crc = crc;
+    }
+    if (!trusted) {
+        trace::Span span("global_crc");
+        std::vector<size_t> order(jobs.size());
+        for (size_t i = 0; i < order.size(); ++i) order[i] = i;
+        std::sort(order.begin(), order.end(), [&](size_t a, size_t b) {
+            return jobs[a].entry.offset < jobs[b].entry.offset;
+        });
+        uint32_t globalCrc = crc32(0, nullptr, 0);
+        uint64_t cursor = 0;
+        for (size_t i : order) {
+            const Entry &e = jobs[i].entry;
+            if (e.offset < cursor) throw std::runtime_error("Overlapping sections in bundle");
+            globalCrc = crcUpdate(globalCrc, base + cursor, e.offset - cursor);
+            globalCrc = crcAppend(globalCrc, jobs[i].crc, e.comp_length);
+            cursor = e.offset + e.comp_length;
         }
-        pool.enqueue([=](){ decompressSection(base, e.offset, e.comp_length, fs::path(outDir)/e.name); });
+        globalCrc = crcUpdate(globalCrc, base + cursor, dataEnd - cursor);
+        if (globalCrc != readLE<uint32_t>(base + dataEnd)) {
+            throw std::runtime_error("Global CRC mismatch");
+        }
+    }
+
+    // Everything verified: publish the extracted files and remember them
+    trace::Span span("publish");
+    for (SectionJob &job : jobs) {
+        if (job.output) job.output->commit();
+    }
+    uint64_t written = 0;
+    for (const SectionJob &job : jobs) {
+        if (job.entry.flags & ENTRY_FLAG_DICTIONARY) continue;
+        fs::path outPath = fs::path(outDir) / job.entry.name;
+        ManifestEntry entry{job.entry.crc32, 0, 0};
+        entry.size  = fs::file_size(outPath, ec);
+        if (!ec && job.output) written += entry.size;
+        if (!ec) entry.mtime = mtimeOf(outPath, ec);
+        if (!ec) current.entries[job.entry.name] = entry;
+    }
+    try {
+        writeManifest(manifestPath, current);
+    } catch (const std::exception &) {
+        // Best effort: the next start just validates the slow way
+    }
+    return written;
+}
+
+void unpackModel(const std::string &bundlePath,
+                 const std::string &outDir,
+                 const UnpackOptions &options) {
+    trace::Span span("unpack", bundlePath);
+    auto start = std::chrono::steady_clock::now();
+    uint64_t written;
+    try {
+        written = extractBundle(bundlePath, outDir, options);
+    } catch (...) {
+        perf::unpack_error.inc();
+        perf::unpack_duration.observe(perf::secondsSince(start));
+        throw;
     }
-    pool.wait();
+    (written > 0 ? perf::unpack_ok : perf::unpack_cached).inc();
+    perf::unpack_written_bytes.inc(written);
+    perf::unpack_duration.observe(perf::secondsSince(start));
 }
@@ -1,8 +1,10 @@
 #pragma once
 
 #include <cstdint>
+#include <cstdio>
 #include <string>
 #include <vector>
+#include <memory>
 #include <functional>
 
 // -----------------------------------------------------------------------------
@@ -10,7 +12,19 @@
 // -----------------------------------------------------------------------------
 
 static constexpr char CONTAINER_MAGIC[7] = {'Q','G','E','N','I','E','1'};
-static constexpr uint16_t CONTAINER_VERSION = 1;
+static constexpr uint16_t CONTAINER_VERSION = 3;
+
+// Per-entry codec (container v2+, v1 entries are always zstd)
+static constexpr uint8_t CODEC_ZSTD   = 0;
+static constexpr uint8_t CODEC_STORED = 1;  // Raw bytes at a page-aligned offset
+
+static constexpr size_t STORED_ALIGNMENT = 4096;
+
+// Per-entry flags (container v3+, reserved in v2). config.json takes its
+// flags from the header's reserved word.
+static constexpr uint8_t ENTRY_FLAG_LONG       = 0x01;  // Frames may need a window above zstd's default limit
+static constexpr uint8_t ENTRY_FLAG_DICT       = 0x02;  // Compressed against the bundle dictionary
+static constexpr uint8_t ENTRY_FLAG_DICTIONARY = 0x04;  // The bundle dictionary itself, never extracted
 
 // -----------------------------------------------------------------------------
 // Metadata for each section inside the bundle
@@ -21,6 +35,26 @@ struct Entry {
     uint64_t    comp_length; // Length in bytes of the compressed data
     uint64_t    raw_length;  // Expected size after decompression
     uint32_t    crc32;       // CRC32 checksum of the compressed data
+    uint8_t     codec = CODEC_ZSTD;
+    uint8_t     flags = 0;   // ENTRY_FLAG_*
+};
+
+// -----------------------------------------------------------------------------
+// Independent zstd frame inside a section
+//
+// Large sections may be stored as several frames followed by a seek table in
+// zstd's seekable format (a skippable frame ending with SEEKABLE_MAGIC), so
+// they can be decompressed in parallel at non-overlapping output offsets.
+// Decoders without seek table support simply skip the skippable frame.
+// -----------------------------------------------------------------------------
+static constexpr uint32_t SKIPPABLE_MAGIC = 0x184D2A5E;
+static constexpr uint32_t SEEKABLE_MAGIC  = 0x8F92EAB1;
+
+struct Frame {
+    uint64_t comp_offset;    // Offset relative to the section start
+    uint64_t comp_length;
+    uint64_t raw_offset;     // Offset inside the decompressed section
+    uint64_t raw_length;
 };
 
 // -----------------------------------------------------------------------------
@@ -29,10 +63,16 @@ struct Entry {
 class MemoryMap {
 public:
     MemoryMap(const std::string &path);
+    // Maps the current contents of a file opened for reading, through a
+    // duplicate of its descriptor (the path may be gone or replaced)
+    explicit MemoryMap(std::FILE *file);
     ~MemoryMap();
 
     const uint8_t *data() const;
     size_t         size() const;
+#ifndef _WIN32
+    int            fd() const;
+#endif
 
 private:
     const uint8_t *data_;
@@ -45,6 +85,79 @@ private:
 #endif
 };
 
+// -----------------------------------------------------------------------------
+// Output strategy used when writing decompressed sections
+// -----------------------------------------------------------------------------
+enum class WriteMode {
+    Auto,   // Mmap on POSIX, Stream elsewhere
+    Stream, // Buffered std::ofstream (portable fallback)
+    Mmap,   // Preallocate and decompress straight into a shared writable mapping
+    Pwrite, // Preallocate and flush large aligned buffers with pwrite()
+    Direct, // Pwrite with O_DIRECT so large unpacks bypass the page cache
+};
+
+// Parses "auto" | "stream" | "mmap" | "pwrite" | "direct"
+WriteMode parseWriteMode(const std::string &name);
+
+// -----------------------------------------------------------------------------
+// Pluggable sink for one contiguous region of a decompressed section
+//
+// The decompressor asks for a writable window, fills part of it and commits
+// the bytes it produced.
+// -----------------------------------------------------------------------------
+class SectionWriter {
+public:
+    virtual ~SectionWriter() = default;
+
+    // Writable window at the current position (capacity 0 once full)
+    virtual uint8_t *window(size_t &capacity) = 0;
+    virtual void     commit(size_t bytes) = 0;
+    // Flushes and validates the number of bytes written to the region
+    virtual void     finish() = 0;
+};
+
+// -----------------------------------------------------------------------------
+// Output file for one section, preallocated from its raw length
+//
+// Regions may be written concurrently from different threads as long as they
+// don't overlap. Data goes to "<path>.part" and commit() renames it into
+// place, so an interrupted unpack never leaves a preallocated file that
+// looks complete.
+// -----------------------------------------------------------------------------
+class SectionOutput {
+public:
+    /**
+     * @param path Final output path
+     * @param size Expected raw size, or 0 when unknown (forces Stream)
+     * @param mode Requested strategy; unsupported modes fall back to Stream
+     */
+    SectionOutput(const std::string &path, uint64_t size, WriteMode mode);
+    ~SectionOutput();
+
+    SectionOutput(const SectionOutput &) = delete;
+    SectionOutput &operator=(const SectionOutput &) = delete;
+
+    // Writer for [offset, offset + length); length 0 means "until EOF"
+    std::unique_ptr<SectionWriter> region(uint64_t offset, uint64_t length);
+    // Copies raw bytes from the bundle, preferring reflink, copy_file_range()
+    // and sendfile() over a userspace copy
+    void copyRegion(const MemoryMap &src, uint64_t srcOffset,
+                    uint64_t dstOffset, uint64_t length);
+    // Publishes the file once every region has finished
+    void commit();
+
+private:
+    std::string path_;
+    std::string part_;
+    uint64_t    size_;
+    WriteMode   mode_;
+    bool        committed_ = false;
+#ifndef _WIN32
+    int         fd_        = -1;
+    uint8_t    *map_       = nullptr;
+#endif
+};
+
 // -----------------------------------------------------------------------------
 // Simple thread pool for executing tasks in parallel
 // -----------------------------------------------------------------------------
@@ -65,14 +178,23 @@ private:
 // Public API: unpack function only
 // -----------------------------------------------------------------------------
 
+struct UnpackOptions {
+    WriteMode write_mode         = WriteMode::Auto;
+    size_t    n_threads          = 0;          // 0 = hardware concurrency
+    uint64_t  max_inflight_bytes = 1ull << 30; // Raw bytes being written at once, 0 = unbounded
+};
+
 /**
  * unpackModel
  *
  * Extracts all sections from a bundled file into the specified output directory.
- * Performs CRC validation and uses a thread pool to decompress sections in parallel.
+ * Performs CRC validation and decompresses sections in parallel on a thread pool
+ * shared by the whole process, largest sections first.
  *
  * @param bundlePath Path to the input bundle file
  * @param outDir     Directory where extracted files will be written
+ * @param options    Output strategy and tuning knobs
  */
 void unpackModel(const std::string &bundlePath,
-                 const std::string &outDir);
+                 const std::string &outDir,
+                 const UnpackOptions &options = {});
@@ -0,0 +1,615 @@
+#include "vector_index.h"
+#include "trace.h"
+#include "unpack.h"
+#include <algorithm>
+#include <cmath>
+#include <cstring>
+#include <filesystem>
+#include <fstream>
+#include <mutex>
+#include <queue>
+#include <stdexcept>
+
+namespace fs = std::filesystem;
+static constexpr size_t HEADER_SIZE = 64;
+static constexpr size_t SECTION_ALIGNMENT = 64;
+static constexpr int    MAX_LEVEL = 16;
+static constexpr uint32_t MAX_DIM = 1u << 16;
+static constexpr uint32_t MAX_M   = 1u << 16;
+
+namespace {
+
+template<typename T>
+void writeLE(uint8_t *ptr, T value) {
+    std::memcpy(ptr, &value, sizeof(T));
+}
+
+template<typename T>
+T readLE(const uint8_t *ptr) {
+    T val;
+    std::memcpy(&val, ptr, sizeof(T));
+    return val;
+}
+
+uint64_t alignUp(uint64_t value) {
+    return (value + SECTION_ALIGNMENT - 1) & ~static_cast<uint64_t>(SECTION_ALIGNMENT - 1);
+}
+
+// Section offsets of the file format, see vector_index.h
+struct Layout {
+    uint64_t rows, scales, levels, links0, upper, end;
+};
+
+Layout fileLayout(const VectorIndexOptions &options, uint64_t count, uint64_t upperWords) {
+    Layout layout;
+    layout.rows = HEADER_SIZE;
+    uint64_t pos = alignUp(layout.rows + count * options.dim * embeddingElementSize(options.type));
+    layout.scales = pos;
+    if (options.type == EmbeddingType::Int8) pos = alignUp(pos + count * sizeof(float));
+    layout.levels = layout.links0 = layout.upper = pos;
+    if (options.kind == VectorIndexKind::Hnsw) {
+        pos = alignUp(pos + count);
+        layout.links0 = pos;
+        pos = alignUp(pos + count * (1 + 2 * static_cast<uint64_t>(options.m)) * sizeof(uint32_t));
+        layout.upper = pos;
+        pos += upperWords * sizeof(uint32_t);
+    }
+    layout.end = pos;
+    return layout;
+}
+
+// Visit marks reused by the searches of one thread; bumping the epoch clears them
+struct VisitedSet {
+    std::vector<uint32_t> marks;
+    uint32_t              epoch = 0;
+
+    void reset(size_t count) {
+        if (marks.size() < count) marks.resize(count, 0);
+        if (++epoch == 0) {
+            std::fill(marks.begin(), marks.end(), 0);
+            epoch = 1;
+        }
+    }
+    bool insert(uint32_t id) {
+        if (marks[id] == epoch) return false;
+        marks[id] = epoch;
+        return true;
+    }
+};
+
+thread_local VisitedSet visited;
+
+void writePadded(std::ofstream &out, const void *data, size_t size, uint64_t &pos) {
+    static const char zeros[SECTION_ALIGNMENT] = {};
+    if (size > 0) out.write(static_cast<const char *>(data), static_cast<std::streamsize>(size));
+    pos += size;
+    uint64_t aligned = alignUp(pos);
+    out.write(zeros, static_cast<std::streamsize>(aligned - pos));
+    pos = aligned;
+}
+
+} // namespace
+
+VectorMetric parseVectorMetric(const std::string &name) {
+    if (name.empty() || name == "cosine") return VectorMetric::Cosine;
+    if (name == "dot") return VectorMetric::Dot;
+    throw std::runtime_error("Unknown metric: " + name);
+}
+
+VectorIndexKind parseVectorIndexKind(const std::string &name) {
+    if (name.empty() || name == "flat") return VectorIndexKind::Flat;
+    if (name == "hnsw") return VectorIndexKind::Hnsw;
+    throw std::runtime_error("Unknown index type: " + name);
+}
+
+VectorIndex::VectorIndex(const VectorIndexOptions &options)
+    : options_(options), rowBytes_(options.dim * embeddingElementSize(options.type)) {
+    if (options_.dim == 0 || options_.dim > MAX_DIM) {
+        throw std::runtime_error("Vector index dim must be between 1 and " + std::to_string(MAX_DIM));
+    }
+    if (options_.m < 2 || options_.m > MAX_M) {
+        throw std::runtime_error("Vector index m must be between 2 and " + std::to_string(MAX_M));
+    }
+    options_.ef_construction = std::max(options_.ef_construction, options_.m);
+    options_.ef_search = std::max<uint32_t>(options_.ef_search, 1);
+}
+
+VectorIndex::~VectorIndex() = default;
+
+size_t VectorIndex::size() const {
+    std::shared_lock<std::shared_mutex> lock(mutex_);
+    return count_;
+}
+
+float VectorIndex::score(const float *query, uint32_t id) const {
+    switch (options_.type) {
+    case EmbeddingType::Float16:
+        return dotF16(query, reinterpret_cast<const uint16_t *>(row(id)), options_.dim);
+    case EmbeddingType::Int8:
+        return dotI8(query, reinterpret_cast<const int8_t *>(row(id)), options_.dim) * scales_[id];
+    default:
+        return dotF32(query, reinterpret_cast<const float *>(row(id)), options_.dim);
+    }
+}
+
+void VectorIndex::decode(uint32_t id, float *out) const {
+    switch (options_.type) {
+    case EmbeddingType::Float16:
+        fromFloat16(reinterpret_cast<const uint16_t *>(row(id)), options_.dim, out);
+        break;
+    case EmbeddingType::Int8:
+        fromInt8(reinterpret_cast<const int8_t *>(row(id)), options_.dim, scales_[id], out);
+        break;
+    default:
+        std::memcpy(out, row(id), rowBytes_);
+        break;
+    }
+}
+
+void VectorIndex::reserve(size_t count) {
+    if (count_ + count > UINT32_MAX) throw std::runtime_error("Vector index is full");
+    // Geometric growth, so that many small adds stay amortized
+    auto grow = [](auto &vec, size_t needed) {
+        if (needed > vec.capacity()) vec.reserve(std::max(needed, vec.capacity() * 2));
+    };
+    size_t rows = count_ + count;
+    grow(ownedRows_, rows * rowBytes_);
+    if (options_.type == EmbeddingType::Int8) grow(ownedScales_, rows);
+    if (options_.kind == VectorIndexKind::Hnsw) {
+        grow(ownedLinks0_, rows * (1 + 2 * options_.m));
+        grow(levels_, rows);
+        grow(upper_, rows);
+    }
+}
+
+void VectorIndex::materialize() {
+    if (!map_) return;
+    ownedRows_.assign(rows_, rows_ + count_ * rowBytes_);
+    if (options_.type == EmbeddingType::Int8) ownedScales_.assign(scales_, scales_ + count_);
+    if (options_.kind == VectorIndexKind::Hnsw) {
+        ownedLinks0_.assign(links0_, links0_ + count_ * (1 + 2 * options_.m));
+    }
+    rows_ = ownedRows_.data();
+    scales_ = ownedScales_.data();
+    links0_ = ownedLinks0_.data();
+    map_.reset();
+}
+
+void VectorIndex::append(const uint8_t *encoded, float scale, const float *values) {
+    uint32_t id = static_cast<uint32_t>(count_);
+    ownedRows_.insert(ownedRows_.end(), encoded, encoded + rowBytes_);
+    rows_ = ownedRows_.data();
+    if (options_.type == EmbeddingType::Int8) {
+        ownedScales_.push_back(scale);
+        scales_ = ownedScales_.data();
+    }
+    count_++;
+    if (options_.kind == VectorIndexKind::Hnsw) insert(id, values);
+}
+
+uint32_t VectorIndex::add(const float *rows, size_t count) {
+    trace::Span span("vector_index_add", std::to_string(count) + " rows");
+    std::unique_lock<std::shared_mutex> lock(mutex_);
+    materialize();
+    reserve(count);
+    uint32_t first = static_cast<uint32_t>(count_);
+    EmbeddingOptions encode;
+    encode.normalize = options_.metric == VectorMetric::Cosine;
+    encode.type = options_.type;
+    uint32_t dims[1] = {options_.dim};
+    std::vector<uint8_t> encoded(rowBytes_);
+    std::vector<float> scratch, values(options_.dim);
+    for (size_t i = 0; i < count; ++i) {
+        float scale = convertEmbedding(rows + i * options_.dim, dims, 1, encode, encoded.data(), scratch);
+        // The graph is built from the stored (possibly quantized) values
+        if (options_.kind == VectorIndexKind::Hnsw && options_.type != EmbeddingType::Float32) {
+            if (options_.type == EmbeddingType::Int8) {
+                fromInt8(reinterpret_cast<const int8_t *>(encoded.data()), options_.dim, scale, values.data());
+            } else {
+                fromFloat16(reinterpret_cast<const uint16_t *>(encoded.data()), options_.dim, values.data());
+            }
+            append(encoded.data(), scale, values.data());
+        } else {
+            append(encoded.data(), scale, reinterpret_cast<const float *>(encoded.data()));
+        }
+    }
+    return first;
+}
+
+uint32_t VectorIndex::addEncoded(const uint8_t *rows, size_t count, const float *scales,
+                                 bool normalized) {
+    if (options_.metric == VectorMetric::Cosine && !normalized) {
+        std::vector<float> values(count * options_.dim);
+        for (size_t i = 0; i < count; ++i) {
+            const uint8_t *src = rows + i * rowBytes_;
+            float *dst = values.data() + i * options_.dim;
+            switch (options_.type) {
+            case EmbeddingType::Float16:
+                fromFloat16(reinterpret_cast<const uint16_t *>(src), options_.dim, dst);
+                break;
+            case EmbeddingType::Int8:
+                fromInt8(reinterpret_cast<const int8_t *>(src), options_.dim, scales[i], dst);
+                break;
+            default:
+                std::memcpy(dst, src, rowBytes_);
+                break;
+            }
+        }
+        return add(values.data(), count);
+    }
+    trace::Span span("vector_index_add", std::to_string(count) + " rows");
+    std::unique_lock<std::shared_mutex> lock(mutex_);
+    materialize();
+    reserve(count);
+    uint32_t first = static_cast<uint32_t>(count_);
+    std::vector<float> values(options_.dim);
+    for (size_t i = 0; i < count; ++i) {
+        const uint8_t *src = rows + i * rowBytes_;
+        float scale = options_.type == EmbeddingType::Int8 ? scales[i] : 1.0f;
+        if (options_.kind == VectorIndexKind::Hnsw) {
+            switch (options_.type) {
+            case EmbeddingType::Float16:
+                fromFloat16(reinterpret_cast<const uint16_t *>(src), options_.dim, values.data());
+                break;
+            case EmbeddingType::Int8:
+                fromInt8(reinterpret_cast<const int8_t *>(src), options_.dim, scale, values.data());
+                break;
+            default:
+                std::memcpy(values.data(), src, rowBytes_);
+                break;
+            }
+        }
+        append(src, scale, values.data());
+    }
+    return first;
+}
+
+std::vector<SearchHit> VectorIndex::search(const float *query, size_t k, uint32_t ef) const {
+    trace::Span span("vector_index_search");
+    std::shared_lock<std::shared_mutex> lock(mutex_);
+    std::vector<SearchHit> hits;
+    if (count_ == 0 || k == 0) return hits;
+    std::vector<float> normalized;
+    if (options_.metric == VectorMetric::Cosine) {
+        normalized.assign(query, query + options_.dim);
+        l2Normalize(normalized.data(), normalized.size());
+        query = normalized.data();
+    }
+
+    std::vector<Candidate> top;
+    if (options_.kind == VectorIndexKind::Flat) {
+        // Min-heap of the best k so far
+        auto worse = [](const Candidate &a, const Candidate &b) { return a.score > b.score; };
+        top.reserve(std::min(k, count_) + 1);
+        for (uint32_t id = 0; id < count_; ++id) {
+            float s = score(query, id);
+            if (top.size() < k) {
+                top.push_back({s, id});
+                std::push_heap(top.begin(), top.end(), worse);
+            } else if (s > top.front().score) {
+                std::pop_heap(top.begin(), top.end(), worse);
+                top.back() = {s, id};
+                std::push_heap(top.begin(), top.end(), worse);
+            }
+        }
+        std::sort(top.begin(), top.end(), [](const Candidate &a, const Candidate &b) {
+            return a.score > b.score;
+        });
+    } else {
+        Candidate entry{score(query, entry_), entry_};
+        for (int level = maxLevel_; level > 0; --level) {
+            entry = closest(query, entry, level);
+        }
+        size_t candidates = std::max<size_t>(k, ef ? ef : options_.ef_search);
+        top = searchLayer(query, {entry}, candidates, 0);
+        if (top.size() > k) top.resize(k);
+    }
+    hits.reserve(top.size());
+    for (const Candidate &c : top) hits.push_back({c.id, c.score});
+    return hits;
+}
+
+// -----------------------------------------------------------------------------
+// HNSW
+// -----------------------------------------------------------------------------
+
+uint32_t *VectorIndex::links(uint32_t id, int level) {
+    if (level == 0) return ownedLinks0_.data() + static_cast<size_t>(id) * (1 + 2 * options_.m);
+    return upper_[id].data() + static_cast<size_t>(level - 1) * (1 + options_.m);
+}
+
+const uint32_t *VectorIndex::links(uint32_t id, int level) const {
+    if (level == 0) return links0_ + static_cast<size_t>(id) * (1 + 2 * options_.m);
+    return upper_[id].data() + static_cast<size_t>(level - 1) * (1 + options_.m);
+}
+
+int VectorIndex::randomLevel() {
+    std::uniform_real_distribution<double> uniform(0.0, 1.0);
+    double r = std::max(uniform(rng_), 1e-12);
+    int level = static_cast<int>(-std::log(r) / std::log(static_cast<double>(options_.m)));
+    return std::min(level, MAX_LEVEL);
+}
+
+VectorIndex::Candidate VectorIndex::closest(const float *query, Candidate entry, int level) const {
+    bool changed = true;
+    while (changed) {
+        changed = false;
+        const uint32_t *l = links(entry.id, level);
+        for (uint32_t j = 1; j <= l[0]; ++j) {
+            float s = score(query, l[j]);
+            if (s > entry.score) {
+                entry = {s, l[j]};
+                changed = true;
+            }
+        }
+    }
+    return entry;
+}
+
+std::vector<VectorIndex::Candidate>
+VectorIndex::searchLayer(const float *query, const std::vector<Candidate> &entries, size_t ef,
+                         int level) const {
+    auto closer = [](const Candidate &a, const Candidate &b) { return a.score < b.score; };
+    auto worse = [](const Candidate &a, const Candidate &b) { return a.score > b.score; };
+    std::priority_queue<Candidate, std::vector<Candidate>, decltype(closer)> candidates(closer);
+    std::priority_queue<Candidate, std::vector<Candidate>, decltype(worse)> results(worse);
+    visited.reset(count_);
+    for (const Candidate &entry : entries) {
+        if (!visited.insert(entry.id)) continue;
+        candidates.push(entry);
+        results.push(entry);
+        if (results.size() > ef) results.pop();
+    }
+    while (!candidates.empty()) {
+        Candidate current = candidates.top();
+        if (results.size() >= ef && current.score < results.top().score) break;
+        candidates.pop();
+        const uint32_t *l = links(current.id, level);
+        for (uint32_t j = 1; j <= l[0]; ++j) {
+            uint32_t neighbor = l[j];
+            if (!visited.insert(neighbor)) continue;
+            float s = score(query, neighbor);
+            if (results.size() < ef || s > results.top().score) {
+                candidates.push({s, neighbor});
+                results.push({s, neighbor});
+                if (results.size() > ef) results.pop();
+            }
+        }
+    }
+    std::vector<Candidate> out(results.size());
+    for (size_t i = out.size(); i-- > 0;) {
+        out[i] = results.top();
+        results.pop();
+    }
+    return out;
+}
+
+// Keeps a candidate only if it is closer to the base than to every neighbor
+// kept so far, which spreads links across directions (heuristic of the paper)
+std::vector<VectorIndex::Candidate>
+VectorIndex::selectNeighbors(const std::vector<Candidate> &candidates, size_t m) const {
+    if (candidates.size() <= m) return candidates;
+    std::vector<Candidate> selected;
+    std::vector<float> values(options_.dim);
+    for (const Candidate &candidate : candidates) {
+        decode(candidate.id, values.data());
+        bool keep = true;
+        for (const Candidate &other : selected) {
+            if (score(values.data(), other.id) > candidate.score) {
+                keep = false;
+                break;
+            }
+        }
+        if (keep) selected.push_back(candidate);
+        if (selected.size() >= m) break;
+    }
+    return selected;
+}
+
+void VectorIndex::connect(uint32_t from, uint32_t to, float s, int level) {
+    uint32_t *l = links(from, level);
+    uint32_t max = maxLinks(level);
+    if (l[0] < max) {
+        l[1 + l[0]++] = to;
+        return;
+    }
+    std::vector<float> values(options_.dim);
+    decode(from, values.data());
+    std::vector<Candidate> candidates;
+    candidates.reserve(max + 1);
+    candidates.push_back({s, to});
+    for (uint32_t j = 1; j <= l[0]; ++j) candidates.push_back({score(values.data(), l[j]), l[j]});
+    std::sort(candidates.begin(), candidates.end(), [](const Candidate &a, const Candidate &b) {
+        return a.score > b.score;
+    });
+    std::vector<Candidate> selected = selectNeighbors(candidates, max);
+    l[0] = static_cast<uint32_t>(selected.size());
+    for (size_t j = 0; j < selected.size(); ++j) l[1 + j] = selected[j].id;
+}
+
+void VectorIndex::insert(uint32_t id, const float *values) {
+    int level = randomLevel();
+    levels_.push_back(static_cast<uint8_t>(level));
+    upper_.emplace_back(static_cast<size_t>(level) * (1 + options_.m), 0);
+    ownedLinks0_.resize(ownedLinks0_.size() + 1 + 2 * options_.m, 0);
+    links0_ = ownedLinks0_.data();
+    if (maxLevel_ < 0) {
+        entry_ = id;
+        maxLevel_ = level;
+        return;
+    }
+    Candidate entry{score(values, entry_), entry_};
+    for (int l = maxLevel_; l > level; --l) {
+        entry = closest(values, entry, l);
+    }
+    std::vector<Candidate> entries{entry};
+    for (int l = std::min(level, maxLevel_); l >= 0; --l) {
+        std::vector<Candidate> found = searchLayer(values, entries, options_.ef_construction, l);
+        std::vector<Candidate> neighbors = selectNeighbors(found, options_.m);
+        uint32_t *own = links(id, l);
+        own[0] = static_cast<uint32_t>(neighbors.size());
+        for (size_t j = 0; j < neighbors.size(); ++j) own[1 + j] = neighbors[j].id;
+        for (const Candidate &neighbor : neighbors) {
+            connect(neighbor.id, id, neighbor.score, l);
+        }
+        entries = std::move(found);
+    }
+    if (level > maxLevel_) {
+        entry_ = id;
+        maxLevel_ = level;
+    }
+}
+
+// -----------------------------------------------------------------------------
+// Files
+// -----------------------------------------------------------------------------
+
+void VectorIndex::save(const std::string &path) const {
+    trace::Span span("vector_index_save", path);
+    std::shared_lock<std::shared_mutex> lock(mutex_);
+    bool hnsw = options_.kind == VectorIndexKind::Hnsw;
+    uint64_t upperWords = 0;
+    if (hnsw) {
+        for (const auto &links : upper_) upperWords += links.size();
+    }
+
+    uint8_t header[HEADER_SIZE] = {};
+    std::memcpy(header, VECTOR_INDEX_MAGIC, sizeof(VECTOR_INDEX_MAGIC));
+    writeLE<uint16_t>(header + 8, VECTOR_INDEX_VERSION);
+    header[10] = static_cast<uint8_t>(options_.type);
+    header[11] = static_cast<uint8_t>(options_.metric);
+    header[12] = static_cast<uint8_t>(options_.kind);
+    writeLE<uint32_t>(header + 16, options_.dim);
+    writeLE<uint32_t>(header + 20, options_.m);
+    writeLE<uint32_t>(header + 24, options_.ef_construction);
+    writeLE<uint32_t>(header + 28, options_.ef_search);
+    writeLE<uint64_t>(header + 32, count_);
+    writeLE<uint32_t>(header + 40, entry_);
+    writeLE<int32_t>(header + 44, maxLevel_);
+    writeLE<uint64_t>(header + 48, upperWords);
+
+    std::string tmpPath = path + ".tmp";
+    {
+        std::ofstream out(tmpPath, std::ios::binary | std::ios::trunc);
+        if (!out) throw std::runtime_error("Failed to write vector index: " + path);
+        uint64_t pos = 0;
+        writePadded(out, header, sizeof(header), pos);
+        writePadded(out, rows_, count_ * rowBytes_, pos);
+        if (options_.type == EmbeddingType::Int8) {
+            writePadded(out, scales_, count_ * sizeof(float), pos);
+        }
+        if (hnsw) {
+            writePadded(out, levels_.data(), levels_.size(), pos);
+            writePadded(out, links0_, count_ * (1 + 2 * options_.m) * sizeof(uint32_t), pos);
+            for (const auto &links : upper_) {
+                if (!links.empty()) {
+                    out.write(reinterpret_cast<const char *>(links.data()),
+                              static_cast<std::streamsize>(links.size() * sizeof(uint32_t)));
+                }
+            }
+        }
+        out.flush();
+        if (!out) {
+            out.close();
+            fs::remove(tmpPath);
+            throw std::runtime_error("Failed to write vector index: " + path);
+        }
+    }
+    fs::rename(tmpPath, path);
+}
+
+std::unique_ptr<VectorIndex> VectorIndex::load(const std::string &path) {
+    trace::Span span("vector_index_load", path);
+    std::unique_ptr<MemoryMap> map;
+    try {
+        map = std::make_unique<MemoryMap>(path);
+    } catch (const std::runtime_error &) {
+        throw std::runtime_error("Failed to open vector index: " + path);
+    }
+    const uint8_t *data = map->data();
+    size_t size = map->size();
+    if (size < HEADER_SIZE || std::memcmp(data, VECTOR_INDEX_MAGIC, sizeof(VECTOR_INDEX_MAGIC)) != 0) {
+        throw std::runtime_error("Invalid vector index file");
+    }
+    uint16_t version = readLE<uint16_t>(data + 8);
+    if (version == 0 || version > VECTOR_INDEX_VERSION) {
+        throw std::runtime_error("Unsupported vector index version: " + std::to_string(version));
+    }
+    if (data[10] > static_cast<uint8_t>(EmbeddingType::Int8) ||
+        data[11] > static_cast<uint8_t>(VectorMetric::Cosine) ||
+        data[12] > static_cast<uint8_t>(VectorIndexKind::Hnsw)) {
+        throw std::runtime_error("Invalid vector index file");
+    }
+    VectorIndexOptions options;
+    options.type = static_cast<EmbeddingType>(data[10]);
+    options.metric = static_cast<VectorMetric>(data[11]);
+    options.kind = static_cast<VectorIndexKind>(data[12]);
+    options.dim = readLE<uint32_t>(data + 16);
+    options.m = readLE<uint32_t>(data + 20);
+    options.ef_construction = readLE<uint32_t>(data + 24);
+    options.ef_search = readLE<uint32_t>(data + 28);
+    uint64_t count = readLE<uint64_t>(data + 32);
+    uint32_t entry = readLE<uint32_t>(data + 40);
+    int32_t maxLevel = readLE<int32_t>(data + 44);
+    uint64_t upperWords = readLE<uint64_t>(data + 48);
+    if (options.dim == 0 || options.dim > MAX_DIM || options.dim > size ||
+        options.m < 2 || options.m > MAX_M) {
+        throw std::runtime_error("Invalid vector index file");
+    }
+    auto index = std::make_unique<VectorIndex>(options);
+    const VectorIndex &graph = *index;
+
+    // Bound the counts by the file size before computing offsets from them
+    uint64_t linkBytes = (1 + 2 * static_cast<uint64_t>(options.m)) * sizeof(uint32_t);
+    if (count > UINT32_MAX || count > size / index->rowBytes_ || upperWords > size ||
+        (options.kind == VectorIndexKind::Hnsw && count > size / linkBytes)) {
+        throw std::runtime_error("Truncated vector index file");
+    }
+    Layout layout = fileLayout(options, count, upperWords);
+    if (layout.end > size) throw std::runtime_error("Truncated vector index file");
+
+    index->count_ = count;
+    index->rows_ = data + layout.rows;
+    if (options.type == EmbeddingType::Int8) {
+        index->scales_ = reinterpret_cast<const float *>(data + layout.scales);
+    }
+    if (options.kind == VectorIndexKind::Hnsw) {
+        const uint32_t max0 = 2 * options.m;
+        index->links0_ = reinterpret_cast<const uint32_t *>(data + layout.links0);
+        index->levels_.assign(data + layout.levels, data + layout.levels + count);
+        const uint32_t *upper = reinterpret_cast<const uint32_t *>(data + layout.upper);
+        uint64_t used = 0;
+        index->upper_.resize(count);
+        for (uint64_t id = 0; id < count; ++id) {
+            uint8_t level = index->levels_[id];
+            size_t words = static_cast<size_t>(level) * (1 + options.m);
+            if (level > MAX_LEVEL || used + words > upperWords) {
+                throw std::runtime_error("Invalid vector index graph");
+            }
+            index->upper_[id].assign(upper + used, upper + used + words);
+            used += words;
+            // Links are followed without bounds checks while searching, and
+            // only to nodes that have links on that level too
+            for (int l = 0; l <= level; ++l) {
+                const uint32_t *links = graph.links(static_cast<uint32_t>(id), l);
+                if (links[0] > (l == 0 ? max0 : options.m)) {
+                    throw std::runtime_error("Invalid vector index graph");
+                }
+                for (uint32_t j = 1; j <= links[0]; ++j) {
+                    if (links[j] >= count || index->levels_[links[j]] < l) {
+                        throw std::runtime_error("Invalid vector index graph");
+                    }
+                }
+            }
+        }
+        if (used != upperWords ||
+            (count > 0 && (entry >= count || maxLevel != index->levels_[entry])) ||
+            (count == 0 && maxLevel != -1)) {
+            throw std::runtime_error("Invalid vector index graph");
+        }
+        index->entry_ = entry;
+        index->maxLevel_ = maxLevel;
+    }
+    index->map_ = std::move(map);
+    return index;
+}
@@ -0,0 +1,140 @@
+#pragma once
+
+#include "embedding_ops.h"
+#include <cstdint>
+#include <memory>
+#include <random>
+#include <shared_mutex>
+#include <string>
+#include <vector>
+
+class MemoryMap;
+
+// -----------------------------------------------------------------------------
+// In-process vector index
+//
+// Rows are stored as float32, float16 or int8 (one scale per row) and scored
+// by dot product against a float query; cosine indexes L2-normalize rows and
+// queries first. Flat indexes scan every row, HNSW indexes walk a
+// hierarchical navigable small world graph (Malkov & Yashunin).
+//
+// Searches take a shared lock and can run on several threads at once; adds
+// take an exclusive one.
+//
+// File format (little-endian), every section starting at a 64-byte boundary
+// so a loaded index reads rows and level-0 links straight from the mapping:
+//   Header (64 bytes): "QVIDX1\0\0", u16 version, u8 type, u8 metric, u8 kind,
+//                      u8 reserved[3], u32 dim, u32 m, u32 ef_construction,
+//                      u32 ef_search, u64 count, u32 entry, i32 max_level,
+//                      u64 upper_words, u64 reserved
+//   Rows:              count x dim elements of type
+//   Scales:            count x f32 (int8 only)
+//   Levels:            count x u8 (HNSW only)
+//   Level-0 links:     count x (1 + 2m) u32, neighbor count then ids (HNSW only)
+//   Upper links:       upper_words u32, level x (1 + m) per node in id order (HNSW only)
+// -----------------------------------------------------------------------------
+
+static constexpr char VECTOR_INDEX_MAGIC[8] = {'Q','V','I','D','X','1','\0','\0'};
+static constexpr uint16_t VECTOR_INDEX_VERSION = 1;
+
+enum class VectorMetric {
+    Dot,
+    Cosine,
+};
+
+enum class VectorIndexKind {
+    Flat,  // Exact
+    Hnsw,  // Approximate
+};
+
+struct VectorIndexOptions {
+    uint32_t        dim             = 0;
+    EmbeddingType   type            = EmbeddingType::Float32;
+    VectorMetric    metric          = VectorMetric::Cosine;
+    VectorIndexKind kind            = VectorIndexKind::Flat;
+    uint32_t        m               = 16;   // HNSW links per node, twice that on level 0
+    uint32_t        ef_construction = 200;  // HNSW candidates while inserting
+    uint32_t        ef_search       = 64;   // HNSW candidates while searching
+};
+
+struct SearchHit {
+    uint32_t id;
+    float    score;  // Higher is closer
+};
+
+// Throws std::runtime_error on unknown names
+VectorMetric    parseVectorMetric(const std::string &name);     // dot, cosine
+VectorIndexKind parseVectorIndexKind(const std::string &name);  // flat, hnsw
+
+class VectorIndex {
+public:
+    explicit VectorIndex(const VectorIndexOptions &options);
+    ~VectorIndex();
+
+    // Maps an index written by save(); the mapping is copied on the first add
+    static std::unique_ptr<VectorIndex> load(const std::string &path);
+
+    const VectorIndexOptions &options() const { return options_; }
+    size_t size() const;
+
+    // Appends count float rows; returns the id of the first
+    uint32_t add(const float *rows, size_t count);
+    // Appends count rows already in options().type, with one scale per row
+    // for int8. normalized tells whether a cosine index can skip normalizing.
+    uint32_t addEncoded(const uint8_t *rows, size_t count, const float *scales, bool normalized);
+
+    // Top k rows by descending score; ef overrides ef_search when non-zero
+    std::vector<SearchHit> search(const float *query, size_t k, uint32_t ef = 0) const;
+
+    // Writes through path.tmp and a rename
+    void save(const std::string &path) const;
+
+private:
+    struct Candidate {
+        float    score;
+        uint32_t id;
+    };
+
+    const uint8_t *row(uint32_t id) const { return rows_ + static_cast<size_t>(id) * rowBytes_; }
+    float score(const float *query, uint32_t id) const;
+    void  decode(uint32_t id, float *out) const;
+    void  reserve(size_t count);
+    void  materialize();
+    void  append(const uint8_t *encoded, float scale, const float *values);
+
+    // HNSW
+    uint32_t *links(uint32_t id, int level);
+    const uint32_t *links(uint32_t id, int level) const;
+    uint32_t maxLinks(int level) const { return level == 0 ? 2 * options_.m : options_.m; }
+    int  randomLevel();
+    // Greedy walk to the closest node on one level
+    Candidate closest(const float *query, Candidate entry, int level) const;
+    void insert(uint32_t id, const float *values);
+    std::vector<Candidate> searchLayer(const float *query, const std::vector<Candidate> &entries,
+                                       size_t ef, int level) const;
+    std::vector<Candidate> selectNeighbors(const std::vector<Candidate> &candidates,
+                                           size_t m) const;
+    void connect(uint32_t from, uint32_t to, float score, int level);
+
+    VectorIndexOptions options_;
+    size_t             rowBytes_;
+    size_t             count_ = 0;
+
+    // Rows, scales and level-0 links point into the owned vectors, or into
+    // map_ for a loaded index until it is modified
+    std::unique_ptr<MemoryMap> map_;
+    const uint8_t  *rows_   = nullptr;
+    const float    *scales_ = nullptr;
+    const uint32_t *links0_ = nullptr;
+    std::vector<uint8_t>  ownedRows_;
+    std::vector<float>    ownedScales_;
+    std::vector<uint32_t> ownedLinks0_;
+
+    std::vector<uint8_t>               levels_;
+    std::vector<std::vector<uint32_t>> upper_;  // level x (1 + m) per node
+    uint32_t     entry_    = 0;
+    int          maxLevel_ = -1;
+    std::mt19937 rng_{42};
+
+    mutable std::shared_mutex mutex_;
+};
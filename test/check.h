@@ -0,0 +1,76 @@
+#pragma once
+
+#include <cstdio>
+#include <cstdlib>
+#include <filesystem>
+#include <fstream>
+#include <iterator>
+#include <stdexcept>
+#include <string>
+#include <vector>
+
+// Minimal assertions for the standalone tests: a failed check prints its
+// location and exits non-zero, which ctest reports as a failure.
+
+#define CHECK(condition)                                                        \
+    do {                                                                        \
+        if (!(condition)) {                                                     \
+            std::fprintf(stderr, "%s:%d: CHECK(%s) failed\n", __FILE__,         \
+                         __LINE__, #condition);                                 \
+            std::exit(1);                                                       \
+        }                                                                       \
+    } while (0)
+
+// Checks that statement throws a std::runtime_error whose message contains
+// text
+#define CHECK_THROWS(statement, text)                                           \
+    do {                                                                        \
+        bool threw_ = false;                                                    \
+        std::string message_;                                                   \
+        try {                                                                   \
+            statement;                                                          \
+        } catch (const std::runtime_error &e) {                                 \
+            threw_ = true;                                                      \
+            message_ = e.what();                                                \
+        }                                                                       \
+        if (!threw_ || message_.find(text) == std::string::npos) {              \
+            std::fprintf(stderr, "%s:%d: %s threw \"%s\", expected \"%s\"\n",   \
+                         __FILE__, __LINE__, #statement, message_.c_str(),      \
+                         text);                                                 \
+            std::exit(1);                                                       \
+        }                                                                       \
+    } while (0)
+
+// Empty scratch directory named by the first argument (ctest passes one per
+// test), removed again when the test passes
+class ScratchDir {
+public:
+    ScratchDir(int argc, char **argv)
+        : path_(argc > 1 ? argv[1]
+                         : (std::filesystem::temp_directory_path() / "qnn-llm-test").string()) {
+        std::filesystem::remove_all(path_);
+        std::filesystem::create_directories(path_);
+    }
+    ~ScratchDir() {
+        std::error_code ec;
+        std::filesystem::remove_all(path_, ec);
+    }
+
+    std::string operator/(const std::string &name) const {
+        return (std::filesystem::path(path_) / name).string();
+    }
+    const std::string &path() const { return path_; }
+
+private:
+    std::string path_;
+};
+
+// Whole files, for tests that damage them
+inline std::vector<char> readFile(const std::string &path) {
+    std::ifstream in(path, std::ios::binary);
+    return std::vector<char>(std::istreambuf_iterator<char>(in), std::istreambuf_iterator<char>());
+}
+
+inline void writeFile(const std::string &path, const std::vector<char> &data) {
+    std::ofstream(path, std::ios::binary | std::ios::trunc).write(data.data(), data.size());
+}
@@ -0,0 +1,248 @@
+//------------------------------------------------------------------------------
+// EmbeddingCache: memory LRU, QEMBC1 files surviving reopen, the file lock,
+// recovery from torn, corrupted or foreign files, and the model identity that
+// keys them
+//------------------------------------------------------------------------------
+
+#include "embedding_cache.h"
+#include "check.h"
+#include <chrono>
+#include <filesystem>
+#include <vector>
+
+namespace fs = std::filesystem;
+
+namespace {
+
+// A [2, 3] output whose values depend on seed
+void store(EmbeddingCache &cache, const std::string &prompt, float seed) {
+    uint32_t dimensions[2] = {2, 3};
+    float values[6];
+    for (int i = 0; i < 6; ++i) values[i] = seed + i;
+    cache.store(prompt, dimensions, 2, values);
+}
+
+bool lookup(EmbeddingCache &cache, const std::string &prompt, float seed) {
+    bool same = false;
+    bool hit = cache.lookup(prompt, [&](const uint32_t *dimensions, uint32_t rank,
+                                        const float *values) {
+        same = rank == 2 && dimensions[0] == 2 && dimensions[1] == 3;
+        for (int i = 0; same && i < 6; ++i) same = values[i] == seed + i;
+    });
+    CHECK(!hit || same);
+    return hit;
+}
+
+// Header, then u32 size + 16-byte key + rank + 2 dims + 6 values + u32 crc
+constexpr size_t HEADER_BYTES = 16;
+constexpr size_t RECORD_BYTES = 4 + 16 + 4 + 8 + 24 + 4;
+
+void testMemory() {
+    EmbeddingCache cache("model", 1 << 20, "");
+    CHECK(!lookup(cache, "a", 1));
+    store(cache, "a", 1);
+    store(cache, "b", 2);
+    CHECK(lookup(cache, "a", 1));
+    CHECK(lookup(cache, "b", 2));
+    // The first output stored for a prompt stays
+    store(cache, "a", 5);
+    CHECK(lookup(cache, "a", 1));
+
+    EmbeddingCacheStats stats = cache.stats();
+    CHECK(stats.hits == 3);
+    CHECK(stats.misses == 1);
+    CHECK(stats.entries == 2);
+    CHECK(stats.file_bytes == 0);
+
+    // Another model never sees these outputs
+    EmbeddingCache other("other model", 1 << 20, "");
+    CHECK(!lookup(other, "a", 1));
+}
+
+void testLruBound() {
+    EmbeddingCache probe("model", 1 << 20, "");
+    store(probe, "a", 1);
+    size_t entryBytes = probe.stats().memory_bytes;
+
+    EmbeddingCache cache("model", entryBytes * 2, "");
+    store(cache, "a", 1);
+    store(cache, "b", 2);
+    // Touching "a" leaves "b" least recently used
+    CHECK(lookup(cache, "a", 1));
+    store(cache, "c", 3);
+    CHECK(cache.stats().memory_bytes == entryBytes * 2);
+    CHECK(cache.stats().entries == 2);
+    CHECK(lookup(cache, "a", 1));
+    CHECK(!lookup(cache, "b", 2));
+    CHECK(lookup(cache, "c", 3));
+
+    // An output larger than the budget is not kept
+    EmbeddingCache tiny("model", entryBytes - 1, "");
+    store(tiny, "a", 1);
+    CHECK(!lookup(tiny, "a", 1));
+    CHECK(tiny.stats().memory_bytes == 0);
+}
+
+void testReopen(const ScratchDir &dir) {
+    std::string path = dir / "reopen.qembc";
+    {
+        EmbeddingCache cache("model", 1 << 20, path);
+        store(cache, "a", 1);
+        store(cache, "b", 2);
+        CHECK(cache.stats().file_bytes == HEADER_BYTES + 2 * RECORD_BYTES);
+        // Appended after the file was mapped on open
+        CHECK(lookup(cache, "a", 1));
+    }
+    CHECK(fs::file_size(path) == HEADER_BYTES + 2 * RECORD_BYTES);
+    {
+        // Served from the file with no memory budget at all
+        EmbeddingCache cache("model", 0, path);
+        CHECK(cache.stats().entries == 2);
+        CHECK(lookup(cache, "a", 1));
+        CHECK(lookup(cache, "b", 2));
+        CHECK(!lookup(cache, "c", 3));
+        store(cache, "c", 3);
+        CHECK(lookup(cache, "c", 3));
+        CHECK(cache.stats().memory_bytes == 0);
+    }
+    EmbeddingCache cache("model", 0, path);
+    CHECK(cache.stats().entries == 3);
+    CHECK(lookup(cache, "c", 3));
+}
+
+void testLocked(const ScratchDir &dir) {
+    std::string path = dir / "locked.qembc";
+    {
+        EmbeddingCache cache("model", 1 << 20, path);
+        CHECK_THROWS(EmbeddingCache("model", 1 << 20, path), "in use");
+    }
+    // Released with the first cache
+    EmbeddingCache cache("model", 1 << 20, path);
+    CHECK_THROWS(EmbeddingCache("model", 1 << 20, dir / "missing/dir.qembc"),
+                 "Failed to open embedding cache");
+}
+
+void testTornTail(const ScratchDir &dir) {
+    std::string path = dir / "torn.qembc";
+    {
+        EmbeddingCache cache("model", 1 << 20, path);
+        store(cache, "a", 1);
+        store(cache, "b", 2);
+    }
+    std::vector<char> whole = readFile(path);
+    CHECK(whole.size() == HEADER_BYTES + 2 * RECORD_BYTES);
+
+    // Cut anywhere inside the second record, as a crash while appending would
+    for (size_t size = HEADER_BYTES + RECORD_BYTES; size < whole.size(); ++size) {
+        writeFile(path, std::vector<char>(whole.begin(), whole.begin() + size));
+        EmbeddingCache cache("model", 1 << 20, path);
+        CHECK(cache.stats().entries == 1);
+        CHECK(cache.stats().file_bytes == HEADER_BYTES + RECORD_BYTES);
+        CHECK(fs::file_size(path) == HEADER_BYTES + RECORD_BYTES);
+        CHECK(lookup(cache, "a", 1));
+        CHECK(!lookup(cache, "b", 2));
+        // Appended where the torn record was
+        store(cache, "b", 2);
+        CHECK(cache.stats().file_bytes == whole.size());
+    }
+    CHECK(readFile(path) == whole);
+
+    // Junk after the last record is cut off the same way
+    std::vector<char> junk = whole;
+    junk.insert(junk.end(), {'j', 'u', 'n', 'k', 0, 0, 0, 0, 1});
+    writeFile(path, junk);
+    {
+        EmbeddingCache cache("model", 1 << 20, path);
+        CHECK(cache.stats().entries == 2);
+        CHECK(cache.stats().file_bytes == whole.size());
+        CHECK(lookup(cache, "b", 2));
+    }
+    CHECK(readFile(path) == whole);
+}
+
+void testCorrupted(const ScratchDir &dir) {
+    std::string path = dir / "corrupt.qembc";
+    {
+        EmbeddingCache cache("model", 1 << 20, path);
+        store(cache, "a", 1);
+        store(cache, "b", 2);
+        store(cache, "c", 3);
+    }
+    std::vector<char> whole = readFile(path);
+
+    // A damaged byte anywhere in the second record drops it and what follows
+    for (size_t i = HEADER_BYTES + RECORD_BYTES; i < HEADER_BYTES + 2 * RECORD_BYTES; ++i) {
+        std::vector<char> corrupt = whole;
+        corrupt[i] ^= 0x5a;
+        writeFile(path, corrupt);
+        EmbeddingCache cache("model", 1 << 20, path);
+        CHECK(cache.stats().entries == 1);
+        CHECK(lookup(cache, "a", 1));
+        CHECK(!lookup(cache, "b", 2));
+        CHECK(!lookup(cache, "c", 3));
+    }
+}
+
+void testStartOver(const ScratchDir &dir) {
+    std::string path = dir / "foreign.qembc";
+    {
+        EmbeddingCache cache("model", 1 << 20, path);
+        store(cache, "a", 1);
+    }
+    // Written for another model
+    {
+        EmbeddingCache cache("other model", 1 << 20, path);
+        CHECK(cache.stats().entries == 0);
+        CHECK(cache.stats().file_bytes == HEADER_BYTES);
+        CHECK(!lookup(cache, "a", 1));
+    }
+    CHECK(fs::file_size(path) == HEADER_BYTES);
+
+    // Shorter than the header, or not a cache at all
+    std::vector<std::vector<char>> files = {
+        {}, {'Q', 'E', 'M', 'B'}, std::vector<char>(100, 'x')};
+    for (const auto &data : files) {
+        writeFile(path, data);
+        EmbeddingCache cache("model", 1 << 20, path);
+        CHECK(cache.stats().entries == 0);
+        CHECK(cache.stats().file_bytes == HEADER_BYTES);
+        store(cache, "a", 1);
+        CHECK(lookup(cache, "a", 1));
+    }
+}
+
+void testModelIdentity(const ScratchDir &dir) {
+    std::string model = dir / "model.bin";
+    writeFile(model, {'a'});
+    std::string config = "{\"model\": {\"binary\": \"" + model + "\"}, \"missing\": \"" +
+                         (dir / "none.bin") + "\"}";
+    std::string identity = embeddingModelIdentity(config);
+    CHECK(identity.compare(0, config.size(), config) == 0);
+    CHECK(identity.size() > config.size());
+    CHECK(embeddingModelIdentity(config) == identity);
+    // Paths that are not files add nothing
+    CHECK(embeddingModelIdentity("{\"a\": \"b\", \"c\": 1}") == "{\"a\": \"b\", \"c\": 1}");
+
+    // A rebuilt binary under the same path
+    writeFile(model, {'a', 'b'});
+    std::string resized = embeddingModelIdentity(config);
+    CHECK(resized != identity);
+    fs::last_write_time(model, fs::last_write_time(model) + std::chrono::seconds(1));
+    CHECK(embeddingModelIdentity(config) != resized);
+}
+
+} // namespace
+
+int main(int argc, char **argv) {
+    ScratchDir dir(argc, argv);
+    testMemory();
+    testLruBound();
+    testReopen(dir);
+    testLocked(dir);
+    testTornTail(dir);
+    testCorrupted(dir);
+    testStartOver(dir);
+    testModelIdentity(dir);
+    std::puts("embedding_cache_test passed");
+    return 0;
+}
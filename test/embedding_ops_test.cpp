@@ -0,0 +1,367 @@
+//------------------------------------------------------------------------------
+// Embedding kernels: half precision conversion against a reference, the SIMD
+// loops against their scalar tails, and int8 quantization
+//------------------------------------------------------------------------------
+
+#include "embedding_ops.h"
+#include "check.h"
+#include <cmath>
+#include <cstring>
+#include <limits>
+#include <random>
+#include <vector>
+
+namespace {
+
+uint32_t floatBits(float value) {
+    uint32_t bits;
+    std::memcpy(&bits, &value, sizeof(bits));
+    return bits;
+}
+
+float bitsFloat(uint32_t bits) {
+    float value;
+    std::memcpy(&value, &bits, sizeof(value));
+    return value;
+}
+
+// Exact value of a half, NaN payloads in the top mantissa bits
+float referenceHalf(uint16_t half) {
+    uint32_t sign = static_cast<uint32_t>(half & 0x8000) << 16;
+    uint32_t exponent = (half >> 10) & 0x1f;
+    uint32_t mantissa = half & 0x3ff;
+    if (exponent == 0x1f) return bitsFloat(sign | 0x7f800000 | (mantissa << 13));
+    double value = exponent == 0 ? std::ldexp(mantissa, -24)
+                                 : std::ldexp(1024 + mantissa, static_cast<int>(exponent) - 25);
+    return static_cast<float>(half & 0x8000 ? -value : value);
+}
+
+bool isHalfNaN(uint16_t half) {
+    return (half & 0x7c00) == 0x7c00 && (half & 0x3ff) != 0;
+}
+
+// Floats that are the same value, or NaNs of the same sign and payload;
+// hardware conversions may set the quiet bit of a signaling NaN
+bool sameFloat(float expected, float actual) {
+    uint32_t a = floatBits(expected), b = floatBits(actual);
+    if (std::isnan(expected)) return std::isnan(actual) && ((a ^ b) & ~0x400000u) == 0;
+    return a == b;
+}
+
+uint16_t toHalf(float value) {
+    uint16_t half;
+    toFloat16(&value, 1, &half);
+    return half;
+}
+
+std::vector<float> randomFloats(size_t n, uint32_t seed, float range = 4.0f) {
+    std::mt19937 rng(seed);
+    std::uniform_real_distribution<float> dist(-range, range);
+    std::vector<float> values(n);
+    for (float &value : values) value = dist(rng);
+    return values;
+}
+
+// Lengths that leave every remainder of the 4, 8 and 16-wide loops
+const size_t LENGTHS[] = {0, 1, 3, 4, 5, 7, 8, 9, 15, 16, 17, 31, 33, 47, 64, 100};
+
+void testToFloat16() {
+    // Every finite half is exact, and each midpoint rounds to the even neighbour
+    for (uint32_t h = 0; h < 0x7c00; ++h) {
+        for (uint16_t sign : {0, 0x8000}) {
+            uint16_t half = static_cast<uint16_t>(h | sign);
+            float value = referenceHalf(half);
+            CHECK(toHalf(value) == half);
+
+            uint16_t next = static_cast<uint16_t>(half + 1);
+            double upper = h == 0x7bff ? 65536.0 : std::fabs(referenceHalf(next));
+            double midpoint = (std::fabs(value) + upper) / 2;
+            uint16_t even = h & 1 ? next : half;
+            float mid = static_cast<float>(sign ? -midpoint : midpoint);
+            CHECK(toHalf(mid) == even);
+            CHECK(toHalf(std::nextafter(mid, 0.0f)) == half);
+            CHECK(toHalf(std::nextafter(mid, sign ? -1e9f : 1e9f)) == next);
+        }
+    }
+
+    // Overflow, values too small for a subnormal, infinities and NaN
+    CHECK(toHalf(65519.0f) == 0x7bff);
+    CHECK(toHalf(65520.0f) == 0x7c00);
+    CHECK(toHalf(-1e10f) == 0xfc00);
+    CHECK(toHalf(std::numeric_limits<float>::infinity()) == 0x7c00);
+    CHECK(toHalf(-std::numeric_limits<float>::infinity()) == 0xfc00);
+    CHECK(toHalf(std::ldexp(1.0f, -25)) == 0x0000);
+    CHECK(toHalf(std::nextafter(std::ldexp(1.0f, -25), 1.0f)) == 0x0001);
+    CHECK(toHalf(-std::numeric_limits<float>::denorm_min()) == 0x8000);
+    CHECK(isHalfNaN(toHalf(std::numeric_limits<float>::quiet_NaN())));
+    CHECK(isHalfNaN(toHalf(bitsFloat(0x7f800001))));
+    CHECK(toHalf(bitsFloat(0xffc00000)) & 0x8000);
+
+    // The SIMD loop against one element at a time, which only runs the tail
+    std::vector<float> values = randomFloats(100, 1, 70000.0f);
+    values[3] = std::numeric_limits<float>::quiet_NaN();
+    values[9] = 1e-6f;
+    values[20] = -std::numeric_limits<float>::infinity();
+    for (size_t n : LENGTHS) {
+        for (size_t offset : {0, 1, 3}) {
+            if (offset + n > values.size()) continue;
+            std::vector<uint16_t> halves(n);
+            toFloat16(values.data() + offset, n, halves.data());
+            for (size_t i = 0; i < n; ++i) {
+                uint16_t expected = toHalf(values[offset + i]);
+                CHECK(halves[i] == expected || (isHalfNaN(expected) && isHalfNaN(halves[i])));
+            }
+        }
+    }
+}
+
+void testFromFloat16() {
+    std::vector<uint16_t> halves(0x10000);
+    for (uint32_t h = 0; h < 0x10000; ++h) halves[h] = static_cast<uint16_t>(h);
+    std::vector<float> values(halves.size());
+    fromFloat16(halves.data(), halves.size(), values.data());
+
+    for (uint32_t h = 0; h < 0x10000; ++h) {
+        uint16_t half = static_cast<uint16_t>(h);
+        float expected = referenceHalf(half);
+        CHECK(sameFloat(expected, values[h]));
+        float scalar;
+        fromFloat16(&half, 1, &scalar);
+        CHECK(floatBits(scalar) == floatBits(expected));
+
+        // Back to the same half; NaNs come back quiet with their payload
+        uint16_t back = toHalf(scalar);
+        if (isHalfNaN(half)) {
+            CHECK(back == (half | 0x200));
+        } else {
+            CHECK(back == half);
+        }
+    }
+
+    // Unaligned starts and every tail length
+    for (size_t n : LENGTHS) {
+        for (size_t offset : {1, 5}) {
+            std::vector<float> out(n);
+            fromFloat16(halves.data() + 0x7bf0 + offset, n, out.data());
+            for (size_t i = 0; i < n; ++i) {
+                CHECK(sameFloat(referenceHalf(halves[0x7bf0 + offset + i]), out[i]));
+            }
+        }
+    }
+}
+
+// int8 quantization as the scalar loop defines it
+float referenceQuantize(const std::vector<float> &src, std::vector<int8_t> &dst) {
+    float maxAbs = 0.0f;
+    for (float value : src) maxAbs = std::max(maxAbs, std::fabs(value));
+    dst.assign(src.size(), 0);
+    if (maxAbs == 0.0f) return 1.0f;
+    float inv = 127.0f / maxAbs;
+    for (size_t i = 0; i < src.size(); ++i) {
+        dst[i] = static_cast<int8_t>(std::nearbyint(src[i] * inv));
+    }
+    return maxAbs / 127.0f;
+}
+
+void testQuantizeInt8() {
+    std::vector<float> values = randomFloats(100, 2);
+    for (size_t n : LENGTHS) {
+        std::vector<float> src(values.begin(), values.begin() + n);
+        std::vector<int8_t> expected, actual(n);
+        float scale = referenceQuantize(src, expected);
+        CHECK(quantizeInt8(src.data(), n, actual.data()) == scale);
+        CHECK(actual == expected);
+        for (size_t i = 0; i < n; ++i) {
+            CHECK(actual[i] >= -127);
+            CHECK(std::fabs(actual[i] * scale - src[i]) <= scale * 0.5f + 1e-6f);
+        }
+    }
+
+    // Ties round to even, in the SIMD loop and in the tail; the extremes do not
+    // saturate past -127
+    std::vector<float> ties(20);
+    for (size_t i = 0; i < ties.size(); ++i) ties[i] = static_cast<float>(i) - 9.5f;
+    ties[0] = -127.0f;
+    ties[19] = 127.0f;
+    std::vector<int8_t> q(ties.size());
+    CHECK(quantizeInt8(ties.data(), ties.size(), q.data()) == 1.0f);
+    for (size_t i = 1; i < 19; ++i) {
+        CHECK(q[i] == static_cast<int8_t>(std::nearbyint(ties[i])));
+        CHECK(q[i] % 2 == 0);
+    }
+    CHECK(q[0] == -127 && q[19] == 127);
+
+    // All zeros, and infinities which leave no usable scale
+    std::vector<float> zeros(20, 0.0f);
+    std::fill(q.begin(), q.end(), 1);
+    CHECK(quantizeInt8(zeros.data(), zeros.size(), q.data()) == 1.0f);
+    CHECK(q == std::vector<int8_t>(20, 0));
+    std::vector<float> inf = randomFloats(20, 3);
+    inf[17] = std::numeric_limits<float>::infinity();
+    std::fill(q.begin(), q.end(), 1);
+    CHECK(std::isinf(quantizeInt8(inf.data(), inf.size(), q.data())));
+    CHECK(q == std::vector<int8_t>(20, 0));
+
+    // NaNs, in the SIMD loop and in the tail, neither set the scale nor
+    // saturate
+    const float nan = std::numeric_limits<float>::quiet_NaN();
+    std::vector<float> withNan = ties;
+    withNan[0] = withNan[5] = withNan[18] = nan;
+    CHECK(quantizeInt8(withNan.data(), withNan.size(), q.data()) == 1.0f);
+    for (size_t i = 0; i < q.size(); ++i) {
+        float expected = std::isnan(withNan[i]) ? 0.0f : std::nearbyint(withNan[i]);
+        CHECK(q[i] == static_cast<int8_t>(expected));
+    }
+    std::vector<float> allNan(20, nan);
+    std::fill(q.begin(), q.end(), 1);
+    CHECK(quantizeInt8(allNan.data(), allNan.size(), q.data()) == 1.0f);
+    CHECK(q == std::vector<int8_t>(20, 0));
+
+    // Magnitudes too small for 127 / maxAbs, and nothing at all
+    std::vector<float> tiny(20, std::numeric_limits<float>::denorm_min());
+    tiny[3] = -tiny[3];
+    std::fill(q.begin(), q.end(), 1);
+    CHECK(quantizeInt8(tiny.data(), tiny.size(), q.data()) == 1.0f);
+    CHECK(q == std::vector<int8_t>(20, 0));
+    CHECK(quantizeInt8(nullptr, 0, nullptr) == 1.0f);
+}
+
+void testFromInt8() {
+    std::vector<int8_t> values(100);
+    for (size_t i = 0; i < values.size(); ++i) values[i] = static_cast<int8_t>(i * 37 - 128);
+    for (size_t n : LENGTHS) {
+        std::vector<float> out(n);
+        fromInt8(values.data(), n, 0.5f, out.data());
+        for (size_t i = 0; i < n; ++i) CHECK(out[i] == values[i] * 0.5f);
+    }
+}
+
+void testPoolAndNormalize() {
+    std::vector<float> values = randomFloats(3 * 100, 4);
+    for (size_t dim : LENGTHS) {
+        if (dim == 0) continue;
+        std::vector<float> pooled(dim);
+        meanPool(values.data(), 3, dim, pooled.data());
+        double norm = 0;
+        for (size_t i = 0; i < dim; ++i) {
+            double mean = (double(values[i]) + values[dim + i] + values[2 * dim + i]) / 3;
+            CHECK(std::fabs(pooled[i] - mean) <= 1e-5);
+            norm += double(pooled[i]) * pooled[i];
+        }
+        std::vector<float> normalized = pooled;
+        l2Normalize(normalized.data(), dim);
+        for (size_t i = 0; i < dim; ++i) {
+            CHECK(std::fabs(normalized[i] - pooled[i] / std::sqrt(norm)) <= 1e-6);
+        }
+    }
+    std::vector<float> zeros(5, 0.0f);
+    l2Normalize(zeros.data(), zeros.size());
+    CHECK(zeros == std::vector<float>(5, 0.0f));
+}
+
+void testDots() {
+    std::vector<float> a = randomFloats(100, 5);
+    std::vector<float> b = randomFloats(100, 6);
+    std::vector<uint16_t> b16(b.size());
+    toFloat16(b.data(), b.size(), b16.data());
+    std::vector<int8_t> b8(b.size());
+    quantizeInt8(b.data(), b.size(), b8.data());
+    for (size_t n : LENGTHS) {
+        double f32 = 0, f16 = 0, i8 = 0;
+        for (size_t i = 0; i < n; ++i) {
+            f32 += double(a[i]) * b[i];
+            f16 += double(a[i]) * referenceHalf(b16[i]);
+            i8 += double(a[i]) * b8[i];
+        }
+        CHECK(std::fabs(dotF32(a.data(), b.data(), n) - f32) <= 1e-4);
+        CHECK(std::fabs(dotF16(a.data(), b16.data(), n) - f16) <= 1e-4);
+        CHECK(std::fabs(dotI8(a.data(), b8.data(), n) - i8) <= 1e-2);
+    }
+}
+
+// Every pooling, normalization and type against a double precision reference
+void testConvertEmbedding() {
+    const uint32_t shapes[][3] = {{1, 0, 0}, {3, 0, 0}, {2, 3, 0}, {2, 2, 17}};
+    const uint32_t ranks[] = {1, 1, 2, 3};
+    const EmbeddingType types[] = {EmbeddingType::Float32, EmbeddingType::Float16,
+                                   EmbeddingType::Int8};
+    std::vector<float> scratch;
+    for (size_t s = 0; s < 4; ++s) {
+        const uint32_t *dims = shapes[s];
+        uint32_t rank = ranks[s];
+        size_t count = 1;
+        for (uint32_t i = 0; i < rank; ++i) count *= dims[i];
+        std::vector<float> src = randomFloats(count, 7 + static_cast<uint32_t>(s));
+
+        for (EmbeddingPooling pooling : {EmbeddingPooling::None, EmbeddingPooling::Mean}) {
+            for (bool normalize : {false, true}) {
+                std::vector<double> expected;
+                if (pooling == EmbeddingPooling::Mean) {
+                    size_t dim = dims[rank - 1], tokens = count / dim;
+                    expected.assign(dim, 0.0);
+                    for (size_t t = 0; t < tokens; ++t) {
+                        for (size_t i = 0; i < dim; ++i) expected[i] += src[t * dim + i] / double(tokens);
+                    }
+                } else {
+                    expected.assign(src.begin(), src.end());
+                }
+                if (normalize) {
+                    double norm = 0;
+                    for (double value : expected) norm += value * value;
+                    for (double &value : expected) value /= std::sqrt(norm);
+                }
+
+                for (EmbeddingType type : types) {
+                    EmbeddingOptions options;
+                    options.pooling = pooling;
+                    options.normalize = normalize;
+                    options.type = type;
+                    size_t length = embeddingOutputLength(dims, rank, options);
+                    CHECK(length == expected.size());
+                    std::vector<uint8_t> dst(length * embeddingElementSize(type));
+                    float scale = convertEmbedding(src.data(), dims, rank, options, dst.data(),
+                                                   scratch);
+                    for (size_t i = 0; i < length; ++i) {
+                        double value;
+                        double tolerance;
+                        if (type == EmbeddingType::Float32) {
+                            CHECK(scale == 1.0f);
+                            value = reinterpret_cast<const float *>(dst.data())[i];
+                            tolerance = 1e-5;
+                        } else if (type == EmbeddingType::Float16) {
+                            CHECK(scale == 1.0f);
+                            value = referenceHalf(reinterpret_cast<const uint16_t *>(dst.data())[i]);
+                            tolerance = std::fabs(expected[i]) / 1024 + 1e-5;
+                        } else {
+                            value = reinterpret_cast<const int8_t *>(dst.data())[i] * double(scale);
+                            tolerance = scale * 0.5 + 1e-5;
+                        }
+                        CHECK(std::fabs(value - expected[i]) <= tolerance);
+                    }
+                }
+            }
+        }
+    }
+
+    CHECK(embeddingElementSize(EmbeddingType::Float32) == 4);
+    CHECK(embeddingElementSize(EmbeddingType::Float16) == 2);
+    CHECK(embeddingElementSize(EmbeddingType::Int8) == 1);
+    CHECK(parseEmbeddingPooling("") == EmbeddingPooling::None);
+    CHECK(parseEmbeddingType("int8") == EmbeddingType::Int8);
+    CHECK_THROWS(parseEmbeddingPooling("max"), "Unknown pooling: max");
+    CHECK_THROWS(parseEmbeddingType("bf16"), "Unknown embedding dtype: bf16");
+}
+
+} // namespace
+
+int main() {
+    testToFloat16();
+    testFromFloat16();
+    testQuantizeInt8();
+    testFromInt8();
+    testPoolAndNormalize();
+    testDots();
+    testConvertEmbedding();
+    std::puts("embedding_ops_test passed");
+    return 0;
+}
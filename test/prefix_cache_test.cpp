@@ -0,0 +1,143 @@
+//------------------------------------------------------------------------------
+// PrefixCache: longest-prefix lookup, LRU eviction by bytes, pruning of the
+// radix tree, and isolation of caches sharing a directory
+//------------------------------------------------------------------------------
+
+#include "PrefixCache.h"
+#include "check.h"
+#include <filesystem>
+#include <fstream>
+
+namespace fs = std::filesystem;
+
+namespace {
+
+// Stands in for GenieDialog_save
+std::string save(PrefixCache &cache, const std::string &prefix, size_t bytes) {
+    std::string path = cache.reserve();
+    std::ofstream(path, std::ios::binary) << std::string(bytes, 'x');
+    cache.insert(prefix, path);
+    return path;
+}
+
+bool lookup(PrefixCache &cache, const std::string &prompt, std::string &prefix,
+            size_t min_length = 0) {
+    PrefixCache::Snapshot snapshot;
+    if (!cache.lookup(prompt, min_length, snapshot)) return false;
+    prefix = snapshot.prefix;
+    return true;
+}
+
+void testLongestPrefix(const ScratchDir &dir) {
+    PrefixCache cache(dir.path(), 0);
+    save(cache, "system A", 10);
+    save(cache, "system A + doc", 10);
+    save(cache, "system B", 10);
+
+    std::string prefix;
+    CHECK(lookup(cache, "system A + doc + question", prefix));
+    CHECK(prefix == "system A + doc");
+    CHECK(lookup(cache, "system A + other", prefix));
+    CHECK(prefix == "system A");
+    CHECK(lookup(cache, "system B", prefix));
+    CHECK(prefix == "system B");
+    CHECK(!lookup(cache, "system C", prefix));
+    CHECK(!lookup(cache, "sys", prefix));
+    // Prefixes the dialog already holds are not worth restoring
+    CHECK(!lookup(cache, "system A + doc + question", prefix, 14));
+
+    PrefixCacheStats stats = cache.stats();
+    CHECK(stats.hits == 3);
+    CHECK(stats.misses == 3);
+    CHECK(stats.entries == 3);
+    CHECK(stats.bytes == 30);
+}
+
+void testEviction(const ScratchDir &dir) {
+    PrefixCache cache(dir.path(), 250);
+    std::string a = save(cache, "system A", 100);
+    std::string doc = save(cache, "system A + doc", 100);
+    std::string prefix;
+    // Touching "system A" leaves "system A + doc" least recently used
+    CHECK(lookup(cache, "system A!", prefix));
+    std::string b = save(cache, "system B", 100);
+
+    PrefixCacheStats stats = cache.stats();
+    CHECK(stats.evictions == 1);
+    CHECK(stats.entries == 2);
+    CHECK(stats.bytes == 200);
+    CHECK(!fs::exists(doc));
+    CHECK(fs::exists(a) && fs::exists(b));
+    CHECK(lookup(cache, "system A + doc + question", prefix));
+    CHECK(prefix == "system A");
+
+    save(cache, "system A + doc", 100);
+    CHECK(!fs::exists(b));
+    // Evicting "system A" merges the edge to its only child
+    save(cache, "system C", 100);
+    CHECK(!fs::exists(a));
+    CHECK(!lookup(cache, "system A", prefix));
+    CHECK(lookup(cache, "system A + doc + question", prefix));
+    CHECK(prefix == "system A + doc");
+    CHECK(lookup(cache, "system C", prefix));
+
+    // A snapshot larger than the budget does not stay
+    save(cache, "huge", 1000);
+    CHECK(!lookup(cache, "huge", prefix));
+    CHECK(cache.stats().bytes <= 250);
+}
+
+void testRemoveAndReplace(const ScratchDir &dir) {
+    PrefixCache cache(dir.path(), 0);
+    std::string first = save(cache, "prompt", 10);
+    std::string second = save(cache, "prompt", 20);
+    CHECK(!fs::exists(first));
+    CHECK(cache.stats().entries == 1);
+    CHECK(cache.stats().bytes == 20);
+
+    save(cache, "prompt and more", 10);
+    cache.remove("prompt");
+    CHECK(!fs::exists(second));
+    std::string prefix;
+    CHECK(!lookup(cache, "prompt and", prefix));
+    CHECK(lookup(cache, "prompt and more!", prefix));
+    CHECK(prefix == "prompt and more");
+    cache.remove("prompt and more");
+    CHECK(!lookup(cache, "prompt and more!", prefix));
+    CHECK(cache.stats().entries == 0);
+    CHECK(cache.stats().bytes == 0);
+    // Removing what is not there is harmless
+    cache.remove("prompt");
+    cache.remove("");
+}
+
+void testSharedDirectory(const ScratchDir &dir) {
+    std::string kept;
+    {
+        PrefixCache first(dir.path(), 0);
+        {
+            PrefixCache second(dir.path(), 0);
+            kept = save(first, "first", 10);
+            std::string other = save(second, "second", 10);
+            CHECK(fs::path(kept).parent_path() != fs::path(other).parent_path());
+        }
+        // Releasing one cache leaves the other's snapshots alone
+        CHECK(fs::exists(kept));
+        std::string prefix;
+        CHECK(lookup(first, "first!", prefix));
+    }
+    CHECK(!fs::exists(fs::path(kept).parent_path()));
+    CHECK(fs::is_empty(dir.path()));
+}
+
+} // namespace
+
+int main(int argc, char **argv) {
+    ScratchDir dir(argc, argv);
+    testLongestPrefix(dir);
+    testEviction(dir);
+    testRemoveAndReplace(dir);
+    testSharedDirectory(dir);
+    std::puts("prefix_cache_test passed");
+    return 0;
+}
@@ -0,0 +1,129 @@
+//------------------------------------------------------------------------------
+// Packed sessions (QSESS1): round trips of both layouts, and rejection of
+// truncated or corrupted files
+//------------------------------------------------------------------------------
+
+#include "session.h"
+#include "check.h"
+#include <algorithm>
+#include <filesystem>
+#include <vector>
+
+namespace fs = std::filesystem;
+
+namespace {
+
+// Runs of pseudo-random bytes, so the packed file stays small enough to
+// corrupt at every offset
+std::vector<char> sessionData(size_t size, uint32_t seed) {
+    std::vector<char> data(size);
+    for (size_t i = 0; i < size; ++i) {
+        if (i % 64 == 0) seed = seed * 1103515245u + 12345u;
+        data[i] = static_cast<char>(seed >> 16);
+    }
+    return data;
+}
+
+void checkSameTree(const std::string &expected, const std::string &actual) {
+    size_t files = 0;
+    for (const auto &entry : fs::recursive_directory_iterator(expected)) {
+        if (!entry.is_regular_file()) continue;
+        fs::path other = fs::path(actual) / fs::relative(entry.path(), expected);
+        CHECK(readFile(entry.path().string()) == readFile(other.string()));
+        files++;
+    }
+    for (const auto &entry : fs::recursive_directory_iterator(actual)) {
+        if (entry.is_regular_file()) files--;
+    }
+    CHECK(files == 0);
+}
+
+void testRoundTrip(const ScratchDir &dir) {
+    // Directory layout, with a nested and an empty file
+    std::string session = dir / "session";
+    fs::create_directories(session + "/kv");
+    writeFile(session + "/state.bin", sessionData(5000, 1));
+    writeFile(session + "/kv/layer0.bin", sessionData(70000, 2));
+    writeFile(session + "/empty.bin", {});
+
+    SessionStats stats;
+    packSession(session, dir / "session.qsess", 3, stats);
+    CHECK(isPackedSession(dir / "session.qsess"));
+    CHECK(!isPackedSession(session + "/state.bin"));
+    CHECK(stats.raw_bytes == 75000);
+    CHECK(stats.file_bytes == fs::file_size(dir / "session.qsess"));
+
+    SessionStats restored;
+    unpackSession(dir / "session.qsess", dir / "restored", restored);
+    CHECK(restored.raw_bytes == 75000);
+    checkSameTree(session, dir / "restored");
+
+    // Single-file layout, replacing what was there
+    writeFile(dir / "single.bin", sessionData(3000, 3));
+    packSession(dir / "single.bin", dir / "single.qsess", 3, stats);
+    unpackSession(dir / "single.qsess", dir / "restored", restored);
+    CHECK(fs::is_regular_file(dir / "restored"));
+    CHECK(readFile(dir / "restored") == readFile(dir / "single.bin"));
+}
+
+void testTruncated(const ScratchDir &dir) {
+    std::vector<char> packed = readFile(dir / "session.qsess");
+    for (size_t size = 0; size < packed.size(); ++size) {
+        writeFile(dir / "truncated.qsess", std::vector<char>(packed.begin(), packed.begin() + size));
+        SessionStats stats;
+        CHECK_THROWS(unpackSession(dir / "truncated.qsess", dir / "out", stats), "");
+    }
+}
+
+void testCorrupted(const ScratchDir &dir) {
+    // Every byte is covered by a check: header fields, zstd framing, per-file
+    // CRCs, the table and the whole-file CRC in the footer
+    std::vector<char> packed = readFile(dir / "session.qsess");
+    for (size_t i = 0; i < packed.size(); ++i) {
+        std::vector<char> corrupt = packed;
+        corrupt[i] ^= 0x5a;
+        writeFile(dir / "corrupt.qsess", corrupt);
+        SessionStats stats;
+        CHECK_THROWS(unpackSession(dir / "corrupt.qsess", dir / "out", stats), "");
+    }
+
+    std::vector<char> corrupt = packed;
+    corrupt[6] = 99;
+    writeFile(dir / "corrupt.qsess", corrupt);
+    SessionStats stats;
+    CHECK_THROWS(unpackSession(dir / "corrupt.qsess", dir / "out", stats),
+                 "Unsupported session version 99");
+}
+
+void testPathTraversal(const ScratchDir &dir) {
+    // A table entry naming a file outside the session is refused before any
+    // write, even though the file checksum is only verified at the end
+    std::string session = dir / "escape";
+    fs::create_directories(session + "/ab");
+    writeFile(session + "/ab/cd", sessionData(100, 4));
+    SessionStats stats;
+    packSession(session, dir / "escape.qsess", 3, stats);
+
+    std::vector<char> packed = readFile(dir / "escape.qsess");
+    std::string name = "ab/cd";
+    auto it = std::search(packed.begin(), packed.end(), name.begin(), name.end());
+    CHECK(it != packed.end());
+    it[0] = '.';
+    it[1] = '.';
+    writeFile(dir / "escape.qsess", packed);
+    CHECK_THROWS(unpackSession(dir / "escape.qsess", dir / "inner/session", stats),
+                 "Invalid session file name");
+    CHECK(!fs::exists(dir / "inner/cd"));
+}
+
+} // namespace
+
+int main(int argc, char **argv) {
+    ScratchDir dir(argc, argv);
+    testRoundTrip(dir);
+    testTruncated(dir);
+    testCorrupted(dir);
+    testPathTraversal(dir);
+    std::puts("session_test passed");
+    return 0;
+}
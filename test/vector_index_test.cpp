@@ -0,0 +1,284 @@
+//------------------------------------------------------------------------------
+// VectorIndex: flat search against a brute-force scan, HNSW recall against
+// flat search, save / load round trips, and rejection of truncated or
+// corrupted QVIDX1 files
+//------------------------------------------------------------------------------
+
+#include "vector_index.h"
+#include "check.h"
+#include <algorithm>
+#include <cmath>
+#include <cstring>
+#include <random>
+#include <set>
+#include <vector>
+
+namespace {
+
+// Header field offsets, see vector_index.h
+constexpr size_t TYPE_OFFSET        = 10;
+constexpr size_t DIM_OFFSET         = 16;
+constexpr size_t M_OFFSET           = 20;
+constexpr size_t COUNT_OFFSET       = 32;
+constexpr size_t ENTRY_OFFSET       = 40;
+constexpr size_t MAX_LEVEL_OFFSET   = 44;
+constexpr size_t UPPER_WORDS_OFFSET = 48;
+constexpr size_t HEADER_SIZE        = 64;
+
+std::vector<float> randomRows(size_t count, uint32_t dim, uint32_t seed) {
+    std::mt19937 rng(seed);
+    std::normal_distribution<float> normal;
+    std::vector<float> rows(count * dim);
+    for (float &value : rows) value = normal(rng);
+    return rows;
+}
+
+std::vector<float> normalized(const float *row, uint32_t dim) {
+    std::vector<float> out(row, row + dim);
+    float norm = 0;
+    for (float value : out) norm += value * value;
+    norm = std::sqrt(norm);
+    for (float &value : out) value /= norm;
+    return out;
+}
+
+// Exact top k by cosine similarity
+std::vector<uint32_t> bruteForce(const std::vector<float> &rows, uint32_t dim,
+                                 const float *query, size_t k) {
+    std::vector<float> q = normalized(query, dim);
+    std::vector<std::pair<float, uint32_t>> scored;
+    for (size_t id = 0; id < rows.size() / dim; ++id) {
+        std::vector<float> row = normalized(rows.data() + id * dim, dim);
+        float score = 0;
+        for (uint32_t i = 0; i < dim; ++i) score += q[i] * row[i];
+        scored.push_back({score, static_cast<uint32_t>(id)});
+    }
+    std::sort(scored.begin(), scored.end(),
+              [](const auto &a, const auto &b) { return a.first > b.first; });
+    std::vector<uint32_t> ids;
+    for (size_t i = 0; i < k && i < scored.size(); ++i) ids.push_back(scored[i].second);
+    return ids;
+}
+
+std::vector<uint32_t> ids(const std::vector<SearchHit> &hits) {
+    std::vector<uint32_t> out;
+    for (const SearchHit &hit : hits) out.push_back(hit.id);
+    return out;
+}
+
+double recall(const std::vector<uint32_t> &expected, const std::vector<uint32_t> &actual) {
+    std::set<uint32_t> want(expected.begin(), expected.end());
+    size_t found = 0;
+    for (uint32_t id : actual) found += want.count(id);
+    return expected.empty() ? 1.0 : double(found) / expected.size();
+}
+
+template<typename T>
+void patch(std::vector<char> &data, size_t offset, T value) {
+    std::memcpy(data.data() + offset, &value, sizeof(T));
+}
+
+template<typename T>
+T field(const std::vector<char> &data, size_t offset) {
+    T value;
+    std::memcpy(&value, data.data() + offset, sizeof(T));
+    return value;
+}
+
+VectorIndexOptions options(uint32_t dim, EmbeddingType type, VectorIndexKind kind, uint32_t m = 16) {
+    VectorIndexOptions options;
+    options.dim = dim;
+    options.type = type;
+    options.kind = kind;
+    options.m = m;
+    return options;
+}
+
+void testOptionBounds() {
+    CHECK_THROWS(VectorIndex(options(0, EmbeddingType::Float32, VectorIndexKind::Flat)),
+                 "dim must be between 1 and 65536");
+    CHECK_THROWS(VectorIndex(options(65537, EmbeddingType::Float32, VectorIndexKind::Flat)),
+                 "dim must be between 1 and 65536");
+    CHECK_THROWS(VectorIndex(options(8, EmbeddingType::Float32, VectorIndexKind::Hnsw, 1)),
+                 "m must be between 2 and 65536");
+    CHECK_THROWS(VectorIndex(options(8, EmbeddingType::Float32, VectorIndexKind::Hnsw, 65537)),
+                 "m must be between 2 and 65536");
+    VectorIndex largest(options(65536, EmbeddingType::Float32, VectorIndexKind::Hnsw, 65536));
+    CHECK(largest.size() == 0);
+}
+
+void testFlatSearch() {
+    const uint32_t dim = 48;
+    std::vector<float> rows = randomRows(500, dim, 1);
+    std::vector<float> queries = randomRows(20, dim, 2);
+    for (EmbeddingType type : {EmbeddingType::Float32, EmbeddingType::Float16, EmbeddingType::Int8}) {
+        VectorIndex index(options(dim, type, VectorIndexKind::Flat));
+        CHECK(index.add(rows.data(), 500) == 0);
+        CHECK(index.size() == 500);
+        double total = 0;
+        for (size_t q = 0; q < 20; ++q) {
+            const float *query = queries.data() + q * dim;
+            std::vector<SearchHit> hits = index.search(query, 10);
+            CHECK(hits.size() == 10);
+            for (size_t i = 1; i < hits.size(); ++i) CHECK(hits[i - 1].score >= hits[i].score);
+            std::vector<uint32_t> expected = bruteForce(rows, dim, query, 10);
+            if (type == EmbeddingType::Float32) CHECK(ids(hits) == expected);
+            total += recall(expected, ids(hits));
+        }
+        // Reduced precision may swap near ties only
+        CHECK(total / 20 >= 0.9);
+    }
+}
+
+void testHnswRecall() {
+    const uint32_t dim = 32;
+    const size_t count = 2000;
+    std::vector<float> rows = randomRows(count, dim, 3);
+    std::vector<float> queries = randomRows(50, dim, 4);
+    VectorIndex flat(options(dim, EmbeddingType::Float32, VectorIndexKind::Flat));
+    VectorIndex hnsw(options(dim, EmbeddingType::Float32, VectorIndexKind::Hnsw));
+    flat.add(rows.data(), count);
+    // Added in batches, like repeated addText calls
+    for (size_t first = 0; first < count; first += 250) {
+        CHECK(hnsw.add(rows.data() + first * dim, 250) == first);
+    }
+    double total = 0, wide = 0;
+    for (size_t q = 0; q < 50; ++q) {
+        const float *query = queries.data() + q * dim;
+        std::vector<uint32_t> expected = ids(flat.search(query, 10));
+        total += recall(expected, ids(hnsw.search(query, 10)));
+        wide += recall(expected, ids(hnsw.search(query, 10, 400)));
+        // A stored row finds itself
+        CHECK(hnsw.search(rows.data() + q * 37 * dim, 1)[0].id == q * 37);
+    }
+    CHECK(total / 50 >= 0.9);
+    CHECK(wide / 50 >= total / 50);
+    CHECK(wide / 50 >= 0.98);
+    // k larger than the index returns every row once
+    VectorIndex small(options(dim, EmbeddingType::Float32, VectorIndexKind::Hnsw));
+    small.add(rows.data(), 5);
+    std::vector<uint32_t> all = ids(small.search(queries.data(), 10));
+    CHECK(all.size() == 5);
+    CHECK(std::set<uint32_t>(all.begin(), all.end()).size() == 5);
+}
+
+void testSaveLoad(const ScratchDir &dir) {
+    const uint32_t dim = 16;
+    std::vector<float> rows = randomRows(300, dim, 5);
+    std::vector<float> queries = randomRows(10, dim, 6);
+    for (VectorIndexKind kind : {VectorIndexKind::Flat, VectorIndexKind::Hnsw}) {
+        for (EmbeddingType type : {EmbeddingType::Float32, EmbeddingType::Float16, EmbeddingType::Int8}) {
+            VectorIndex index(options(dim, type, kind, 8));
+            index.add(rows.data(), 300);
+            index.save(dir / "index.qvidx");
+            std::unique_ptr<VectorIndex> loaded = VectorIndex::load(dir / "index.qvidx");
+            CHECK(loaded->size() == 300);
+            CHECK(loaded->options().type == type);
+            CHECK(loaded->options().kind == kind);
+            CHECK(loaded->options().m == 8);
+            for (size_t q = 0; q < 10; ++q) {
+                std::vector<SearchHit> a = index.search(queries.data() + q * dim, 5);
+                std::vector<SearchHit> b = loaded->search(queries.data() + q * dim, 5);
+                CHECK(ids(a) == ids(b));
+                for (size_t i = 0; i < a.size(); ++i) CHECK(a[i].score == b[i].score);
+            }
+            // Adding copies the mapping, the file can then be replaced
+            std::vector<float> extra = randomRows(1, dim, 7);
+            CHECK(loaded->add(extra.data(), 1) == 300);
+            index.save(dir / "index.qvidx");
+            CHECK(loaded->search(extra.data(), 1)[0].id == 300);
+        }
+    }
+}
+
+// HNSW float32 index small enough to damage at every offset
+std::vector<char> smallHnswFile(const ScratchDir &dir) {
+    std::vector<float> rows = randomRows(100, 8, 8);
+    VectorIndex index(options(8, EmbeddingType::Float32, VectorIndexKind::Hnsw, 4));
+    index.add(rows.data(), 100);
+    index.save(dir / "small.qvidx");
+    return readFile(dir / "small.qvidx");
+}
+
+void testTruncated(const ScratchDir &dir) {
+    std::vector<char> file = smallHnswFile(dir);
+    CHECK(field<uint64_t>(file, UPPER_WORDS_OFFSET) > 0);
+    for (size_t size = 0; size < file.size(); ++size) {
+        writeFile(dir / "truncated.qvidx", std::vector<char>(file.begin(), file.begin() + size));
+        CHECK_THROWS(VectorIndex::load(dir / "truncated.qvidx"),
+                     size < HEADER_SIZE ? "vector index" : "Truncated vector index file");
+    }
+}
+
+void testCorruptHeader(const ScratchDir &dir) {
+    const std::vector<char> file = smallHnswFile(dir);
+    uint64_t count = field<uint64_t>(file, COUNT_OFFSET);
+    auto check = [&](auto edit, const char *message) {
+        std::vector<char> corrupt = file;
+        edit(corrupt);
+        writeFile(dir / "corrupt.qvidx", corrupt);
+        CHECK_THROWS(VectorIndex::load(dir / "corrupt.qvidx"), message);
+    };
+    check([](std::vector<char> &f) { f[0] = 'X'; }, "Invalid vector index file");
+    check([](std::vector<char> &f) { patch<uint16_t>(f, 8, 2); }, "Unsupported vector index version: 2");
+    check([](std::vector<char> &f) { f[TYPE_OFFSET] = 7; }, "Invalid vector index file");
+    check([](std::vector<char> &f) { patch<uint32_t>(f, DIM_OFFSET, 0); }, "Invalid vector index file");
+    check([](std::vector<char> &f) { patch<uint32_t>(f, DIM_OFFSET, 1u << 20); }, "Invalid vector index file");
+    check([](std::vector<char> &f) { patch<uint32_t>(f, M_OFFSET, 1); }, "Invalid vector index file");
+    check([](std::vector<char> &f) { patch<uint32_t>(f, M_OFFSET, 70000); }, "Invalid vector index file");
+    check([&](std::vector<char> &f) { patch<uint64_t>(f, COUNT_OFFSET, count + 1000); }, "Truncated vector index file");
+    check([](std::vector<char> &f) { patch<uint64_t>(f, COUNT_OFFSET, uint64_t(1) << 40); }, "Truncated vector index file");
+    check([](std::vector<char> &f) { patch<uint64_t>(f, UPPER_WORDS_OFFSET, uint64_t(1) << 62); }, "Truncated vector index file");
+    check([&](std::vector<char> &f) { patch<uint32_t>(f, ENTRY_OFFSET, static_cast<uint32_t>(count)); }, "Invalid vector index graph");
+    check([&](std::vector<char> &f) {
+        patch<int32_t>(f, MAX_LEVEL_OFFSET, field<int32_t>(f, MAX_LEVEL_OFFSET) + 1);
+    }, "Invalid vector index graph");
+    check([&](std::vector<char> &f) {
+        patch<uint64_t>(f, UPPER_WORDS_OFFSET, field<uint64_t>(f, UPPER_WORDS_OFFSET) - 1);
+    }, "Invalid vector index graph");
+}
+
+void testCorruptGraph(const ScratchDir &dir) {
+    // Levels and links are trusted while searching, so every damaged byte
+    // must either be rejected or leave a graph that is safe to walk
+    const std::vector<char> file = smallHnswFile(dir);
+    const size_t graph = HEADER_SIZE + 100 * 8 * sizeof(float);
+    std::vector<float> queries = randomRows(3, 8, 9);
+    size_t rejected = 0;
+    for (size_t offset = graph; offset < file.size(); ++offset) {
+        for (uint8_t mask : {0x01, 0x80}) {
+            std::vector<char> corrupt = file;
+            corrupt[offset] ^= mask;
+            writeFile(dir / "corrupt.qvidx", corrupt);
+            std::unique_ptr<VectorIndex> index;
+            try {
+                index = VectorIndex::load(dir / "corrupt.qvidx");
+            } catch (const std::runtime_error &e) {
+                CHECK(std::string(e.what()).find("vector index") != std::string::npos);
+                rejected++;
+                continue;
+            }
+            for (size_t q = 0; q < 3; ++q) {
+                for (const SearchHit &hit : index->search(queries.data() + q * 8, 10)) {
+                    CHECK(hit.id < 100);
+                }
+            }
+        }
+    }
+    CHECK(rejected > 0);
+}
+
+} // namespace
+
+int main(int argc, char **argv) {
+    ScratchDir dir(argc, argv);
+    testOptionBounds();
+    testFlatSearch();
+    testHnswRecall();
+    testSaveLoad(dir);
+    testTruncated(dir);
+    testCorruptHeader(dir);
+    testCorruptGraph(dir);
+    std::puts("vector_index_test passed");
+    return 0;
+}